@@ -8,23 +8,124 @@ set(PICO_BOARD pico)
 # Name of the '.uf2' firmware file to write to flash.
 set(BOOTLOADER_FIRMWARE_FILENAME "firmware.uf2")
 
+# Optional directory of versioned '.uf2' files (see 'scripts/uf2_version.py').  If the firmware
+# file above is not present, the newest file in this directory built for PICO_BOARD is
+# installed, but only if it is newer than the installed firmware.  The bootloader reads only
+# the first block of each file to choose, and files in this directory are not deleted.  Set to
+# a directory name (e.g., "firmware") to enable.
+set(BOOTLOADER_FIRMWARE_DIR "")
+
+# Optional log file on the SD card.  After each update attempt, the bootloader appends a 60 byte
+# record of the image size, blocks and bytes read, sectors erased, SD card baud rate, time
+# spent in each phase and the result (see 'src/boot3/update_log.h').  The record is written
+# once the flash work is done.  Convert collected logs to CSV with 'scripts/update_log.py'.
+# Set to a file name (e.g., "update.log") to enable.
+set(BOOTLOADER_UPDATE_LOG "")
+
 # Typically, PICO_FLASH_SIZE_BYTES is set by the SDK based on the board type.
 # math(EXPR PICO_FLASH_SIZE_BYTES "2 * 1024 * 1024" OUTPUT_FORMAT HEXADECIMAL)
 
-# Reserve 64kB for the bootloader
+# Optionally build a size-optimized bootloader, so that a smaller BOOTLOADER_SIZE (below) leaves
+# more flash for the firmware.  The compact build is compiled with -Os and drops floating point
+# support (including from printf).  It does not change the reservation, and is not known to fit
+# in 32kB.  FatFs keeps its write support (as configured by the FatFs_SPI submodule's
+# 'ffconf.h'): the bootloader deletes 'firmware.uf2' and may append to the update log, and
+# FatFs has no read-only configuration that keeps f_unlink (FF_FS_READONLY removes it, and
+# FF_FS_MINIMIZE removes f_unlink and f_stat).  Section garbage collection drops the FatFs
+# functions that are not called.
+set(BOOTLOADER_COMPACT false)
+
+# Optionally run the update's hot path from RAM: the UF2 passes ('prog.c', 'update.c', etc.),
+# the FatFs read path and the SD card's SPI driver (or the UART transport).  Otherwise, this
+# code executes through the same 16kB XIP cache that pass 1 fills with reads of the flash it
+# compares against.  The code is copied to RAM at startup, so the bootloader uses about the
+# same flash either way.  Running from RAM also lets pass 2 read the next blocks while the
+# flash erases in the background, and the build fails if anything that can run meanwhile is
+# linked into flash.  With BOOTLOADER_USE_UART, each pass logs its blocks per second for
+# comparison.
+set(BOOTLOADER_HOT_PATH_IN_RAM false)
+
+# Experimental: program pages with the flash chip's quad page program (1-1-4, instruction 0x32)
+# when its SFDP tables report one and its Quad Enable bit is set, instead of the bootrom's
+# single-lane page program.  This is driven directly through the SSI and has not yet been
+# verified on a device, so each page is read back.  If a page differs, the rest of the update
+# uses the single-lane program, and the update fails if the page cannot be completed.  The
+# chip's page program time (typically 0.4ms) dominates either way.
+set(BOOTLOADER_QUAD_PROGRAM false)
+
+# Reserve 64kB for the bootloader.  The last 4kB sector holds the version of the installed
+# firmware.  After linking, the build reports the bytes the bootloader uses and fails if it
+# does not fit.  To reserve less (e.g., for the compact build), round that size up to a
+# multiple of 4kB and add 4kB for the last sector.  The size depends on the options enabled
+# here, so check it again after changing them.  The firmware's linker script must match the
+# reservation.
 math(EXPR BOOTLOADER_SIZE "64 * 1024" OUTPUT_FORMAT HEXADECIMAL)
 
+# Optionally reserve flash below the bootloader for updates staged by the firmware itself
+# (e.g., received over a radio link).  See 'include/boot_control.h'.  Must be a multiple of
+# 4kB and large enough for the staged image plus a 256 byte header.  The firmware must not
+# extend into the staging area.  0 disables staging.
+math(EXPR BOOTLOADER_STAGING_SIZE "0" OUTPUT_FORMAT HEXADECIMAL)
+
+# Optionally reserve flash below the staging area (if any) for a copy of the sectors each
+# update overwrites.  If the new firmware is started BOOTLOADER_ROLLBACK_BOOTS times without
+# confirming that it works (see 'include/boot_control.h'), or the update is interrupted, the
+# previous firmware is copied back from flash.  Must be a multiple of 4kB, and hold a 4kB
+# header plus the sectors of the largest update (larger updates are installed without a
+# rollback copy).  The firmware must not extend into the slot.  0 disables rollback.
+math(EXPR BOOTLOADER_ROLLBACK_SIZE "0" OUTPUT_FORMAT HEXADECIMAL)
+set(BOOTLOADER_ROLLBACK_BOOTS 3)
+
+# Optionally check the installed firmware for flash corruption before starting it.  After each
+# update, the bootloader records a CRC-32 of each 4kB sector of the firmware in its last sector
+# (see 'src/boot3/scrub.h').  Before each start (other than after a watchdog reset), it checks
+# BOOTLOADER_SCRUB_KB of the firmware against them, beginning at a random sector, which takes
+# about 85ms per MB.  Set it to the size of the firmware (or larger) to check all of it on
+# every boot, or smaller to bound the delay and check the rest over later boots.  If a sector
+# does not match, the LED flashes "C" and the firmware is reinstalled from the SD card (if
+# present).  0 disables the scrub.
+set(BOOTLOADER_SCRUB_KB 0)
+
+# Selects how the bootloader starts the firmware:
+#
+#   false: Reset the device with the watchdog.  The device boots a second time through the
+#          bootrom, stage 2 and stage 3 bootloaders, which then jumps to the firmware.
+#   true:  Return the clocks and peripherals used by the bootloader to their reset state and
+#          jump directly to the firmware.  This avoids the second pass through the bootrom
+#          and stage 2 bootloader.  Peripherals the bootloader does not use are left as the
+#          bootrom left them.  (See "Measuring Boot Time" in 'README.md'.)
+set(BOOTLOADER_DIRECT_HANDOFF false)
+
 # Configure the LED status indicator
 set(BOOTLOADER_USE_LED true)
 set(BOOTLOADER_LED_PIN "PICO_DEFAULT_LED_PIN")
 
-# Configure UART logging.
+# Configure UART logging.  Messages are queued in a 2kB ring and sent by DMA while the
+# bootloader continues, so logging does not stall updates (see 'src/boot3/uart_log.h').
 set(BOOTLOADER_USE_UART false)
 set(BOOTLOADER_UART "PICO_DEFAULT_UART")
 set(BOOTLOADER_UART_TX_PIN "PICO_DEFAULT_UART_TX_PIN")
 set(BOOTLOADER_UART_RX_PIN "PICO_DEFAULT_UART_RX_PIN")
 set(BOOTLOADER_UART_BAUD_RATE "PICO_DEFAULT_UART_BAUD_RATE")
 
+# Optionally time f_read, flash erase/program, memcmp, process_block, SHA-256 (signed
+# images only) and AES decryption (encrypted images only) during updates.
+# The resulting latency histograms are written to the UART (requires BOOTLOADER_USE_UART)
+# after each update in a compact binary form.  Decode with 'scripts/profile_decode.py'.
+set(BOOTLOADER_USE_PROFILE false)
+
+# Optionally accept only UF2 files signed by 'scripts/uf2_sign.py' with the matching private
+# key.  Set to the Ed25519 public key printed by 'scripts/uf2_sign.py --keygen' (64 hex
+# digits).  Leave empty to accept unsigned UF2 files.
+set(BOOTLOADER_SIGNING_KEY "")
+
+# Optionally accept UF2 files encrypted by 'scripts/uf2_encrypt.py' with the same key, so that
+# images on the SD card are not stored as plaintext.  Set to the AES-128 key printed by
+# 'scripts/uf2_encrypt.py --keygen' (32 hex digits).  Unencrypted UF2 files are still
+# accepted; combine with BOOTLOADER_SIGNING_KEY to reject files that were not prepared by you.
+# Leave empty to reject encrypted UF2 files.
+set(BOOTLOADER_ENCRYPTION_KEY "")
+
 #  Pico Pin | GPIO      | Adapter Pin | Description               
 # ----------|-----------|-------------|---------------------------
 #  21       | 16 (RX)   | DO          | Data out (from SD card)
@@ -49,3 +150,30 @@ set(BOOTLOADER_SD_DETECT_PIN 22)
 
 # SD card SPI baud rate: 12.5MHz
 set(BOOTLOADER_SD_BAUD_RATE 12500000)
+
+# Optional tuning file in the SD card's root directory.  Its 'key = value' lines override the
+# SPI baud rate (up to BOOTLOADER_SD_BAUD_RATE_MAX), whether the LED blinks during updates,
+# and whether updates that match the installed firmware are skipped, for updates from that
+# card (see 'src/boot3/tuning.h').  Out of range values are ignored.  Set to a file name
+# (e.g., "tuning.txt") to enable.
+set(BOOTLOADER_TUNING_FILE "")
+set(BOOTLOADER_SD_BAUD_RATE_MAX 25000000)
+
+# Check the SD card for firmware updates.
+set(BOOTLOADER_USE_SD true)
+
+# Optionally accept firmware streamed over a UART (e.g., by a factory station running
+# 'scripts/uf2_stream.py').  On each poll, the bootloader offers to receive a file and waits
+# up to BOOTLOADER_UART_TRANSPORT_PROBE_MS for a reply.  Blocks are sent in CRC-checked
+# frames (see 'src/boot3/uart_proto.h') and a read fails after repeated timeouts of
+# BOOTLOADER_UART_TRANSPORT_TIMEOUT_MS.
+#
+# The UART must not be the one used for diagnostics (BOOTLOADER_UART), and its pins must not
+# overlap the SD card's.
+set(BOOTLOADER_USE_UART_TRANSPORT false)
+set(BOOTLOADER_UART_TRANSPORT 1)
+set(BOOTLOADER_UART_TRANSPORT_TX_PIN 4)
+set(BOOTLOADER_UART_TRANSPORT_RX_PIN 5)
+set(BOOTLOADER_UART_TRANSPORT_BAUD_RATE 3000000)
+set(BOOTLOADER_UART_TRANSPORT_PROBE_MS 20)
+set(BOOTLOADER_UART_TRANSPORT_TIMEOUT_MS 500)
@@ -0,0 +1,227 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Header-only interface between the firmware and the SD card bootloader.  Copy this file
+// into (or add this directory to the include path of) the firmware project.
+//
+// Note: This header is also included by the stage 3 bootloader's assembly, so only
+// preprocessor definitions may appear outside of '#ifndef __ASSEMBLER__'.
+
+// Fast boot: On the next reboot, the stage 3 bootloader's entry point jumps directly to the
+// firmware before its C runtime starts, skipping the rest of the stage 3 bootloader (and the
+// SD card), if the watchdog scratch register BOOT_CONTROL_FAST_BOOT_SCRATCH contains
+// BOOT_CONTROL_FAST_BOOT_MAGIC.
+//
+// The register is cleared before checking the firmware's vector table, so the request applies
+// to a single reboot.  If the vector table is not plausible, the stage 3 bootloader runs as
+// normal.
+//
+// Watchdog scratch register 0 is otherwise available to the firmware, unless the bootloader
+// is built with a rollback slot (see below).  (Registers 1-2 hold the mailbox below and
+// registers 4-7 are used by the bootrom and Pico SDK.)
+#define BOOT_CONTROL_FAST_BOOT_SCRATCH  3
+#define BOOT_CONTROL_FAST_BOOT_MAGIC    0xFA57B007
+
+// Mailbox: Requests for the stage 3 bootloader on the next reboot.  The mailbox occupies two
+// watchdog scratch registers:
+//
+//     BOOT_CONTROL_MAILBOX_SCRATCH        magic (bits 31-16) | version (bits 15-8) | flags (bits 7-0)
+//     BOOT_CONTROL_MAILBOX_CHECK_SCRATCH  bitwise complement of the above
+//
+// The stage 3 bootloader reads and clears the mailbox at startup, so requests apply to a
+// single reboot.  Mailboxes with a different magic or version, or a mismatched complement,
+// are ignored.  Undefined flags are ignored.
+#define BOOT_CONTROL_MAILBOX_SCRATCH        2
+#define BOOT_CONTROL_MAILBOX_CHECK_SCRATCH  1
+#define BOOT_CONTROL_MAILBOX_MAGIC          0xB0C7
+#define BOOT_CONTROL_MAILBOX_VERSION        1
+
+// Run the firmware without mounting the SD card or checking for a firmware file.  (If the
+// firmware is not valid, the stage 3 bootloader polls for the SD card as usual.)
+#define BOOT_CONTROL_SKIP_SD_PROBE          (1u << 0)
+
+// Check the SD card for a firmware file.  Takes precedence over BOOT_CONTROL_SKIP_SD_PROBE.
+#define BOOT_CONTROL_FORCE_UPDATE_CHECK     (1u << 1)
+
+// If a firmware file is found, erase and rewrite every sector it covers, even if flash
+// already contains identical firmware.
+#define BOOT_CONTROL_FORCE_FULL_REWRITE     (1u << 2)
+
+#define BOOT_CONTROL_MAILBOX_FLAGS_MASK     0xFFu
+
+// Staging: If the bootloader is built with a staging area (BOOTLOADER_STAGING_SIZE in
+// 'config.cmake'), the firmware can install an update by writing it to flash directly below
+// the bootloader, at:
+//
+//     BOOT_CONTROL_STAGING_OFFSET(PICO_FLASH_SIZE_BYTES, BOOTLOADER_SIZE, BOOTLOADER_STAGING_SIZE)
+//
+// The first page of the staging area holds a boot_control_staging_header_t and the image
+// follows at BOOT_CONTROL_STAGING_DATA_OFFSET.  The image is either a UF2 file (RP2040 blocks
+// are installed) or a dense binary that is written to flash starting at XIP_BASE.  To stage
+// an update, the firmware:
+//
+//     1. Erases the staging area.
+//     2. Programs the image at BOOT_CONTROL_STAGING_DATA_OFFSET.
+//     3. Programs the header (see 'boot_control_staging_header()'), which marks the image
+//        as ready.
+//     4. Reboots (e.g., with 'boot_control_reboot(0)').
+//
+// The stage 3 bootloader validates and installs the staged image before checking the SD card,
+// then erases the header.  A staged image that fails validation is discarded.
+#define BOOT_CONTROL_STAGING_OFFSET(flash_size, bootloader_size, staging_size) \
+    ((flash_size) - (bootloader_size) - (staging_size))
+#define BOOT_CONTROL_STAGING_DATA_OFFSET    0x100
+#define BOOT_CONTROL_STAGING_MAGIC          0x47545342  // "BSTG" (little-endian)
+#define BOOT_CONTROL_STAGING_VERSION        1
+#define BOOT_CONTROL_STAGING_UF2            1
+#define BOOT_CONTROL_STAGING_DENSE          2
+
+// Rollback: If the bootloader is built with a rollback slot (BOOTLOADER_ROLLBACK_SIZE in
+// 'config.cmake'), each update first saves the sectors it overwrites.  The stage 3 bootloader
+// counts the starts of the new firmware in watchdog scratch register
+// BOOT_CONTROL_BOOT_COUNT_SCRATCH:
+//
+//     magic (bits 31-16) | count (bits 15-0)
+//
+// and restores the previous firmware once the count reaches BOOTLOADER_ROLLBACK_BOOTS.  The
+// firmware confirms that it works by writing BOOT_CONTROL_BOOT_CONFIRMED to the register
+// (see 'boot_control_confirm()'), which the stage 3 bootloader takes on the next reboot.
+// Power-on reset clears the register (and the count), so firmware should confirm on each
+// start once it is running normally.
+#define BOOT_CONTROL_BOOT_COUNT_SCRATCH     0
+#define BOOT_CONTROL_BOOT_COUNT_MAGIC       0xB0C0
+#define BOOT_CONTROL_BOOT_CONFIRMED         0x600DB007
+
+#ifndef __ASSEMBLER__
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <hardware/watchdog.h>
+
+typedef struct {
+    uint32_t magic;         // BOOT_CONTROL_STAGING_MAGIC
+    uint16_t version;       // BOOT_CONTROL_STAGING_VERSION
+    uint16_t format;        // BOOT_CONTROL_STAGING_UF2 or BOOT_CONTROL_STAGING_DENSE
+    uint32_t size;          // Size of the image in bytes
+    uint32_t crc;           // CRC-32 (as used by zlib) of the image
+} boot_control_staging_header_t;
+
+// Continues the CRC-32 (as used by zlib) over 'len' bytes at 'data'.  Pass 0 as the initial
+// 'crc' to start a new checksum.
+static inline uint32_t boot_control_crc32(uint32_t crc, const void* data, uint32_t len) {
+    const uint8_t* p = (const uint8_t*) data;
+
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+
+    return ~crc;
+}
+
+// Returns the staging header for the given image.
+static inline boot_control_staging_header_t boot_control_staging_header(uint16_t format, const void* image, uint32_t size) {
+    boot_control_staging_header_t header;
+    header.magic = BOOT_CONTROL_STAGING_MAGIC;
+    header.version = BOOT_CONTROL_STAGING_VERSION;
+    header.format = format;
+    header.size = size;
+    header.crc = boot_control_crc32(0, image, size);
+
+    return header;
+}
+
+// Returns the mailbox word for the given flags.  (The check register holds its complement.)
+static inline uint32_t boot_control_encode(uint32_t flags) {
+    return ((uint32_t) BOOT_CONTROL_MAILBOX_MAGIC << 16)
+        | ((uint32_t) BOOT_CONTROL_MAILBOX_VERSION << 8)
+        | (flags & BOOT_CONTROL_MAILBOX_FLAGS_MASK);
+}
+
+// Returns the flags from the given mailbox registers, or 0 if they do not hold a valid
+// mailbox.
+static inline uint32_t boot_control_decode(uint32_t word, uint32_t check) {
+    const bool ok = (word >> 16) == BOOT_CONTROL_MAILBOX_MAGIC
+        && ((word >> 8) & 0xFF) == BOOT_CONTROL_MAILBOX_VERSION
+        && check == ~word;
+
+    return ok
+        ? word & BOOT_CONTROL_MAILBOX_FLAGS_MASK
+        : 0;
+}
+
+// Posts the given flags for the stage 3 bootloader on the next reboot, replacing any
+// previous request.  Also cancels a pending fast boot, which would skip the stage 3
+// bootloader.
+static inline void boot_control_post(uint32_t flags) {
+    const uint32_t word = boot_control_encode(flags);
+    watchdog_hw->scratch[BOOT_CONTROL_FAST_BOOT_SCRATCH] = 0;
+    watchdog_hw->scratch[BOOT_CONTROL_MAILBOX_SCRATCH] = word;
+    watchdog_hw->scratch[BOOT_CONTROL_MAILBOX_CHECK_SCRATCH] = ~word;
+}
+
+// Returns the posted flags (or 0 if none) and clears the mailbox.  Used by the stage 3
+// bootloader.
+static inline uint32_t boot_control_take(void) {
+    const uint32_t flags = boot_control_decode(
+        watchdog_hw->scratch[BOOT_CONTROL_MAILBOX_SCRATCH],
+        watchdog_hw->scratch[BOOT_CONTROL_MAILBOX_CHECK_SCRATCH]);
+
+    watchdog_hw->scratch[BOOT_CONTROL_MAILBOX_SCRATCH] = 0;
+    watchdog_hw->scratch[BOOT_CONTROL_MAILBOX_CHECK_SCRATCH] = 0;
+
+    return flags;
+}
+
+// Returns the boot count register word for the given count.
+static inline uint32_t boot_control_encode_boot_count(uint32_t count) {
+    return ((uint32_t) BOOT_CONTROL_BOOT_COUNT_MAGIC << 16) | (count & 0xFFFF);
+}
+
+// Returns the count from the given boot count register word, or 0 if it does not hold a count.
+static inline uint32_t boot_control_decode_boot_count(uint32_t word) {
+    return (word >> 16) == BOOT_CONTROL_BOOT_COUNT_MAGIC
+        ? word & 0xFFFF
+        : 0;
+}
+
+// Confirms that the firmware installed by the last update works, so that the stage 3
+// bootloader does not roll it back.
+static inline void boot_control_confirm(void) {
+    watchdog_hw->scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH] = BOOT_CONTROL_BOOT_CONFIRMED;
+}
+
+// Reboots into the stage 3 bootloader with the given flags.  For example, after the
+// firmware has downloaded an update to the SD card:
+//
+//     boot_control_reboot(BOOT_CONTROL_FORCE_UPDATE_CHECK);
+static inline void boot_control_reboot(uint32_t flags) {
+    boot_control_post(flags);
+    watchdog_reboot(/* pc: */ 0, /* sp: */ 0, /* delay_ms: */ 0);
+
+    while (true) {
+        tight_loop_contents();
+    }
+}
+
+// Reboots directly into the firmware, without checking the SD card for updates.
+static inline void boot_control_reboot_to_firmware(void) {
+    watchdog_hw->scratch[BOOT_CONTROL_FAST_BOOT_SCRATCH] = BOOT_CONTROL_FAST_BOOT_MAGIC;
+    watchdog_reboot(/* pc: */ 0, /* sp: */ 0, /* delay_ms: */ 0);
+
+    while (true) {
+        tight_loop_contents();
+    }
+}
+
+#endif // __ASSEMBLER__
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Measures the time from the bootloader's handoff to the firmware's first UART output, to
+# compare builds with and without BOOTLOADER_DIRECT_HANDOFF.  Requires UART diagnostics
+# (BOOTLOADER_USE_UART) and firmware that prints to the same UART at the top of 'main()'.
+#
+# The on-chip timer cannot measure this, since it is reset by the watchdog, by the direct
+# handoff and again by the firmware's C runtime.  Instead, the host timestamps the end of the
+# bootloader's "[Boot3] Handoff" line (sent before the handoff, see 'run_firmware()') and the
+# first printable byte the firmware sends.  Both arrive through the same adapter, so its
+# latency cancels, but its jitter does not: reset the device several times (--count) and
+# compare the minimum and median.  (FTDI adapters buffer for 16 ms unless the latency timer
+# is lowered, e.g. 'setserial <port> low_latency'.)
+#
+# Usage: boot_time.py [--baud 115200] [--count 10] <port>
+
+import argparse
+import os
+import re
+import select
+import statistics
+import sys
+import termios
+import time
+import tty
+
+HANDOFF = re.compile(rb"\[Boot3\] Handoff: (\w+) at (\d+) us\r?\n")
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % baud)
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+
+    return fd
+
+
+def read(fd):
+    select.select([fd], [], [])
+    return os.read(fd, 4096), time.monotonic()
+
+
+def measure(fd):
+    # Wait for the bootloader's handoff line.
+    pending = b""
+    while True:
+        data, now = read(fd)
+        pending += data
+        match = HANDOFF.search(pending)
+        if match:
+            break
+        pending = pending[-256:]
+
+    path, boot3_us = match.group(1).decode(), int(match.group(2))
+    handoff = now
+    rest = pending[match.end():]
+
+    # Wait for the firmware's first printable byte.  (Pins may glitch while the device resets,
+    # which the UART receives as NUL or 0xFF bytes.)
+    while not any(0x20 <= b < 0x7F for b in rest):
+        rest, now = read(fd)
+
+    return path, boot3_us, (now - handoff) * 1e6
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure the time from the bootloader's handoff to the firmware's first output.")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--count", type=int, default=10, help="number of boots to measure")
+    parser.add_argument("port")
+    args = parser.parse_args()
+
+    fd = open_port(args.port, args.baud)
+    times = []
+
+    try:
+        print("Reset the device %d times..." % args.count, file=sys.stderr)
+        while len(times) < args.count:
+            path, boot3_us, handoff_us = measure(fd)
+            times.append(handoff_us)
+            print("%s handoff: bootloader ran %u us, firmware output after %.0f us" % (path, boot3_us, handoff_us))
+    finally:
+        os.close(fd)
+
+    print("Handoff to firmware output: min %.0f us, median %.0f us" % (min(times), statistics.median(times)))
+
+
+if __name__ == "__main__":
+    main()
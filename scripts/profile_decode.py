@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Decodes the latency histograms written to the UART by the bootloader when
+# BOOTLOADER_USE_PROFILE is enabled and prints percentiles for each operation.
+# See 'src/boot3/profile.h' for the frame format.
+#
+# Usage:
+#   profile_decode.py capture.bin                   # Decode frames from a UART capture
+#   profile_decode.py /dev/ttyACM0 --baud 115200    # Wait for frames on a serial port (requires pyserial)
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"BPRF"
+VERSION = 1
+
+# Must match 'profile_op_t' in 'src/boot3/profile.h'.
+OP_NAMES = ["f_read", "flash_erase", "flash_prog", "memcmp", "process_block", "sha256", "decrypt"]
+
+PERCENTILES = [50, 90, 99]
+
+
+class Truncated(Exception):
+    pass
+
+
+def get_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise Truncated()
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return value, pos
+
+
+def decode_frame(data, start):
+    # Returns (histograms, end) for the frame whose magic begins at 'start', or raises
+    # 'Truncated' if more data is needed and 'ValueError' if the frame is corrupt.
+    pos = start + len(MAGIC)
+    if pos + 3 > len(data):
+        raise Truncated()
+
+    version, num_ops, num_buckets = data[pos:pos + 3]
+    if version != VERSION:
+        raise ValueError(f"unsupported version {version}")
+    pos += 3
+
+    histograms = []
+    for op in range(num_ops):
+        count, pos = get_varint(data, pos)
+        total, pos = get_varint(data, pos)
+        maximum, pos = get_varint(data, pos)
+        buckets = []
+        for _ in range(num_buckets):
+            n, pos = get_varint(data, pos)
+            buckets.append(n)
+
+        name = OP_NAMES[op] if op < len(OP_NAMES) else f"op{op}"
+        histograms.append((name, count, total, maximum, buckets))
+
+    if pos + 4 > len(data):
+        raise Truncated()
+
+    (crc,) = struct.unpack_from("<I", data, pos)
+    if crc != zlib.crc32(data[start + len(MAGIC):pos]):
+        raise ValueError("CRC mismatch")
+
+    return histograms, pos + 4
+
+
+def bucket_upper_us(bucket):
+    # Bucket 0 holds 0us, bucket 'i' holds [2^(i-1), 2^i) us.
+    return 0 if bucket == 0 else (1 << bucket) - 1
+
+
+def percentile(buckets, count, maximum, p):
+    # Returns an upper bound on the p-th percentile (exact to within a factor of 2).
+    target = max(1, -(-count * p // 100))
+    seen = 0
+    for bucket, n in enumerate(buckets):
+        seen += n
+        if seen >= target:
+            return min(bucket_upper_us(bucket), maximum)
+    return maximum
+
+
+def print_histograms(histograms, clk_mhz=None):
+    header = f"{'op':<14}{'count':>8}{'total ms':>11}{'mean us':>10}"
+    header += "".join(f"{'p' + str(p) + ' us':>10}" for p in PERCENTILES)
+    header += f"{'max us':>10}"
+    if clk_mhz:
+        header += f"{'mean cyc':>12}"
+    print(header)
+
+    for name, count, total, maximum, buckets in histograms:
+        if count == 0:
+            print(f"{name:<14}{0:>8}")
+            continue
+
+        line = f"{name:<14}{count:>8}{total / 1000:>11.1f}{total / count:>10.1f}"
+        line += "".join(f"{'<=' + str(percentile(buckets, count, maximum, p)):>10}" for p in PERCENTILES)
+        line += f"{maximum:>10}"
+        if clk_mhz:
+            line += f"{total * clk_mhz / count:>12.0f}"
+        print(line)
+    print()
+
+
+def decode(data, clk_mhz=None):
+    # Decodes all complete frames in 'data' and returns the unconsumed tail.
+    pos = 0
+    while True:
+        start = data.find(MAGIC, pos)
+        if start < 0:
+            return data[max(0, len(data) - len(MAGIC) + 1):]
+        try:
+            histograms, pos = decode_frame(data, start)
+            print_histograms(histograms, clk_mhz)
+        except Truncated:
+            return data[start:]
+        except ValueError as e:
+            print(f"skipping corrupt frame: {e}", file=sys.stderr)
+            pos = start + 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode bootloader latency histograms.")
+    parser.add_argument("input", help="UART capture file, '-' for stdin, or serial port")
+    parser.add_argument("--baud", type=int, default=115200, help="baud rate when reading a serial port")
+    parser.add_argument("--clk-mhz", type=float, help="system clock, to also report the mean cost in cycles")
+    args = parser.parse_args()
+
+    if args.input == "-":
+        decode(sys.stdin.buffer.read(), args.clk_mhz)
+    elif args.input.startswith("/dev/"):
+        import serial
+        pending = b""
+        with serial.Serial(args.input, args.baud) as port:
+            while True:
+                pending = decode(pending + port.read(max(1, port.in_waiting)), args.clk_mhz)
+    else:
+        with open(args.input, "rb") as f:
+            decode(f.read(), args.clk_mhz)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Encrypts a UF2 file for a bootloader built with BOOTLOADER_ENCRYPTION_KEY.  Encrypts the
+# payload of each RP2040 flash block with AES-128 in counter mode and inserts an encryption
+# block holding the image's nonce (see 'src/boot3/encryption.h').
+#
+# Usage: uf2_encrypt.py --keygen <key.bin>
+#        uf2_encrypt.py <key.bin> <input.uf2> <output.uf2>
+#
+# '--keygen' writes a new key and prints it to set as BOOTLOADER_ENCRYPTION_KEY in
+# 'config.cmake'.  Keep the key secret.
+#
+# The manifest and signature describe the plaintext, so run 'uf2_manifest.py' and
+# 'uf2_sign.py' first.
+
+import os
+import struct
+import sys
+
+from uf2_manifest import (RP2040_FAMILY_ID, UF2_BLOCK_SIZE, UF2_FLAG_FAMILY_ID_PRESENT,
+                          UF2_FLAG_NOT_MAIN_FLASH, UF2_MAGIC_END, UF2_MAGIC_START0,
+                          UF2_MAGIC_START1, ENCRYPTION_MAGIC, FLASH_PAGE_SIZE, XIP_BASE, Block,
+                          is_encryption, read_blocks)
+
+ENCRYPTION_VERSION = 1
+ENCRYPTION_ALGORITHM_AES128_CTR = 1
+ENCRYPTION_HEADER = struct.Struct("<IHH12s8s")
+ENCRYPTION_KEY_CHECK_COUNTER = 0xFFFFFFFF
+
+#
+# AES-128 encryption (FIPS 197).  This is slow, but adequate for encrypting one image.
+#
+
+
+def xtime(x):
+    return ((x << 1) ^ (0x1B if x & 0x80 else 0)) & 0xFF
+
+
+def make_sbox():
+    # S(x) is the affine transform of the multiplicative inverse of x in GF(2^8).
+    exp, log = [0] * 255, [0] * 256
+    x = 1
+    for i in range(255):
+        exp[i], log[x] = x, i
+        x ^= xtime(x)  # Multiply by the generator 3
+    sbox = []
+    for x in range(256):
+        b = 0 if x == 0 else exp[(255 - log[x]) % 255]
+        s = b
+        for shift in range(1, 5):
+            s ^= ((b << shift) | (b >> (8 - shift))) & 0xFF
+        sbox.append(s ^ 0x63)
+    return sbox
+
+
+SBOX = make_sbox()
+
+
+def expand_key(key):
+    words = [list(key[i:i + 4]) for i in range(0, 16, 4)]
+    rcon = 1
+    for i in range(4, 44):
+        t = list(words[i - 1])
+        if i % 4 == 0:
+            t = [SBOX[b] for b in t[1:] + t[:1]]
+            t[0] ^= rcon
+            rcon = xtime(rcon)
+        words.append([a ^ b for a, b in zip(words[i - 4], t)])
+    return [sum(words[4 * r:4 * r + 4], []) for r in range(11)]
+
+
+def encrypt_block(round_keys, block):
+    # The state is 16 bytes in column order (state[r + 4c] is row r, column c).
+    s = [a ^ b for a, b in zip(block, round_keys[0])]
+    for r in range(1, 11):
+        s = [SBOX[b] for b in s]
+        s = [s[(i + 4 * (i % 4)) % 16] for i in range(16)]  # ShiftRows
+        if r < 10:
+            mixed = []
+            for c in range(4):
+                a = s[4 * c:4 * c + 4]
+                t = a[0] ^ a[1] ^ a[2] ^ a[3]
+                mixed += [a[i] ^ t ^ xtime(a[i] ^ a[(i + 1) % 4]) for i in range(4)]
+            s = mixed
+        s = [a ^ b for a, b in zip(s, round_keys[r])]
+    return bytes(s)
+
+
+def ctr_key_stream(round_keys, nonce, counter, length):
+    stream = b""
+    while len(stream) < length:
+        stream += encrypt_block(round_keys, nonce + struct.pack(">I", counter))
+        counter += 1
+    return stream[:length]
+
+
+#
+# UF2 encryption
+#
+
+def encryption_block(round_keys, nonce):
+    key_check = ctr_key_stream(round_keys, nonce, ENCRYPTION_KEY_CHECK_COUNTER, 8)
+    payload = ENCRYPTION_HEADER.pack(ENCRYPTION_MAGIC, ENCRYPTION_VERSION, ENCRYPTION_ALGORITHM_AES128_CTR,
+                                     nonce, key_check)
+
+    block = Block(bytes(UF2_BLOCK_SIZE))
+    block.magic_start0 = UF2_MAGIC_START0
+    block.magic_start1 = UF2_MAGIC_START1
+    block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT
+    block.payload_size = len(payload)
+    block.file_size = RP2040_FAMILY_ID
+    block.data = payload
+    block.magic_end = UF2_MAGIC_END
+    return block
+
+
+def encrypt(blocks, key, nonce):
+    if any(b.is_rp2040() and is_encryption(b) for b in blocks):
+        sys.exit("already encrypted")
+
+    flash = [i for i, b in enumerate(blocks) if b.is_rp2040() and b.is_flash()]
+    if not flash:
+        sys.exit("no RP2040 flash blocks found")
+
+    round_keys = expand_key(key)
+
+    for i in flash:
+        block = blocks[i]
+        stream = ctr_key_stream(round_keys, nonce, (block.target_addr - XIP_BASE) // 16, FLASH_PAGE_SIZE)
+        payload = bytes(a ^ b for a, b in zip(block.data[:FLASH_PAGE_SIZE], stream))
+        block.data = payload + block.data[FLASH_PAGE_SIZE:]
+
+    # The nonce must precede the first flash block (and follow the image header, if any).
+    result = blocks[:flash[0]] + [encryption_block(round_keys, nonce)] + blocks[flash[0]:]
+
+    # Renumber the RP2040 blocks to account for the encryption block.
+    rp2040 = [b for b in result if b.is_rp2040()]
+    for block_no, block in enumerate(rp2040):
+        block.block_no = block_no
+        block.num_blocks = len(rp2040)
+
+    return result
+
+
+def read_key(path):
+    with open(path, "rb") as f:
+        key = f.read()
+
+    if len(key) != 16:
+        sys.exit(f"{path}: expected a 16-byte AES-128 key")
+
+    return key
+
+
+def main():
+    if len(sys.argv) == 3 and sys.argv[1] == "--keygen":
+        key = os.urandom(16)
+        with open(os.open(sys.argv[2], os.O_WRONLY | os.O_CREAT | os.O_EXCL, 0o600), "wb") as f:
+            f.write(key)
+        print(f"BOOTLOADER_ENCRYPTION_KEY {key.hex()}")
+        return
+
+    if len(sys.argv) != 4:
+        sys.exit(f"usage: {sys.argv[0]} --keygen <key.bin>\n"
+                 f"       {sys.argv[0]} <key.bin> <input.uf2> <output.uf2>")
+
+    key = read_key(sys.argv[1])
+    blocks = encrypt(read_blocks(sys.argv[2]), key, os.urandom(12))
+
+    with open(sys.argv[3], "wb") as f:
+        for block in blocks:
+            f.write(block.pack())
+
+    print(f"{sys.argv[3]}: encrypted")
+
+
+if __name__ == "__main__":
+    main()
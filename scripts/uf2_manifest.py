@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Prepends a manifest to a UF2 file.  The manifest lists the flash sectors written by the
+# RP2040 image along with the CRC-32 of each sector, which lets the bootloader skip updates
+# (and unchanged sectors) without reading the entire UF2 file.
+#
+# See 'src/boot3/manifest.h' for the format.
+#
+# Usage: uf2_manifest.py <input.uf2> <output.uf2>
+
+import struct
+import sys
+import zlib
+
+UF2_MAGIC_START0 = 0x0A324655
+UF2_MAGIC_START1 = 0x9E5D5157
+UF2_MAGIC_END = 0x0AB16F30
+UF2_FLAG_NOT_MAIN_FLASH = 0x00000001
+UF2_FLAG_FAMILY_ID_PRESENT = 0x00002000
+RP2040_FAMILY_ID = 0xE48BFF56
+
+UF2_BLOCK_SIZE = 512
+UF2_HEADER = struct.Struct("<8I")
+UF2_DATA_SIZE = 476
+
+MANIFEST_MAGIC = 0x464E4D42
+MANIFEST_VERSION = 1
+MANIFEST_HEADER = struct.Struct("<IHHIII")
+MANIFEST_ENTRY = struct.Struct("<II")
+MANIFEST_MAX_ENTRIES_PER_BLOCK = (UF2_DATA_SIZE - MANIFEST_HEADER.size) // MANIFEST_ENTRY.size
+
+IMAGE_HEADER_MAGIC = 0x474D4942
+ENCRYPTION_MAGIC = 0x434E4542
+PARTIAL_MAGIC = 0x54525042
+
+XIP_BASE = 0x10000000
+FLASH_PAGE_SIZE = 256
+FLASH_SECTOR_SIZE = 4096
+
+
+class Block:
+    def __init__(self, raw):
+        (self.magic_start0, self.magic_start1, self.flags, self.target_addr,
+         self.payload_size, self.block_no, self.num_blocks, self.file_size) = UF2_HEADER.unpack_from(raw)
+        self.data = raw[UF2_HEADER.size:UF2_HEADER.size + UF2_DATA_SIZE]
+        (self.magic_end,) = struct.unpack_from("<I", raw, UF2_BLOCK_SIZE - 4)
+
+    def is_rp2040(self):
+        return (self.flags & UF2_FLAG_FAMILY_ID_PRESENT) != 0 and self.file_size == RP2040_FAMILY_ID
+
+    def is_flash(self):
+        return (self.flags & UF2_FLAG_NOT_MAIN_FLASH) == 0
+
+    def is_manifest(self):
+        return not self.is_flash() and struct.unpack_from("<I", self.data)[0] == MANIFEST_MAGIC
+
+    def pack(self):
+        return (UF2_HEADER.pack(self.magic_start0, self.magic_start1, self.flags, self.target_addr,
+                                self.payload_size, self.block_no, self.num_blocks, self.file_size)
+                + self.data.ljust(UF2_DATA_SIZE, b"\0")
+                + struct.pack("<I", self.magic_end))
+
+
+def is_image_header(block):
+    return not block.is_flash() and struct.unpack_from("<I", block.data)[0] == IMAGE_HEADER_MAGIC
+
+
+def is_encryption(block):
+    return not block.is_flash() and struct.unpack_from("<I", block.data)[0] == ENCRYPTION_MAGIC
+
+
+def is_partial(block):
+    return not block.is_flash() and struct.unpack_from("<I", block.data)[0] == PARTIAL_MAGIC
+
+
+def partly_written_sectors(pages):
+    # Returns the sectors that the given (addr, data) pages write only in part.
+    written = {}
+    for addr, _ in pages:
+        sector = (addr - XIP_BASE) // FLASH_SECTOR_SIZE
+        written[sector] = written.get(sector, 0) + 1
+    return sorted(s for s, count in written.items() if count < FLASH_SECTOR_SIZE // FLASH_PAGE_SIZE)
+
+
+def check_not_encrypted(blocks, action):
+    # The manifest and signature describe the plaintext ('uf2_encrypt.py' runs last).
+    if any(b.is_rp2040() and is_encryption(b) for b in blocks):
+        sys.exit(f"cannot {action} an encrypted UF2 file; encrypt it afterwards")
+
+
+def read_blocks(path):
+    with open(path, "rb") as f:
+        raw = f.read()
+
+    if len(raw) % UF2_BLOCK_SIZE != 0:
+        sys.exit(f"{path}: size is not a multiple of {UF2_BLOCK_SIZE} bytes")
+
+    blocks = [Block(raw[i:i + UF2_BLOCK_SIZE]) for i in range(0, len(raw), UF2_BLOCK_SIZE)]
+
+    for block in blocks:
+        if (block.magic_start0, block.magic_start1, block.magic_end) != (UF2_MAGIC_START0, UF2_MAGIC_START1, UF2_MAGIC_END):
+            sys.exit(f"{path}: invalid UF2 block")
+
+    return blocks
+
+
+def sector_crcs(pages):
+    # Returns a list of (sector, crc) for each sector written, as it will appear in flash.
+    sectors = {}
+    for addr, data in pages:
+        offset = addr - XIP_BASE
+        sector = sectors.setdefault(offset // FLASH_SECTOR_SIZE, bytearray(b"\xff" * FLASH_SECTOR_SIZE))
+        start = offset % FLASH_SECTOR_SIZE
+        sector[start:start + FLASH_PAGE_SIZE] = data[:FLASH_PAGE_SIZE]
+
+    # For sector 0, the stage 2 bootloader is excluded (the bootloader preserves its own).
+    return [(index, zlib.crc32(sectors[index][FLASH_PAGE_SIZE if index == 0 else 0:]))
+            for index in sorted(sectors)]
+
+
+def manifest_blocks(entries, image_crc):
+    blocks = []
+    for first in range(0, len(entries), MANIFEST_MAX_ENTRIES_PER_BLOCK):
+        chunk = entries[first:first + MANIFEST_MAX_ENTRIES_PER_BLOCK]
+        payload = MANIFEST_HEADER.pack(MANIFEST_MAGIC, MANIFEST_VERSION, len(chunk), first, len(entries), image_crc)
+        payload += b"".join(MANIFEST_ENTRY.pack(sector, crc) for sector, crc in chunk)
+
+        block = Block(bytes(UF2_BLOCK_SIZE))
+        block.magic_start0 = UF2_MAGIC_START0
+        block.magic_start1 = UF2_MAGIC_START1
+        block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT
+        block.payload_size = len(payload)
+        block.file_size = RP2040_FAMILY_ID
+        block.data = payload
+        block.magic_end = UF2_MAGIC_END
+        blocks.append(block)
+    return blocks
+
+
+def add_manifest(blocks):
+    check_not_encrypted(blocks, "add a manifest to")
+
+    # Drop any existing manifest so that the script can be run repeatedly.
+    blocks = [b for b in blocks if not (b.is_rp2040() and b.is_manifest())]
+
+    pages = [(b.target_addr, b.data) for b in blocks if b.is_rp2040() and b.is_flash()]
+    if not pages:
+        sys.exit("no RP2040 flash blocks found")
+
+    # A partial update preserves the pages it does not write, so the manifest's CRCs (which
+    # assume those pages are erased) would never match.
+    if any(b.is_rp2040() and is_partial(b) for b in blocks) and partly_written_sectors(pages):
+        sys.exit("a partial update with a manifest must write whole sectors")
+
+    addrs = [addr for addr, _ in pages]
+    if addrs != sorted(addrs):
+        print("warning: blocks are not in ascending address order; the bootloader will "
+              "not be able to verify per-sector CRCs", file=sys.stderr)
+
+    image_crc = 0
+    for _, data in pages:
+        image_crc = zlib.crc32(data[:FLASH_PAGE_SIZE], image_crc)
+
+    entries = sector_crcs(pages)
+
+    # The image header ('uf2_version.py'), if any, must remain the first block.
+    headers = [b for b in blocks if b.is_rp2040() and is_image_header(b)]
+    others = [b for b in blocks if not (b.is_rp2040() and is_image_header(b))]
+    result = headers + manifest_blocks(entries, image_crc) + others
+
+    # Renumber the RP2040 blocks to account for the manifest.
+    rp2040 = [b for b in result if b.is_rp2040()]
+    for block_no, block in enumerate(rp2040):
+        block.block_no = block_no
+        block.num_blocks = len(rp2040)
+
+    return result, entries
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(f"usage: {sys.argv[0]} <input.uf2> <output.uf2>")
+
+    blocks, entries = add_manifest(read_blocks(sys.argv[1]))
+
+    with open(sys.argv[2], "wb") as f:
+        for block in blocks:
+            f.write(block.pack())
+
+    print(f"{sys.argv[2]}: {len(entries)} sectors in manifest")
+
+
+if __name__ == "__main__":
+    main()
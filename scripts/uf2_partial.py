@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Marks a UF2 file as a partial update by inserting a partial-update block.  The bootloader
+# then rewrites only the pages in the UF2 file (e.g., an asset region) and keeps the rest of
+# the installed firmware, including its vector table.  The pages of a partly written sector
+# that the UF2 file does not write are preserved.
+#
+# See 'src/boot3/prog.h' for the format.  A partial update must not write the first 4kB sector
+# (the stage 2 bootloader and vector table).
+#
+# Usage: uf2_partial.py <input.uf2> <output.uf2>
+#
+# Run this before 'uf2_manifest.py', 'uf2_sign.py' and 'uf2_encrypt.py'.
+
+import struct
+import sys
+
+from uf2_manifest import (RP2040_FAMILY_ID, UF2_BLOCK_SIZE, UF2_FLAG_FAMILY_ID_PRESENT,
+                          UF2_FLAG_NOT_MAIN_FLASH, UF2_MAGIC_END, UF2_MAGIC_START0,
+                          UF2_MAGIC_START1, FLASH_SECTOR_SIZE, PARTIAL_MAGIC, XIP_BASE, Block,
+                          check_not_encrypted, is_image_header, is_partial,
+                          partly_written_sectors, read_blocks)
+
+PARTIAL_VERSION = 1
+PARTIAL_HEADER = struct.Struct("<IHH")
+
+
+def partial_block():
+    payload = PARTIAL_HEADER.pack(PARTIAL_MAGIC, PARTIAL_VERSION, 0)
+
+    block = Block(bytes(UF2_BLOCK_SIZE))
+    block.magic_start0 = UF2_MAGIC_START0
+    block.magic_start1 = UF2_MAGIC_START1
+    block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT
+    block.payload_size = len(payload)
+    block.file_size = RP2040_FAMILY_ID
+    block.data = payload
+    block.magic_end = UF2_MAGIC_END
+    return block
+
+
+def make_partial(blocks):
+    check_not_encrypted(blocks, "mark")
+
+    if any(b.is_rp2040() and b.is_manifest() for b in blocks):
+        sys.exit("remove the manifest first; run 'uf2_manifest.py' afterwards")
+
+    # Drop any existing partial-update block so that the script can be run repeatedly.
+    blocks = [b for b in blocks if not (b.is_rp2040() and is_partial(b))]
+
+    pages = [(b.target_addr, b.data) for b in blocks if b.is_rp2040() and b.is_flash()]
+    if not pages:
+        sys.exit("no RP2040 flash blocks found")
+
+    if any(addr < XIP_BASE + FLASH_SECTOR_SIZE for addr, _ in pages):
+        sys.exit("a partial update must not write the first sector (stage 2 bootloader and vector table)")
+
+    # The image header ('uf2_version.py'), if any, must remain the first block.
+    headers = [b for b in blocks if b.is_rp2040() and is_image_header(b)]
+    others = [b for b in blocks if not (b.is_rp2040() and is_image_header(b))]
+    result = headers + [partial_block()] + others
+
+    # Renumber the RP2040 blocks to account for the partial-update block.
+    rp2040 = [b for b in result if b.is_rp2040()]
+    for block_no, block in enumerate(rp2040):
+        block.block_no = block_no
+        block.num_blocks = len(rp2040)
+
+    return result, partly_written_sectors(pages)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(f"usage: {sys.argv[0]} <input.uf2> <output.uf2>")
+
+    blocks, preserved = make_partial(read_blocks(sys.argv[1]))
+
+    with open(sys.argv[2], "wb") as f:
+        for block in blocks:
+            f.write(block.pack())
+
+    print(f"{sys.argv[2]}: partial update, {len(preserved)} partly written sectors")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Signs a UF2 file for a bootloader built with BOOTLOADER_SIGNING_KEY.  Appends a signature
+# block holding the Ed25519 signature of the image digest (see 'src/boot3/signature.h').
+#
+# Usage: uf2_sign.py --keygen <key.bin>
+#        uf2_sign.py <key.bin> <input.uf2> <output.uf2>
+#
+# '--keygen' writes a new private key and prints the public key to set as
+# BOOTLOADER_SIGNING_KEY in 'config.cmake'.  Keep the private key secret.
+#
+# Signing may be combined with 'uf2_manifest.py' in either order, followed by 'uf2_encrypt.py'.
+
+import hashlib
+import os
+import struct
+import sys
+
+from uf2_manifest import (RP2040_FAMILY_ID, UF2_BLOCK_SIZE, UF2_FLAG_FAMILY_ID_PRESENT,
+                          UF2_FLAG_NOT_MAIN_FLASH, UF2_MAGIC_END, UF2_MAGIC_START0,
+                          UF2_MAGIC_START1, FLASH_PAGE_SIZE, Block, check_not_encrypted,
+                          read_blocks)
+
+SIGNATURE_MAGIC = 0x47495342
+SIGNATURE_VERSION = 1
+SIGNATURE_ALGORITHM_ED25519 = 1
+SIGNATURE_HEADER = struct.Struct("<IHH")
+
+#
+# Ed25519 signing (RFC 8032).  This is slow, but adequate for signing one digest.
+#
+
+P = 2**255 - 19
+L = 2**252 + 27742317777372353535851937790883648493
+D = -121665 * pow(121666, P - 2, P) % P
+
+
+def point_add(p, q):
+    x1, y1, z1, t1 = p
+    x2, y2, z2, t2 = q
+    a = (y1 - x1) * (y2 - x2) % P
+    b = (y1 + x1) * (y2 + x2) % P
+    c = t1 * 2 * D * t2 % P
+    d = z1 * 2 * z2 % P
+    e, f, g, h = b - a, d - c, d + c, b + a
+    return (e * f % P, g * h % P, f * g % P, e * h % P)
+
+
+def point_mul(s, p):
+    q = (0, 1, 1, 0)
+    while s > 0:
+        if s & 1:
+            q = point_add(q, p)
+        p = point_add(p, p)
+        s >>= 1
+    return q
+
+
+def point_encode(p):
+    x, y, z, _ = p
+    zi = pow(z, P - 2, P)
+    x, y = x * zi % P, y * zi % P
+    return int.to_bytes(y | ((x & 1) << 255), 32, "little")
+
+
+def base_point():
+    y = 4 * pow(5, P - 2, P) % P
+    xx = (y * y - 1) * pow(D * y * y + 1, P - 2, P)
+    x = pow(xx, (P + 3) // 8, P)
+    if (x * x - xx) % P != 0:
+        x = x * pow(2, (P - 1) // 4, P) % P
+    if x % 2 != 0:
+        x = P - x
+    return (x, y, 1, x * y % P)
+
+
+B = base_point()
+
+
+def expand_key(secret):
+    h = hashlib.sha512(secret).digest()
+    a = int.from_bytes(h[:32], "little")
+    a &= (1 << 254) - 8
+    a |= 1 << 254
+    return a, h[32:]
+
+
+def public_key(secret):
+    a, _ = expand_key(secret)
+    return point_encode(point_mul(a, B))
+
+
+def sign(secret, message):
+    a, prefix = expand_key(secret)
+    pk = point_encode(point_mul(a, B))
+    r = int.from_bytes(hashlib.sha512(prefix + message).digest(), "little") % L
+    R = point_encode(point_mul(r, B))
+    k = int.from_bytes(hashlib.sha512(R + pk + message).digest(), "little") % L
+    return R + int.to_bytes((r + k * a) % L, 32, "little")
+
+
+#
+# UF2 signing
+#
+
+def is_signature(block):
+    return not block.is_flash() and struct.unpack_from("<I", block.data)[0] == SIGNATURE_MAGIC
+
+
+def image_digest(blocks):
+    # SHA-256 of each RP2040 flash block's target address and payload, in file order.
+    sha = hashlib.sha256()
+    for block in blocks:
+        if block.is_rp2040() and block.is_flash():
+            sha.update(struct.pack("<I", block.target_addr))
+            sha.update(block.data[:FLASH_PAGE_SIZE])
+    return sha.digest()
+
+
+def signature_block(signature):
+    payload = SIGNATURE_HEADER.pack(SIGNATURE_MAGIC, SIGNATURE_VERSION, SIGNATURE_ALGORITHM_ED25519) + signature
+
+    block = Block(bytes(UF2_BLOCK_SIZE))
+    block.magic_start0 = UF2_MAGIC_START0
+    block.magic_start1 = UF2_MAGIC_START1
+    block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT
+    block.payload_size = len(payload)
+    block.file_size = RP2040_FAMILY_ID
+    block.data = payload
+    block.magic_end = UF2_MAGIC_END
+    return block
+
+
+def add_signature(blocks, secret):
+    check_not_encrypted(blocks, "sign")
+
+    # Drop any existing signature so that the script can be run repeatedly.
+    blocks = [b for b in blocks if not (b.is_rp2040() and is_signature(b))]
+
+    if not any(b.is_rp2040() and b.is_flash() for b in blocks):
+        sys.exit("no RP2040 flash blocks found")
+
+    result = blocks + [signature_block(sign(secret, image_digest(blocks)))]
+
+    # Renumber the RP2040 blocks to account for the signature.
+    rp2040 = [b for b in result if b.is_rp2040()]
+    for block_no, block in enumerate(rp2040):
+        block.block_no = block_no
+        block.num_blocks = len(rp2040)
+
+    return result
+
+
+def read_key(path):
+    with open(path, "rb") as f:
+        secret = f.read()
+
+    if len(secret) != 32:
+        sys.exit(f"{path}: expected a 32-byte Ed25519 private key")
+
+    return secret
+
+
+def main():
+    if len(sys.argv) == 3 and sys.argv[1] == "--keygen":
+        secret = os.urandom(32)
+        with open(os.open(sys.argv[2], os.O_WRONLY | os.O_CREAT | os.O_EXCL, 0o600), "wb") as f:
+            f.write(secret)
+        print(f"BOOTLOADER_SIGNING_KEY {public_key(secret).hex()}")
+        return
+
+    if len(sys.argv) != 4:
+        sys.exit(f"usage: {sys.argv[0]} --keygen <key.bin>\n"
+                 f"       {sys.argv[0]} <key.bin> <input.uf2> <output.uf2>")
+
+    secret = read_key(sys.argv[1])
+    blocks = add_signature(read_blocks(sys.argv[2]), secret)
+
+    with open(sys.argv[3], "wb") as f:
+        for block in blocks:
+            f.write(block.pack())
+
+    print(f"{sys.argv[3]}: signed with key {public_key(secret).hex()}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Streams a UF2 file to the bootloader's UART transport (BOOTLOADER_USE_UART_TRANSPORT in
+# 'config.cmake').  Waits for the device to probe, serves the file for each pass of the
+# update, and exits once the device reports that the firmware is installed.  With --repeat,
+# keeps serving the file to each device connected in turn (e.g., on a factory station).
+#
+# See 'src/boot3/uart_proto.h' for the protocol.
+#
+# Usage: uf2_stream.py [--baud 3000000] [--repeat] <port> <firmware.uf2>
+
+import argparse
+import os
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+import zlib
+
+SYNC = 0x5A
+VERSION = 1
+MAX_PAYLOAD = 512
+HEADER = struct.Struct("<BBHH")
+CRC = struct.Struct("<I")
+
+PROBE, READ, ACK, NAK, STOP, REMOVE = 0x01, 0x02, 0x03, 0x04, 0x05, 0x06
+NONE, OFFER, DATA, END, REMOVED = 0x80, 0x81, 0x82, 0x83, 0x86
+
+# Resend unacknowledged frames after this long.  Must exceed the time the device takes to
+# erase and program the flash for a window of blocks.
+TIMEOUT_S = 0.5
+
+
+def encode(frame_type, seq, payload=b""):
+    body = HEADER.pack(SYNC, frame_type, seq & 0xFFFF, len(payload))[1:] + payload
+    return bytes([SYNC]) + body + CRC.pack(zlib.crc32(body))
+
+
+class Decoder:
+    """Reassembles frames from a byte stream, discarding noise and corrupt frames."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+
+    def feed(self, data):
+        self.buffer += data
+        frames = []
+
+        while True:
+            start = self.buffer.find(bytes([SYNC]))
+            if start < 0:
+                self.buffer.clear()
+                return frames
+            del self.buffer[:start]
+
+            if len(self.buffer) < HEADER.size:
+                return frames
+
+            _, frame_type, seq, length = HEADER.unpack_from(self.buffer)
+            if length > MAX_PAYLOAD:
+                del self.buffer[:1]
+                continue
+
+            size = HEADER.size + length + CRC.size
+            if len(self.buffer) < size:
+                return frames
+
+            body = bytes(self.buffer[1:HEADER.size + length])
+            (crc,) = CRC.unpack_from(self.buffer, HEADER.size + length)
+            del self.buffer[:size if crc == zlib.crc32(body) else 1]
+
+            if crc == zlib.crc32(body):
+                frames.append((frame_type, seq, body[HEADER.size - 1:]))
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % baud)
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+
+    return fd
+
+
+def serve(fd, blocks, window):
+    """Serves the file to one device.  Returns once the device removes the file."""
+
+    decoder = Decoder()
+    num_blocks = len(blocks)
+    streaming = False
+    base = next_index = 0
+    last_heard = time.monotonic()
+    reads = 0
+
+    def unwrap(seq):
+        return base + ((seq - base + 0x8000) & 0xFFFF) - 0x8000
+
+    while True:
+        while streaming and next_index <= num_blocks and next_index < base + window:
+            if next_index == num_blocks:
+                os.write(fd, encode(END, next_index))
+            else:
+                os.write(fd, encode(DATA, next_index, blocks[next_index]))
+            next_index += 1
+
+        ready, _, _ = select.select([fd], [], [], 0.05)
+        if not ready:
+            if streaming and time.monotonic() - last_heard > TIMEOUT_S:
+                next_index = base
+                last_heard = time.monotonic()
+            continue
+
+        last_heard = time.monotonic()
+
+        for frame_type, seq, payload in decoder.feed(os.read(fd, 4096)):
+            if frame_type == PROBE:
+                streaming = False
+                if payload[:1] == bytes([VERSION]):
+                    window = max(1, min(window, payload[1]))
+                    os.write(fd, encode(OFFER, 0, struct.pack("<I", num_blocks)))
+                else:
+                    os.write(fd, encode(NONE, 0))
+            elif frame_type == READ:
+                reads += 1
+                print("Pass %d: sending %d blocks" % (reads, num_blocks), file=sys.stderr)
+                streaming = True
+                base = next_index = 0
+            elif frame_type == ACK and streaming:
+                acked = unwrap(seq)
+                if base < acked <= next_index:
+                    base = acked
+                    if base == num_blocks and next_index > num_blocks:
+                        streaming = False
+            elif frame_type == NAK:
+                missing = unwrap(seq)
+                if missing <= num_blocks:
+                    streaming = True
+                    base = next_index = missing
+            elif frame_type == STOP:
+                streaming = False
+            elif frame_type == REMOVE:
+                os.write(fd, encode(REMOVED, 0))
+                return
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stream a UF2 file to the bootloader over a UART.")
+    parser.add_argument("--baud", type=int, default=3000000)
+    parser.add_argument("--repeat", action="store_true", help="serve each device connected in turn")
+    parser.add_argument("port")
+    parser.add_argument("uf2")
+    args = parser.parse_args()
+
+    with open(args.uf2, "rb") as f:
+        data = f.read()
+
+    if not data or len(data) % MAX_PAYLOAD != 0:
+        sys.exit("%s: not a UF2 file" % args.uf2)
+
+    blocks = [data[i:i + MAX_PAYLOAD] for i in range(0, len(data), MAX_PAYLOAD)]
+    fd = open_port(args.port, args.baud)
+
+    try:
+        while True:
+            print("Waiting for device on %s..." % args.port, file=sys.stderr)
+            serve(fd, blocks, window=4)
+            print("Firmware installed.", file=sys.stderr)
+            if not args.repeat:
+                break
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Adds an image header to a UF2 file, identifying the firmware's version and the board it was
+# built for (see 'src/boot3/image_header.h').  The bootloader uses the header to choose the
+# newest UF2 file in its firmware directory (BOOTLOADER_FIRMWARE_DIR in 'config.cmake').
+#
+# Usage: uf2_version.py [--board <PICO_BOARD>] <version> <input.uf2> <output.uf2>
+#
+# The version is either an integer or 'major.minor.patch', which is encoded as
+# (major << 24) | (minor << 16) | patch.  Larger versions are newer.  Without '--board', the
+# image may be installed on any board.
+#
+# The image header must be the first block, so add it before or after 'uf2_manifest.py' and
+# 'uf2_sign.py' (which keep it first).
+
+import argparse
+import struct
+import sys
+
+from uf2_manifest import (RP2040_FAMILY_ID, UF2_BLOCK_SIZE, UF2_FLAG_FAMILY_ID_PRESENT,
+                          UF2_FLAG_NOT_MAIN_FLASH, UF2_MAGIC_END, UF2_MAGIC_START0,
+                          UF2_MAGIC_START1, Block, is_image_header, read_blocks)
+
+IMAGE_HEADER_MAGIC = 0x474D4942
+IMAGE_HEADER_VERSION = 1
+IMAGE_BOARD_ID_SIZE = 32
+IMAGE_HEADER = struct.Struct(f"<IHHI{IMAGE_BOARD_ID_SIZE}s")
+
+
+def parse_version(text):
+    parts = text.split(".")
+
+    try:
+        if len(parts) == 1:
+            version = int(parts[0], 0)
+        elif len(parts) == 3:
+            major, minor, patch = (int(part) for part in parts)
+            if major > 0xFF or minor > 0xFF or patch > 0xFFFF:
+                raise ValueError
+            version = (major << 24) | (minor << 16) | patch
+        else:
+            raise ValueError
+    except ValueError:
+        sys.exit(f"invalid version '{text}' (expected an integer or 'major.minor.patch')")
+
+    if not 0 <= version <= 0xFFFFFFFF:
+        sys.exit(f"version '{text}' does not fit in 32 bits")
+
+    return version
+
+
+def image_header_block(version, board):
+    board_id = board.encode()
+    if len(board_id) >= IMAGE_BOARD_ID_SIZE:
+        sys.exit(f"board ID '{board}' is longer than {IMAGE_BOARD_ID_SIZE - 1} characters")
+
+    payload = IMAGE_HEADER.pack(IMAGE_HEADER_MAGIC, IMAGE_HEADER_VERSION, 0, version, board_id)
+
+    block = Block(bytes(UF2_BLOCK_SIZE))
+    block.magic_start0 = UF2_MAGIC_START0
+    block.magic_start1 = UF2_MAGIC_START1
+    block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT
+    block.payload_size = len(payload)
+    block.file_size = RP2040_FAMILY_ID
+    block.data = payload
+    block.magic_end = UF2_MAGIC_END
+    return block
+
+
+def add_image_header(blocks, version, board):
+    # Drop any existing image header so that the script can be run repeatedly.
+    blocks = [b for b in blocks if not (b.is_rp2040() and is_image_header(b))]
+
+    if not any(b.is_rp2040() and b.is_flash() for b in blocks):
+        sys.exit("no RP2040 flash blocks found")
+
+    result = [image_header_block(version, board)] + blocks
+
+    # Renumber the RP2040 blocks to account for the image header.
+    rp2040 = [b for b in result if b.is_rp2040()]
+    for block_no, block in enumerate(rp2040):
+        block.block_no = block_no
+        block.num_blocks = len(rp2040)
+
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Adds a version and board ID to a UF2 file.")
+    parser.add_argument("--board", default="", help="board the firmware was built for (PICO_BOARD)")
+    parser.add_argument("version", help="integer or 'major.minor.patch'")
+    parser.add_argument("input")
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    version = parse_version(args.version)
+    blocks = add_image_header(read_blocks(args.input), version, args.board)
+
+    with open(args.output, "wb") as f:
+        for block in blocks:
+            f.write(block.pack())
+
+    print(f"{args.output}: version 0x{version:08x}, board '{args.board or '(any)'}'")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+#
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Converts the update logs written to SD cards by the bootloader (see BOOTLOADER_UPDATE_LOG in
+# 'config.cmake') to CSV, one row per update.  See 'src/boot3/update_log.h' for the record
+# format.
+#
+# Usage:
+#   update_log.py update.log                    # Print the records in one log
+#   update_log.py cards/ > updates.csv          # Collect logs from a directory of card dumps
+
+import argparse
+import csv
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"BULG"
+VERSION = 1
+
+# Fields up to and including 'result', followed by the reserved bytes and the CRC.  Must match
+# 'update_log_record_t' in 'src/boot3/update_log.h'.
+RECORD = struct.Struct("<4sHHIIIIII5IB3xI")
+
+# Must match 'update_log_phase_t' in 'src/boot3/update_log.h'.
+PHASE_NAMES = ["manifest", "validate", "prepare", "write", "finish"]
+
+# Must match 'update_result_t' in 'src/boot3/update.h'.
+RESULT_NAMES = ["programmed", "skipped", "invalid_uf2", "flash_failed"]
+
+COLUMNS = ["file", "index", "image_version", "image_size", "blocks_accepted", "sectors_erased",
+           "bytes_read", "baud_rate"] + [f"{name}_ms" for name in PHASE_NAMES] + ["total_ms", "result"]
+
+
+def decode_record(data, start):
+    # Returns (row, end) for the record whose magic begins at 'start', or raises 'ValueError' if
+    # the record is truncated or corrupt.
+    if start + 8 > len(data):
+        raise ValueError("truncated record")
+
+    version, size = struct.unpack_from("<HH", data, start + 4)
+    if version < VERSION or size < RECORD.size:
+        raise ValueError(f"unsupported version {version}")
+    if start + size > len(data):
+        raise ValueError("truncated record")
+
+    # The CRC is the last field, so later versions keep it at 'size - 4'.
+    (crc,) = struct.unpack_from("<I", data, start + size - 4)
+    if crc != zlib.crc32(data[start:start + size - 4]):
+        raise ValueError("CRC mismatch")
+
+    fields = RECORD.unpack_from(data, start)
+    (image_version, image_size, blocks_accepted, sectors_erased, bytes_read, baud_rate) = fields[3:9]
+    phase_us = fields[9:9 + len(PHASE_NAMES)]
+    result = fields[9 + len(PHASE_NAMES)]
+
+    row = {
+        "image_version": image_version,
+        "image_size": image_size,
+        "blocks_accepted": blocks_accepted,
+        "sectors_erased": sectors_erased,
+        "bytes_read": bytes_read,
+        "baud_rate": baud_rate,
+        "total_ms": f"{sum(phase_us) / 1000:.1f}",
+        "result": RESULT_NAMES[result] if result < len(RESULT_NAMES) else f"result{result}",
+    }
+    for name, us in zip(PHASE_NAMES, phase_us):
+        row[f"{name}_ms"] = f"{us / 1000:.1f}"
+
+    return row, start + size
+
+
+def decode(path, data, writer):
+    # Writes a row for each valid record.  A record cut short by a power loss is skipped by
+    # searching for the next magic.
+    pos = 0
+    index = 0
+    while True:
+        start = data.find(MAGIC, pos)
+        if start < 0:
+            return
+        try:
+            row, pos = decode_record(data, start)
+        except ValueError as e:
+            print(f"{path}: skipping record at offset {start}: {e}", file=sys.stderr)
+            pos = start + 1
+            continue
+        writer.writerow({"file": path, "index": index, **row})
+        index += 1
+
+
+def log_files(paths, name):
+    # Yields the given files and each file named 'name' below the given directories.
+    for path in paths:
+        if not os.path.isdir(path):
+            yield path
+            continue
+        for root, dirs, files in os.walk(path):
+            dirs.sort()
+            for file in sorted(files):
+                if file.lower() == name.lower():
+                    yield os.path.join(root, file)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert bootloader update logs to CSV.")
+    parser.add_argument("input", nargs="+", help="log files, or directories to search for them")
+    parser.add_argument("--name", default="update.log", help="log file name when searching directories")
+    args = parser.parse_args()
+
+    writer = csv.DictWriter(sys.stdout, fieldnames=COLUMNS)
+    writer.writeheader()
+
+    for path in log_files(args.input, args.name):
+        with open(path, "rb") as f:
+            decode(path, f.read(), writer)
+
+
+if __name__ == "__main__":
+    main()
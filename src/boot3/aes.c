@@ -0,0 +1,198 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// AES-128 (FIPS 197) encryption, table-driven for the Cortex-M0+:
+//
+//   * SubBytes, ShiftRows and MixColumns are combined into lookups in a single 1kB table,
+//     rotated for each row, rather than the usual four 1kB tables.  The M0+ rotates in one
+//     cycle, and the smaller table is built in RAM by 'aes128_init()', where each lookup is a
+//     two cycle load instead of a read through the XIP cache (which pass 1 floods with reads
+//     of the flash being compared).  The RP2040 has no data cache, so lookups take the same
+//     time for every index.
+//   * The final round takes the S-box from the same table, so the S-box in flash is only
+//     read while expanding the key.
+//   * The state is held as little-endian column words, so blocks load without byte swaps.
+//   * Only the forward cipher is implemented, since counter mode decrypts with it.
+//
+// Use BOOTLOADER_USE_PROFILE to measure the cost per UF2 block on the device (see
+// 'scripts/profile_decode.py').
+
+// Standard
+#include <stdbool.h>
+#include <string.h>
+
+// Project
+#include "aes.h"
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+// te[x] holds the bytes {2·S(x), S(x), S(x), 3·S(x)} (low to high), which is the MixColumns
+// column for row 0.  Rotating it left by 8, 16 or 24 bits gives the column for rows 1, 2 or 3.
+static uint32_t te[256];
+static bool is_te_built = false;
+
+static inline uint32_t rol(uint32_t x, uint32_t n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline uint8_t xtime(uint8_t x) {
+    return (uint8_t) ((x << 1) ^ ((x >> 7) * 0x1b));
+}
+
+static inline uint32_t load_le32(const uint8_t* p) {
+    return p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void store_le32(uint8_t* p, uint32_t x) {
+    p[0] = (uint8_t) x;
+    p[1] = (uint8_t) (x >> 8);
+    p[2] = (uint8_t) (x >> 16);
+    p[3] = (uint8_t) (x >> 24);
+}
+
+static void build_te() {
+    for (int x = 0; x < 256; x++) {
+        const uint8_t s = sbox[x];
+        const uint8_t s2 = xtime(s);
+        te[x] = s2 | ((uint32_t) s << 8) | ((uint32_t) s << 16) | ((uint32_t) (s2 ^ s) << 24);
+    }
+
+    is_te_built = true;
+}
+
+// One column of a full round: row 'r' of the output column is taken from row 'r' of 'a', 'b',
+// 'c' and 'd' respectively (i.e., ShiftRows), then mixed.
+#define ROUND_COLUMN(a, b, c, d, rk) (                  \
+    te[(a) & 0xFF] ^                                    \
+    rol(te[((b) >> 8) & 0xFF], 8) ^                     \
+    rol(te[((c) >> 16) & 0xFF], 16) ^                   \
+    rol(te[(d) >> 24], 24) ^ (rk))
+
+// One column of the final round, which omits MixColumns.  Byte 1 of each table entry is S(x).
+#define FINAL_COLUMN(a, b, c, d, rk) (                  \
+    ((te[(a) & 0xFF] >> 8) & 0x000000FF) ^              \
+    (te[((b) >> 8) & 0xFF] & 0x0000FF00) ^              \
+    ((te[((c) >> 16) & 0xFF] << 8) & 0x00FF0000) ^      \
+    ((te[(d) >> 24] << 16) & 0xFF000000) ^ (rk))
+
+static void encrypt_words(const aes128_t* aes, uint32_t state[4]) {
+    const uint32_t* rk = aes->round_keys;
+
+    uint32_t s0 = state[0] ^ rk[0];
+    uint32_t s1 = state[1] ^ rk[1];
+    uint32_t s2 = state[2] ^ rk[2];
+    uint32_t s3 = state[3] ^ rk[3];
+
+    for (int round = 1; round < AES128_ROUNDS; round++) {
+        rk += 4;
+        const uint32_t t0 = ROUND_COLUMN(s0, s1, s2, s3, rk[0]);
+        const uint32_t t1 = ROUND_COLUMN(s1, s2, s3, s0, rk[1]);
+        const uint32_t t2 = ROUND_COLUMN(s2, s3, s0, s1, rk[2]);
+        const uint32_t t3 = ROUND_COLUMN(s3, s0, s1, s2, rk[3]);
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    rk += 4;
+    state[0] = FINAL_COLUMN(s0, s1, s2, s3, rk[0]);
+    state[1] = FINAL_COLUMN(s1, s2, s3, s0, rk[1]);
+    state[2] = FINAL_COLUMN(s2, s3, s0, s1, rk[2]);
+    state[3] = FINAL_COLUMN(s3, s0, s1, s2, rk[3]);
+}
+
+void aes128_init(aes128_t* aes, const uint8_t key[AES128_KEY_SIZE]) {
+    if (!is_te_built) {
+        build_te();
+    }
+
+    uint32_t* w = aes->round_keys;
+    for (int i = 0; i < 4; i++) {
+        w[i] = load_le32(key + 4 * i);
+    }
+
+    uint8_t rcon = 0x01;
+    for (int i = 4; i < 4 * (AES128_ROUNDS + 1); i++) {
+        uint32_t t = w[i - 1];
+
+        if (i % 4 == 0) {
+            // SubWord(RotWord(t)) ^ Rcon, with the bytes of 't' stored low to high.
+            t = rol(t, 24);
+            t = sbox[t & 0xFF]
+                | ((uint32_t) sbox[(t >> 8) & 0xFF] << 8)
+                | ((uint32_t) sbox[(t >> 16) & 0xFF] << 16)
+                | ((uint32_t) sbox[t >> 24] << 24);
+            t ^= rcon;
+            rcon = xtime(rcon);
+        }
+
+        w[i] = w[i - 4] ^ t;
+    }
+}
+
+void aes128_encrypt(const aes128_t* aes, const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) {
+    uint32_t state[4];
+    for (int i = 0; i < 4; i++) {
+        state[i] = load_le32(in + 4 * i);
+    }
+
+    encrypt_words(aes, state);
+
+    for (int i = 0; i < 4; i++) {
+        store_le32(out + 4 * i, state[i]);
+    }
+}
+
+void aes128_ctr(const aes128_t* aes, uint8_t counter[AES_BLOCK_SIZE], uint8_t* data, size_t len) {
+    uint32_t key_stream[4];
+
+    while (len > 0) {
+        for (int i = 0; i < 4; i++) {
+            key_stream[i] = load_le32(counter + 4 * i);
+        }
+
+        encrypt_words(aes, key_stream);
+
+        for (int i = AES_BLOCK_SIZE - 1; i >= 0 && ++counter[i] == 0; i--) { }
+
+        const size_t count = len < AES_BLOCK_SIZE ? len : AES_BLOCK_SIZE;
+
+        if (count == AES_BLOCK_SIZE && ((uintptr_t) data & 3) == 0) {
+            // Whole, aligned block (e.g., a UF2 payload): XOR a word at a time.
+            uint8_t* aligned = __builtin_assume_aligned(data, 4);
+            for (int i = 0; i < 4; i++) {
+                uint32_t word;
+                memcpy(&word, aligned + 4 * i, sizeof(word));
+                word ^= key_stream[i];
+                memcpy(aligned + 4 * i, &word, sizeof(word));
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                data[i] ^= (uint8_t) (key_stream[i / 4] >> (8 * (i % 4)));
+            }
+        }
+
+        data += count;
+        len -= count;
+    }
+}
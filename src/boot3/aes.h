@@ -0,0 +1,37 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AES_BLOCK_SIZE 16
+#define AES128_KEY_SIZE 16
+#define AES128_ROUNDS 10
+
+typedef struct {
+    uint32_t round_keys[4 * (AES128_ROUNDS + 1)];   // Expanded key (little-endian column words)
+} aes128_t;
+
+// Expands the given key.
+void aes128_init(aes128_t* aes, const uint8_t key[AES128_KEY_SIZE]);
+
+// Encrypts a single block (FIPS 197).
+void aes128_encrypt(const aes128_t* aes, const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]);
+
+// Encrypts or decrypts 'len' bytes at 'data' in place in counter mode (NIST SP 800-38A).  The
+// 'counter' block is incremented as a 128-bit big-endian integer for each block, so that a
+// following call continues the key stream (if 'len' is a multiple of AES_BLOCK_SIZE).
+void aes128_ctr(const aes128_t* aes, uint8_t counter[AES_BLOCK_SIZE], uint8_t* data, size_t len);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,26 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Continues the standard CRC-32 (IEEE 802.3, as used by zlib) over 'len' bytes at 'data'.
+// Pass 0 as the initial 'crc' to start a new checksum.
+uint32_t crc32_update(uint32_t crc, const void* data, size_t len);
+
+// Continues the CRC-32 over 'len' bytes that all have the given 'value'.  This is used to
+// account for unwritten (erased) flash, which reads as 0xFF.
+uint32_t crc32_fill(uint32_t crc, uint8_t value, size_t len);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
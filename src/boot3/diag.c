@@ -5,40 +5,44 @@
 
 // Standard
 #include <stdint.h>
-#include <stdio.h>
 
 // Pico SDK
 #include <hardware/gpio.h>
 #include <pico/stdlib.h>
+#include <pico/time.h>
 
 // Project
 #include "diag.h"
+#include "diag_pattern.h"
+#include "uart_log.h"
 
 typedef struct diag_message_s {
     const char* message;
     bool is_fatal;
-    const uint8_t* pattern;
 } diag_message_t;
 
-typedef const uint8_t morse_pattern_t[];
-static const morse_pattern_t morse_d = { 3, 1, 1, 0 };
-static const morse_pattern_t morse_e = { 1, 0 };
-static const morse_pattern_t morse_f = { 1, 1, 3, 1, 0 };
-static const morse_pattern_t morse_i = { 1, 1, 0 };
-static const morse_pattern_t morse_n = { 3, 1, 0 };
-static const morse_pattern_t morse_s = { 3, 3, 3, 0 };
-static const morse_pattern_t morse_w = { 1, 3, 3, 0 };
-
 const diag_message_t messages[] = {
-    /* DIAG_ENTERING_FIRMWARE: */           { .message = "Entering firmware", .is_fatal = false, .pattern = morse_e },
-    /* FATAL_WATCHDOG_WITHOUT_FIRMWARE: */  { .message = "Watchdog bad firmware", .is_fatal = true, .pattern = morse_w },
-    /* DIAG_NO_FIRMWARE: */                 { .message = "No firmware", .is_fatal = false, .pattern = morse_n },
-    /* FATAL_FLASH_FAILED: */               { .message = "Flash failed", .is_fatal = true, .pattern = morse_f },
-    /* FATAL_INVALID_UF2: */                { .message = "Invalid UF2", .is_fatal = true, .pattern = morse_i },
-    /* DIAG_DELETE_FAILED: */               { .message = "Delete failed", .is_fatal = false, .pattern = morse_d },
-    /* DIAG_SKIPPED_PROGRAMMING: */         { .message = "Skipped programming", .is_fatal = false, .pattern = morse_s },
+    /* DIAG_ENTERING_FIRMWARE: */           { .message = "Entering firmware", .is_fatal = false },
+    /* FATAL_WATCHDOG_WITHOUT_FIRMWARE: */  { .message = "Watchdog bad firmware", .is_fatal = true },
+    /* DIAG_NO_FIRMWARE: */                 { .message = "No firmware", .is_fatal = false },
+    /* FATAL_FLASH_FAILED: */               { .message = "Flash failed", .is_fatal = true },
+    /* FATAL_INVALID_UF2: */                { .message = "Invalid UF2", .is_fatal = true },
+    /* DIAG_DELETE_FAILED: */               { .message = "Delete failed", .is_fatal = false },
+    /* DIAG_SKIPPED_PROGRAMMING: */         { .message = "Skipped programming", .is_fatal = false },
+    /* DIAG_STAGING_REJECTED: */            { .message = "Staged image rejected", .is_fatal = false },
+    /* DIAG_ROLLED_BACK: */                 { .message = "Rolled back", .is_fatal = false },
+    /* DIAG_SCRUB_FAILED: */                { .message = "Scrub failed", .is_fatal = false },
+    /* DIAG_IMAGE_REJECTED: */              { .message = "Image rejected", .is_fatal = false },
 };
 
+// LED patterns are played in the background by a timer alarm that steps through a table
+// of timed LED states, so that displaying a diagnostic code does not delay the bootloader.
+static diag_step_t steps[DIAG_MAX_STEPS];
+static volatile int num_steps;
+static volatile int current_step;
+static volatile bool is_repeating;
+static volatile alarm_id_t pattern_alarm;
+
 void diag_init() {
     #ifdef BOOTLOADER_USE_LED
     gpio_init(BOOTLOADER_LED_PIN);
@@ -47,69 +51,102 @@ void diag_init() {
     #endif
 
     #ifdef BOOTLOADER_USE_UART
-    stdio_uart_init_full(__CONCAT(uart, BOOTLOADER_UART), BOOTLOADER_UART_BAUD_RATE, BOOTLOADER_UART_TX_PIN, BOOTLOADER_UART_RX_PIN);
+    uart_log_init();
     #endif
 }
 
-void led_on() {
+static void led_put(bool on) {
     #ifdef BOOTLOADER_USE_LED
-    gpio_put(BOOTLOADER_LED_PIN, true);
+    gpio_put(BOOTLOADER_LED_PIN, on);
     #endif
 }
 
-void led_off() {
-    #ifdef BOOTLOADER_USE_LED
-    gpio_put(BOOTLOADER_LED_PIN, false);
-    #endif
+static void stop_pattern() {
+    if (pattern_alarm != 0) {
+        cancel_alarm(pattern_alarm);
+        pattern_alarm = 0;
+    }
 }
 
-void led_toggle() {
-    #ifdef BOOTLOADER_USE_LED
-    gpio_put(BOOTLOADER_LED_PIN, !gpio_get_out_level(BOOTLOADER_LED_PIN));
-    #endif
+// Invoked from the timer IRQ at the end of each step.  Returns the (negative) delay in
+// microseconds until the end of the next step, measured from when this step was scheduled
+// to end, or 0 when the pattern is complete.
+static int64_t pattern_alarm_callback(alarm_id_t id, void* user_data) {
+    int step = current_step + 1;
+
+    if (step >= num_steps) {
+        if (!is_repeating) {
+            pattern_alarm = 0;
+            return 0;
+        }
+
+        // Skip the leading gap when repeating.
+        step = 1;
+    }
+
+    current_step = step;
+    led_put(steps[step].led_on);
+    return -(int64_t) steps[step].duration_ms * 1000;
 }
 
-static bool is_led_on() {
-    #ifdef BOOTLOADER_USE_LED
-    return gpio_get_out_level(BOOTLOADER_LED_PIN) == 0;
-    #else
-    return false; // LED functionality is not enabled
-    #endif
+static void start_pattern(diag_code_t code, bool repeat) {
+    stop_pattern();
+
+    num_steps = diag_steps(diag_morse(code), steps);
+    current_step = 0;
+    is_repeating = repeat;
+
+    led_put(steps[0].led_on);
+    const alarm_id_t id = add_alarm_in_ms(steps[0].duration_ms, pattern_alarm_callback, NULL, true);
+    pattern_alarm = id > 0 ? id : 0;
 }
 
-static void blink(const uint8_t* pattern) {
-    const unsigned int dot = 100;
+bool diag_is_busy() {
+    return pattern_alarm != 0;
+}
 
-    if (is_led_on()) {
-        led_off();
-        sleep_ms(3 * dot);
-    }
+void diag_stop() {
+    stop_pattern();
+}
 
-    for (int i = 0; pattern[i] != 0; i++) {
-        led_on();
-        sleep_ms(pattern[i] * dot);
-        led_off();
-        sleep_ms(dot);
-    }
+// Direct control of the LED (e.g., progress indication) cancels any pattern in progress.
 
-    sleep_ms(3 * dot);
+void led_on() {
+    stop_pattern();
+    led_put(true);
 }
 
-static void diag_or_fatal(diag_code_t code) {
-    const diag_message_t* msg = &messages[code];
+void led_off() {
+    stop_pattern();
+    led_put(false);
+}
 
-    #ifdef BOOTLOADER_USE_UART
-    printf("[Boot3] (%u): %s\n", code, msg->message);
-    fflush(stdout);
-    #endif
+void led_toggle() {
+    stop_pattern();
 
     #ifdef BOOTLOADER_USE_LED
-    do {
-        blink(msg->pattern);
-    } while (msg->is_fatal);
+    gpio_put(BOOTLOADER_LED_PIN, !gpio_get_out_level(BOOTLOADER_LED_PIN));
     #endif
 }
 
+static void diag_or_fatal(diag_code_t code) {
+    const diag_message_t* msg = &messages[code];
+
+    // Queue "[Boot3] (<code>): <message>" for the UART.
+    LOG("[Boot3] (%u): %s\r\n", (unsigned) code, msg->message);
+
+    // Play the pattern in the background.  Fatal errors repeat the pattern forever.
+    start_pattern(code, msg->is_fatal);
+
+    if (msg->is_fatal) {
+        uart_log_flush();
+    }
+
+    while (msg->is_fatal) {
+        tight_loop_contents();
+    }
+}
+
 void diag(diag_code_t code) {
     assert(!messages[code].is_fatal);
     diag_or_fatal(code);
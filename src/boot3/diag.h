@@ -5,6 +5,9 @@
 
 #pragma once
 
+// Standard
+#include <stdbool.h>
+
 void led_on();
 void led_off();
 void led_toggle();
@@ -17,8 +20,23 @@ typedef enum diag_code_s {
     FATAL_INVALID_UF2 = 4,
     DIAG_DELETE_FAILED = 5,
     DIAG_SKIPPED_PROGRAMMING = 6,
+    DIAG_STAGING_REJECTED = 7,
+    DIAG_ROLLED_BACK = 8,
+    DIAG_SCRUB_FAILED = 9,
+    DIAG_IMAGE_REJECTED = 10,
 } diag_code_t;
 
 void diag_init(void);
+
+// Reports a diagnostic code over the UART and starts its LED pattern, which plays in the
+// background.  Returns immediately.
 void diag(diag_code_t code);
+
+// Reports a fatal diagnostic code and repeats its LED pattern forever.  Does not return.
 void fatal(diag_code_t code);
+
+// Returns true while an LED pattern is playing.
+bool diag_is_busy(void);
+
+// Stops the LED pattern in progress (if any), leaving the LED as it is.
+void diag_stop(void);
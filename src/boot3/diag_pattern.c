@@ -0,0 +1,59 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Pico SDK
+#include <pico/assert.h>
+
+// Project
+#include "diag_pattern.h"
+
+typedef const uint8_t morse_pattern_t[];
+static const morse_pattern_t morse_b = { 3, 1, 1, 1, 0 };
+static const morse_pattern_t morse_c = { 3, 1, 3, 1, 0 };
+static const morse_pattern_t morse_d = { 3, 1, 1, 0 };
+static const morse_pattern_t morse_e = { 1, 0 };
+static const morse_pattern_t morse_f = { 1, 1, 3, 1, 0 };
+static const morse_pattern_t morse_i = { 1, 1, 0 };
+static const morse_pattern_t morse_n = { 3, 1, 0 };
+static const morse_pattern_t morse_r = { 1, 3, 1, 0 };
+static const morse_pattern_t morse_s = { 3, 3, 3, 0 };
+static const morse_pattern_t morse_u = { 1, 1, 3, 0 };
+static const morse_pattern_t morse_w = { 1, 3, 3, 0 };
+
+static const uint8_t* const patterns[] = {
+    /* DIAG_ENTERING_FIRMWARE: */           morse_e,
+    /* FATAL_WATCHDOG_WITHOUT_FIRMWARE: */  morse_w,
+    /* DIAG_NO_FIRMWARE: */                 morse_n,
+    /* FATAL_FLASH_FAILED: */               morse_f,
+    /* FATAL_INVALID_UF2: */                morse_i,
+    /* DIAG_DELETE_FAILED: */               morse_d,
+    /* DIAG_SKIPPED_PROGRAMMING: */         morse_s,
+    /* DIAG_STAGING_REJECTED: */            morse_r,
+    /* DIAG_ROLLED_BACK: */                 morse_b,
+    /* DIAG_SCRUB_FAILED: */                morse_c,
+    /* DIAG_IMAGE_REJECTED: */              morse_u,
+};
+
+const uint8_t* diag_morse(diag_code_t code) {
+    return patterns[code];
+}
+
+int diag_steps(const uint8_t* morse, diag_step_t steps[DIAG_MAX_STEPS]) {
+    int n = 0;
+
+    steps[n++] = (diag_step_t) { .led_on = false, .duration_ms = 3 * DIAG_DOT_MS };
+
+    for (int i = 0; morse[i] != 0; i++) {
+        assert(i < DIAG_MAX_ELEMENTS);
+
+        steps[n++] = (diag_step_t) { .led_on = true, .duration_ms = morse[i] * DIAG_DOT_MS };
+        steps[n++] = (diag_step_t) { .led_on = false, .duration_ms = DIAG_DOT_MS };
+    }
+
+    // Extend the final gap to separate the pattern from whatever follows.
+    steps[n - 1].duration_ms += 3 * DIAG_DOT_MS;
+
+    return n;
+}
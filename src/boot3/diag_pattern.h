@@ -0,0 +1,49 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Project
+#include "diag.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Duration of a Morse "dot".  Dashes are 3 dots, and elements are separated by 1 dot.
+#define DIAG_DOT_MS 100
+
+// Longest Morse pattern (in elements) used by a diagnostic code.
+#define DIAG_MAX_ELEMENTS 4
+
+// A pattern is expanded into a table of steps, each of which holds the LED on or off for a
+// fixed duration:
+//
+//     step 0:          LED off for 3 dots (separates the pattern from prior LED activity)
+//     step 2i + 1:     LED on for the i-th element
+//     step 2i + 2:     LED off for 1 dot (4 dots after the last element)
+//
+// Repeating patterns (fatal errors) restart at step 1.
+#define DIAG_MAX_STEPS (2 * DIAG_MAX_ELEMENTS + 1)
+
+typedef struct {
+    bool led_on;            // LED state for this step
+    uint16_t duration_ms;   // How long to hold the LED state
+} diag_step_t;
+
+// Returns the zero-terminated Morse pattern for the given diagnostic code, where each element
+// is the duration of the LED 'on' time in dots.
+const uint8_t* diag_morse(diag_code_t code);
+
+// Expands the given Morse pattern into 'steps' and returns the number of steps.
+int diag_steps(const uint8_t* morse, diag_step_t steps[DIAG_MAX_STEPS]);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
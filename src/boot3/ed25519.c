@@ -0,0 +1,389 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Ed25519 signature verification, derived from the public domain TweetNaCl
+// (https://tweetnacl.cr.yp.to).  Field elements are 16 limbs of 16 bits held in int64_t,
+// which keeps the arithmetic simple and small at the cost of speed.  Expect a verification
+// to take on the order of a second on the RP2040 at 125MHz.  It runs once per update.
+
+// Standard
+#include <string.h>
+
+// Project
+#include "ed25519.h"
+#include "sha512.h"
+
+// An element of GF(2^255 - 19), as 16 limbs of 16 bits (little-endian).
+typedef int64_t gf[16];
+
+static const gf gf0 = { 0 };
+static const gf gf1 = { 1 };
+
+// Curve constant d = -121665/121666.
+static const gf D = {
+    0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070,
+    0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203
+};
+
+// 2 * d
+static const gf D2 = {
+    0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0,
+    0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406
+};
+
+// Base point B = (X, Y).
+static const gf X = {
+    0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c,
+    0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169
+};
+
+static const gf Y = {
+    0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666,
+    0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666
+};
+
+// sqrt(-1)
+static const gf I = {
+    0xa0b0, 0x4a0e, 0x1b27, 0xc4ee, 0xe478, 0xad2f, 0x1806, 0x2f43,
+    0xd7a7, 0x3dfb, 0x0099, 0x2b4d, 0xdf0b, 0x4fc1, 0x2480, 0x2b83
+};
+
+// Order of the base point, L = 2^252 + 27742317777372353535851937790883648493 (little-endian).
+static const int64_t L[32] = {
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10
+};
+
+static void set25519(gf r, const gf a) {
+    memcpy(r, a, sizeof(gf));
+}
+
+// Propagates carries so that each limb is within 16 bits.  The carry out of the top limb
+// wraps around to the bottom limb multiplied by 38 (since 2^256 = 38 mod p).
+static void car25519(gf o) {
+    for (int i = 0; i < 16; i++) {
+        const int64_t c = o[i] >> 16;
+        o[i] -= c * 65536;
+
+        if (i < 15) {
+            o[i + 1] += c;
+        } else {
+            o[0] += 38 * c;
+        }
+    }
+}
+
+// Swaps 'p' and 'q' if 'b' is 1.
+static void sel25519(gf p, gf q, int64_t b) {
+    const int64_t mask = ~(b - 1);
+    for (int i = 0; i < 16; i++) {
+        const int64_t t = mask & (p[i] ^ q[i]);
+        p[i] ^= t;
+        q[i] ^= t;
+    }
+}
+
+// Writes the canonical (fully reduced) little-endian encoding of 'n'.
+static void pack25519(uint8_t o[32], const gf n) {
+    gf m, t;
+    set25519(t, n);
+    car25519(t);
+    car25519(t);
+    car25519(t);
+
+    // Subtract p twice, keeping the result only if it did not go negative.
+    for (int j = 0; j < 2; j++) {
+        m[0] = t[0] - 0xffed;
+        for (int i = 1; i < 15; i++) {
+            m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+            m[i - 1] &= 0xffff;
+        }
+        m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+        const int64_t b = (m[15] >> 16) & 1;
+        m[14] &= 0xffff;
+        sel25519(t, m, 1 - b);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        o[2 * i] = (uint8_t) t[i];
+        o[2 * i + 1] = (uint8_t) (t[i] >> 8);
+    }
+}
+
+static bool neq25519(const gf a, const gf b) {
+    uint8_t c[32], d[32];
+    pack25519(c, a);
+    pack25519(d, b);
+    return memcmp(c, d, sizeof(c)) != 0;
+}
+
+static uint8_t par25519(const gf a) {
+    uint8_t d[32];
+    pack25519(d, a);
+    return d[0] & 1;
+}
+
+static void unpack25519(gf o, const uint8_t n[32]) {
+    for (int i = 0; i < 16; i++) {
+        o[i] = n[2 * i] + ((int64_t) n[2 * i + 1] << 8);
+    }
+    o[15] &= 0x7fff;
+}
+
+static void A(gf o, const gf a, const gf b) {
+    for (int i = 0; i < 16; i++) {
+        o[i] = a[i] + b[i];
+    }
+}
+
+static void Z(gf o, const gf a, const gf b) {
+    for (int i = 0; i < 16; i++) {
+        o[i] = a[i] - b[i];
+    }
+}
+
+static void M(gf o, const gf a, const gf b) {
+    int64_t t[31] = { 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            t[i + j] += a[i] * b[j];
+        }
+    }
+
+    // Fold the upper half back in (2^256 = 38 mod p).
+    for (int i = 0; i < 15; i++) {
+        t[i] += 38 * t[i + 16];
+    }
+
+    memcpy(o, t, sizeof(gf));
+    car25519(o);
+    car25519(o);
+}
+
+static void S(gf o, const gf a) {
+    M(o, a, a);
+}
+
+// o = i^(p - 2) = 1/i
+static void inv25519(gf o, const gf i) {
+    gf c;
+    set25519(c, i);
+    for (int a = 253; a >= 0; a--) {
+        S(c, c);
+        if (a != 2 && a != 4) {
+            M(c, c, i);
+        }
+    }
+    set25519(o, c);
+}
+
+// o = i^((p - 5) / 8)
+static void pow2523(gf o, const gf i) {
+    gf c;
+    set25519(c, i);
+    for (int a = 250; a >= 0; a--) {
+        S(c, c);
+        if (a != 1) {
+            M(c, c, i);
+        }
+    }
+    set25519(o, c);
+}
+
+// p = p + q, in extended coordinates (X, Y, Z, T).
+static void add(gf p[4], gf q[4]) {
+    gf a, b, c, d, t;
+
+    Z(a, p[1], p[0]);
+    Z(t, q[1], q[0]);
+    M(a, a, t);
+    A(b, p[0], p[1]);
+    A(t, q[0], q[1]);
+    M(b, b, t);
+    M(c, p[3], q[3]);
+    M(c, c, D2);
+    M(d, p[2], q[2]);
+    A(d, d, d);
+
+    Z(t, b, a);     // e
+    A(b, b, a);     // h
+    Z(a, d, c);     // f
+    A(d, d, c);     // g
+
+    M(p[0], t, a);
+    M(p[1], b, d);
+    M(p[2], d, a);
+    M(p[3], t, b);
+}
+
+static void cswap(gf p[4], gf q[4], uint8_t b) {
+    for (int i = 0; i < 4; i++) {
+        sel25519(p[i], q[i], b);
+    }
+}
+
+static void pack(uint8_t r[32], gf p[4]) {
+    gf tx, ty, zi;
+    inv25519(zi, p[2]);
+    M(tx, p[0], zi);
+    M(ty, p[1], zi);
+    pack25519(r, ty);
+    r[31] ^= par25519(tx) << 7;
+}
+
+// p = s * q.  Clobbers 'q'.
+static void scalarmult(gf p[4], gf q[4], const uint8_t s[32]) {
+    set25519(p[0], gf0);
+    set25519(p[1], gf1);
+    set25519(p[2], gf1);
+    set25519(p[3], gf0);
+
+    for (int i = 255; i >= 0; i--) {
+        const uint8_t b = (s[i / 8] >> (i & 7)) & 1;
+        cswap(p, q, b);
+        add(q, p);
+        add(p, p);
+        cswap(p, q, b);
+    }
+}
+
+// p = s * B, using 'base' as scratch.
+static void scalarbase(gf p[4], gf base[4], const uint8_t s[32]) {
+    set25519(base[0], X);
+    set25519(base[1], Y);
+    set25519(base[2], gf1);
+    M(base[3], X, Y);
+    scalarmult(p, base, s);
+}
+
+// Decodes the point 'p' and negates it.  Returns false if 'p' is not on the curve.
+static bool unpackneg(gf r[4], const uint8_t p[32]) {
+    gf t, chk, num, den, den2, den4, den6;
+    set25519(r[2], gf1);
+    unpack25519(r[1], p);
+    S(num, r[1]);
+    M(den, num, D);
+    Z(num, num, r[2]);
+    A(den, r[2], den);
+
+    S(den2, den);
+    S(den4, den2);
+    M(den6, den4, den2);
+    M(t, den6, num);
+    M(t, t, den);
+
+    pow2523(t, t);
+    M(t, t, num);
+    M(t, t, den);
+    M(t, t, den);
+    M(r[0], t, den);
+
+    S(chk, r[0]);
+    M(chk, chk, den);
+    if (neq25519(chk, num)) {
+        M(r[0], r[0], I);
+    }
+
+    S(chk, r[0]);
+    M(chk, chk, den);
+    if (neq25519(chk, num)) {
+        return false;
+    }
+
+    if (par25519(r[0]) == (p[31] >> 7)) {
+        Z(r[0], gf0, r[0]);
+    }
+
+    M(r[3], r[0], r[1]);
+    return true;
+}
+
+// r = x mod L, where 'x' holds 64 little-endian bytes.  Clobbers 'x'.
+static void modL(uint8_t r[32], int64_t x[64]) {
+    int64_t carry;
+
+    for (int i = 63; i >= 32; i--) {
+        int j;
+        carry = 0;
+        for (j = i - 32; j < i - 12; j++) {
+            x[j] += carry - 16 * x[i] * L[j - (i - 32)];
+            carry = (x[j] + 128) >> 8;
+            x[j] -= carry * 256;
+        }
+        x[j] += carry;
+        x[i] = 0;
+    }
+
+    carry = 0;
+    for (int j = 0; j < 32; j++) {
+        x[j] += carry - (x[31] >> 4) * L[j];
+        carry = x[j] >> 8;
+        x[j] &= 255;
+    }
+
+    for (int j = 0; j < 32; j++) {
+        x[j] -= carry * L[j];
+    }
+
+    for (int i = 0; i < 32; i++) {
+        x[i + 1] += x[i] >> 8;
+        r[i] = (uint8_t) (x[i] & 255);
+    }
+}
+
+// RFC 8032 requires rejecting signatures where S is not reduced (S >= L).  Otherwise,
+// S + L would also verify, making signatures malleable.
+static bool is_reduced(const uint8_t s[32]) {
+    for (int i = 31; i >= 0; i--) {
+        if (s[i] != L[i]) {
+            return s[i] < L[i];
+        }
+    }
+    return false;
+}
+
+bool ed25519_verify(
+    const uint8_t signature[ED25519_SIGNATURE_SIZE],
+    const uint8_t* message,
+    size_t message_len,
+    const uint8_t public_key[ED25519_PUBLIC_KEY_SIZE]
+) {
+    // The points are kept off the stack, which is only 2kB in the bootloader.
+    static gf p[4], q[4], b[4];
+
+    const uint8_t* R = signature;
+    const uint8_t* s = signature + 32;
+
+    if (!is_reduced(s) || !unpackneg(q, public_key)) {
+        return false;
+    }
+
+    // k = SHA-512(R || A || message) mod L
+    uint8_t k[32];
+    {
+        uint8_t h[64];
+        sha512_t sha;
+        sha512_init(&sha);
+        sha512_update(&sha, R, 32);
+        sha512_update(&sha, public_key, ED25519_PUBLIC_KEY_SIZE);
+        sha512_update(&sha, message, message_len);
+        sha512_final(&sha, h);
+
+        int64_t x[64];
+        for (int i = 0; i < 64; i++) {
+            x[i] = h[i];
+        }
+        modL(k, x);
+    }
+
+    // Check that R = s*B - k*A.  ('q' holds -A.)
+    scalarmult(p, q, k);
+    scalarbase(q, b, s);
+    add(p, q);
+
+    uint8_t t[32];
+    pack(t, p);
+    return memcmp(t, R, sizeof(t)) == 0;
+}
@@ -0,0 +1,33 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ED25519_PUBLIC_KEY_SIZE 32
+#define ED25519_SIGNATURE_SIZE 64
+
+// Returns true if 'signature' is a valid Ed25519 signature (RFC 8032) of 'message' by the
+// holder of the private key for 'public_key'.
+//
+// Only verification is implemented.  Everything involved is public, so unlike signing, the
+// code is not written to run in constant time.
+bool ed25519_verify(
+    const uint8_t signature[ED25519_SIGNATURE_SIZE],
+    const uint8_t* message,
+    size_t message_len,
+    const uint8_t public_key[ED25519_PUBLIC_KEY_SIZE]);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
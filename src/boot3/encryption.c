@@ -0,0 +1,73 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Pico SDK
+#include <hardware/flash.h>
+
+// Project
+#include "encryption.h"
+
+// Sets the counter block for the given 32-bit counter value.
+static void set_counter(const encryption_t* encryption, uint32_t value, uint8_t counter[AES_BLOCK_SIZE]) {
+    memcpy(counter, encryption->nonce, ENCRYPTION_NONCE_SIZE);
+    counter[12] = (uint8_t) (value >> 24);
+    counter[13] = (uint8_t) (value >> 16);
+    counter[14] = (uint8_t) (value >> 8);
+    counter[15] = (uint8_t) value;
+}
+
+void encryption_init(encryption_t* encryption, const aes128_t* key) {
+    memset(encryption, 0, sizeof(encryption_t));
+    encryption->_key = key;
+}
+
+void encryption_restart(encryption_t* encryption) {
+    encryption->is_present = false;
+}
+
+bool encryption_is_encryption_block(const struct uf2_block* block) {
+    const encryption_header_t* header = (const encryption_header_t*) block->data;
+    return (block->flags & UF2_FLAG_NOT_MAIN_FLASH) != 0
+        && header->magic == ENCRYPTION_MAGIC;
+}
+
+bool encryption_add_block(encryption_t* encryption, const struct uf2_block* block) {
+    const encryption_header_t* header = (const encryption_header_t*) block->data;
+
+    bool ok = encryption_is_encryption_block(block);
+    ok &= header->version == ENCRYPTION_VERSION;
+    ok &= header->algorithm == ENCRYPTION_ALGORITHM_AES128_CTR;
+    ok &= sizeof(encryption_header_t) <= block->payload_size;
+
+    // A UF2 file has at most one nonce, and can only be decrypted with a key.
+    ok &= !encryption->is_present;
+    ok &= encryption->_key != NULL;
+
+    if (!ok) {
+        return false;
+    }
+
+    memcpy(encryption->nonce, header->nonce, sizeof(encryption->nonce));
+
+    // The key stream is the encryption of zeros.
+    uint8_t counter[AES_BLOCK_SIZE];
+    uint8_t key_check[AES_BLOCK_SIZE] = { 0 };
+    set_counter(encryption, ENCRYPTION_KEY_CHECK_COUNTER, counter);
+    aes128_ctr(encryption->_key, counter, key_check, sizeof(key_check));
+
+    encryption->is_present = memcmp(key_check, header->key_check, ENCRYPTION_KEY_CHECK_SIZE) == 0;
+    return encryption->is_present;
+}
+
+void encryption_decrypt_block(const encryption_t* encryption, const struct uf2_block* block, struct uf2_block* plaintext) {
+    memcpy(plaintext, block, sizeof(struct uf2_block));
+
+    uint8_t counter[AES_BLOCK_SIZE];
+    set_counter(encryption, (block->target_addr - XIP_BASE) / AES_BLOCK_SIZE, counter);
+    aes128_ctr(encryption->_key, counter, plaintext->data, FLASH_PAGE_SIZE);
+}
@@ -0,0 +1,84 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <boot/uf2.h>
+
+// Project
+#include "aes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An encrypted UF2 file carries an encryption block: a UF2 metadata block (flagged
+// UF2_FLAG_NOT_MAIN_FLASH) that precedes all flash blocks and holds a nonce chosen at random
+// for the image.  The 256-byte payload of each RP2040 flash block is encrypted with AES-128 in
+// counter mode, using the device key (BOOTLOADER_ENCRYPTION_KEY) and the counter block:
+//
+//     nonce (12 bytes) | (target_addr - XIP_BASE) / 16 (32-bit big-endian)
+//
+// Since the counter follows the target address, each block is decrypted on its own as it is
+// read, in any order, and blocks for other families can be skipped.  The block headers and
+// metadata blocks are not encrypted.
+//
+// The key check is the first 8 bytes of the key stream for the counter value 0xFFFFFFFF (which
+// no flash block uses), so that a file encrypted with another key is rejected before flash is
+// erased rather than written as garbage.
+//
+// The encryption block is added by 'scripts/uf2_encrypt.py'.  The manifest and signature
+// describe the plaintext, so a UF2 file is encrypted after it is signed.
+
+#define ENCRYPTION_MAGIC                0x434E4542  // "BENC" (little-endian)
+#define ENCRYPTION_VERSION              1
+#define ENCRYPTION_ALGORITHM_AES128_CTR 1
+#define ENCRYPTION_NONCE_SIZE           12
+#define ENCRYPTION_KEY_CHECK_SIZE       8
+#define ENCRYPTION_KEY_CHECK_COUNTER    0xFFFFFFFF
+
+// Payload of the encryption block.
+typedef struct {
+    uint32_t magic;                                 // ENCRYPTION_MAGIC
+    uint16_t version;                               // ENCRYPTION_VERSION
+    uint16_t algorithm;                             // ENCRYPTION_ALGORITHM_AES128_CTR
+    uint8_t nonce[ENCRYPTION_NONCE_SIZE];           // Random, unique to the image
+    uint8_t key_check[ENCRYPTION_KEY_CHECK_SIZE];   // Identifies the key (see above)
+} encryption_header_t;
+
+typedef struct {
+    uint8_t nonce[ENCRYPTION_NONCE_SIZE];           // Nonce from the UF2 file
+    bool is_present;                                // True if the encryption block was read
+
+    // Private:
+    const aes128_t* _key;                           // Device key, or NULL if none
+} encryption_t;
+
+// Initializes the state with the device key (or NULL if the bootloader has none, in which
+// case encrypted UF2 files are rejected).
+void encryption_init(encryption_t* encryption, const aes128_t* key);
+
+// Resets the state for reading the UF2 file again.
+void encryption_restart(encryption_t* encryption);
+
+// Returns true if the given (metadata) block is an encryption block.
+bool encryption_is_encryption_block(const struct uf2_block* block);
+
+// Records the nonce from the given encryption block.  Returns false if the block is malformed,
+// uses an unsupported algorithm, does not match the device key, or a nonce was already
+// received.
+bool encryption_add_block(encryption_t* encryption, const struct uf2_block* block);
+
+// Copies the given flash block to 'plaintext', decrypting its payload.
+void encryption_decrypt_block(const encryption_t* encryption, const struct uf2_block* block, struct uf2_block* plaintext);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,171 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <stdlib.h>
+#include <string.h>
+
+// Pico SDK
+#include <hardware/flash.h>
+
+// Project
+#include "erase_plan.h"
+#include "flash.h"
+
+#define SECTORS_PER_32K 8
+#define SECTORS_PER_64K 16
+
+void erase_plan_init(erase_plan_t* plan) {
+    memset(plan, 0, sizeof(erase_plan_t));
+}
+
+void erase_plan_free(erase_plan_t* plan) {
+    free(plan->erases);
+    memset(plan, 0, sizeof(erase_plan_t));
+}
+
+static bool is_blank(uint32_t sector) {
+    const uint32_t* words = (const uint32_t*) flash_contents(sector * FLASH_SECTOR_SIZE);
+
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE / sizeof(uint32_t); i++) {
+        if (words[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void erase_plan_find_blank(uint32_t* blank, const interval_set_t* sectors, uint32_t limit) {
+    memset(blank, 0, ERASE_PLAN_BITMAP_WORDS(limit) * sizeof(uint32_t));
+
+    for (int i = 0; i < sectors->num_intervals; i++) {
+        for (uint32_t sector = sectors->intervals[i].start; sector < sectors->intervals[i].end && sector < limit; sector++) {
+            if (is_blank(sector)) {
+                blank[sector / 32] |= 1u << (sector % 32);
+            }
+        }
+    }
+}
+
+static void append(erase_plan_t* plan, uint32_t start, uint32_t count, uint32_t cost_ms) {
+    if (plan->num_erases == plan->_capacity) {
+        plan->_capacity += (plan->_capacity / 2) + 1;
+        plan->erases = (interval_t*) realloc(plan->erases, sizeof(interval_t) * plan->_capacity);
+    }
+
+    plan->erases[plan->num_erases].start = start;
+    plan->erases[plan->num_erases].end = start + count;
+    plan->num_erases++;
+    plan->cost_ms += cost_ms;
+}
+
+static bool may_erase(const interval_set_t* sectors, uint32_t limit, uint32_t sector) {
+    return sector < limit && interval_set_contains(sectors, sector);
+}
+
+static bool must_erase(const interval_set_t* sectors, const uint32_t* blank, uint32_t limit, uint32_t sector) {
+    const bool is_marked_blank = blank != NULL && (blank[sector / 32] & (1u << (sector % 32))) != 0;
+    return may_erase(sectors, limit, sector) && !is_marked_blank;
+}
+
+// Returns true if the 32kB half with the given sector counts is cheaper to erase (or as cheap)
+// with one 32kB erase than with 4kB erases.
+static bool use_32k(const flash_caps_t* caps, uint32_t num_may_erase, uint32_t num_must_erase) {
+    return caps->erase_32k_opcode != 0
+        && num_may_erase == SECTORS_PER_32K
+        && caps->erase_32k_ms <= num_must_erase * caps->erase_4k_ms;
+}
+
+static void plan_block(erase_plan_t* plan, const interval_set_t* sectors, const uint32_t* blank, uint32_t limit,
+                       const flash_caps_t* caps, uint32_t first) {
+    uint32_t num_may_erase[2] = { 0, 0 };       // Per 32kB half
+    uint32_t num_must_erase[2] = { 0, 0 };
+
+    for (uint32_t i = 0; i < SECTORS_PER_64K; i++) {
+        num_may_erase[i / SECTORS_PER_32K] += may_erase(sectors, limit, first + i);
+        num_must_erase[i / SECTORS_PER_32K] += must_erase(sectors, blank, limit, first + i);
+    }
+
+    if (num_must_erase[0] + num_must_erase[1] == 0) {
+        return;
+    }
+
+    uint32_t halves_ms = 0;
+    for (uint32_t half = 0; half < 2; half++) {
+        if (num_must_erase[half] > 0) {
+            halves_ms += use_32k(caps, num_may_erase[half], num_must_erase[half])
+                ? caps->erase_32k_ms
+                : num_must_erase[half] * caps->erase_4k_ms;
+        }
+    }
+
+    // Prefer the larger erase when the costs are equal, since it is one command instead of many.
+    if (caps->erase_64k_opcode != 0
+        && num_may_erase[0] + num_may_erase[1] == SECTORS_PER_64K
+        && caps->erase_64k_ms <= halves_ms) {
+        append(plan, first, SECTORS_PER_64K, caps->erase_64k_ms);
+        return;
+    }
+
+    for (uint32_t half = 0; half < 2; half++) {
+        const uint32_t half_first = first + half * SECTORS_PER_32K;
+
+        if (num_must_erase[half] == 0) {
+            continue;
+        }
+
+        if (use_32k(caps, num_may_erase[half], num_must_erase[half])) {
+            append(plan, half_first, SECTORS_PER_32K, caps->erase_32k_ms);
+            continue;
+        }
+
+        for (uint32_t sector = half_first; sector < half_first + SECTORS_PER_32K; sector++) {
+            if (must_erase(sectors, blank, limit, sector)) {
+                append(plan, sector, 1, caps->erase_4k_ms);
+            }
+        }
+    }
+}
+
+void erase_plan_build(erase_plan_t* plan, const interval_set_t* sectors, const uint32_t* blank,
+                      uint32_t limit, const flash_caps_t* caps) {
+    plan->num_erases = 0;
+    plan->cost_ms = 0;
+
+    // Visit each 64kB block that contains a sector of the set once, in ascending order.
+    uint32_t next_block = 0;
+
+    for (int i = 0; i < sectors->num_intervals; i++) {
+        const uint32_t start = sectors->intervals[i].start;
+        const uint32_t end = sectors->intervals[i].end < limit ? sectors->intervals[i].end : limit;
+
+        for (uint32_t first = start - (start % SECTORS_PER_64K); first < end; first += SECTORS_PER_64K) {
+            if (first >= next_block) {
+                plan_block(plan, sectors, blank, limit, caps, first);
+                next_block = first + SECTORS_PER_64K;
+            }
+        }
+    }
+}
+
+const interval_t* erase_plan_find(const erase_plan_t* plan, uint32_t sector) {
+    int left = 0;
+    int right = plan->num_erases - 1;
+
+    while (left <= right) {
+        const int mid = left + (right - left) / 2;
+        const interval_t* erase = &plan->erases[mid];
+
+        if (sector < erase->start) {
+            right = mid - 1;
+        } else if (sector >= erase->end) {
+            left = mid + 1;
+        } else {
+            return erase;
+        }
+    }
+
+    return NULL;
+}
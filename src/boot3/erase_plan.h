@@ -0,0 +1,57 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Project
+#include "flash_caps.h"
+#include "interval_set.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of words in a bitmap with one bit per sector.
+#define ERASE_PLAN_BITMAP_WORDS(num_sectors) (((num_sectors) + 31) / 32)
+
+// The erase planner chooses the cheapest mix of 4kB sector erases and 32kB/64kB block erases
+// that erases every sector in a set that is not already blank.  An erase never extends past
+// the set, so sectors outside of it (e.g., those the manifest reports as unchanged, and the
+// bootloader) are never erased.
+//
+// Because the erase sizes are aligned powers of two, each 64kB block is planned on its own:
+// either one 64kB erase, or for each half, either one 32kB erase or a 4kB erase of each
+// sector that is not blank.  The cost of each erase is its typical time from 'flash_caps_t'.
+typedef struct {
+    interval_t* erases;     // Sectors erased by each erase, in ascending order
+    int num_erases;         // Number of erases in the plan
+    uint32_t cost_ms;       // Sum of the typical times of the erases
+    int _capacity;          // Private: capacity of the erases array
+} erase_plan_t;
+
+void erase_plan_init(erase_plan_t* plan);
+void erase_plan_free(erase_plan_t* plan);
+
+// Sets the bit in 'blank' (ERASE_PLAN_BITMAP_WORDS(limit) words) of each sector in 'sectors'
+// below 'limit' whose flash contents are all 0xFF, and clears the others.
+void erase_plan_find_blank(uint32_t* blank, const interval_set_t* sectors, uint32_t limit);
+
+// Replaces the plan with the cheapest erases that cover every sector in 'sectors' that is not
+// marked in 'blank' (which may be NULL if no sectors are known to be blank).  Sectors at or
+// above 'limit' (the end of the program area) are never erased.  Erases that 'caps' does not
+// support are not used.
+void erase_plan_build(erase_plan_t* plan, const interval_set_t* sectors, const uint32_t* blank,
+                      uint32_t limit, const flash_caps_t* caps);
+
+// Returns the erase in the plan that covers 'sector', or NULL if the sector is not erased.
+const interval_t* erase_plan_find(const erase_plan_t* plan, uint32_t sector);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
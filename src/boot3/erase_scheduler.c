@@ -0,0 +1,114 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <stdlib.h>
+#include <string.h>
+
+// Pico SDK
+#include <pico/assert.h>
+
+// Project
+#include "erase_scheduler.h"
+#include "flash.h"
+
+void erase_scheduler_init(erase_scheduler_t* scheduler, const erase_plan_t* plan, bool is_async) {
+    memset(scheduler, 0, sizeof(erase_scheduler_t));
+    scheduler->plan = plan;
+    interval_set_init(&scheduler->erased);
+
+    // Without a buffer, pages are programmed synchronously.
+    if (is_async) {
+        scheduler->_pending_offs = malloc(ERASE_SCHEDULER_MAX_PENDING * sizeof(uint32_t));
+        scheduler->_pending_data = malloc(ERASE_SCHEDULER_MAX_PENDING * FLASH_PAGE_SIZE);
+        scheduler->is_async = scheduler->_pending_offs != NULL && scheduler->_pending_data != NULL;
+    }
+}
+
+void erase_scheduler_free(erase_scheduler_t* scheduler) {
+    // Flash must be idle before returning, since the caller may read it.
+    if (scheduler->is_busy) {
+        flash_erase_wait();
+    }
+
+    free(scheduler->_pending_offs);
+    free(scheduler->_pending_data);
+    interval_set_free(&scheduler->erased);
+    memset(scheduler, 0, sizeof(erase_scheduler_t));
+}
+
+// Starts the planned erase that covers the given sector.  If the plan does not erase the
+// sector, it is already blank and can be programmed immediately.
+static void start_erase(erase_scheduler_t* scheduler, uint32_t sector) {
+    assert(!scheduler->is_busy);
+
+    const interval_t* erase = erase_plan_find(scheduler->plan, sector);
+    if (erase == NULL) {
+        interval_set_union(&scheduler->erased, sector, sector + 1);
+        return;
+    }
+
+    interval_set_union(&scheduler->erased, erase->start, erase->end);
+    flash_erase_start(erase->start * FLASH_SECTOR_SIZE, (erase->end - erase->start) * FLASH_SECTOR_SIZE);
+    scheduler->is_busy = true;
+
+    if (!scheduler->is_async) {
+        erase_scheduler_flush(scheduler);
+    }
+}
+
+void erase_scheduler_flush(erase_scheduler_t* scheduler) {
+    if (!scheduler->is_busy) {
+        return;
+    }
+
+    flash_erase_wait();
+    scheduler->is_busy = false;
+
+    for (uint32_t i = 0; i < scheduler->_num_pending; i++) {
+        flash_prog(scheduler->_pending_offs[i], scheduler->_pending_data[i], FLASH_PAGE_SIZE);
+    }
+    scheduler->_num_pending = 0;
+}
+
+void erase_scheduler_prog(erase_scheduler_t* scheduler, uint32_t flash_offs, const uint8_t* data) {
+    const uint32_t sector = flash_offs / FLASH_SECTOR_SIZE;
+
+    // The flash performs one operation at a time, so a previous erase must complete before
+    // starting the next.
+    if (!interval_set_contains(&scheduler->erased, sector)) {
+        erase_scheduler_flush(scheduler);
+        start_erase(scheduler, sector);
+    }
+
+    // If the erase has already finished, catch up on the pages waiting for it.
+    if (scheduler->is_busy && !flash_erase_busy()) {
+        erase_scheduler_flush(scheduler);
+    }
+
+    // While the erase is in progress, buffer the page so that the caller can continue.
+    if (scheduler->is_busy && scheduler->_num_pending < ERASE_SCHEDULER_MAX_PENDING) {
+        scheduler->_pending_offs[scheduler->_num_pending] = flash_offs;
+        memcpy(scheduler->_pending_data[scheduler->_num_pending], data, FLASH_PAGE_SIZE);
+        scheduler->_num_pending++;
+        return;
+    }
+
+    erase_scheduler_flush(scheduler);
+    flash_prog(flash_offs, data, FLASH_PAGE_SIZE);
+}
+
+void erase_scheduler_finish(erase_scheduler_t* scheduler) {
+    erase_scheduler_flush(scheduler);
+
+    // Sectors that were not programmed must still be erased.
+    const erase_plan_t* plan = scheduler->plan;
+    for (int i = 0; i < plan->num_erases; i++) {
+        if (!interval_set_contains(&scheduler->erased, plan->erases[i].start)) {
+            start_erase(scheduler, plan->erases[i].start);
+            erase_scheduler_flush(scheduler);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <hardware/flash.h>
+
+// Project
+#include "erase_plan.h"
+#include "interval_set.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of pages buffered while an erase is in progress.
+#ifndef ERASE_SCHEDULER_MAX_PENDING
+#define ERASE_SCHEDULER_MAX_PENDING 64
+#endif
+
+// The erase scheduler erases each sector just before its first page is programmed, instead
+// of erasing every sector up front.
+//
+// When asynchronous, the scheduler starts the erase and returns, so that the caller can read
+// the next UF2 blocks while the flash is busy.  Pages received in the meantime are buffered
+// in RAM and programmed once the erase completes.  A sector is never programmed before its
+// erase has finished.
+//
+// The erases themselves come from an erase plan ('erase_plan.h'): the first page programmed
+// in a sector starts the planned erase that covers it (perhaps a 32kB or 64kB block).  A
+// sector the plan does not erase (because it is already blank) is programmed directly.
+typedef struct {
+    const erase_plan_t* plan;       // Erases to perform
+    interval_set_t erased;          // Sectors erased so far (including any erase in progress)
+    bool is_async;                  // False to wait for each erase before returning
+    bool is_busy;                   // True while an erase is in progress
+
+    // Private: pages waiting for the erase in progress.
+    uint32_t _num_pending;
+    uint32_t* _pending_offs;
+    uint8_t (*_pending_data)[FLASH_PAGE_SIZE];
+} erase_scheduler_t;
+
+// Initializes the scheduler to perform the erases of 'plan', which must outlive it.
+//
+// 'is_async' must be false if anything may read flash while an erase is in progress (e.g.,
+// the staging transport).
+void erase_scheduler_init(erase_scheduler_t* scheduler, const erase_plan_t* plan, bool is_async);
+
+// Waits for any erase in progress and frees resources.  Buffered pages are discarded.
+void erase_scheduler_free(erase_scheduler_t* scheduler);
+
+// Programs one page at 'flash_offs', first erasing its sector if it has not yet been erased.
+// The page may be buffered until an erase in progress completes.
+void erase_scheduler_prog(erase_scheduler_t* scheduler, uint32_t flash_offs, const uint8_t* data);
+
+// Waits for any erase in progress and programs the buffered pages.
+void erase_scheduler_flush(erase_scheduler_t* scheduler);
+
+// Flushes buffered pages and performs any remaining erases of the plan.
+void erase_scheduler_finish(erase_scheduler_t* scheduler);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -3,21 +3,460 @@
  * SPDX-License-Identifier: 0BSD
  */
 
+// Standard
+#include <stdint.h>
+#include <string.h>
+
 // Pico SDK
 #include <hardware/flash.h>
+#include <hardware/irq.h>
+#include <hardware/regs/m0plus.h>
+#include <hardware/structs/ioqspi.h>
+#include <hardware/structs/ssi.h>
 #include <hardware/sync.h>
+#include <pico/assert.h>
+#include <pico/bootrom.h>
+#include <pico/time.h>
 
 // Project
 #include "flash.h"
+#include "profile.h"
+
+#define FLASH_CMD_READ_JEDEC_ID 0x9F
+#define FLASH_CMD_READ_SFDP     0x5A
+#define FLASH_CMD_WRITE_ENABLE  0x06
+#define FLASH_CMD_READ_STATUS   0x05
+#define FLASH_STATUS_BUSY_BITS  0x01
+
+static flash_caps_t caps;
+static bool caps_valid = false;
+
+#ifdef BOOTLOADER_QUAD_PROGRAM
+// True if the chip has a quad page program and its Quad Enable bit is set (see 'flash_detect()').
+static bool quad_program_ok = false;
+
+// False once a page did not read back as written (see 'flash_prog()').
+static bool prog_ok = true;
+#endif
+
+// Like the SDK, keep a copy of the stage 2 bootloader in RAM to restore XIP after erasing.
+// (It is copied once, before the update erases sector 0.)
+#define BOOT2_SIZE_WORDS 64
+static uint32_t boot2_copyout[BOOT2_SIZE_WORDS];
+static bool boot2_copyout_valid = false;
+
+static void __no_inline_not_in_flash_func(init_boot2_copyout)(void) {
+    if (boot2_copyout_valid) {
+        return;
+    }
+
+    for (int i = 0; i < BOOT2_SIZE_WORDS; i++) {
+        boot2_copyout[i] = ((const uint32_t*) XIP_BASE)[i];
+    }
+
+    __compiler_memory_barrier();
+    boot2_copyout_valid = true;
+}
+
+// Erases 'count' bytes with the bootrom's 'flash_range_erase()', which uses 'block_cmd' for
+// each 'block_size'-aligned block and 4kB sector erases otherwise.  The SDK's
+// 'flash_range_erase()' does the same with a fixed 64kB block erase (0xD8).
+static void __no_inline_not_in_flash_func(range_erase)(uint32_t flash_offs, size_t count, uint32_t block_size, uint8_t block_cmd) {
+    rom_connect_internal_flash_fn connect_internal_flash = (rom_connect_internal_flash_fn) rom_func_lookup_inline(ROM_FUNC_CONNECT_INTERNAL_FLASH);
+    rom_flash_exit_xip_fn flash_exit_xip = (rom_flash_exit_xip_fn) rom_func_lookup_inline(ROM_FUNC_FLASH_EXIT_XIP);
+    rom_flash_range_erase_fn flash_range_erase = (rom_flash_range_erase_fn) rom_func_lookup_inline(ROM_FUNC_FLASH_RANGE_ERASE);
+    rom_flash_flush_cache_fn flash_flush_cache = (rom_flash_flush_cache_fn) rom_func_lookup_inline(ROM_FUNC_FLASH_FLUSH_CACHE);
+
+    init_boot2_copyout();
+    __compiler_memory_barrier();
+
+    connect_internal_flash();
+    flash_exit_xip();
+    flash_range_erase(flash_offs, count, block_size, block_cmd);
+    flash_flush_cache();
+
+    // Restore XIP through the stage 2 bootloader, which returns when called.
+    ((void (*)(void)) ((intptr_t) boot2_copyout + 1))();
+}
+
+#if defined(BOOTLOADER_QUAD_PROGRAM) || defined(BOOTLOADER_HOT_PATH_IN_RAM)
+// Drives the flash chip select directly, like the SDK's 'flash_do_cmd()'.
+static void __no_inline_not_in_flash_func(flash_cs_force)(bool high) {
+    const uint32_t value = high ? IO_QSPI_GPIO_QSPI_SS_CTRL_OUTOVER_VALUE_HIGH : IO_QSPI_GPIO_QSPI_SS_CTRL_OUTOVER_VALUE_LOW;
+    hw_write_masked(&ioqspi_hw->io[1].ctrl, value << IO_QSPI_GPIO_QSPI_SS_CTRL_OUTOVER_LSB, IO_QSPI_GPIO_QSPI_SS_CTRL_OUTOVER_BITS);
+}
+
+// Sends 'count' bytes of 'tx' and receives as many into 'rx' (which may be NULL).  XIP must
+// be disabled, which leaves the SSI in standard SPI mode.
+static void __no_inline_not_in_flash_func(ssi_transfer)(const uint8_t* tx, uint8_t* rx, size_t count) {
+    // Keep the RX FIFO (16 entries) from overflowing.
+    const size_t max_in_flight = 16 - 2;
+    size_t tx_remaining = count;
+    size_t rx_remaining = count;
+
+    flash_cs_force(false);
+
+    while (tx_remaining > 0 || rx_remaining > 0) {
+        const uint32_t flags = ssi_hw->sr;
+
+        if ((flags & SSI_SR_TFNF_BITS) && tx_remaining > 0 && rx_remaining - tx_remaining < max_in_flight) {
+            ssi_hw->dr0 = *tx++;
+            tx_remaining--;
+        }
+
+        if ((flags & SSI_SR_RFNE_BITS) && rx_remaining > 0) {
+            const uint8_t value = (uint8_t) ssi_hw->dr0;
+            if (rx != NULL) {
+                *rx++ = value;
+            }
+            rx_remaining--;
+        }
+    }
+
+    flash_cs_force(true);
+}
+
+// Returns true if the flash chip reports a program or erase in progress.
+static bool __no_inline_not_in_flash_func(is_chip_busy)(void) {
+    const uint8_t tx[2] = { FLASH_CMD_READ_STATUS, 0 };
+    uint8_t rx[2];
+
+    const uint32_t interrupts = save_and_disable_interrupts();
+    ssi_transfer(tx, rx, sizeof(tx));
+    restore_interrupts(interrupts);
+
+    return (rx[1] & FLASH_STATUS_BUSY_BITS) != 0;
+}
+#endif
+
+#ifdef BOOTLOADER_QUAD_PROGRAM
+// Sends one page with the chip's quad page program (1-1-4): the instruction and address on
+// one lane, and the data on all four.  The SSI is switched to quad transmit-only mode with
+// 32-bit frames for the page and restored afterwards.  The chip ends the program when chip
+// select rises, so the transfer must not stall: the FIFO is filled before the transfer starts
+// (by selecting the slave), and a frame takes 8 clocks to send, which leaves ample time to
+// refill it.
+static void __no_inline_not_in_flash_func(quad_page_program)(uint32_t flash_offs, const uint8_t* page) {
+    const uint32_t ctrlr0 = ssi_hw->ctrlr0;
+    const uint32_t spi_ctrlr0 = ssi_hw->spi_ctrlr0;
+    const uint32_t ser = ssi_hw->ser;
+
+    ssi_hw->ssienr = 0;
+    ssi_hw->ctrlr0 = (SSI_CTRLR0_SPI_FRF_VALUE_QUAD << SSI_CTRLR0_SPI_FRF_LSB)
+        | (31 << SSI_CTRLR0_DFS_32_LSB)
+        | (SSI_CTRLR0_TMOD_VALUE_TX_ONLY << SSI_CTRLR0_TMOD_LSB);
+    ssi_hw->spi_ctrlr0 = (6 << SSI_SPI_CTRLR0_ADDR_L_LSB)     // 24-bit address (in 4-bit units)
+        | (SSI_SPI_CTRLR0_INST_L_VALUE_8B << SSI_SPI_CTRLR0_INST_L_LSB)
+        | (SSI_SPI_CTRLR0_TRANS_TYPE_VALUE_1C1A << SSI_SPI_CTRLR0_TRANS_TYPE_LSB);
+    ssi_hw->ser = 0;
+    ssi_hw->ssienr = 1;
+
+    flash_cs_force(false);
+    ssi_hw->dr0 = caps.quad_program_opcode;
+    ssi_hw->dr0 = flash_offs;
+
+    // The data is sent most significant bit first, so each frame holds 4 bytes in big-endian order.
+    size_t i = 0;
+    for (; i < FLASH_PAGE_SIZE && (ssi_hw->sr & SSI_SR_TFNF_BITS); i += 4) {
+        ssi_hw->dr0 = ((uint32_t) page[i] << 24) | ((uint32_t) page[i + 1] << 16) | ((uint32_t) page[i + 2] << 8) | page[i + 3];
+    }
+
+    ssi_hw->ser = 1;
+
+    for (; i < FLASH_PAGE_SIZE; i += 4) {
+        while (!(ssi_hw->sr & SSI_SR_TFNF_BITS)) {}
+        ssi_hw->dr0 = ((uint32_t) page[i] << 24) | ((uint32_t) page[i + 1] << 16) | ((uint32_t) page[i + 2] << 8) | page[i + 3];
+    }
+
+    // Wait for the last frame to be shifted out before deselecting the chip.
+    while ((ssi_hw->sr & (SSI_SR_TFE_BITS | SSI_SR_BUSY_BITS)) != SSI_SR_TFE_BITS) {}
+    flash_cs_force(true);
+
+    ssi_hw->ssienr = 0;
+    ssi_hw->ctrlr0 = ctrlr0;
+    ssi_hw->spi_ctrlr0 = spi_ctrlr0;
+    ssi_hw->ser = ser;
+    ssi_hw->ssienr = 1;
+}
+
+// Programs 'count' bytes (whole pages) with 'quad_page_program()'.  Like 'range_erase()', this
+// runs from RAM with XIP disabled, and restores XIP through the stage 2 bootloader.
+static void __no_inline_not_in_flash_func(quad_range_program)(uint32_t flash_offs, const uint8_t* data, size_t count) {
+    rom_connect_internal_flash_fn connect_internal_flash = (rom_connect_internal_flash_fn) rom_func_lookup_inline(ROM_FUNC_CONNECT_INTERNAL_FLASH);
+    rom_flash_exit_xip_fn flash_exit_xip = (rom_flash_exit_xip_fn) rom_func_lookup_inline(ROM_FUNC_FLASH_EXIT_XIP);
+    rom_flash_flush_cache_fn flash_flush_cache = (rom_flash_flush_cache_fn) rom_func_lookup_inline(ROM_FUNC_FLASH_FLUSH_CACHE);
+
+    init_boot2_copyout();
+    __compiler_memory_barrier();
+
+    connect_internal_flash();
+    flash_exit_xip();
+
+    const uint8_t write_enable = FLASH_CMD_WRITE_ENABLE;
+    for (size_t offset = 0; offset < count; offset += FLASH_PAGE_SIZE) {
+        ssi_transfer(&write_enable, NULL, 1);
+        quad_page_program(flash_offs + offset, data + offset);
+
+        while (is_chip_busy()) {}
+    }
+
+    flash_flush_cache();
+    ((void (*)(void)) ((intptr_t) boot2_copyout + 1))();
+}
+#endif
+
+static bool read_sfdp(void* context, uint32_t addr, void* buffer, size_t len) {
+    // Instruction, 24-bit address and 8 dummy clocks, followed by the data.  (Static to keep
+    // it off the stack.)
+    static uint8_t tx[5 + SFDP_BASIC_TABLE_MAX_DWORDS * 4];
+    static uint8_t rx[sizeof(tx)];
+
+    if (len > sizeof(tx) - 5) {
+        return false;
+    }
+
+    memset(tx, 0, sizeof(tx));
+    tx[0] = FLASH_CMD_READ_SFDP;
+    tx[1] = (uint8_t) (addr >> 16);
+    tx[2] = (uint8_t) (addr >> 8);
+    tx[3] = (uint8_t) addr;
+
+    const uint32_t interrupts = save_and_disable_interrupts();
+    flash_do_cmd(tx, rx, 5 + len);
+    restore_interrupts(interrupts);
+
+    memcpy(buffer, &rx[5], len);
+    return true;
+}
+
+const flash_caps_t* flash_detect(void) {
+    init_boot2_copyout();
+    flash_caps_init(&caps, PICO_FLASH_SIZE_BYTES);
+
+    uint8_t tx[4] = { FLASH_CMD_READ_JEDEC_ID, 0, 0, 0 };
+    uint8_t rx[4];
+
+    const uint32_t interrupts = save_and_disable_interrupts();
+    flash_do_cmd(tx, rx, sizeof(tx));
+    restore_interrupts(interrupts);
+
+    flash_caps_detect(&caps, (rx[1] << 16) | (rx[2] << 8) | rx[3], read_sfdp, NULL);
+    caps_valid = true;
+
+#ifdef BOOTLOADER_QUAD_PROGRAM
+    // The quad page program only works once the chip's Quad Enable bit is set, which the
+    // stage 2 bootloader does for quad reads.  Check rather than assume it.
+    quad_program_ok = caps.quad_program_opcode != 0;
+    if (quad_program_ok && caps.qe_status_opcode != 0) {
+        uint8_t status_tx[2] = { caps.qe_status_opcode, 0 };
+        uint8_t status_rx[2];
+
+        const uint32_t interrupts = save_and_disable_interrupts();
+        flash_do_cmd(status_tx, status_rx, sizeof(status_tx));
+        restore_interrupts(interrupts);
+
+        quad_program_ok = (status_rx[1] & caps.qe_mask) != 0;
+    }
+#endif
+
+    return &caps;
+}
 
 void flash_erase(uint32_t flash_offs, size_t count) {
+    PROFILE_BEGIN(start);
+
+    if (!caps_valid) {
+        // The chip has not been detected, so only use the SDK's erases.
+        uint32_t interrupts = save_and_disable_interrupts();
+        flash_range_erase(flash_offs, count);
+        restore_interrupts(interrupts);
+    } else {
+        // Erase the range with the largest blocks the chip supports.
+        while (count > 0) {
+            const uint32_t size = flash_caps_erase_size(&caps, flash_offs, count);
+
+            uint32_t interrupts = save_and_disable_interrupts();
+            range_erase(flash_offs, size, size, flash_caps_erase_opcode(&caps, size));
+            restore_interrupts(interrupts);
+
+            flash_offs += size;
+            count -= size;
+        }
+    }
+
+    PROFILE_END(PROFILE_FLASH_ERASE, start);
+}
+
+static void single_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
     uint32_t interrupts = save_and_disable_interrupts();
-    flash_range_erase(flash_offs, count);
+    flash_range_program(flash_offs, data, count);
     restore_interrupts(interrupts);
 }
 
+#ifdef BOOTLOADER_QUAD_PROGRAM
+// With BOOTLOADER_QUAD_PROGRAM, pages are programmed with the chip's quad page program if
+// 'flash_detect()' found it usable, which sends a page in a quarter of the clocks, and read
+// back.  If they differ, the quad program is not used again, and the range is programmed
+// again on a single lane, which completes pages that the quad program left unwritten.  If
+// that does not help, 'flash_prog_ok()' reports it.
 void flash_prog(uint32_t flash_offs, const uint8_t *data, size_t count) {
-    uint32_t interrupts = save_and_disable_interrupts();
-    flash_range_program(flash_offs, data, count);
+    PROFILE_BEGIN(start);
+
+    if (!caps_valid || !quad_program_ok) {
+        single_range_program(flash_offs, data, count);
+    } else {
+        uint32_t interrupts = save_and_disable_interrupts();
+        quad_range_program(flash_offs, data, count);
+        restore_interrupts(interrupts);
+
+        if (memcmp(flash_contents(flash_offs), data, count) != 0) {
+            quad_program_ok = false;
+            single_range_program(flash_offs, data, count);
+
+            prog_ok &= memcmp(flash_contents(flash_offs), data, count) == 0;
+        }
+    }
+
+    PROFILE_END(PROFILE_FLASH_PROG, start);
+}
+
+bool flash_prog_ok(void) {
+    return prog_ok;
+}
+#else
+// Pages are programmed with the bootrom's single-lane page program (0x02).
+void flash_prog(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    PROFILE_BEGIN(start);
+    single_range_program(flash_offs, data, count);
+    PROFILE_END(PROFILE_FLASH_PROG, start);
+}
+
+bool flash_prog_ok(void) {
+    return true;
+}
+#endif
+
+#ifdef BOOTLOADER_HOT_PATH_IN_RAM
+// The erase in progress.  XIP stays disabled until its last block is erased, so everything
+// that runs in the meantime (the transport's read path, the UF2 passes and any interrupt
+// handlers) must be in RAM (see BOOTLOADER_RAM_OBJECTS in 'CMakeLists.txt').
+static struct {
+    bool is_busy;
+    uint32_t flash_offs;    // Start of the next block to erase
+    size_t count;           // Bytes left to erase after the block in progress
+    uint32_t masked_irqs;   // Interrupts masked until the erase completes
+#ifdef BOOTLOADER_USE_PROFILE
+    uint32_t start_us;      // Time the erase started
+#endif
+} erase;
+
+// Interrupts that may be taken during a background erase: DMA completion, which the SD card
+// driver waits for, and the default alarm pool's timer, which its timeouts use.  Their
+// handlers are linked into RAM, which 'hot_path.cmake' checks.  Other interrupts are masked
+// until the erase completes.
+#define ERASE_ALLOWED_IRQS ((1u << DMA_IRQ_0) | (1u << DMA_IRQ_1) \
+    | (1u << (TIMER_IRQ_0 + PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM)))
+
+// Sends the write enable and erase instructions for the largest block the chip supports at
+// the start of the remaining range, and returns without waiting for the erase.
+static void __no_inline_not_in_flash_func(start_next_erase)(void) {
+    const uint32_t size = flash_caps_erase_size(&caps, erase.flash_offs, erase.count);
+
+    const uint8_t write_enable = FLASH_CMD_WRITE_ENABLE;
+    const uint8_t cmd[4] = {
+        flash_caps_erase_opcode(&caps, size),
+        (uint8_t) (erase.flash_offs >> 16),
+        (uint8_t) (erase.flash_offs >> 8),
+        (uint8_t) erase.flash_offs,
+    };
+
+    const uint32_t interrupts = save_and_disable_interrupts();
+    ssi_transfer(&write_enable, NULL, 1);
+    ssi_transfer(cmd, NULL, sizeof(cmd));
+    restore_interrupts(interrupts);
+
+    erase.flash_offs += size;
+    erase.count -= size;
+}
+
+// The erase commands are sent from RAM with XIP disabled, and 'flash_erase_busy()' polls the
+// chip's status register, so the caller can read the SD card while the flash is busy.  Once
+// the last block is erased, XIP is restored as 'range_erase()' does.
+void __no_inline_not_in_flash_func(flash_erase_start)(uint32_t flash_offs, size_t count) {
+    assert(!erase.is_busy);
+
+    // Without the chip's capabilities, erase as the SDK does.
+    if (!caps_valid) {
+        flash_erase(flash_offs, count);
+        return;
+    }
+
+    rom_connect_internal_flash_fn connect_internal_flash = (rom_connect_internal_flash_fn) rom_func_lookup_inline(ROM_FUNC_CONNECT_INTERNAL_FLASH);
+    rom_flash_exit_xip_fn flash_exit_xip = (rom_flash_exit_xip_fn) rom_func_lookup_inline(ROM_FUNC_FLASH_EXIT_XIP);
+
+    init_boot2_copyout();
+    __compiler_memory_barrier();
+
+    const uint32_t interrupts = save_and_disable_interrupts();
+    erase.masked_irqs = *((io_rw_32*) (PPB_BASE + M0PLUS_NVIC_ISER_OFFSET)) & ~ERASE_ALLOWED_IRQS;
+    irq_set_mask_enabled(erase.masked_irqs, false);
+    connect_internal_flash();
+    flash_exit_xip();
     restore_interrupts(interrupts);
+
+#ifdef BOOTLOADER_USE_PROFILE
+    erase.start_us = time_us_32();
+#endif
+
+    erase.is_busy = true;
+    erase.flash_offs = flash_offs;
+    erase.count = count;
+    start_next_erase();
 }
+
+bool __no_inline_not_in_flash_func(flash_erase_busy)(void) {
+    if (!erase.is_busy) {
+        return false;
+    }
+
+    if (is_chip_busy()) {
+        return true;
+    }
+
+    if (erase.count > 0) {
+        start_next_erase();
+        return true;
+    }
+
+    rom_flash_flush_cache_fn flash_flush_cache = (rom_flash_flush_cache_fn) rom_func_lookup_inline(ROM_FUNC_FLASH_FLUSH_CACHE);
+
+    const uint32_t interrupts = save_and_disable_interrupts();
+    flash_flush_cache();
+    ((void (*)(void)) ((intptr_t) boot2_copyout + 1))();
+    irq_set_mask_enabled(erase.masked_irqs, true);
+    restore_interrupts(interrupts);
+
+    erase.is_busy = false;
+    PROFILE_END(PROFILE_FLASH_ERASE, erase.start_us);
+    return false;
+}
+
+void __no_inline_not_in_flash_func(flash_erase_wait)(void) {
+    while (flash_erase_busy()) {
+        tight_loop_contents();
+    }
+}
+#else
+// Without BOOTLOADER_HOT_PATH_IN_RAM, the erase runs to completion before returning.  While
+// the flash is busy, it cannot be read, which includes executing in place, and FatFs and
+// the SD card driver run from flash.
+void flash_erase_start(uint32_t flash_offs, size_t count) {
+    flash_erase(flash_offs, count);
+}
+
+bool flash_erase_busy(void) {
+    return false;
+}
+
+void flash_erase_wait(void) {}
+#endif
@@ -6,8 +6,63 @@
 #pragma once
 
 // Standard
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
+#if !PICO_NO_HARDWARE
+// Pico SDK
+#include <hardware/regs/addressmap.h>
+#endif
+
+// Project
+#include "flash_caps.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reads the flash chip's JEDEC ID and SFDP tables (see 'flash_caps.h').  Called at the start
+// of an update, before sector 0 is erased.  Subsequent erases use the largest erase blocks
+// the chip supports.
+const flash_caps_t* flash_detect(void);
+
 void flash_erase(uint32_t flash_offs, size_t count);
 void flash_prog(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+// Returns false if a page written by 'flash_prog()' did not read back as written.  Only pages
+// written with the quad page program (BOOTLOADER_QUAD_PROGRAM) are read back.
+bool flash_prog_ok(void);
+
+// True if 'flash_erase_start()' returns while the erase is in progress.  On the device, this
+// requires BOOTLOADER_HOT_PATH_IN_RAM, since nothing can execute from flash until the erase
+// completes.  Host builds (PICO_NO_HARDWARE) follow the same setting.
+#ifdef BOOTLOADER_HOT_PATH_IN_RAM
+#define FLASH_ERASE_IS_ASYNC 1
+#else
+#define FLASH_ERASE_IS_ASYNC 0
+#endif
+
+// Starts erasing the given sector-aligned range.  If the erase runs in the background, flash
+// must not be read or programmed until 'flash_erase_wait()' returns.
+void flash_erase_start(uint32_t flash_offs, size_t count);
+
+// Returns true while an erase started by 'flash_erase_start()' is in progress.
+bool flash_erase_busy(void);
+
+// Waits for an erase started by 'flash_erase_start()' to complete.
+void flash_erase_wait(void);
+
+// Returns a pointer to the current contents of flash at the given offset.  On the device,
+// this is the XIP address.  Host builds (PICO_NO_HARDWARE) provide a simulated flash.
+#if PICO_NO_HARDWARE
+const uint8_t* flash_contents(uint32_t flash_offs);
+#else
+static inline const uint8_t* flash_contents(uint32_t flash_offs) {
+    return (const uint8_t*) (XIP_BASE + flash_offs);
+}
+#endif
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
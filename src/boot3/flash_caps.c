@@ -0,0 +1,231 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Project
+#include "flash_caps.h"
+
+#define SIZE_4K     (1u << 12)
+#define SIZE_32K    (1u << 15)
+#define SIZE_64K    (1u << 16)
+
+// The RP2040 maps at most 16MB of flash.  Larger capacities are clamped.
+#define MAX_SIZE    (1u << 24)
+
+static uint32_t read_u24(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return read_u24(p) | ((uint32_t) p[3] << 24);
+}
+
+void flash_caps_init(flash_caps_t* caps, uint32_t size_bytes) {
+    memset(caps, 0, sizeof(flash_caps_t));
+    caps->size_bytes = size_bytes;
+    caps->erase_4k_opcode = 0x20;
+    caps->erase_64k_opcode = 0xD8;
+    caps->erase_4k_ms = 45;
+    caps->erase_32k_ms = 120;
+    caps->erase_64k_ms = 150;
+}
+
+uint32_t flash_caps_jedec_size(uint32_t jedec_id) {
+    // Most vendors encode the capacity as log2(bytes).  Anything outside 64kB..16MB is more
+    // likely a vendor-specific code (or a missing chip, which reads as 0x000000 or 0xFFFFFF).
+    const uint32_t log2_size = jedec_id & 0xFF;
+    return (16 <= log2_size && log2_size <= 24) ? (1u << log2_size) : 0;
+}
+
+// Returns the capacity from DWORD 2 of the basic table, or 0 if it is implausible.
+static uint32_t density_bytes(uint32_t dword2) {
+    if ((dword2 & 0x80000000) == 0) {
+        // Bits 30:0 hold the capacity in bits, minus one.
+        const uint32_t bits = (dword2 & 0x7FFFFFFF) + 1;
+        return bits < 8 ? 0 : (bits >= MAX_SIZE * 8 ? MAX_SIZE : bits / 8);
+    }
+
+    // Bits 30:0 hold log2 of the capacity in bits (only used for chips of 4Gbit or more).
+    const uint32_t log2_bits = dword2 & 0x7FFFFFFF;
+    return log2_bits < 3 ? 0 : (log2_bits >= 27 ? MAX_SIZE : 1u << (log2_bits - 3));
+}
+
+// Returns the typical time of the given erase type (0..3) from DWORD 10 of the basic table.
+static uint16_t erase_time_ms(uint32_t dword10, uint32_t type) {
+    // Bits 4:0 hold the count (minus one) and bits 6:5 the units: 1ms, 16ms, 128ms or 1s.
+    static const uint16_t units_ms[] = { 1, 16, 128, 1000 };
+    const uint32_t field = (dword10 >> (4 + type * 7)) & 0x7F;
+    return ((field & 0x1F) + 1) * units_ms[field >> 5];
+}
+
+// Sets the location of the Quad Enable bit from DWORD 15 of the basic table (bits 22:20).
+// Returns false if the encoding is reserved or does not say how to read the bit.
+static bool quad_enable_bit(uint32_t dword15, flash_caps_t* caps) {
+    switch ((dword15 >> 20) & 0x7) {
+        case 0:     // No Quad Enable bit
+            caps->qe_status_opcode = 0;
+            caps->qe_mask = 0;
+            return true;
+        case 2:     // Bit 6 of status register 1
+            caps->qe_status_opcode = 0x05;
+            caps->qe_mask = 1u << 6;
+            return true;
+        case 3:     // Bit 7 of status register 2, read with 0x3F
+            caps->qe_status_opcode = 0x3F;
+            caps->qe_mask = 1u << 7;
+            return true;
+        case 4:     // Bit 1 of status register 2, read with 0x35
+        case 5:
+            caps->qe_status_opcode = 0x35;
+            caps->qe_mask = 1u << 1;
+            return true;
+        default:    // Bit 1 of status register 2, which may not be readable (1), or reserved
+            return false;
+    }
+}
+
+bool flash_caps_parse_sfdp(flash_caps_t* caps, sfdp_read_fn read, void* context) {
+    uint8_t header[8];
+    if (!read(context, 0, header, sizeof(header)) || read_u32(header) != SFDP_SIGNATURE) {
+        return false;
+    }
+
+    // Only major revision 1 is defined (minor revisions are backwards compatible).
+    if (header[5] != 1) {
+        return false;
+    }
+
+    // Find the basic table with the highest minor revision.  (The first parameter header
+    // always describes a basic table, but later revisions may follow.)
+    const uint32_t num_headers = header[6] + 1;
+    uint32_t table_addr = 0;
+    uint32_t table_dwords = 0;
+    int table_minor = -1;
+
+    for (uint32_t i = 0; i < num_headers && i < SFDP_MAX_PARAMETER_HEADERS; i++) {
+        uint8_t param[8];
+        if (!read(context, sizeof(header) + i * sizeof(param), param, sizeof(param))) {
+            return false;
+        }
+
+        const uint32_t id = (param[7] << 8) | param[0];
+        if (id == SFDP_BASIC_TABLE_ID && param[2] == 1 && (int) param[1] > table_minor) {
+            table_minor = param[1];
+            table_dwords = param[3];
+            table_addr = read_u24(&param[4]);
+        }
+    }
+
+    // JESD216 (revision 1.0) defines 9 DWORDs, including the erase types in DWORDs 8 and 9.
+    if (table_minor < 0 || table_dwords < 9) {
+        return false;
+    }
+
+    if (table_dwords > SFDP_BASIC_TABLE_MAX_DWORDS) {
+        table_dwords = SFDP_BASIC_TABLE_MAX_DWORDS;
+    }
+
+    uint8_t table[SFDP_BASIC_TABLE_MAX_DWORDS * 4];
+    if (!read(context, table_addr, table, table_dwords * 4)) {
+        return false;
+    }
+
+    const uint32_t dword1 = read_u32(&table[0]);
+    const uint32_t size_bytes = density_bytes(read_u32(&table[4]));
+    if (size_bytes == 0) {
+        return false;
+    }
+
+    flash_caps_t result = *caps;
+    result.has_sfdp = true;
+    result.size_bytes = size_bytes;
+
+    // DWORD 1, bits 1:0 are 01b if 4kB erases are supported, with the instruction in bits 15:8.
+    if ((dword1 & 0x3) == 0x1) {
+        result.erase_4k_opcode = (dword1 >> 8) & 0xFF;
+    }
+
+    // DWORDs 8 and 9 list up to four erase types as (log2 size, instruction) byte pairs.  A
+    // size of 0 means the erase type is unused.  JESD216A added their typical times in
+    // DWORD 10; older tables keep the default times.
+    result.erase_32k_opcode = 0;
+    result.erase_64k_opcode = 0;
+
+    const bool has_erase_times = table_dwords >= 10;
+    const uint32_t dword10 = has_erase_times ? read_u32(&table[36]) : 0;
+
+    for (uint32_t i = 0; i < 4; i++) {
+        const uint8_t log2_size = table[28 + i * 2];
+        const uint8_t opcode = table[28 + i * 2 + 1];
+
+        uint16_t* time_ms = NULL;
+
+        if (log2_size == 12) {
+            time_ms = &result.erase_4k_ms;
+        } else if (log2_size == 15) {
+            result.erase_32k_opcode = opcode;
+            time_ms = &result.erase_32k_ms;
+        } else if (log2_size == 16) {
+            result.erase_64k_opcode = opcode;
+            time_ms = &result.erase_64k_ms;
+        }
+
+        if (time_ms != NULL && has_erase_times) {
+            *time_ms = erase_time_ms(dword10, i);
+        }
+    }
+
+    // The basic table does not describe page program instructions.  Winbond, GigaDevice and
+    // Puya chips that support 1-1-4 fast reads (DWORD 1, bit 22) also support 1-1-4 page
+    // programs with instruction 0x32.  (Others, such as Macronix, use 1-4-4 with 0x38.)
+    const uint8_t manufacturer = (caps->jedec_id >> 16) & 0xFF;
+    const bool has_quad_read = (dword1 & (1u << 22)) != 0;
+    const bool is_known_manufacturer = manufacturer == JEDEC_MANUFACTURER_WINBOND
+        || manufacturer == JEDEC_MANUFACTURER_GIGADEVICE
+        || manufacturer == JEDEC_MANUFACTURER_PUYA;
+    const bool has_qe = table_dwords >= 15 && quad_enable_bit(read_u32(&table[56]), &result);
+    result.quad_program_opcode = has_quad_read && is_known_manufacturer && has_qe ? FLASH_QUAD_PAGE_PROGRAM : 0;
+
+    *caps = result;
+    return true;
+}
+
+void flash_caps_detect(flash_caps_t* caps, uint32_t jedec_id, sfdp_read_fn read, void* context) {
+    // A missing or unresponsive chip reads as all zeros or all ones.
+    if (jedec_id == 0 || jedec_id == 0xFFFFFF) {
+        return;
+    }
+
+    caps->jedec_id = jedec_id;
+
+    if (!flash_caps_parse_sfdp(caps, read, context)) {
+        const uint32_t size_bytes = flash_caps_jedec_size(jedec_id);
+        if (size_bytes != 0) {
+            caps->size_bytes = size_bytes;
+        }
+    }
+}
+
+uint32_t flash_caps_erase_size(const flash_caps_t* caps, uint32_t flash_offs, uint32_t count) {
+    if (caps->erase_64k_opcode != 0 && flash_offs % SIZE_64K == 0 && count >= SIZE_64K) {
+        return SIZE_64K;
+    }
+
+    if (caps->erase_32k_opcode != 0 && flash_offs % SIZE_32K == 0 && count >= SIZE_32K) {
+        return SIZE_32K;
+    }
+
+    return SIZE_4K;
+}
+
+uint8_t flash_caps_erase_opcode(const flash_caps_t* caps, uint32_t size) {
+    switch (size) {
+        case SIZE_64K: return caps->erase_64k_opcode;
+        case SIZE_32K: return caps->erase_32k_opcode;
+        default: return caps->erase_4k_opcode;
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Capabilities of the flash chip, learned at the start of each update from its JEDEC ID
+// (instruction 0x9F) and its SFDP tables (Serial Flash Discoverable Parameters, JESD216,
+// instruction 0x5A).  Anything the chip does not report keeps the default, which matches
+// what the Pico SDK assumes: PICO_FLASH_SIZE_BYTES, 4kB sector erases (0x20) and 64kB block
+// erases (0xD8).  The typical erase times (used to choose between erase sizes) default to
+// the W25Q16JV datasheet's.
+//
+// The parsing is separate from the device code in 'flash.c', so that it can be tested on the
+// host with SFDP dumps.
+
+#define JEDEC_MANUFACTURER_WINBOND      0xEF
+#define JEDEC_MANUFACTURER_GIGADEVICE   0xC8
+#define JEDEC_MANUFACTURER_PUYA         0x85
+
+#define SFDP_SIGNATURE                  0x50444653  // "SFDP" (little-endian)
+#define SFDP_BASIC_TABLE_ID             0xFF00      // JEDEC Basic Flash Parameter table
+#define SFDP_MAX_PARAMETER_HEADERS      8           // Headers beyond this are ignored
+#define SFDP_BASIC_TABLE_MAX_DWORDS     16          // Only DWORDs 1-10 and 15 are used
+
+#define FLASH_QUAD_PAGE_PROGRAM         0x32        // 1-1-4 page program
+
+// The 1-1-4 page program is only used with BOOTLOADER_QUAD_PROGRAM ('flash.c'), and only if
+// the chip's Quad Enable bit is set, which the stage 2 bootloader does for quad reads.  The
+// bit's location comes from the basic SFDP table (JESD216A, DWORD 15), so chips with older
+// tables keep programming on a single lane.
+
+typedef struct {
+    uint32_t jedec_id;              // Manufacturer (bits 23:16), memory type and capacity, or 0
+    uint32_t size_bytes;            // Capacity of the chip
+    bool has_sfdp;                  // True if the chip has a valid basic SFDP table
+    uint8_t erase_4k_opcode;        // Instruction for a 4kB sector erase
+    uint8_t erase_32k_opcode;       // Instruction for a 32kB block erase, or 0 if unsupported
+    uint8_t erase_64k_opcode;       // Instruction for a 64kB block erase, or 0 if unsupported
+    uint8_t quad_program_opcode;    // FLASH_QUAD_PAGE_PROGRAM if supported, otherwise 0
+    uint8_t qe_status_opcode;       // Instruction to read the status register holding the Quad
+                                    // Enable bit, or 0 if the chip has none
+    uint8_t qe_mask;                // The Quad Enable bit in that status register
+    uint16_t erase_4k_ms;           // Typical time of a 4kB sector erase
+    uint16_t erase_32k_ms;          // Typical time of a 32kB block erase
+    uint16_t erase_64k_ms;          // Typical time of a 64kB block erase
+} flash_caps_t;
+
+// Reads 'len' bytes of the SFDP address space starting at 'addr'.  Returns false on failure.
+typedef bool (*sfdp_read_fn)(void* context, uint32_t addr, void* buffer, size_t len);
+
+// Initializes 'caps' with the defaults for a chip of 'size_bytes' (PICO_FLASH_SIZE_BYTES).
+void flash_caps_init(flash_caps_t* caps, uint32_t size_bytes);
+
+// Returns the capacity encoded in the last byte of a JEDEC ID (2^n bytes), or 0 if it is
+// implausible.
+uint32_t flash_caps_jedec_size(uint32_t jedec_id);
+
+// Updates 'caps' from the basic SFDP table.  Returns false (leaving 'caps' unchanged) if the
+// chip has no SFDP or the table is malformed.
+bool flash_caps_parse_sfdp(flash_caps_t* caps, sfdp_read_fn read, void* context);
+
+// Updates 'caps' from the JEDEC ID and the SFDP tables, falling back on the capacity in the
+// JEDEC ID if the chip has no SFDP.
+void flash_caps_detect(flash_caps_t* caps, uint32_t jedec_id, sfdp_read_fn read, void* context);
+
+// Returns the size of the largest erase supported by the chip that starts at 'flash_offs'
+// and does not extend past 'count' bytes (both sector-aligned).
+uint32_t flash_caps_erase_size(const flash_caps_t* caps, uint32_t flash_offs, uint32_t count);
+
+// Returns the instruction for an erase of the given size (as returned by
+// 'flash_caps_erase_size()').
+uint8_t flash_caps_erase_opcode(const flash_caps_t* caps, uint32_t size);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,85 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Pico SDK
+#include <hardware/clocks.h>
+#include <hardware/resets.h>
+#include <hardware/structs/nvic.h>
+#include <hardware/structs/scb.h>
+#include <hardware/structs/systick.h>
+#include <hardware/sync.h>
+#include <hardware/xosc.h>
+
+// Project
+#include "handoff.h"
+#include "uart_log.h"
+#include "vector_table.h"
+
+// Peripherals used by the bootloader (SD card SPI + DMA, GPIO, UART, timer alarms) plus the
+// PLLs.  These are held in reset, as they would be after a watchdog reset.  Note that we must
+// not reset IO_QSPI or PADS_QSPI, since we are executing from flash.
+#define HANDOFF_RESET_BITS (    \
+    RESETS_RESET_DMA_BITS |     \
+    RESETS_RESET_IO_BANK0_BITS | \
+    RESETS_RESET_PADS_BANK0_BITS | \
+    RESETS_RESET_PLL_SYS_BITS | \
+    RESETS_RESET_PLL_USB_BITS | \
+    RESETS_RESET_PWM_BITS |     \
+    RESETS_RESET_SPI0_BITS |    \
+    RESETS_RESET_SPI1_BITS |    \
+    RESETS_RESET_TIMER_BITS |   \
+    RESETS_RESET_UART0_BITS |   \
+    RESETS_RESET_UART1_BITS)
+
+static void reset_interrupts() {
+    // Disable and clear all NVIC interrupts, as well as the SysTick and any pending
+    // PendSV / SysTick exceptions.
+    nvic_hw->icer = 0xFFFFFFFF;
+    nvic_hw->icpr = 0xFFFFFFFF;
+    systick_hw->csr = 0;
+    scb_hw->icsr = M0PLUS_ICSR_PENDSVCLR_BITS | M0PLUS_ICSR_PENDSTCLR_BITS;
+}
+
+static void reset_clocks() {
+    // Glitchlessly switch clk_sys to clk_ref, and clk_ref to the ROSC (their reset sources).
+    // This is the same sequence 'clocks_init()' uses before reconfiguring the clocks.
+    hw_clear_bits(&clocks_hw->clk[clk_sys].ctrl, CLOCKS_CLK_SYS_CTRL_SRC_BITS);
+    while (clocks_hw->clk[clk_sys].selected != 0x1) {
+        tight_loop_contents();
+    }
+
+    hw_clear_bits(&clocks_hw->clk[clk_ref].ctrl, CLOCKS_CLK_REF_CTRL_SRC_BITS);
+    while (clocks_hw->clk[clk_ref].selected != 0x1) {
+        tight_loop_contents();
+    }
+
+    clocks_hw->clk[clk_sys].div = 1 << CLOCKS_CLK_SYS_DIV_INT_LSB;
+    clocks_hw->clk[clk_ref].div = 1 << CLOCKS_CLK_REF_DIV_INT_LSB;
+
+    // Stop the clocks that are disabled at reset.
+    hw_clear_bits(&clocks_hw->clk[clk_peri].ctrl, CLOCKS_CLK_PERI_CTRL_ENABLE_BITS);
+    hw_clear_bits(&clocks_hw->clk[clk_usb].ctrl, CLOCKS_CLK_USB_CTRL_ENABLE_BITS);
+    hw_clear_bits(&clocks_hw->clk[clk_adc].ctrl, CLOCKS_CLK_ADC_CTRL_ENABLE_BITS);
+    hw_clear_bits(&clocks_hw->clk[clk_rtc].ctrl, CLOCKS_CLK_RTC_CTRL_ENABLE_BITS);
+
+    // Nothing is running from the XOSC or PLLs now.
+    xosc_disable();
+}
+
+void handoff_direct(void) {
+    // Let any pending diagnostic output drain before resetting the UART and DMA.
+    uart_log_flush();
+
+    (void) save_and_disable_interrupts();
+    reset_interrupts();
+    reset_clocks();
+    reset_block(HANDOFF_RESET_BITS);
+
+    // Interrupts are enabled at reset.  Nothing can fire at this point, since all sources
+    // have been disabled.
+    restore_interrupts(0);
+
+    vector_into_flash(VECTOR_TABLE_ADDR);
+}
@@ -0,0 +1,11 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Returns the clocks and the peripherals used by the bootloader to their reset state and
+// jumps directly to the firmware's vector table, avoiding a second pass through the bootrom,
+// stage 2 and stage 3 bootloaders.  Does not return.
+void handoff_direct(void);
@@ -0,0 +1,221 @@
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Post-build check that the update hot path was linked into RAM (BOOTLOADER_HOT_PATH_IN_RAM).
+# The object file patterns in 'CMakeLists.txt' silently match nothing if a source is renamed,
+# so check the linked addresses instead.  Invoked with 'cmake -P' after linking:
+#
+#   ELF                 Path to the bootloader's ELF file
+#   NM                  Path to 'arm-none-eabi-nm'
+#   OBJDUMP             Path to 'arm-none-eabi-objdump'
+#   USE_SD              True if the SD card transport is linked (BOOTLOADER_USE_SD)
+#   USE_UART_TRANSPORT  True if the UART transport is linked (BOOTLOADER_USE_UART_TRANSPORT)
+#   USE_SIGNING         True if signed UF2 files are verified (BOOTLOADER_SIGNING_KEY)
+#   USE_ENCRYPTION      True if encrypted UF2 files are decrypted (BOOTLOADER_ENCRYPTION_KEY)
+#
+# Two things are checked:
+#
+#   1. One function from each layer of the hot path that is linked (UF2 passes, hashing,
+#      decryption and the transports' read paths) is in RAM, so that passes 1 and 2 do not
+#      run through the XIP cache.
+#
+#   2. Every function that can run while pass 2 erases flash in the background is in RAM,
+#      since XIP is disabled until the erase completes.  Starting from the functions that run
+#      during the erase (the transport's block loop, the pass 2 callbacks and the interrupt
+#      handlers left enabled by 'flash_erase_start()'), the check follows each direct call
+#      and branch in the disassembly, including through linker veneers.  Calls through
+#      function pointers cannot be followed, so their targets are listed as roots below.
+#
+# On failure, the ELF is deleted so that the next build relinks and checks again.
+
+set(hot_functions
+    process_block
+    interval_set_union
+    crc32_update
+    erase_plan_find
+    flash_erase_busy
+)
+
+# Functions that run while an erase is in progress.  'read_block' and 'write_uf2_callback'
+# ('update.c') are invoked through the transport's callback.
+set(erase_roots
+    flash_erase_busy
+    read_block
+    write_uf2_callback
+)
+
+# Functions that run during an erase only if they are linked: handlers of the interrupts that
+# stay enabled, and the SD card driver's block read (called through 'sd_card_t').
+set(optional_roots
+    alarm_pool_alarm_callback
+    sleep_until_callback
+    sd_read_blocks
+)
+
+# Interrupt handlers, found by name (e.g., 'hardware_alarm_irq_handler' and the SD card
+# driver's DMA handler).
+set(handler_pattern "(irq_handler|_isr)$")
+
+if (USE_SIGNING)
+    list(APPEND hot_functions signature_hash_block sha256_update)
+endif()
+
+if (USE_ENCRYPTION)
+    list(APPEND hot_functions aes128_ctr)
+endif()
+
+if (USE_SD)
+    list(APPEND hot_functions f_read disk_read spi_transfer)
+    list(APPEND erase_roots read_file_blocks f_close)
+endif()
+
+if (USE_UART_TRANSPORT)
+    list(APPEND hot_functions uart_link_getc uart_proto_encode)
+    list(APPEND erase_roots uart_transport_read_uf2)
+endif()
+
+# RP2040 XIP address space.  Code anywhere else (SRAM or the bootrom) runs while XIP is
+# disabled.
+math(EXPR flash_start "0x10000000")
+math(EXPR flash_end "0x20000000")
+
+#
+# 1. Representative functions
+#
+
+execute_process(
+    COMMAND ${NM} ${ELF}
+    OUTPUT_VARIABLE symbols
+    RESULT_VARIABLE result
+)
+
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Unable to read symbols from '${ELF}'")
+endif()
+
+set(in_flash "")
+foreach(function ${hot_functions})
+    string(REGEX MATCH "([0-9a-fA-F]+) [Tt] ${function}\n" _ "${symbols}")
+    set(address "${CMAKE_MATCH_1}")
+
+    if (address STREQUAL "")
+        message(FATAL_ERROR "'${ELF}' does not define hot path function '${function}'")
+    endif()
+
+    math(EXPR address "0x${address}")
+    if (NOT address LESS flash_start AND address LESS flash_end)
+        math(EXPR address "${address}" OUTPUT_FORMAT HEXADECIMAL)
+        list(APPEND in_flash "${function} (${address})")
+    endif()
+endforeach()
+
+if (in_flash)
+    file(REMOVE ${ELF})
+    list(JOIN in_flash ", " in_flash)
+    message(FATAL_ERROR "Hot path functions are not in RAM: ${in_flash}")
+endif()
+
+#
+# 2. Everything reachable during a background erase
+#
+
+# Code in RAM is linked into .data (see 'memmap.ld'), which is disassembled as well.
+execute_process(
+    COMMAND ${OBJDUMP} --disassemble-all --no-show-raw-insn -j .text -j .data ${ELF}
+    OUTPUT_VARIABLE listing
+    RESULT_VARIABLE result
+)
+
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Unable to disassemble '${ELF}'")
+endif()
+
+# Split the listing into one list element per symbol, separated by blank lines.  Characters
+# that are special in CMake lists do not matter to the check, so they are dropped first.
+string(REGEX REPLACE "[][;]" "" listing "${listing}")
+string(REPLACE "\n\n" ";" listing "${listing}")
+
+set(functions "")
+foreach(block IN LISTS listing)
+    if (NOT block MATCHES "^\n*([0-9a-f]+) <([^>]+)>:")
+        continue()
+    endif()
+
+    math(EXPR address "0x${CMAKE_MATCH_1}")
+    set(name "${CMAKE_MATCH_2}")
+    list(APPEND functions "${name}")
+
+    # Static functions may share a name, so keep the callees of all of them, and treat the
+    # name as in flash if any of them is.
+    if (NOT address LESS flash_start AND address LESS flash_end)
+        math(EXPR address "${address}" OUTPUT_FORMAT HEXADECIMAL)
+        set("in_flash_${name}" "${address}")
+    endif()
+
+    # Branches and calls to another symbol, e.g. "bl 10001234 <f_read>" or a tail call
+    # "b.n 20000456 <memcpy+0x4>".  Branches within the function are ignored below.
+    string(REGEX MATCHALL "\tb[a-z]*(\\.[nw])?\t[0-9a-f]+ <[^>+]+" targets "${block}")
+    foreach(target IN LISTS targets)
+        string(REGEX REPLACE ".*<" "" target "${target}")
+
+        # A linker veneer ('__f_read_veneer') reaches its target through a literal.
+        string(REGEX REPLACE "^__(.+)_veneer$" "\\1" target "${target}")
+
+        if (NOT target STREQUAL name)
+            list(APPEND "calls_${name}" "${target}")
+        endif()
+    endforeach()
+endforeach()
+
+foreach(root ${erase_roots})
+    list(FIND functions ${root} index)
+    if (index LESS 0)
+        message(FATAL_ERROR "'${ELF}' does not define background erase function '${root}'")
+    endif()
+endforeach()
+
+foreach(root ${optional_roots})
+    list(FIND functions ${root} index)
+    if (NOT index LESS 0)
+        list(APPEND erase_roots ${root})
+    endif()
+endforeach()
+
+foreach(function IN LISTS functions)
+    if (function MATCHES "${handler_pattern}")
+        list(APPEND erase_roots ${function})
+    endif()
+endforeach()
+
+# Breadth-first search of the call graph.
+set(reached ${erase_roots})
+list(REMOVE_DUPLICATES reached)
+set(queue ${reached})
+set(in_flash "")
+
+while (queue)
+    list(GET queue 0 function)
+    list(REMOVE_AT queue 0)
+
+    if (DEFINED "in_flash_${function}")
+        list(APPEND in_flash "${function} (${in_flash_${function}})")
+    endif()
+
+    foreach(callee IN LISTS "calls_${function}")
+        list(FIND reached ${callee} index)
+        if (index LESS 0)
+            list(APPEND reached ${callee})
+            list(APPEND queue ${callee})
+        endif()
+    endforeach()
+endwhile()
+
+if (in_flash)
+    file(REMOVE ${ELF})
+    list(JOIN in_flash ", " in_flash)
+    message(FATAL_ERROR "Functions that may run during a background erase are not in RAM: ${in_flash}")
+endif()
+
+list(LENGTH hot_functions count)
+list(LENGTH reached reached_count)
+message(STATUS "Update hot path is in RAM (checked ${count} functions, and ${reached_count} reachable during erases)")
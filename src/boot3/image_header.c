@@ -0,0 +1,80 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <stddef.h>
+#include <string.h>
+
+// Project
+#include "crc32.h"
+#include "image_header.h"
+
+bool image_header_is_header_block(const struct uf2_block* block) {
+    const image_header_t* header = (const image_header_t*) block->data;
+    return (block->flags & UF2_FLAG_NOT_MAIN_FLASH) != 0
+        && header->magic == IMAGE_HEADER_MAGIC;
+}
+
+bool image_header_read(image_header_t* header, const struct uf2_block* block) {
+    const image_header_t* source = (const image_header_t*) block->data;
+
+    // The image header is read on its own when choosing between UF2 files, so check that it
+    // is a valid RP2040 block.
+    bool ok = (block->magic_start0 == UF2_MAGIC_START0)
+        && (block->magic_start1 == UF2_MAGIC_START1)
+        && (block->magic_end == UF2_MAGIC_END);
+    ok &= (block->flags & UF2_FLAG_FAMILY_ID_PRESENT) != 0 && block->file_size == RP2040_FAMILY_ID;
+
+    ok &= image_header_is_header_block(block);
+    ok &= source->version == IMAGE_HEADER_VERSION;
+    ok &= sizeof(image_header_t) <= block->payload_size;
+    ok &= block->payload_size <= sizeof(block->data);
+
+    // The board ID must be NUL-terminated.
+    ok &= memchr(source->board_id, '\0', sizeof(source->board_id)) != NULL;
+
+    if (ok) {
+        memcpy(header, source, sizeof(image_header_t));
+    }
+
+    return ok;
+}
+
+bool image_header_is_compatible(const image_header_t* header, const char* board_id) {
+    return header->board_id[0] == '\0'
+        || board_id[0] == '\0'
+        || strncmp(header->board_id, board_id, sizeof(header->board_id)) == 0;
+}
+
+bool image_header_is_newer(const image_header_t* candidate, const image_header_t* installed, const char* board_id) {
+    return image_header_is_present(candidate)
+        && image_header_is_compatible(candidate, board_id)
+        && (installed == NULL
+            || (image_header_is_present(installed) && candidate->image_version > installed->image_version));
+}
+
+image_record_t image_record_make(const image_header_t* header) {
+    image_record_t record;
+
+    if (header == NULL) {
+        memset(&record, 0xFF, sizeof(record));
+    } else {
+        // Firmware without an image header is recorded with an empty one.
+        memset(&record.header, 0, sizeof(record.header));
+        if (image_header_is_present(header)) {
+            record.header = *header;
+        }
+        record.crc = crc32_update(0, &record.header, sizeof(record.header));
+    }
+
+    return record;
+}
+
+const image_header_t* image_record_header(const image_record_t* record) {
+    return (image_header_is_present(&record->header) || record->header.magic == 0)
+        && record->crc == crc32_update(0, &record->header, sizeof(record->header))
+        ? &record->header
+        : NULL;
+}
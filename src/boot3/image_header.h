@@ -0,0 +1,94 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <boot/uf2.h>
+#include <hardware/flash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The image header is an optional UF2 metadata block (flagged UF2_FLAG_NOT_MAIN_FLASH) that
+// must be the first block of the UF2 file.  It identifies the firmware by a version number and
+// the board it was built for, so that the bootloader can choose between several UF2 files in
+// the firmware directory (BOOTLOADER_FIRMWARE_DIR) by reading only their first block.
+//
+// After installing a UF2 file, the bootloader records its header in the last sector of flash,
+// which is reserved for the bootloader.  A UF2 file from the firmware directory is only
+// installed if it is newer than the recorded header.  Firmware installed from a UF2 file
+// without a header has no version, so it is recorded with an empty header, which no image in
+// the firmware directory replaces.
+//
+// Like other metadata blocks, the image header is not covered by the signature (see
+// 'signature.h').
+//
+// The image header is added by 'scripts/uf2_version.py'.
+
+#define IMAGE_HEADER_MAGIC      0x474D4942  // "BIMG" (little-endian)
+#define IMAGE_HEADER_VERSION    1
+#define IMAGE_BOARD_ID_SIZE     32
+
+// The board this bootloader was built for (PICO_BOARD).  Images built for other boards are
+// ignored in the firmware directory and rejected otherwise.  An empty ID matches any board.
+#ifndef BOOTLOADER_BOARD_ID
+#define BOOTLOADER_BOARD_ID ""
+#endif
+
+// Payload of the image header block.
+typedef struct {
+    uint32_t magic;                             // IMAGE_HEADER_MAGIC
+    uint16_t version;                           // IMAGE_HEADER_VERSION
+    uint16_t reserved;                          // 0
+    uint32_t image_version;                     // Firmware version (larger is newer)
+    char board_id[IMAGE_BOARD_ID_SIZE];         // NUL-padded board name, or empty for any board
+} image_header_t;
+
+// The installed firmware's image header is recorded at IMAGE_RECORD_OFFSET.  An erased
+// record means that the installed firmware is unknown (e.g., an update was interrupted).  The
+// rest of the sector holds the scrub table (see 'scrub.h').
+#define IMAGE_RECORD_OFFSET     (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+typedef struct {
+    image_header_t header;                      // Header of the installed firmware
+    uint32_t crc;                               // CRC-32 of 'header'
+} image_record_t;
+
+// Returns true if the given header was read from a UF2 file (i.e., 'magic' is set).
+static inline bool image_header_is_present(const image_header_t* header) {
+    return header->magic == IMAGE_HEADER_MAGIC;
+}
+
+// Returns true if the given (metadata) block is an image header.
+bool image_header_is_header_block(const struct uf2_block* block);
+
+// Copies the image header from the given block.  Returns false if the block is malformed.
+bool image_header_read(image_header_t* header, const struct uf2_block* block);
+
+// Returns true if an image with the given header may be installed on the given board.
+bool image_header_is_compatible(const image_header_t* header, const char* board_id);
+
+// Returns true if 'candidate' is compatible with the given board and newer than 'installed'
+// (which may be NULL if the installed firmware is unknown).  Nothing is newer than installed
+// firmware without a header.
+bool image_header_is_newer(const image_header_t* candidate, const image_header_t* installed, const char* board_id);
+
+// Returns the record for the given header, which may not be present (firmware without a
+// header).  If the header is NULL, the record is erased (all 0xFF).
+image_record_t image_record_make(const image_header_t* header);
+
+// Returns the header from the given record, or NULL if the record is erased or corrupt.  The
+// header is not present if the installed firmware has none.
+const image_header_t* image_record_header(const image_record_t* record);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -184,3 +184,13 @@ int interval_set_union(interval_set_t* set, uint32_t start, uint32_t end) {
 
     return added;
 }
+
+bool interval_set_contains(const interval_set_t* set, uint32_t value) {
+    // 'find_interval' returns the first interval where 'end >= value'.  Because intervals are
+    // half-open, 'value' is contained only if it is also strictly less than 'end'.
+    int i = find_interval(set, value);
+
+    return i < set->num_intervals
+        && set->intervals[i].start <= value
+        && value < set->intervals[i].end;
+}
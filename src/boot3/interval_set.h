@@ -40,6 +40,9 @@ void interval_set_clear(interval_set_t* set);
 // Returns the number of new elements added to the set.
 int interval_set_union(interval_set_t* set, uint32_t start, uint32_t end);
 
+// Returns true if 'value' is an element of 'set'.
+bool interval_set_contains(const interval_set_t* set, uint32_t value);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -0,0 +1,168 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Project
+#include "log_ring.h"
+
+void log_ring_init(log_ring_t* ring, uint8_t* buffer, uint32_t size) {
+    ring->buffer = buffer;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+}
+
+bool log_ring_write(log_ring_t* ring, const void* data, uint32_t len) {
+    if (len > log_ring_free(ring)) {
+        ring->dropped += len;
+        return false;
+    }
+
+    const uint32_t head = ring->head;
+    const uint32_t offset = head & ring->mask;
+    const uint32_t first = len < ring->mask + 1 - offset ? len : ring->mask + 1 - offset;
+
+    memcpy(ring->buffer + offset, data, first);
+    memcpy(ring->buffer, (const uint8_t*) data + first, len - first);
+
+    // Publish the bytes only after they are in the buffer.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ring->head = head + len;
+    return true;
+}
+
+void log_ring_consume(log_ring_t* ring, uint32_t len) {
+    ring->tail += len;
+}
+
+uint32_t log_ring_read(log_ring_t* ring, void* data, uint32_t len) {
+    const uint32_t pending = log_ring_pending(ring);
+    if (len > pending) { len = pending; }
+
+    uint8_t* out = (uint8_t*) data;
+    for (uint32_t i = 0; i < len; i++) {
+        out[i] = ring->buffer[(ring->tail + i) & ring->mask];
+    }
+
+    log_ring_consume(ring, len);
+    return len;
+}
+
+// A bounded output buffer.  Characters that do not fit (leaving room for the NUL) are
+// discarded.
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t len;
+} output_t;
+
+static void put(output_t* out, char c) {
+    if (out->len + 1 < out->size) {
+        out->buffer[out->len] = c;
+    }
+    out->len++;
+}
+
+static void put_number(output_t* out, uint32_t value, uint32_t base, bool upper, bool negative, char pad, int width) {
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char reversed[10];
+    int count = 0;
+
+    do {
+        reversed[count++] = digits[value % base];
+        value /= base;
+    } while (value != 0);
+
+    width -= count + (negative ? 1 : 0);
+
+    // Zero padding follows the sign, space padding precedes it.
+    if (negative && pad == '0') { put(out, '-'); }
+    while (width-- > 0) { put(out, pad); }
+    if (negative && pad != '0') { put(out, '-'); }
+
+    while (count > 0) {
+        put(out, reversed[--count]);
+    }
+}
+
+size_t log_format(char* buffer, size_t size, const char* format, va_list args) {
+    output_t out = { buffer, size, 0 };
+
+    for (const char* p = format; *p != '\0'; p++) {
+        if (*p != '%') {
+            put(&out, *p);
+            continue;
+        }
+
+        p++;
+
+        char pad = ' ';
+        if (*p == '0') {
+            pad = '0';
+            p++;
+        }
+
+        int width = 0;
+        while ('0' <= *p && *p <= '9') {
+            width = width * 10 + (*p++ - '0');
+        }
+
+        if (*p == 'l') { p++; }
+
+        switch (*p) {
+            case 'c':
+                put(&out, (char) va_arg(args, int));
+                break;
+
+            case 's': {
+                const char* s = va_arg(args, const char*);
+                int len = (int) strlen(s);
+                while (width-- > len) { put(&out, ' '); }
+                while (*s != '\0') { put(&out, *s++); }
+                break;
+            }
+
+            case 'd': {
+                const int value = va_arg(args, int);
+                const uint32_t magnitude = value < 0 ? 0u - (uint32_t) value : (uint32_t) value;
+                put_number(&out, magnitude, 10, false, value < 0, pad, width);
+                break;
+            }
+
+            case 'u':
+                put_number(&out, va_arg(args, unsigned), 10, false, false, pad, width);
+                break;
+
+            case 'x':
+            case 'X':
+                put_number(&out, va_arg(args, unsigned), 16, *p == 'X', false, pad, width);
+                break;
+
+            case '%':
+                put(&out, '%');
+                break;
+
+            case '\0':
+                // Trailing '%'.
+                p--;
+                break;
+
+            default:
+                // Unsupported conversion: copy it verbatim.
+                put(&out, '%');
+                put(&out, *p);
+                break;
+        }
+    }
+
+    if (size > 0) {
+        buffer[out.len < size ? out.len : size - 1] = '\0';
+    }
+
+    return out.len < size ? out.len : (size > 0 ? size - 1 : 0);
+}
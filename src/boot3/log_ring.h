@@ -0,0 +1,66 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Single-producer, single-consumer byte ring for log output ('uart_log.h').  The producer
+// appends messages and advances 'head'.  The consumer (the UART's DMA channel) reads from
+// 'tail' and advances it once the bytes have been sent.  Each index is only written by one
+// side, so neither side takes a lock.
+//
+// 'head' and 'tail' count bytes since 'log_ring_init()' and wrap at 2^32.  The buffer size
+// must be a power of two, so that the offset into the buffer is 'index & mask'.
+typedef struct {
+    uint8_t* buffer;
+    uint32_t mask;              // Buffer size - 1
+    volatile uint32_t head;     // Bytes written (updated by the producer)
+    volatile uint32_t tail;     // Bytes consumed (updated by the consumer)
+    uint32_t dropped;           // Bytes discarded because the ring was full
+} log_ring_t;
+
+// Initializes an empty ring over 'buffer', whose size must be a power of two.
+void log_ring_init(log_ring_t* ring, uint8_t* buffer, uint32_t size);
+
+// Appends 'len' bytes.  If they do not all fit, nothing is written and the bytes are counted
+// in 'dropped'.  Returns false if the bytes were dropped.
+bool log_ring_write(log_ring_t* ring, const void* data, uint32_t len);
+
+// Returns the number of bytes written but not yet consumed.
+static inline uint32_t log_ring_pending(const log_ring_t* ring) {
+    return ring->head - ring->tail;
+}
+
+// Returns the number of bytes that can be written without dropping.
+static inline uint32_t log_ring_free(const log_ring_t* ring) {
+    return ring->mask + 1 - log_ring_pending(ring);
+}
+
+// Marks 'len' pending bytes as consumed (e.g., after the DMA channel has sent them).
+void log_ring_consume(log_ring_t* ring, uint32_t len);
+
+// Copies up to 'len' pending bytes to 'data' and consumes them.  Returns the number of bytes
+// copied.
+uint32_t log_ring_read(log_ring_t* ring, void* data, uint32_t len);
+
+// Formats a message into 'buffer' without newlib's printf.  Supports '%%', '%c', '%s', '%d',
+// '%u', '%x' and '%X', with an optional '0' flag and field width (e.g., '%08x').  A 'l'
+// length modifier is accepted and ignored, since 'int' and 'long' are both 32-bit on the
+// RP2040.  The result is truncated to fit and always NUL-terminated (if 'size' > 0).
+// Returns the length of the result, excluding the NUL.
+size_t log_format(char* buffer, size_t size, const char* format, va_list args);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
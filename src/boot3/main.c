@@ -14,151 +14,120 @@
 // Pico SDK
 #include <boot/uf2.h>
 #include <hardware/flash.h>
+#include <hardware/structs/rosc.h>
+#include <hardware/timer.h>
 #include <hardware/watchdog.h>
 
 // Project
+#include "boot_control.h"
 #include "diag.h"
 #include "flash.h"
-#include "prog.h"
+#include "handoff.h"
+#include "rollback.h"
+#include "scrub.h"
+#include "staging.h"
 #include "transport.h"
+#include "uart_log.h"
+#include "update.h"
 #include "vector_table.h"
 
-// During pass 1 (validation), this callback is invoked for each block in the UF2
-// file that is valid and matches the expected family ID.
-static bool validate_uf2_callback(prog_t* prog, const struct uf2_block* block) {
-    // Blink the LED to show progress during large files.
-    if (prog->num_blocks_accepted % 128 == 0) {
-        led_toggle();
+// Transports probed for new firmware, in order.
+static const transport_t* const transports[] = {
+    #ifdef BOOTLOADER_USE_SD
+    &sd_transport,
+    #endif
+    #ifdef BOOTLOADER_USE_UART_TRANSPORT
+    &uart_transport,
+    #endif
+};
+
+#if BOOTLOADER_SCRUB_KB > 0
+// Returns 32 bits from the ring oscillator's random bit.
+static uint32_t rosc_random() {
+    uint32_t value = 0;
+    for (int i = 0; i < 32; i++) {
+        value = (value << 1) | (rosc_hw->randombit & 1);
     }
-
-    // While validating, we also check if the current contents of flash are identical
-    // to the contents of the UF2 file (ignoring the stage2 bootloader).
-    if (block->target_addr != XIP_BASE) {
-        // Once we've found the first different block, we can stop reading/comparing.
-        prog->is_different = prog->is_different
-            || memcmp((void*) block->target_addr, block->data, FLASH_PAGE_SIZE) != 0;
-    }
-
-    // And continue processing blocks.
-    return true;
+    return value;
 }
 
-// During pass 2 (writing), this callback is invoked for each block in the UF2
-// file that is valid and matches the expected family ID.
-static bool write_uf2_callback(prog_t* prog, const struct uf2_block* block) {
-    // Blink the LED rapidly to show progress during large files.
-    if (prog->num_blocks_accepted % 16 == 0) {
-        led_toggle();
-    }
+// Checks BOOTLOADER_SCRUB_KB of the installed firmware against the CRCs recorded by the last
+// update (see 'scrub.h'), starting at a random chunk so that every chunk is checked over
+// successive boots.  If a chunk does not match, marks the scrub as failed and returns false,
+// so that the firmware is reinstalled from the SD card, if available.  Once marked, returns
+// false without checking until the sector is erased by an update.
+static bool scrub_firmware() {
+    const scrub_table_t* table = (const scrub_table_t*) flash_contents(SCRUB_TABLE_OFFSET);
 
-    // There are a few target addresses that we require special handling.
-    switch (block->target_addr) {
-        case XIP_BASE:
-            // Ignore the stage2 bootloader block from the UF2 file.  We want to preserve our
-            // custom boot stage 2 (which we've already restored after erasing the sectors).
-            break;
-
-        case VECTOR_TABLE_ADDR:
-            // We detect if firmware has been installed by checking for a valid vector table.
-            // Delay writing the vector table until the end of the programming process.
-            memcpy(prog->vector_table, block->data, FLASH_PAGE_SIZE);
-            break;
-
-        default:
-            // Normal block: write to flash.
-            flash_prog(block->target_addr - XIP_BASE, block->data, FLASH_PAGE_SIZE);
-            break;
+    if (scrub_is_marked_failed((const image_record_t*) flash_contents(IMAGE_RECORD_OFFSET))) {
+        return false;
     }
 
-    // And continue processing blocks.
-    return true;
-}
-
-static void update_firmware() {
-    prog_t prog;
-    prog_init(&prog);
-    prog.accept_block = validate_uf2_callback;
-
-    //
-    // Pass 1: Validate the UF2 file
-    //
-
-    bool ok = read_uf2(&prog, process_block);
-
-    // Ensure that the entire program was received.
-    ok &= (prog.num_blocks > 0);
-    ok &= (prog.num_blocks_accepted == prog.num_blocks);
-
-    // Ensure that the program contains a valid vector table.
-    ok &= (prog.has_vector_table);
-
-    if (!ok) {
-        fatal(FATAL_INVALID_UF2);
-    }
-
-    if (!prog.is_different) {
-        diag(DIAG_SKIPPED_PROGRAMMING);
-        goto done;
+    if (!scrub_table_is_valid(table)) {
+        return true;
     }
 
-    //
-    // Pass 2: Write the UF2 file to flash
-    //
-
-    // Because there is a valid vector table in the UF2 file, we can assume
-    // that sector zero will be erased.
-    assert(prog.sectors_erased.num_intervals > 0);
-    assert(prog.sectors_erased.intervals[0].start == 0);
-
-    // Backup stage 2 bootloader.
-    uint8_t boot2_backup[FLASH_PAGE_SIZE];
-    memcpy(boot2_backup, (void*) XIP_BASE, FLASH_PAGE_SIZE);
+    const uint32_t first = rosc_random() % table->header.num_chunks;
+    const uint32_t count = scrub_chunks_for(table, BOOTLOADER_SCRUB_KB * 1024u);
 
-    // Erase sectors written by the UF2 file.
-    led_on();
+#ifdef BOOTLOADER_USE_UART
+    const uint32_t start_us = time_us_32();
+#endif
+    const int failed = scrub_check(table, flash_contents(0), first, count);
+#ifdef BOOTLOADER_USE_UART
+    LOG("[Boot3] Scrub: %u of %u chunks from %u, %u us\r\n",
+        (unsigned) count, (unsigned) table->header.num_chunks, (unsigned) first, (unsigned) (time_us_32() - start_us));
+#endif
 
-    for (int i = 0; i < prog.sectors_erased.num_intervals; i++) {
-        interval_t* current = &prog.sectors_erased.intervals[i];
-        uint32_t sector_start = current->start * FLASH_SECTOR_SIZE;
-        uint32_t sector_end = current->end * FLASH_SECTOR_SIZE;
-        flash_erase(sector_start, sector_end - sector_start);
+    if (failed < 0) {
+        return true;
     }
 
-    // To improve the odds of recovery in case programming is interrupted, we
-    // restore our custom stage 2 bootloader before first.
-    flash_prog(0, boot2_backup, FLASH_PAGE_SIZE);
+    LOG("[Boot3] Scrub: chunk %d (offset %08x) does not match\r\n", failed, (unsigned) (failed * table->header.chunk_size));
 
-    // Reset our programming state and prepare for writing.
-    prog.accept_block = write_uf2_callback;
-    prog.num_blocks = 0;
-    prog.num_blocks_accepted = 0;
-    interval_set_clear(&prog.pages_written);
+    // Programming zeros over the record needs no erase, and keeps the table.
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0, sizeof(page));
+    flash_prog(IMAGE_RECORD_OFFSET, page, sizeof(page));
+    return false;
+}
+#else
+#define scrub_firmware() (true)
+#endif
 
-    ok &= read_uf2(&prog, process_block);
-    if (!ok) {
-        fatal(FATAL_FLASH_FAILED);
-    }
+static void run_firmware() {
+    // Note that the LED pattern is cut short by the reset below.  We do not delay booting
+    // the firmware to display it.
+    diag(DIAG_ENTERING_FIRMWARE);
 
-    // Programming is successful.  The only thing left to do is to write the vector table
-    // to flash.
-    flash_prog(VECTOR_TABLE_ADDR - XIP_BASE, prog.vector_table, FLASH_PAGE_SIZE);
+    #if BOOTLOADER_ROLLBACK_SIZE > 0
+    // Count the start of firmware that has not confirmed it works since the last update.
+    rollback_count_boot();
+    #endif
 
-done:
-    // Finally, remove the UF2 file to prevent reprogramming on next boot.
-    if (ok && !remove_uf2()) {
-        diag(DIAG_DELETE_FAILED);
-    }
+    // 'scripts/boot_time.py' times the firmware's first output from the end of this line.
+    #ifdef BOOTLOADER_DIRECT_HANDOFF
+    LOG("[Boot3] Handoff: direct at %u us\r\n", time_us_32());
+    #else
+    LOG("[Boot3] Handoff: watchdog at %u us\r\n", time_us_32());
+    #endif
 
-    prog_free(&prog);
-    led_off();
-}
+    // Send any pending UART output before the handoff or reset below.
+    uart_log_flush();
 
-static void run_firmware() {
-    diag(DIAG_ENTERING_FIRMWARE);
+    #ifdef BOOTLOADER_DIRECT_HANDOFF
+    // Return the clocks and peripherals we used to their reset state and jump directly
+    // to the firmware.
+    handoff_direct();
+    #endif
 
     // We use the watchdog to reset the cores and peripherals to get back to
-    // a known state before running the firmware.  The 'main()' function detects
-    // if we are entering from the watchdog and jumps to the vector table.
+    // a known state before running the firmware.  The fast boot magic tells our
+    // entry point ('fast_boot.S') to jump directly to the firmware's vector table.
+    //
+    // (As a fallback, the 'main()' function also detects if we are entering from
+    // the watchdog and jumps to the vector table.)
+    watchdog_hw->scratch[BOOT_CONTROL_FAST_BOOT_SCRATCH] = BOOT_CONTROL_FAST_BOOT_MAGIC;
     watchdog_enable(/* delay_ms: */ 0, /* pause_on_debug: */ true);
 
     // Wait for the watchdog to kick in and reset the device.
@@ -168,6 +137,10 @@ static void run_firmware() {
 }
 
 int main() {
+    // Take any requests posted by the firmware before rebooting.  (Clearing the mailbox
+    // ensures that each request applies to a single reboot.)
+    const uint32_t boot_flags = boot_control_take();
+
     // To ensure that all cores and peripherals are in their initial state, our
     // stage 3 bootloader uses the watchdog to reset the device when it is ready
     // to run the firmware.
@@ -176,6 +149,18 @@ int main() {
         // for the watchdog.
         watchdog_hw->scratch[4] = 0;
 
+        #if BOOTLOADER_ROLLBACK_SIZE > 0
+        // 'fast_boot.S' normally takes the fast boot request from 'run_firmware()',
+        // which has already counted the start.  Otherwise, the firmware itself was reset by
+        // the watchdog (e.g., after hanging), and this is another start.
+        const bool is_counted = watchdog_hw->scratch[BOOT_CONTROL_FAST_BOOT_SCRATCH] == BOOT_CONTROL_FAST_BOOT_MAGIC;
+        watchdog_hw->scratch[BOOT_CONTROL_FAST_BOOT_SCRATCH] = 0;
+
+        if (!rollback_check(check_vector_table(vector_table)) && !is_counted) {
+            rollback_count_boot();
+        }
+        #endif
+
         // Double check that we have a valid vector table before jumping.
         if (!check_vector_table(vector_table)) {
             diag_init();
@@ -183,24 +168,99 @@ int main() {
         }
 
         // Run the firmware.
-        extern void vector_into_flash(uint32_t);
         vector_into_flash(VECTOR_TABLE_ADDR);
     }
 
     diag_init();
-    transport_init();
+
+    #if BOOTLOADER_ROLLBACK_SIZE > 0
+    // Restore the previous firmware if the last update failed to start (or was interrupted).
+    if (rollback_check(check_vector_table(vector_table))) {
+        diag(DIAG_ROLLED_BACK);
+    }
+    #endif
+
+    #if BOOTLOADER_STAGING_SIZE > 0
+    // Install an update staged in flash by the firmware.  This does not involve the SD card.
+    if (staging_transport.uf2_exists()) {
+        switch (update_firmware(&staging_transport, (boot_flags & BOOT_CONTROL_FORCE_FULL_REWRITE) != 0)) {
+            case UPDATE_INVALID_UF2:
+                // Flash was not modified.  Discard the staged image and continue with the
+                // installed firmware (if any).
+                staging_transport.remove_uf2();
+                diag(DIAG_STAGING_REJECTED);
+                break;
+
+            case UPDATE_FLASH_FAILED:
+                fatal(FATAL_FLASH_FAILED);
+                break;
+
+            default:
+                break;
+        }
+    }
+    #endif
+
+    // If the firmware asked us not to probe the SD card (or other transports), run it
+    // immediately.  (Unless it is corrupt, in which case we look for a replacement.)
+    const bool skip_sd_probe = (boot_flags & BOOT_CONTROL_SKIP_SD_PROBE) != 0
+        && (boot_flags & BOOT_CONTROL_FORCE_UPDATE_CHECK) == 0;
+
+    if (skip_sd_probe && check_vector_table(vector_table) && scrub_firmware()) {
+        run_firmware();
+    }
+
+    for (size_t i = 0; i < count_of(transports); i++) {
+        transports[i]->init();
+    }
 
     // Poll for either a new firmware file or a valid vector table.
     while (true) {
-        if (uf2_exists()) {
-            update_firmware();
+        for (size_t i = 0; i < count_of(transports); i++) {
+            const transport_t* transport = transports[i];
+
+            if (!transport->uf2_exists()) {
+                continue;
+            }
+
+            switch (update_firmware(transport, (boot_flags & BOOT_CONTROL_FORCE_FULL_REWRITE) != 0)) {
+                case UPDATE_INVALID_UF2:
+                    // Flash was not modified.  Skip an image the transport keeps (e.g., in the
+                    // SD card's firmware directory), and fall back to the next image or the
+                    // installed firmware.  Otherwise, the file must be replaced.
+                    if (transport->reject_uf2 == NULL || !transport->reject_uf2()) {
+                        fatal(FATAL_INVALID_UF2);
+                    }
+                    diag(DIAG_IMAGE_REJECTED);
+                    break;
+
+                case UPDATE_FLASH_FAILED:
+                    fatal(FATAL_FLASH_FAILED);
+                    break;
+
+                default:
+                    break;
+            }
+
+            break;
         }
 
+        // If the scrub finds corrupt firmware, poll the transports again for a replacement.
+        // The firmware is not started until one is installed.
+        bool is_corrupt = false;
         if (check_vector_table(vector_table)) {
-            run_firmware();
+            if (scrub_firmware()) {
+                run_firmware();
+            }
+            is_corrupt = true;
+        }
+
+        // Keep polling for firmware while the 'no firmware' (or 'scrub failed') pattern plays.
+        if (!diag_is_busy()) {
+            diag(is_corrupt ? DIAG_SCRUB_FAILED : DIAG_NO_FIRMWARE);
         }
 
-        diag(DIAG_NO_FIRMWARE);
+        uart_log_poll();
     }
 
     assert(false);
@@ -0,0 +1,233 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <stdlib.h>
+#include <string.h>
+
+// Pico SDK
+#include <hardware/flash.h>
+
+// Project
+#include "crc32.h"
+#include "manifest.h"
+#include "prog.h"
+
+#define MANIFEST_MAX_SECTORS (PROG_AREA_SIZE / FLASH_SECTOR_SIZE)
+
+void manifest_init(manifest_t* manifest) {
+    memset(manifest, 0, sizeof(manifest_t));
+    interval_set_init(&manifest->sectors_changed);
+    manifest_restart(manifest);
+}
+
+void manifest_free(manifest_t* manifest) {
+    free(manifest->entries);
+    interval_set_free(&manifest->sectors_changed);
+    memset(manifest, 0, sizeof(manifest_t));
+}
+
+void manifest_restart(manifest_t* manifest) {
+    manifest->num_received = 0;
+    manifest->_image_crc = 0;
+    manifest->_entry = manifest->num_entries;   // No sector in progress
+    manifest->_offset = 0;
+    manifest->_sector_crc = 0;
+    manifest->_num_verified = 0;
+    manifest->_is_ordered = true;
+}
+
+bool manifest_is_manifest_block(const struct uf2_block* block) {
+    const manifest_header_t* header = (const manifest_header_t*) block->data;
+    return (block->flags & UF2_FLAG_NOT_MAIN_FLASH) != 0
+        && header->magic == MANIFEST_MAGIC;
+}
+
+bool manifest_add_block(manifest_t* manifest, const struct uf2_block* block) {
+    const manifest_header_t* header = (const manifest_header_t*) block->data;
+    const manifest_entry_t* entries = (const manifest_entry_t*) (header + 1);
+
+    bool ok = manifest_is_manifest_block(block);
+    ok &= header->version == MANIFEST_VERSION;
+
+    // The manifest must list at least one sector, and no more than fit in the program area.
+    ok &= (0 < header->total_entries) && (header->total_entries <= MANIFEST_MAX_SECTORS);
+
+    // Manifest blocks must be sequential and may not exceed the declared number of entries.
+    ok &= header->first_entry == manifest->num_received;
+    ok &= (0 < header->num_entries) && (header->num_entries <= MANIFEST_MAX_ENTRIES_PER_BLOCK);
+    ok &= header->num_entries <= header->total_entries - header->first_entry;
+
+    // The entries must fit within the block's payload.
+    ok &= sizeof(manifest_header_t) + header->num_entries * sizeof(manifest_entry_t) <= block->payload_size;
+    ok &= block->payload_size <= sizeof(block->data);
+
+    if (!ok) { return false; }
+
+    if (header->first_entry == 0) {
+        // First manifest block: (re)allocate the sector list.  Note that the UF2 file is read
+        // multiple times, in which case we overwrite the previous entries with the same data.
+        if (manifest->entries == NULL || manifest->num_entries != header->total_entries) {
+            free(manifest->entries);
+            manifest->entries = (manifest_entry_t*) malloc(sizeof(manifest_entry_t) * header->total_entries);
+        }
+
+        // Reject the UF2 file if there is no room for the sector list.
+        if (manifest->entries == NULL) {
+            manifest->num_entries = 0;
+            return false;
+        }
+
+        manifest->num_entries = header->total_entries;
+        manifest->image_crc = header->image_crc;
+        manifest->_entry = manifest->num_entries;
+    } else {
+        // Subsequent manifest blocks must agree with the first.
+        ok &= header->total_entries == manifest->num_entries;
+        ok &= header->image_crc == manifest->image_crc;
+    }
+
+    for (uint32_t i = 0; ok && i < header->num_entries; i++) {
+        const manifest_entry_t* entry = &entries[i];
+
+        // Sectors must be within the program area and listed in strictly ascending order.
+        ok &= entry->sector < MANIFEST_MAX_SECTORS;
+        ok &= manifest->num_received == 0
+            || manifest->entries[manifest->num_received - 1].sector < entry->sector;
+
+        manifest->entries[manifest->num_received++] = *entry;
+    }
+
+    return ok;
+}
+
+// Returns the number of leading bytes of the sector excluded from its CRC-32.  For sector 0,
+// this is the stage 2 bootloader, which we never overwrite.
+static uint32_t sector_skip(uint32_t sector) {
+    return sector == 0 ? FLASH_PAGE_SIZE : 0;
+}
+
+int manifest_find_changed(manifest_t* manifest, const uint8_t* flash) {
+    interval_set_clear(&manifest->sectors_changed);
+
+    for (uint32_t i = 0; i < manifest->num_entries; i++) {
+        const manifest_entry_t* entry = &manifest->entries[i];
+        const uint32_t skip = sector_skip(entry->sector);
+        const uint8_t* sector = flash + entry->sector * FLASH_SECTOR_SIZE;
+
+        if (crc32_update(0, sector + skip, FLASH_SECTOR_SIZE - skip) != entry->crc) {
+            interval_set_union(&manifest->sectors_changed, entry->sector, entry->sector + 1);
+        }
+    }
+
+    // The vector table is written last so that an interrupted update leaves no valid firmware.
+    // To preserve this guarantee, sector 0 is always rewritten if any other sector changes.
+    if (manifest->sectors_changed.num_elements > 0 && manifest->entries[0].sector == 0) {
+        interval_set_union(&manifest->sectors_changed, 0, 1);
+    }
+
+    return manifest->sectors_changed.num_elements;
+}
+
+void manifest_mark_all_changed(manifest_t* manifest) {
+    for (uint32_t i = 0; i < manifest->num_entries; i++) {
+        const uint32_t sector = manifest->entries[i].sector;
+        interval_set_union(&manifest->sectors_changed, sector, sector + 1);
+    }
+}
+
+// Returns the index of the entry for the given sector, or -1 if the sector is not listed.
+static int find_entry(const manifest_t* manifest, uint32_t sector) {
+    int left = 0;
+    int right = manifest->num_entries - 1;
+
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+
+        if (manifest->entries[mid].sector < sector) {
+            left = mid + 1;
+        } else if (manifest->entries[mid].sector > sector) {
+            right = mid - 1;
+        } else {
+            return mid;
+        }
+    }
+
+    return -1;
+}
+
+// Pads the current sector with erased bytes and compares its CRC-32 with the manifest.
+static bool finish_sector(manifest_t* manifest) {
+    if (manifest->_entry >= manifest->num_entries) { return true; }
+
+    uint32_t crc = crc32_fill(manifest->_sector_crc, 0xFF, FLASH_SECTOR_SIZE - manifest->_offset);
+    manifest->_num_verified++;
+
+    return crc == manifest->entries[manifest->_entry].crc;
+}
+
+bool manifest_verify_block(manifest_t* manifest, const struct uf2_block* block) {
+    const uint32_t addr = block->target_addr - XIP_BASE;
+    const uint32_t sector = addr / FLASH_SECTOR_SIZE;
+    const uint32_t offset = addr % FLASH_SECTOR_SIZE;
+
+    manifest->_image_crc = crc32_update(manifest->_image_crc, block->data, FLASH_PAGE_SIZE);
+
+    // Every sector written by the UF2 file must be listed in the manifest.
+    const int entry = find_entry(manifest, sector);
+    if (entry < 0) { return false; }
+
+    // Per-sector CRCs are accumulated as the blocks stream by, which requires the blocks to be
+    // in ascending address order (as produced by the Pico SDK tools).  Otherwise, we can only
+    // verify the image CRC.
+    if (!manifest->_is_ordered) { return true; }
+
+    if ((uint32_t) entry != manifest->_entry) {
+        if (manifest->_entry < manifest->num_entries && (uint32_t) entry < manifest->_entry) {
+            manifest->_is_ordered = false;
+            return true;
+        }
+
+        if (!finish_sector(manifest)) { return false; }
+
+        manifest->_entry = entry;
+        manifest->_offset = sector_skip(sector);
+        manifest->_sector_crc = 0;
+    }
+
+    // Skip the stage 2 bootloader, which is excluded from the sector CRC.
+    if (offset < sector_skip(sector)) { return true; }
+
+    if (offset < manifest->_offset) {
+        manifest->_is_ordered = false;
+        return true;
+    }
+
+    // Account for any unwritten (erased) pages between the previous block and this one.
+    manifest->_sector_crc = crc32_fill(manifest->_sector_crc, 0xFF, offset - manifest->_offset);
+    manifest->_sector_crc = crc32_update(manifest->_sector_crc, block->data, FLASH_PAGE_SIZE);
+    manifest->_offset = offset + FLASH_PAGE_SIZE;
+
+    return true;
+}
+
+bool manifest_verify_finish(manifest_t* manifest) {
+    bool ok = manifest_is_complete(manifest);
+    ok &= manifest->_image_crc == manifest->image_crc;
+
+    if (manifest->_is_ordered) {
+        ok &= finish_sector(manifest);
+        manifest->_entry = manifest->num_entries;
+
+        // Every listed sector must have been written by the UF2 file.
+        ok &= manifest->_num_verified == manifest->num_entries;
+    } else {
+        // We were unable to verify the per-sector CRCs, so we cannot trust them to skip
+        // unchanged sectors.  Conservatively rewrite every sector listed in the manifest.
+        manifest_mark_all_changed(manifest);
+    }
+
+    return ok;
+}
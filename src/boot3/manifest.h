@@ -0,0 +1,116 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <boot/uf2.h>
+
+// Project
+#include "interval_set.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The manifest is an optional set of UF2 metadata blocks (flagged UF2_FLAG_NOT_MAIN_FLASH)
+// at the very beginning of the UF2 file.  It lists every flash sector written by the image
+// along with the CRC-32 of each sector's final contents, plus a CRC-32 of the whole image.
+//
+// This lets the bootloader decide if the installed firmware is already up to date by
+// checksumming the current flash contents, without reading the rest of the UF2 file, and
+// limit erasing/programming to the sectors that actually changed.
+//
+// The manifest is generated by 'scripts/uf2_manifest.py'.
+
+#define MANIFEST_MAGIC      0x464E4D42  // "BMNF" (little-endian)
+#define MANIFEST_VERSION    1
+
+// Header at the start of the payload of each manifest block.
+typedef struct {
+    uint32_t magic;             // MANIFEST_MAGIC
+    uint16_t version;           // MANIFEST_VERSION
+    uint16_t num_entries;       // Number of entries that follow in this block
+    uint32_t first_entry;       // Index of the first entry in this block
+    uint32_t total_entries;     // Total number of entries in the manifest (i.e., sectors written)
+    uint32_t image_crc;         // CRC-32 of the payloads of all flash blocks, in file order
+} manifest_header_t;
+
+// One entry per flash sector written by the image, sorted by ascending sector index.
+//
+// The CRC-32 covers the full 4kB sector as it will appear in flash after programming
+// (pages not written by the image are erased to 0xFF).  For sector 0, the first page is
+// excluded, since we always preserve our custom stage 2 bootloader.
+typedef struct {
+    uint32_t sector;            // Index of the sector relative to XIP_BASE
+    uint32_t crc;               // CRC-32 of the sector's contents
+} manifest_entry_t;
+
+#define MANIFEST_MAX_ENTRIES_PER_BLOCK \
+    ((sizeof(((struct uf2_block*) 0)->data) - sizeof(manifest_header_t)) / sizeof(manifest_entry_t))
+
+typedef struct {
+    manifest_entry_t* entries;      // Sector list (NULL if the UF2 file has no manifest)
+    uint32_t num_entries;           // Total number of entries declared by the manifest
+    uint32_t num_received;          // Number of entries received so far
+    uint32_t image_crc;             // Expected CRC-32 of all flash block payloads
+    interval_set_t sectors_changed; // Sectors where the current flash contents differ from the manifest
+
+    // Private: state for verifying the manifest against the UF2 file during validation.
+    uint32_t _image_crc;            // Running CRC-32 of flash block payloads
+    uint32_t _entry;                // Index of the entry currently being checksummed
+    uint32_t _offset;               // Offset within the current sector checksummed so far
+    uint32_t _sector_crc;           // Running CRC-32 of the current sector
+    uint32_t _num_verified;         // Number of entries whose CRC-32 has been verified
+    bool _is_ordered;               // False if flash blocks were not in ascending address order
+} manifest_t;
+
+void manifest_init(manifest_t* manifest);
+void manifest_free(manifest_t* manifest);
+
+// Resets the state for processing the UF2 file again, retaining the sector list and the
+// set of changed sectors.
+void manifest_restart(manifest_t* manifest);
+
+// Returns true if the UF2 file contains a manifest.
+static inline bool manifest_is_present(const manifest_t* manifest) {
+    return manifest->entries != NULL;
+}
+
+// Returns true if all entries of the manifest have been received.
+static inline bool manifest_is_complete(const manifest_t* manifest) {
+    return manifest->entries != NULL && manifest->num_received == manifest->num_entries;
+}
+
+// Returns true if the given (metadata) block holds part of a manifest.
+bool manifest_is_manifest_block(const struct uf2_block* block);
+
+// Adds the entries from the given manifest block.  Returns false if the block is malformed
+// or inconsistent with previously received manifest blocks.
+bool manifest_add_block(manifest_t* manifest, const struct uf2_block* block);
+
+// Checksums the current contents of each listed sector of 'flash' (which points to the
+// start of flash) and records those that differ from the manifest in 'sectors_changed'.
+// Returns the number of sectors that need to be reprogrammed.
+int manifest_find_changed(manifest_t* manifest, const uint8_t* flash);
+
+// Records every listed sector in 'sectors_changed', regardless of the current flash contents.
+void manifest_mark_all_changed(manifest_t* manifest);
+
+// Verifies the given flash block against the manifest.  Returns false if the block writes
+// to a sector not listed in the manifest or completes a sector whose CRC-32 does not match.
+bool manifest_verify_block(manifest_t* manifest, const struct uf2_block* block);
+
+// Completes verification after the last flash block.  Returns false if the image CRC-32
+// does not match, or if a sector listed by the manifest was not written.
+bool manifest_verify_finish(manifest_t* manifest);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,100 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Project
+#include "crc32.h"
+#include "profile.h"
+#include "uart_log.h"
+
+static profile_hist_t histograms[PROFILE_NUM_OPS];
+
+// The frame is written to the UART log ring in one piece.
+_Static_assert(PROFILE_MAX_ENCODED_SIZE <= UART_LOG_SIZE, "UART_LOG_SIZE is too small for the profile frame");
+
+uint32_t profile_bucket(uint32_t us) {
+    if (us == 0) { return 0; }
+
+    const uint32_t bucket = 32 - __builtin_clz(us);
+    return bucket < PROFILE_NUM_BUCKETS
+        ? bucket
+        : PROFILE_NUM_BUCKETS - 1;
+}
+
+void profile_record(profile_op_t op, uint32_t us) {
+    profile_hist_t* hist = &histograms[op];
+
+    hist->count++;
+    hist->total_us += us;
+    hist->max_us = us > hist->max_us ? us : hist->max_us;
+    hist->buckets[profile_bucket(us)]++;
+}
+
+void profile_reset(void) {
+    memset(histograms, 0, sizeof(histograms));
+}
+
+const profile_hist_t* profile_get(profile_op_t op) {
+    return &histograms[op];
+}
+
+// Appends 'value' as an unsigned LEB128 varint.  Most buckets are zero and encode as a
+// single byte.
+static uint8_t* put_varint(uint8_t* p, uint32_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+
+    *p++ = (uint8_t) value;
+    return p;
+}
+
+size_t profile_encode(uint8_t* buffer, size_t size) {
+    if (size < PROFILE_MAX_ENCODED_SIZE) { return 0; }
+
+    uint8_t* p = buffer;
+
+    memcpy(p, PROFILE_MAGIC, 4);
+    p += 4;
+
+    uint8_t* const body = p;
+    *p++ = PROFILE_VERSION;
+    *p++ = PROFILE_NUM_OPS;
+    *p++ = PROFILE_NUM_BUCKETS;
+
+    for (int op = 0; op < PROFILE_NUM_OPS; op++) {
+        const profile_hist_t* hist = &histograms[op];
+
+        p = put_varint(p, hist->count);
+        p = put_varint(p, hist->total_us);
+        p = put_varint(p, hist->max_us);
+
+        for (int i = 0; i < PROFILE_NUM_BUCKETS; i++) {
+            p = put_varint(p, hist->buckets[i]);
+        }
+    }
+
+    const uint32_t crc = crc32_update(0, body, p - body);
+    for (int i = 0; i < 4; i++) {
+        *p++ = (uint8_t) (crc >> (8 * i));
+    }
+
+    return p - buffer;
+}
+
+void profile_dump(void) {
+    #if defined(BOOTLOADER_USE_PROFILE) && defined(BOOTLOADER_USE_UART)
+    uint8_t buffer[PROFILE_MAX_ENCODED_SIZE];
+    const size_t length = profile_encode(buffer, sizeof(buffer));
+
+    // Queue the binary frame behind any pending messages.  (Flushing first ensures that the
+    // frame fits in the log ring.)
+    uart_log_flush();
+    uart_log_write(buffer, length);
+    #endif
+}
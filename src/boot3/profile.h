@@ -0,0 +1,93 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef BOOTLOADER_USE_PROFILE
+// Pico SDK
+#include <hardware/timer.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Operations timed when BOOTLOADER_USE_PROFILE is enabled.  The order must match the
+// names in 'scripts/profile_decode.py'.
+typedef enum profile_op_s {
+    PROFILE_F_READ = 0,
+    PROFILE_FLASH_ERASE = 1,
+    PROFILE_FLASH_PROG = 2,
+    PROFILE_MEMCMP = 3,
+    PROFILE_PROCESS_BLOCK = 4,
+    PROFILE_HASH = 5,
+    PROFILE_DECRYPT = 6,
+    PROFILE_NUM_OPS
+} profile_op_t;
+
+// Durations are recorded in log2 buckets of microseconds.  Bucket 0 counts durations of 0us
+// and bucket 'i' counts durations in [2^(i-1), 2^i) us.  The last bucket also counts anything
+// longer.
+#define PROFILE_NUM_BUCKETS 24
+
+typedef struct {
+    uint32_t count;                         // Number of recorded durations
+    uint32_t total_us;                      // Sum of recorded durations
+    uint32_t max_us;                        // Longest recorded duration
+    uint32_t buckets[PROFILE_NUM_BUCKETS];  // Histogram of recorded durations
+} profile_hist_t;
+
+// PROFILE_BEGIN() / PROFILE_END() bracket a timed operation using the hardware timer.  They
+// compile to nothing unless BOOTLOADER_USE_PROFILE is enabled in 'config.cmake'.
+//
+//     PROFILE_BEGIN(start);
+//     f_read(...);
+//     PROFILE_END(PROFILE_F_READ, start);
+#ifdef BOOTLOADER_USE_PROFILE
+#define PROFILE_BEGIN(name) const uint32_t name = time_us_32()
+#define PROFILE_END(op, name) profile_record((op), time_us_32() - (name))
+#else
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END(op, name) ((void)0)
+#endif
+
+// Frames begin with this magic, followed by a version byte.
+#define PROFILE_MAGIC "BPRF"
+#define PROFILE_VERSION 1
+
+// Worst case size of an encoded frame (every counter requires a 5 byte varint).
+#define PROFILE_MAX_ENCODED_SIZE \
+    (4 + 3 + PROFILE_NUM_OPS * (3 + PROFILE_NUM_BUCKETS) * 5 + 4)
+
+// Returns the histogram bucket for the given duration.
+uint32_t profile_bucket(uint32_t us);
+
+// Records a duration for the given operation.
+void profile_record(profile_op_t op, uint32_t us);
+
+// Clears all histograms.
+void profile_reset(void);
+
+// Returns the histogram for the given operation.
+const profile_hist_t* profile_get(profile_op_t op);
+
+// Encodes the histograms into 'buffer' and returns the number of bytes written, or 0 if the
+// buffer is too small.  The frame is:
+//
+//     "BPRF" | version | num_ops | num_buckets
+//     for each op: count, total_us, max_us, buckets[num_buckets]  (unsigned LEB128 varints)
+//     CRC-32 of the preceding bytes after the magic (little-endian)
+size_t profile_encode(uint8_t* buffer, size_t size);
+
+// Writes the encoded histograms to the diagnostic UART (if enabled).
+void profile_dump(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
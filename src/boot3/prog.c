@@ -11,6 +11,7 @@
 
 // Project
 #include "prog.h"
+#include "profile.h"
 #include "vector_table.h"
 
 #if NDEBUG
@@ -31,24 +32,99 @@ uint32_t sector_index(uint32_t addr) {
     return (addr - XIP_BASE) / FLASH_SECTOR_SIZE;
 }
 
+// Encrypted UF2 files are only decrypted if the bootloader has a device key, so that the AES
+// code is not linked otherwise.
+#ifdef BOOTLOADER_ENCRYPTION_KEY
+// The decrypted copy of the current flash block of an encrypted UF2 file.  (Static to keep it
+// off the stack.)
+static struct uf2_block plaintext;
+#endif
+
 void prog_init(prog_t* prog) {
     memset(prog, 0, sizeof(prog_t));
+    prog->area_end = PROG_AREA_END;
     interval_set_init(&prog->pages_written);
     interval_set_init(&prog->sectors_erased);
+    manifest_init(&prog->manifest);
+    signature_init(&prog->signature);
+    encryption_init(&prog->encryption, NULL);
 }
 
 void prog_free(prog_t* prog) {
     interval_set_free(&prog->pages_written);
     interval_set_free(&prog->sectors_erased);
+    manifest_free(&prog->manifest);
     memset(prog, 0, sizeof(prog_t));
 }
 
-// Called by the transport for each UF2 block.
+void prog_set_flash_size(prog_t* prog, uint32_t flash_size) {
+    if (flash_size >= PICO_FLASH_SIZE_BYTES) {
+        prog->area_end = PROG_AREA_END;
+    } else if (flash_size >= BOOTLOADER_SIZE + BOOTLOADER_STAGING_SIZE + BOOTLOADER_ROLLBACK_SIZE) {
+        prog->area_end = PROG_AREA_BEGIN + flash_size - BOOTLOADER_SIZE - BOOTLOADER_STAGING_SIZE - BOOTLOADER_ROLLBACK_SIZE;
+    } else {
+        // Nothing fits.
+        prog->area_end = PROG_AREA_BEGIN;
+    }
+}
+
+void prog_restart(prog_t* prog) {
+    prog->num_blocks = 0;
+    prog->num_blocks_accepted = 0;
+    prog->num_metadata_blocks = 0;
+    prog->has_vector_table = false;
+    prog->is_partial = false;
+    prog->is_done = false;
+    interval_set_clear(&prog->pages_written);
+    interval_set_clear(&prog->sectors_erased);
+    memset(&prog->image_header, 0, sizeof(prog->image_header));
+    manifest_restart(&prog->manifest);
+    signature_restart(&prog->signature);
+    encryption_restart(&prog->encryption);
+}
+
+static bool is_partial_block(const struct uf2_block* block) {
+    const prog_partial_header_t* header = (const prog_partial_header_t*) block->data;
+    return header->magic == PROG_PARTIAL_MAGIC;
+}
+
+static bool read_partial_block(prog_t* prog, const struct uf2_block* block) {
+    const prog_partial_header_t* header = (const prog_partial_header_t*) block->data;
+
+    bool ok = header->version == PROG_PARTIAL_VERSION;
+    ok &= sizeof(prog_partial_header_t) <= block->payload_size;
+
+    // A UF2 file has at most one partial-update block.
+    ok &= !prog->is_partial;
+
+    prog->is_partial |= ok;
+    return ok;
+}
+
+bool prog_is_complete(const prog_t* prog) {
+    return prog->num_blocks > 0
+        && prog->num_blocks_accepted + prog->num_metadata_blocks == prog->num_blocks;
+}
+
+static bool has_uf2_magic(const struct uf2_block* block) {
+    return (block->magic_start0 == UF2_MAGIC_START0) &&         // Block must start with magic numbers
+           (block->magic_start1 == UF2_MAGIC_START1) &&
+           (block->magic_end == UF2_MAGIC_END);                 // Block must end with magic number
+}
+
+static bool is_other_family(const struct uf2_block* block) {
+    return (block->flags & UF2_FLAG_FAMILY_ID_PRESENT) == 0 || (block->file_size != RP2040_FAMILY_ID);
+}
+
+uint32_t prog_blocks_to_skip(const struct uf2_block* block) {
+    return has_uf2_magic(block) && is_other_family(block) && block->block_no < block->num_blocks
+        ? block->num_blocks - block->block_no - 1
+        : 0;
+}
+
 bool process_block(prog_t* prog, const struct uf2_block* block) {
     // Must be a valid UF2 block.
-    bool ok = ((block->magic_start0 == UF2_MAGIC_START0) &&     // Block must start with magic numbers 
-               (block->magic_start1 == UF2_MAGIC_START1) && 
-               (block->magic_end == UF2_MAGIC_END));            // Block must end with magic number
+    bool ok = has_uf2_magic(block);
 
     // If the family Id is missing or does not match the expected RP2040 family ID, then skip the
     // block.  The UF2 specification allows programs for multiple targets to be concatenated in a
@@ -60,7 +136,7 @@ bool process_block(prog_t* prog, const struct uf2_block* block) {
     //
     // Note that when the UF2_FLAG_FAMILY_ID_PRESENT flag is set, the 'file_size' field contains the
     // family ID.
-    if (((block->flags & UF2_FLAG_FAMILY_ID_PRESENT) == 0 || (block->file_size != RP2040_FAMILY_ID))) {
+    if (is_other_family(block)) {
         // If block is part of a program for another target (but is otherwise a valid UF2 block),
         // ignore it and continue programming.
         return ok;
@@ -69,7 +145,9 @@ bool process_block(prog_t* prog, const struct uf2_block* block) {
     // Each block has a 'num_blocks' field that indicates the total number of blocks in the program.
     // We capture this value from the first block we process and require that subsequent blocks
     // report the same number of total blocks.
-    if (prog->num_blocks_accepted == 0) {
+    const uint32_t num_blocks_processed = prog->num_blocks_accepted + prog->num_metadata_blocks;
+
+    if (num_blocks_processed == 0) {
         // 'num_blocks' must be greater than 0, since the program has at least one block
         // (i.e., the block we're processing now).
         ok &= (block->num_blocks > 0);
@@ -82,8 +160,8 @@ bool process_block(prog_t* prog, const struct uf2_block* block) {
     }
 
     // The 'block_no' field indicates the sequential index of this block within the program.
-    // It must start at 0 and increment by 1 for each subsequent block.
-    ok &= block->block_no == prog->num_blocks_accepted;
+    // It must start at 0 and increment by 1 for each subsequent block (including metadata blocks).
+    ok &= block->block_no == num_blocks_processed;
 
     // The 'block_no' field must be less than the total number of blocks in the program.
     ok &= block->block_no < prog->num_blocks;
@@ -91,11 +169,44 @@ bool process_block(prog_t* prog, const struct uf2_block* block) {
     // The UF2 spec allows metadata blocks that are not intended to be written to flash.
     // These are indicated by the UF2_FLAG_NOT_MAIN_FLASH flag and should be skipped.
     if ((block->flags & UF2_FLAG_NOT_MAIN_FLASH) != 0) {
+        if (image_header_is_header_block(block)) {
+            // The image header must be the first block.
+            ok &= (num_blocks_processed == 0);
+            ok &= ok && image_header_read(&prog->image_header, block);
+        } else if (manifest_is_manifest_block(block)) {
+            // The manifest must precede all flash blocks.
+            ok &= (prog->num_blocks_accepted == 0);
+            ok &= ok && manifest_add_block(&prog->manifest, block);
+        } else if (signature_is_signature_block(block)) {
+            ok &= ok && signature_add_block(&prog->signature, block);
+        } else if (encryption_is_encryption_block(block)) {
+#ifdef BOOTLOADER_ENCRYPTION_KEY
+            // The nonce must precede all flash blocks.
+            ok &= (prog->num_blocks_accepted == 0);
+            ok &= ok && encryption_add_block(&prog->encryption, block);
+#else
+            // Without a device key, encrypted UF2 files are rejected.
+            ok = false;
+#endif
+        } else if (is_partial_block(block)) {
+            // The partial-update block must precede all flash blocks.
+            ok &= (prog->num_blocks_accepted == 0);
+            ok &= ok && read_partial_block(prog, block);
+        }
+
         // If this block is not for the main flash (but is otherwise valid), ignore it
         // and continue programming.
+        if (ok) {
+            prog->num_metadata_blocks++;
+            prog->is_done |= prog_is_complete(prog);
+        }
+
         return ok;
     }
 
+    // If the UF2 file has a manifest, it must be complete before the first flash block.
+    ok &= !manifest_is_present(&prog->manifest) || manifest_is_complete(&prog->manifest);
+
     // The target address is the address in flash where the block should be written.
     // In the RP2040 memory map, flash memory begins at XIP_BASE.
     uint32_t start_addr = block->target_addr;
@@ -109,7 +220,21 @@ bool process_block(prog_t* prog, const struct uf2_block* block) {
     ok &= (end_addr - start_addr) == FLASH_PAGE_SIZE;
 
     // The target address must be within the available program area.
-    ok &= (PROG_AREA_BEGIN <= start_addr) && (end_addr <= PROG_AREA_END);
+    ok &= (PROG_AREA_BEGIN <= start_addr) && (end_addr <= prog->area_end);
+
+    // A partial update leaves sector 0 (the stage 2 bootloader and vector table) untouched.
+    ok &= !prog->is_partial || (start_addr >= PROG_AREA_BEGIN + FLASH_SECTOR_SIZE);
+
+    // If the UF2 file is encrypted, the remaining checks and 'accept_block' see the decrypted
+    // payload.  (Only the payload is encrypted, so the checks above are unaffected.)
+#ifdef BOOTLOADER_ENCRYPTION_KEY
+    if (ok && prog->encryption.is_present) {
+        PROFILE_BEGIN(decrypt_start);
+        encryption_decrypt_block(&prog->encryption, block, &plaintext);
+        PROFILE_END(PROFILE_DECRYPT, decrypt_start);
+        block = &plaintext;
+    }
+#endif
 
     if (block->target_addr == VECTOR_TABLE_ADDR) {
         // Note that a valid vector table was found.
@@ -138,6 +263,9 @@ bool process_block(prog_t* prog, const struct uf2_block* block) {
 
     if (ok) {
         prog->num_blocks_accepted++;
+
+        // Any blocks that follow are for other families.
+        prog->is_done |= prog_is_complete(prog);
     }
 
     return ok;
@@ -10,9 +10,23 @@
 #include <hardware/flash.h>
 
 // Project
+#include "encryption.h"
+#include "image_header.h"
 #include "interval_set.h"
+#include "manifest.h"
+#include "signature.h"
 
-#define PROG_AREA_SIZE (PICO_FLASH_SIZE_BYTES - BOOTLOADER_SIZE)
+// The optional staging area ('staging.h') sits between the program area and the bootloader,
+// and the optional rollback slot ('rollback.h') sits between the program and staging areas.
+#ifndef BOOTLOADER_STAGING_SIZE
+#define BOOTLOADER_STAGING_SIZE 0
+#endif
+
+#ifndef BOOTLOADER_ROLLBACK_SIZE
+#define BOOTLOADER_ROLLBACK_SIZE 0
+#endif
+
+#define PROG_AREA_SIZE (PICO_FLASH_SIZE_BYTES - BOOTLOADER_SIZE - BOOTLOADER_STAGING_SIZE - BOOTLOADER_ROLLBACK_SIZE)
 #define PROG_AREA_BEGIN (XIP_BASE)
 #define PROG_AREA_END (PROG_AREA_BEGIN + PROG_AREA_SIZE)
 
@@ -20,6 +34,26 @@
 extern "C" {
 #endif
 
+// A partial update carries a partial-update block: a UF2 metadata block (flagged
+// UF2_FLAG_NOT_MAIN_FLASH) that precedes all flash blocks.  A partial update rewrites only the
+// pages it holds (e.g., an asset region) and leaves the rest of the installed firmware in
+// place, so it needs no vector table.  It must not write sector 0 (the stage 2 bootloader and
+// vector table).  Pages of a partly written sector that the UF2 file does not write are
+// preserved.
+//
+// The block is added by 'scripts/uf2_partial.py'.  A signed full image cannot be turned into a
+// partial one (or vice versa) by adding or removing the block, since one writes sector 0 and
+// the other has no vector table.
+#define PROG_PARTIAL_MAGIC      0x54525042  // "BPRT" (little-endian)
+#define PROG_PARTIAL_VERSION    1
+
+// Payload of the partial-update block.
+typedef struct {
+    uint32_t magic;                         // PROG_PARTIAL_MAGIC
+    uint16_t version;                       // PROG_PARTIAL_VERSION
+    uint16_t reserved;                      // 0
+} prog_partial_header_t;
+
 // Forward declaration of prog_t
 struct prog_s;
 typedef struct prog_s prog_t;
@@ -29,19 +63,51 @@ typedef bool (*accept_block_cb_t)(prog_t* prog, const struct uf2_block* block);
 typedef struct prog_s {
     interval_set_t pages_written;           // Tracks which flash pages have been written to detect overlapping writes.
     interval_set_t sectors_erased;          // Tracks which flash sectors have been written for bulk erasure.
+    uint32_t area_end;                      // End of the program area (PROG_AREA_END, unless the flash is smaller)
     uint32_t num_blocks;                    // Total number of blocks declared in the UF2 file
     uint32_t num_blocks_accepted;           // Number of blocks accepted for writing so far.
+    uint32_t num_metadata_blocks;           // Number of valid metadata (UF2_FLAG_NOT_MAIN_FLASH) blocks so far.
     accept_block_cb_t accept_block;         // Invoked for each valid program block that is accepted for writing.
     uint8_t vector_table[FLASH_PAGE_SIZE];  // Pending vector table to write at the end of the programming process
     bool has_vector_table;                  // True if the vector table was found in the UF2 file
+    bool is_partial;                        // True if the UF2 file is a partial update (see above)
     bool is_different;                      // True if the UF2 file differs from the current flash contents
+    bool is_done;                           // Set to stop reading the UF2 file early (by 'accept_block', or once complete)
+    image_header_t image_header;            // Optional image header from the first block of the UF2 file
+    manifest_t manifest;                    // Optional manifest from the start of the UF2 file
+    signature_t signature;                  // Optional signature and running image digest
+    encryption_t encryption;                // Optional nonce for decrypting the UF2 file's payloads
 } prog_t;
 
 void prog_init(prog_t* prog);
 void prog_free(prog_t* prog);
 
+// Limits the program area to a flash chip of 'flash_size' bytes, as detected at runtime (see
+// 'flash_caps.h').  If the chip is smaller than PICO_FLASH_SIZE_BYTES, addresses past its end
+// wrap around to the start of flash, and the bootloader occupies the top of the actual chip.
+void prog_set_flash_size(prog_t* prog, uint32_t flash_size);
+
+// Resets the per-pass state before reading the UF2 file again.
+void prog_restart(prog_t* prog);
+
+// Returns true if every block declared by the UF2 file has been processed.
+bool prog_is_complete(const prog_t* prog);
+
+uint32_t page_index(uint32_t addr);
+uint32_t sector_index(uint32_t addr);
+
+// Called by the transport for each UF2 block.  Sets 'is_done' once every block of the
+// program has been processed, since the rest of the file can only hold blocks for other
+// families.  The payloads of an encrypted UF2 file are decrypted before 'accept_block' is
+// invoked.
 bool process_block(prog_t* prog, const struct uf2_block* block);
 
+// Returns the number of blocks following 'block' that belong to the same program for another
+// family, according to its 'block_no' and 'num_blocks'.  The transport may seek past them
+// instead of reading them.  (In a multi-family UF2 file, each family's blocks are contiguous
+// and numbered independently.)  Returns 0 for RP2040 blocks and malformed blocks.
+uint32_t prog_blocks_to_skip(const struct uf2_block* block);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -0,0 +1,301 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Pico SDK
+#include <hardware/flash.h>
+#include <hardware/watchdog.h>
+
+// Project
+#include "boot_control.h"
+#include "crc32.h"
+#include "erase_plan.h"
+#include "flash.h"
+#include "rollback.h"
+
+_Static_assert(BOOTLOADER_ROLLBACK_SIZE % FLASH_SECTOR_SIZE == 0,
+    "BOOTLOADER_ROLLBACK_SIZE must be a multiple of the flash sector size");
+_Static_assert(BOOTLOADER_ROLLBACK_SIZE >= 2 * FLASH_SECTOR_SIZE,
+    "BOOTLOADER_ROLLBACK_SIZE must hold the header and at least one sector");
+_Static_assert(sizeof(rollback_header_t) == ROLLBACK_CONFIRMED_OFFSET,
+    "The rollback header must fill the pages before the state words");
+
+#define NUM_FLASH_SECTORS (PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE)
+#define SLOT_SECTOR (ROLLBACK_OFFSET / FLASH_SECTOR_SIZE)
+
+// The header is built in RAM and programmed once the copies are complete.  (Static to keep it
+// off the stack.)
+static rollback_header_t header;
+
+// Sectors that are already blank, and need not be erased.
+static uint32_t blank_sectors[ERASE_PLAN_BITMAP_WORDS(NUM_FLASH_SECTORS)];
+
+static const rollback_header_t* slot_header() {
+    return (const rollback_header_t*) flash_contents(ROLLBACK_OFFSET);
+}
+
+static uint32_t copy_offset(uint32_t copy) {
+    return ROLLBACK_OFFSET + (copy + 1) * FLASH_SECTOR_SIZE;
+}
+
+static bool is_valid(const rollback_header_t* slot) {
+    return slot->magic == ROLLBACK_MAGIC
+        && slot->version == ROLLBACK_VERSION
+        && slot->num_entries <= ROLLBACK_MAX_ENTRIES;
+}
+
+// State words are set by programming them to 0.  Any other value than 0xFFFFFFFF (e.g., from
+// an interrupted program) also counts as set.
+static bool is_state_set(uint32_t offset) {
+    return *(const uint32_t*) flash_contents(ROLLBACK_OFFSET + offset) != 0xFFFFFFFF;
+}
+
+static void set_state(uint32_t offset) {
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    memset(page, 0, sizeof(uint32_t));
+    flash_prog(ROLLBACK_OFFSET + offset, page, sizeof(page));
+}
+
+static bool is_blank(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies a sector to flash one page at a time through RAM, since flash is not readable while
+// 'flash_prog()' runs.  Pages that are blank are skipped (the sector was erased).
+static void copy_sector(uint32_t dest_offs, uint32_t src_offs) {
+    uint8_t page[FLASH_PAGE_SIZE];
+
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE; i += FLASH_PAGE_SIZE) {
+        memcpy(page, flash_contents(src_offs + i), sizeof(page));
+
+        if (!is_blank(page, sizeof(page))) {
+            flash_prog(dest_offs + i, page, sizeof(page));
+        }
+    }
+}
+
+// Plans the cheapest mix of erases for the given sectors, skipping those already blank.
+static void plan_erases(erase_plan_t* plan, const interval_set_t* sectors, const flash_caps_t* caps) {
+    erase_plan_find_blank(blank_sectors, sectors, NUM_FLASH_SECTORS);
+    erase_plan_build(plan, sectors, blank_sectors, NUM_FLASH_SECTORS, caps);
+}
+
+static void erase_sectors(const interval_set_t* sectors, const flash_caps_t* caps) {
+    erase_plan_t plan;
+    erase_plan_init(&plan);
+    plan_erases(&plan, sectors, caps);
+
+    for (int i = 0; i < plan.num_erases; i++) {
+        const interval_t* erase = &plan.erases[i];
+        flash_erase(erase->start * FLASH_SECTOR_SIZE, (erase->end - erase->start) * FLASH_SECTOR_SIZE);
+    }
+
+    erase_plan_free(&plan);
+}
+
+static uint32_t slot_crc(const rollback_header_t* slot) {
+    uint32_t crc = 0;
+    uint32_t copy = 0;
+
+    for (uint32_t i = 0; i < slot->num_entries; i++) {
+        if ((slot->entries[i] & ROLLBACK_ENTRY_BLANK) == 0) {
+            crc = crc32_update(crc, flash_contents(copy_offset(copy++)), FLASH_SECTOR_SIZE);
+        }
+    }
+
+    crc = crc32_update(crc, &slot->record, sizeof(slot->record));
+    return crc32_update(crc, slot->entries, slot->num_entries * sizeof(slot->entries[0]));
+}
+
+static void set_boot_count(uint32_t count) {
+    watchdog_hw->scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH] = boot_control_encode_boot_count(count);
+}
+
+// Rewrites the installed image record (see 'update.c') if it differs from 'record'.  The scrub
+// table in the rest of the sector (see 'scrub.h') describes the firmware being replaced, so it
+// is erased.
+static void restore_record(const image_record_t* record) {
+    const uint8_t* current = flash_contents(IMAGE_RECORD_OFFSET);
+
+    if (memcmp(current, record, sizeof(*record)) == 0
+        && is_blank(current + FLASH_PAGE_SIZE, FLASH_SECTOR_SIZE - FLASH_PAGE_SIZE)) {
+        return;
+    }
+
+    if (!is_blank(current, FLASH_SECTOR_SIZE)) {
+        flash_erase(IMAGE_RECORD_OFFSET, FLASH_SECTOR_SIZE);
+    }
+
+    if (image_record_header(record) != NULL) {
+        uint8_t page[FLASH_PAGE_SIZE];
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page, record, sizeof(*record));
+        flash_prog(IMAGE_RECORD_OFFSET, page, sizeof(page));
+    }
+}
+
+void rollback_discard(void) {
+    if (!is_blank(flash_contents(ROLLBACK_OFFSET), FLASH_SECTOR_SIZE)) {
+        flash_erase(ROLLBACK_OFFSET, FLASH_SECTOR_SIZE);
+    }
+}
+
+bool rollback_save(const interval_set_t* sectors, const uint32_t* blank, uint32_t limit, const flash_caps_t* caps) {
+    // A previous slot no longer matches the program area once the update starts.
+    rollback_discard();
+
+    // The slot lies at a fixed offset from the top of PICO_FLASH_SIZE_BYTES, which would wrap
+    // around on a smaller chip.
+    if (caps->size_bytes < PICO_FLASH_SIZE_BYTES) {
+        return false;
+    }
+
+    memset(&header, 0xFF, sizeof(header));
+    header.num_entries = 0;
+    uint32_t num_copies = 0;
+
+    for (int i = 0; i < sectors->num_intervals; i++) {
+        for (uint32_t sector = sectors->intervals[i].start; sector < sectors->intervals[i].end && sector < limit; sector++) {
+            const bool is_marked_blank = blank != NULL && (blank[sector / 32] & (1u << (sector % 32))) != 0;
+
+            if (header.num_entries == ROLLBACK_MAX_ENTRIES || (!is_marked_blank && num_copies == ROLLBACK_CAPACITY)) {
+                return false;
+            }
+
+            header.entries[header.num_entries++] = sector | (is_marked_blank ? ROLLBACK_ENTRY_BLANK : 0);
+            num_copies += !is_marked_blank;
+        }
+    }
+
+    // Copy the sectors that are not blank, in order.
+    interval_set_t copy_sectors;
+    interval_set_init(&copy_sectors);
+    interval_set_union(&copy_sectors, SLOT_SECTOR + 1, SLOT_SECTOR + 1 + num_copies);
+    erase_sectors(&copy_sectors, caps);
+    interval_set_free(&copy_sectors);
+
+    uint32_t copy = 0;
+
+    for (uint32_t i = 0; i < header.num_entries; i++) {
+        if ((header.entries[i] & ROLLBACK_ENTRY_BLANK) == 0) {
+            copy_sector(copy_offset(copy++), header.entries[i] * FLASH_SECTOR_SIZE);
+        }
+    }
+
+    // The header is programmed last, so that an interrupted save leaves the slot empty.
+    memcpy(&header.record, flash_contents(IMAGE_RECORD_OFFSET), sizeof(header.record));
+    header.magic = ROLLBACK_MAGIC;
+    header.version = ROLLBACK_VERSION;
+    header.crc = slot_crc(&header);
+    flash_prog(ROLLBACK_OFFSET, (const uint8_t*) &header, sizeof(header));
+
+    set_boot_count(0);
+    return true;
+}
+
+// Writes the saved sectors back to the program area.  Returns false (and empties the slot)
+// if the copies are corrupt.
+static bool restore(void) {
+    const rollback_header_t* slot = slot_header();
+
+    if (slot->crc != slot_crc(slot)) {
+        rollback_discard();
+        return false;
+    }
+
+    // If the restore is interrupted, it starts over on the next boot.
+    if (!is_state_set(ROLLBACK_RESTORING_OFFSET)) {
+        set_state(ROLLBACK_RESTORING_OFFSET);
+    }
+
+    interval_set_t sectors;
+    interval_set_init(&sectors);
+
+    for (uint32_t i = 0; i < slot->num_entries; i++) {
+        const uint32_t sector = slot->entries[i] & ~ROLLBACK_ENTRY_BLANK;
+        interval_set_union(&sectors, sector, sector + 1);
+    }
+
+    erase_plan_t plan;
+    erase_plan_init(&plan);
+    plan_erases(&plan, &sectors, flash_detect());
+    interval_set_free(&sectors);
+
+    // Each erase is followed by the copies of its sectors, so that sector 0 (which holds our
+    // stage 2 bootloader) is blank for as short a time as possible.
+    int next_erase = 0;
+    uint32_t copy = 0;
+
+    for (uint32_t i = 0; i < slot->num_entries; i++) {
+        const uint32_t sector = slot->entries[i] & ~ROLLBACK_ENTRY_BLANK;
+
+        while (next_erase < plan.num_erases && plan.erases[next_erase].start <= sector) {
+            const interval_t* erase = &plan.erases[next_erase++];
+            flash_erase(erase->start * FLASH_SECTOR_SIZE, (erase->end - erase->start) * FLASH_SECTOR_SIZE);
+        }
+
+        if ((slot->entries[i] & ROLLBACK_ENTRY_BLANK) == 0) {
+            copy_sector(sector * FLASH_SECTOR_SIZE, copy_offset(copy++));
+        }
+    }
+
+    erase_plan_free(&plan);
+
+    // Copy the record to RAM before it is rewritten, since it lies in flash.
+    const image_record_t record = slot->record;
+    restore_record(&record);
+
+    rollback_discard();
+    set_boot_count(0);
+    return true;
+}
+
+bool rollback_is_armed(void) {
+    return is_valid(slot_header())
+        && !is_state_set(ROLLBACK_CONFIRMED_OFFSET)
+        && !is_state_set(ROLLBACK_RESTORING_OFFSET);
+}
+
+bool rollback_check(bool firmware_is_valid) {
+    if (!is_valid(slot_header())) {
+        return false;
+    }
+
+    if (is_state_set(ROLLBACK_RESTORING_OFFSET)) {
+        return restore();
+    }
+
+    if (is_state_set(ROLLBACK_CONFIRMED_OFFSET)) {
+        return false;
+    }
+
+    const uint32_t word = watchdog_hw->scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH];
+
+    if (word == BOOT_CONTROL_BOOT_CONFIRMED) {
+        set_state(ROLLBACK_CONFIRMED_OFFSET);
+        watchdog_hw->scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH] = 0;
+        return false;
+    }
+
+    if (!firmware_is_valid || boot_control_decode_boot_count(word) >= BOOTLOADER_ROLLBACK_BOOTS) {
+        return restore();
+    }
+
+    return false;
+}
+
+void rollback_count_boot(void) {
+    if (rollback_is_armed()) {
+        set_boot_count(boot_control_decode_boot_count(watchdog_hw->scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH]) + 1);
+    }
+}
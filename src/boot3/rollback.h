@@ -0,0 +1,91 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <hardware/flash.h>
+
+// Project
+#include "flash_caps.h"
+#include "image_header.h"
+#include "interval_set.h"
+#include "prog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The rollback slot holds the previous firmware's copy of each sector the last update
+// changed.  Its size is BOOTLOADER_ROLLBACK_SIZE ('config.cmake'), which is 0 if disabled.
+// It lies between the program area and the staging area.
+//
+// The first sector of the slot holds a rollback_header_t, followed by the copies of the
+// saved sectors that were not blank.  The header's last two pages hold state words, which
+// are programmed (from 0xFFFFFFFF) without erasing the header:
+//
+//     ROLLBACK_CONFIRMED_OFFSET  The new firmware confirmed that it works.  The slot is
+//                                kept, but is no longer restored.
+//     ROLLBACK_RESTORING_OFFSET  A restore has started.  If it is interrupted, it resumes
+//                                on the next boot.
+//
+// A slot is armed from the start of pass 2 until the new firmware confirms it (see
+// 'boot_control_confirm()').  While armed, the previous firmware is restored if the new
+// firmware is started BOOTLOADER_ROLLBACK_BOOTS times without confirming, or if the program
+// area no longer holds valid firmware (e.g., the update was interrupted).
+#define ROLLBACK_OFFSET             PROG_AREA_SIZE
+#define ROLLBACK_MAGIC              0x4B424C52  // "RLBK" (little-endian)
+#define ROLLBACK_VERSION            1
+
+#define ROLLBACK_CONFIRMED_OFFSET   (FLASH_SECTOR_SIZE - 2 * FLASH_PAGE_SIZE)
+#define ROLLBACK_RESTORING_OFFSET   (FLASH_SECTOR_SIZE - FLASH_PAGE_SIZE)
+
+// Number of sectors the slot can hold copies of (after the header).
+#define ROLLBACK_CAPACITY           (BOOTLOADER_ROLLBACK_SIZE / FLASH_SECTOR_SIZE - 1)
+
+// Entries are sector indices.  Sectors that were blank are restored by erasing them, so no
+// copy is kept.
+#define ROLLBACK_ENTRY_BLANK        0x8000
+#define ROLLBACK_MAX_ENTRIES        1762
+
+#ifndef BOOTLOADER_ROLLBACK_BOOTS
+#define BOOTLOADER_ROLLBACK_BOOTS   3
+#endif
+
+typedef struct {
+    uint32_t magic;                                 // ROLLBACK_MAGIC
+    uint16_t version;                               // ROLLBACK_VERSION
+    uint16_t num_entries;                           // Number of saved sectors
+    uint32_t crc;                                   // CRC-32 of the copies, 'record' and 'entries'
+    image_record_t record;                          // Installed image record of the saved firmware
+    uint16_t entries[ROLLBACK_MAX_ENTRIES];         // Saved sectors, in ascending order
+} rollback_header_t;
+
+// Saves the sectors in 'sectors' below 'limit' that pass 2 may overwrite, and resets the boot
+// count.  Sectors marked in 'blank' (see 'erase_plan.h') are recorded without a copy.
+// Returns false (leaving the slot empty) if the copies do not fit.
+bool rollback_save(const interval_set_t* sectors, const uint32_t* blank, uint32_t limit, const flash_caps_t* caps);
+
+// Empties the slot.
+void rollback_discard(void);
+
+// Returns true if the slot holds an unconfirmed update.
+bool rollback_is_armed(void);
+
+// Called at startup, before starting the firmware.  Takes a confirmation posted by the
+// firmware, and restores the previous firmware if the armed update failed (see above) or an
+// earlier restore was interrupted.  Returns true if the previous firmware was restored.
+bool rollback_check(bool firmware_is_valid);
+
+// Counts a start of the firmware while the slot is armed.  Called just before starting it.
+void rollback_count_boot(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
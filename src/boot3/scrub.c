@@ -0,0 +1,152 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// On the device, each chunk is read through the XIP streaming interface by DMA and checksummed
+// by the DMA sniffer, which computes the same CRC-32 as 'crc32_update()' when it reverses and
+// inverts its output.  The stream reads flash directly, so the check neither depends on nor
+// evicts the contents of the XIP cache, and the core only waits for the DMA to finish.  Host
+// builds (PICO_NO_HARDWARE) use 'crc32_update()'.
+
+// Standard
+#include <stddef.h>
+#include <string.h>
+
+#if !PICO_NO_HARDWARE
+// Pico SDK
+#include <hardware/dma.h>
+#include <hardware/structs/xip_ctrl.h>
+#endif
+
+// Project
+#include "crc32.h"
+#include "scrub.h"
+
+#if PICO_NO_HARDWARE
+static uint32_t chunk_crc(const uint8_t* data, uint32_t len) {
+    return crc32_update(0, data, len);
+}
+#else
+static uint32_t chunk_crc(const uint8_t* data, uint32_t len) {
+    const uint channel = dma_claim_unused_channel(true);
+
+    // Drain anything left in the stream FIFO.
+    while ((xip_ctrl_hw->stat & XIP_STAT_FIFO_EMPTY_BITS) == 0) {
+        (void) xip_ctrl_hw->stream_fifo;
+    }
+
+    // The reflected CRC-32 with an initial value of 0xFFFFFFFF, reversed and inverted on
+    // output, is the standard CRC-32.
+    dma_sniffer_enable(channel, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, /* force_channel_enable: */ true);
+    hw_set_bits(&dma_hw->sniff_ctrl, DMA_SNIFF_CTRL_OUT_REV_BITS | DMA_SNIFF_CTRL_OUT_INV_BITS);
+    dma_sniffer_set_data_accumulator(0xFFFFFFFF);
+
+    // The data is only sniffed, so every word is written to the same place.
+    static uint32_t sink;
+    dma_channel_config config = dma_channel_get_default_config(channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, DREQ_XIP_STREAM);
+    channel_config_set_sniff_enable(&config, true);
+    dma_channel_configure(channel, &config, &sink, (const void*) XIP_AUX_BASE, len / 4, /* trigger: */ true);
+
+    xip_ctrl_hw->stream_addr = (uint32_t) data;
+    xip_ctrl_hw->stream_ctr = len / 4;
+
+    dma_channel_wait_for_finish_blocking(channel);
+    const uint32_t crc = dma_sniffer_get_data_accumulator();
+
+    dma_sniffer_disable();
+    dma_channel_unclaim(channel);
+    return crc;
+}
+#endif
+
+static uint32_t table_crc(const scrub_table_t* table) {
+    const uint32_t crc = crc32_update(0, &table->header, offsetof(scrub_header_t, crc));
+    return crc32_update(crc, table->chunk_crcs, table->header.num_chunks * sizeof(uint32_t));
+}
+
+void scrub_table_build(scrub_table_t* table, const uint8_t* flash, uint32_t size) {
+    memset(table, 0xFF, sizeof(scrub_table_t));
+
+    uint32_t chunk_size = FLASH_SECTOR_SIZE;
+    while (size > chunk_size * SCRUB_MAX_CHUNKS) {
+        chunk_size *= 2;
+    }
+
+    table->header.magic = SCRUB_MAGIC;
+    table->header.version = SCRUB_VERSION;
+    table->header.num_chunks = (uint16_t) ((size + chunk_size - 1) / chunk_size);
+    table->header.chunk_size = chunk_size;
+    table->header.size = size;
+
+    for (uint32_t i = 0; i < table->header.num_chunks; i++) {
+        const uint32_t offset = i * chunk_size;
+        const uint32_t len = size - offset < chunk_size ? size - offset : chunk_size;
+        table->chunk_crcs[i] = chunk_crc(flash + offset, len);
+    }
+
+    table->header.crc = table_crc(table);
+}
+
+bool scrub_table_is_valid(const scrub_table_t* table) {
+    const scrub_header_t* header = &table->header;
+
+    bool ok = header->magic == SCRUB_MAGIC;
+    ok &= header->version == SCRUB_VERSION;
+    ok &= header->chunk_size >= FLASH_SECTOR_SIZE;
+    ok &= (header->chunk_size & (header->chunk_size - 1)) == 0;
+    ok &= header->size % FLASH_SECTOR_SIZE == 0;
+    ok &= header->num_chunks > 0 && header->num_chunks <= SCRUB_MAX_CHUNKS;
+
+    // Only read the entries once the header is known to be sane.
+    return ok
+        && (header->size + header->chunk_size - 1) / header->chunk_size == header->num_chunks
+        && header->crc == table_crc(table);
+}
+
+uint32_t scrub_table_prog_size(const scrub_table_t* table) {
+    const uint32_t size = sizeof(scrub_header_t) + table->header.num_chunks * sizeof(uint32_t);
+    return (size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+}
+
+bool scrub_is_marked_failed(const image_record_t* record) {
+    const uint8_t* bytes = (const uint8_t*) record;
+
+    for (size_t i = 0; i < sizeof(image_record_t); i++) {
+        if (bytes[i] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t scrub_chunks_for(const scrub_table_t* table, uint32_t bytes) {
+    const uint32_t count = bytes / table->header.chunk_size + (bytes % table->header.chunk_size != 0);
+
+    if (count == 0) {
+        return 1;
+    }
+
+    return count < table->header.num_chunks ? count : table->header.num_chunks;
+}
+
+int scrub_check(const scrub_table_t* table, const uint8_t* flash, uint32_t first, uint32_t count) {
+    const scrub_header_t* header = &table->header;
+
+    for (uint32_t n = 0; n < count && n < header->num_chunks; n++) {
+        const uint32_t i = (first + n) % header->num_chunks;
+        const uint32_t offset = i * header->chunk_size;
+        const uint32_t len = header->size - offset < header->chunk_size ? header->size - offset : header->chunk_size;
+
+        if (chunk_crc(flash + offset, len) != table->chunk_crcs[i]) {
+            return (int) i;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,86 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <hardware/flash.h>
+
+// Project
+#include "image_header.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// After each update, the bootloader records a CRC-32 of each chunk of the installed firmware
+// in the scrub table, which fills the rest of the sector holding the installed image record
+// (see 'image_header.h').  Before starting the firmware, the bootloader checks some or all of
+// the chunks against the table (see BOOTLOADER_SCRUB_KB in 'config.cmake'), so that flash
+// corruption is found before the firmware runs into it.
+//
+// The table covers flash from offset 0 (including the stage 2 bootloader and vector table)
+// to the end of the last sector written by the update.  A chunk is the smallest power of two
+// number of sectors for which the table has room, which is a single sector for firmware of
+// up to 3.7MB.
+//
+// The table is erased along with the record when an update starts, and is only written once
+// the update completes.  Restoring the previous firmware (see 'rollback.h') also erases it.
+//
+// If a chunk does not match, the bootloader marks the scrub as failed by programming the
+// record's page with zeros, without erasing the sector.  This invalidates the record, so that
+// any compatible image in the firmware directory is newer than the installed firmware, while
+// keeping the table.  The firmware is not started again until an update (or rollback) erases
+// the sector.
+
+#define SCRUB_MAGIC             0x42524353  // "SCRB" (little-endian)
+#define SCRUB_VERSION           1
+#define SCRUB_TABLE_OFFSET      (IMAGE_RECORD_OFFSET + FLASH_PAGE_SIZE)
+#define SCRUB_TABLE_SIZE        (FLASH_SECTOR_SIZE - FLASH_PAGE_SIZE)
+
+typedef struct {
+    uint32_t magic;                             // SCRUB_MAGIC
+    uint16_t version;                           // SCRUB_VERSION
+    uint16_t num_chunks;                        // Number of entries in 'chunk_crcs'
+    uint32_t chunk_size;                        // Bytes per chunk (a power of two number of sectors)
+    uint32_t size;                              // Bytes covered from the start of flash
+    uint32_t crc;                               // CRC-32 of the fields above and the entries
+} scrub_header_t;
+
+#define SCRUB_MAX_CHUNKS        ((SCRUB_TABLE_SIZE - sizeof(scrub_header_t)) / sizeof(uint32_t))
+
+typedef struct {
+    scrub_header_t header;
+    uint32_t chunk_crcs[SCRUB_MAX_CHUNKS];      // CRC-32 of each chunk (the last may be shorter)
+} scrub_table_t;
+
+// Sets 'table' to the CRCs of the first 'size' bytes of flash (a multiple of
+// FLASH_SECTOR_SIZE), where 'flash' points to the start of flash.  Unused entries are left
+// erased (0xFF).
+void scrub_table_build(scrub_table_t* table, const uint8_t* flash, uint32_t size);
+
+// Returns true if the given table is intact (e.g., not erased).
+bool scrub_table_is_valid(const scrub_table_t* table);
+
+// Returns the number of bytes of the table to program, which is a multiple of FLASH_PAGE_SIZE.
+uint32_t scrub_table_prog_size(const scrub_table_t* table);
+
+// Returns the number of chunks that cover at least 'bytes' (at least one, and at most all).
+uint32_t scrub_chunks_for(const scrub_table_t* table, uint32_t bytes);
+
+// Checks 'count' chunks, starting with chunk 'first' and wrapping around to chunk 0.  Returns
+// the first chunk whose contents do not match the table, or -1 if all match.
+int scrub_check(const scrub_table_t* table, const uint8_t* flash, uint32_t first, uint32_t count);
+
+// Returns true if the given record (at IMAGE_RECORD_OFFSET) is marked by a failed scrub.
+bool scrub_is_marked_failed(const image_record_t* record);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
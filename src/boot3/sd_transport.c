@@ -0,0 +1,401 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+// Pico SDK
+#include <pico/stdlib.h>
+
+// SPI/FatFS
+#include <ff.h>
+#include <diskio.h>
+#include <f_util.h>
+#include <hw_config.h>
+#include <rtc.h>
+
+// Project
+#include "crc32.h"
+#include "diag.h"
+#include "flash.h"
+#include "image_header.h"
+#include "profile.h"
+#include "transport.h"
+#include "tuning.h"
+#include "uart_log.h"
+
+#define PC_NAME "0:"
+#define FIRMWARE_FILENAME (PC_NAME BOOTLOADER_FIRMWARE_FILENAME)
+
+// If BOOTLOADER_FIRMWARE_DIR is defined, the newest compatible '.uf2' file in this directory
+// is installed when 'firmware.uf2' is not present (see 'image_header.h').
+#ifdef BOOTLOADER_FIRMWARE_DIR
+#define FIRMWARE_DIR (PC_NAME BOOTLOADER_FIRMWARE_DIR)
+#endif
+
+// If BOOTLOADER_UPDATE_LOG is defined, a record of each update attempt is appended to this
+// file (see 'update_log.h').
+#ifdef BOOTLOADER_UPDATE_LOG
+#define UPDATE_LOG_FILENAME (PC_NAME BOOTLOADER_UPDATE_LOG)
+#endif
+
+// If BOOTLOADER_TUNING_FILE is defined, settings in this file override the compiled ones (see
+// 'tuning.h').
+#ifdef BOOTLOADER_TUNING_FILE
+#define TUNING_FILENAME (PC_NAME BOOTLOADER_TUNING_FILE)
+#endif
+
+static spi_t spis[] = {{
+    .hw_inst    = __CONCAT(spi, BOOTLOADER_SD_SPI),
+    .miso_gpio  = BOOTLOADER_SD_SPI_RX_PIN,
+    .mosi_gpio  = BOOTLOADER_SD_SPI_TX_PIN,
+    .sck_gpio   = BOOTLOADER_SD_SPI_SCK_PIN,
+    .baud_rate  = BOOTLOADER_SD_BAUD_RATE
+}};
+
+static sd_card_t sd_cards[] = {{
+    .pcName = PC_NAME,
+    .spi = &spis[0],
+    .ss_gpio = BOOTLOADER_SD_SPI_CSN_PIN,
+    .card_detect_gpio = BOOTLOADER_SD_DETECT_PIN,
+    .use_card_detect = BOOTLOADER_SD_USE_DETECT
+}};
+
+size_t sd_get_num() { return count_of(sd_cards); }
+
+sd_card_t* sd_get_by_num(size_t num) {
+    return num < sd_get_num()
+        ?  &sd_cards[num]
+        : NULL;
+}
+
+size_t spi_get_num() { return count_of(spis); }
+
+spi_t* spi_get_by_num(size_t num) {
+    return num < spi_get_num()
+        ? &spis[num]
+        : NULL;
+}
+
+static FIL file = { 0 };
+
+// The firmware file found by 'sd_uf2_exists()': either FIRMWARE_FILENAME or a file in the
+// firmware directory.  NULL until found, and again once the card is remounted.
+static const char* firmware_path = NULL;
+static bool is_dir_image = false;
+
+#ifdef BOOTLOADER_FIRMWARE_DIR
+// Path of the newest image in the firmware directory, and the candidate being examined.
+static char dir_image_path[sizeof(FIRMWARE_DIR) + sizeof(((FILINFO*) 0)->fname)];
+static char dir_candidate_path[sizeof(dir_image_path)];
+
+// Images in the firmware directory that failed validation, identified by the CRC-32 of their
+// path, so that the next newest image (or the installed firmware) is used instead.  Forgotten
+// when the card is remounted.  If more images are rejected than fit, the directory is ignored.
+#define MAX_REJECTED_IMAGES 8
+static uint32_t rejected_images[MAX_REJECTED_IMAGES];
+static uint32_t num_rejected_images = 0;
+
+static uint32_t path_crc(const char* path) {
+    return crc32_update(0, path, strlen(path));
+}
+
+static bool is_rejected(const char* path) {
+    const uint32_t crc = path_crc(path);
+
+    for (uint32_t i = 0; i < num_rejected_images; i++) {
+        if (rejected_images[i] == crc) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool has_uf2_extension(const char* name) {
+    const size_t len = strlen(name);
+    return len > 4
+        && name[len - 4] == '.'
+        && tolower((unsigned char) name[len - 3]) == 'u'
+        && tolower((unsigned char) name[len - 2]) == 'f'
+        && name[len - 1] == '2';
+}
+
+// Reads the image header from the first block of the given file.
+static bool read_image_header(const char* path, image_header_t* header) {
+    // Static to keep the block off the stack.
+    static struct uf2_block block;
+
+    if (f_open(&file, path, FA_READ | FA_OPEN_EXISTING) != FR_OK) {
+        return false;
+    }
+
+    UINT bytes_read = 0;
+    bool ok = f_read(&file, &block, sizeof(block), &bytes_read) == FR_OK
+        && bytes_read == sizeof(block)
+        && image_header_read(header, &block);
+
+    f_close(&file);
+    return ok;
+}
+
+// Selects the newest image for this board in the firmware directory, reading only the first
+// block of each '.uf2' file.  Returns true if the image is newer than the installed firmware.
+static bool find_dir_image() {
+    static DIR dir;
+    static FILINFO info;
+
+    if (num_rejected_images == MAX_REJECTED_IMAGES || f_opendir(&dir, FIRMWARE_DIR) != FR_OK) {
+        return false;
+    }
+
+    image_header_t newest = { 0 };
+    image_header_t header;
+
+    while (f_readdir(&dir, &info) == FR_OK && info.fname[0] != '\0') {
+        if ((info.fattrib & (AM_DIR | AM_HID | AM_SYS)) != 0 || !has_uf2_extension(info.fname)) {
+            continue;
+        }
+
+        // "<dir>/<name>" (without snprintf, which would link newlib's printf).
+        memcpy(dir_candidate_path, FIRMWARE_DIR, sizeof(FIRMWARE_DIR) - 1);
+        dir_candidate_path[sizeof(FIRMWARE_DIR) - 1] = '/';
+        strcpy(dir_candidate_path + sizeof(FIRMWARE_DIR), info.fname);
+
+        if (is_rejected(dir_candidate_path)) {
+            continue;
+        }
+
+        const image_header_t* newest_so_far = image_header_is_present(&newest) ? &newest : NULL;
+        if (read_image_header(dir_candidate_path, &header)
+            && image_header_is_newer(&header, newest_so_far, BOOTLOADER_BOARD_ID)) {
+            newest = header;
+            strcpy(dir_image_path, dir_candidate_path);
+        }
+    }
+
+    f_closedir(&dir);
+
+    // Compare with the version recorded when the installed firmware was written.
+    const image_header_t* installed = image_record_header((const image_record_t*) flash_contents(IMAGE_RECORD_OFFSET));
+    return image_header_is_newer(&newest, installed, BOOTLOADER_BOARD_ID);
+}
+#endif
+
+#ifdef BOOTLOADER_TUNING_FILE
+static tuning_t tuning;
+
+// Reads the tuning file (if any) from the newly mounted card, and applies its SPI clock.  The
+// card was initialized at 400kHz and switched to 'spis[0].baud_rate' by the mount, which is
+// also used if the card is initialized again.
+static void read_tuning() {
+    // Static to keep the buffer off the stack.
+    static char text[TUNING_MAX_FILE_SIZE];
+
+    tuning_init(&tuning, BOOTLOADER_SD_BAUD_RATE);
+
+    if (f_open(&file, TUNING_FILENAME, FA_READ | FA_OPEN_EXISTING) == FR_OK) {
+        UINT bytes_read = 0;
+
+        if (f_size(&file) <= sizeof(text)
+            && f_read(&file, text, sizeof(text), &bytes_read) == FR_OK) {
+            const int num_ignored = tuning_parse(&tuning, text, bytes_read);
+            LOG("[Boot3] Tuning: %u Hz, LED %u, skip %u, %d lines ignored\r\n",
+                (unsigned) tuning.sd_baud_rate, (unsigned) tuning.led_progress,
+                (unsigned) tuning.skip_identical, num_ignored);
+        }
+
+        f_close(&file);
+    }
+
+    if (spis[0].baud_rate != tuning.sd_baud_rate) {
+        spis[0].baud_rate = tuning.sd_baud_rate;
+        spi_set_baudrate(spis[0].hw_inst, tuning.sd_baud_rate);
+    }
+}
+#endif
+
+static void sd_init() {
+    time_init();
+    firmware_path = NULL;
+}
+
+// Mounts the card, unless it is already mounted and still responds.  Returns false if there
+// is no card.
+static bool mount_card() {
+    sd_card_t* pSd = sd_get_by_num(0);
+
+    if (pSd->mounted && !pSd->sd_test_com(pSd)) {
+        f_unmount(pSd->pcName);
+        pSd->mounted = false;
+    }
+
+    FRESULT fr = FR_OK;
+
+    if (!pSd->mounted) {
+        fr = f_mount(&pSd->fatfs, pSd->pcName, 1);
+        
+        if (fr != FR_OK) {
+            pSd->m_Status |= STA_NOINIT;
+            pSd->mounted = false;
+            return false;
+        }
+        
+        pSd->mounted = true;
+
+        // The card may have been replaced, so forget the firmware found on it.
+        firmware_path = NULL;
+
+        #ifdef BOOTLOADER_FIRMWARE_DIR
+        num_rejected_images = 0;
+        #endif
+
+        #ifdef BOOTLOADER_TUNING_FILE
+        read_tuning();
+        #endif
+    }
+
+    return true;
+}
+
+static bool sd_uf2_exists() {
+    firmware_path = NULL;
+
+    if (!mount_card()) {
+        return false;
+    }
+
+    FILINFO fileInfo;
+    FRESULT fr = f_stat(FIRMWARE_FILENAME, &fileInfo);
+    if (FR_OK == fr && fileInfo.fsize > 0) {
+        firmware_path = FIRMWARE_FILENAME;
+        is_dir_image = false;
+        return true;
+    }
+
+#ifdef BOOTLOADER_FIRMWARE_DIR
+    if (find_dir_image()) {
+        firmware_path = dir_image_path;
+        is_dir_image = true;
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+// Reads the open file and invokes the callback for each UF2 block.  Pass 2 may erase flash
+// in the background while this runs, so 'hot_path.cmake' checks that everything it calls is
+// in RAM.  (Kept out of line so that the check can find it.)
+static bool __noinline read_file_blocks(prog_t* prog, accept_block_cb_t callback) {
+    while (true) {
+        struct uf2_block block;
+        UINT bytes_read = 0;
+
+        PROFILE_BEGIN(read_start);
+        const bool ok = f_read(&file, &block, sizeof(block), &bytes_read) == FR_OK;
+        PROFILE_END(PROFILE_F_READ, read_start);
+        if (!ok) {
+            return false;
+        }
+
+        if (bytes_read < sizeof(block)) {
+            return bytes_read == 0;
+        }
+
+        PROFILE_BEGIN(callback_start);
+        const bool accepted = callback(prog, &block);
+        PROFILE_END(PROFILE_PROCESS_BLOCK, callback_start);
+        if (!accepted || prog->is_done) {
+            return accepted;
+        }
+
+        // Seek past the rest of a program for another family (e.g., the RP2350 half of a
+        // combined UF2 file) rather than reading it.
+        const uint32_t skip = prog_blocks_to_skip(&block);
+        if (skip > 0 && f_lseek(&file, f_tell(&file) + (FSIZE_t) skip * sizeof(block)) != FR_OK) {
+            return false;
+        }
+    }
+}
+
+static bool sd_read_uf2(prog_t* prog, accept_block_cb_t callback) {
+    // Each pass opens the file found by 'sd_uf2_exists()', rather than scanning the firmware
+    // directory again.
+    if ((!mount_card() || firmware_path == NULL) && !sd_uf2_exists()) {
+        return false;
+    }
+
+    if (f_open(&file, firmware_path, FA_READ | FA_OPEN_EXISTING) != FR_OK) {
+        return false;
+    }
+
+    const bool ok = read_file_blocks(prog, callback);
+    f_close(&file);
+    return ok;
+}
+
+static bool sd_remove_uf2() {
+    // Images in the firmware directory are kept, since the card may be used to update other
+    // devices.  The recorded version prevents installing them again.
+    if (is_dir_image) {
+        return true;
+    }
+
+    FRESULT fr = f_unlink(FIRMWARE_FILENAME);
+    firmware_path = NULL;
+    return fr == FR_OK;
+}
+
+static bool sd_reject_uf2() {
+#ifdef BOOTLOADER_FIRMWARE_DIR
+    // Skip an invalid image in the firmware directory, which is kept on the card (see
+    // 'sd_remove_uf2()') and would otherwise be chosen again.
+    if (is_dir_image && firmware_path != NULL) {
+        if (num_rejected_images < MAX_REJECTED_IMAGES) {
+            rejected_images[num_rejected_images++] = path_crc(firmware_path);
+        }
+
+        firmware_path = NULL;
+        return true;
+    }
+#endif
+
+    // An invalid 'firmware.uf2' must be replaced or removed.
+    return false;
+}
+
+#ifdef BOOTLOADER_UPDATE_LOG
+static bool sd_append_log(const void* data, size_t size) {
+    if (f_open(&file, UPDATE_LOG_FILENAME, FA_WRITE | FA_OPEN_APPEND) != FR_OK) {
+        return false;
+    }
+
+    UINT bytes_written = 0;
+    bool ok = f_write(&file, data, size, &bytes_written) == FR_OK
+        && bytes_written == size;
+
+    ok &= f_close(&file) == FR_OK;
+    return ok;
+}
+#endif
+
+const transport_t sd_transport = {
+    .name = "SD card",
+    .baud_rate = BOOTLOADER_SD_BAUD_RATE,
+    .init = sd_init,
+    .uf2_exists = sd_uf2_exists,
+    .read_uf2 = sd_read_uf2,
+    .remove_uf2 = sd_remove_uf2,
+    .reject_uf2 = sd_reject_uf2,
+    #ifdef BOOTLOADER_UPDATE_LOG
+    .append_log = sd_append_log,
+    #endif
+    #ifdef BOOTLOADER_TUNING_FILE
+    .tuning = &tuning,
+    #endif
+};
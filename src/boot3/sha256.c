@@ -0,0 +1,146 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// SHA-256 (FIPS 180-4), written for the Cortex-M0+:
+//
+//   * The message schedule is kept as a rolling window of 16 words rather than expanded to
+//     64 words up front, which saves 192 bytes of stack and the stores and loads to fill it.
+//   * Rounds are unrolled by 8 so that the working variables rotate by renaming instead of
+//     by 8 register moves per round.
+//   * Rotations are written so that GCC emits a single RORS, and Ch() and Maj() use the
+//     forms with the fewest operations (the M0+ has no BIC with three operands).
+//   * Whole blocks are hashed directly from the caller's buffer.  Only partial blocks are
+//     copied.
+//
+// Use BOOTLOADER_USE_PROFILE to measure the cost per UF2 block on the device (see
+// 'scripts/profile_decode.py').
+
+// Standard
+#include <string.h>
+
+// Project
+#include "sha256.h"
+
+static const uint32_t K[64] = {
+    0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+    0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+    0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+    0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+    0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+    0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+    0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+    0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u,
+};
+
+static inline uint32_t ror(uint32_t x, uint32_t n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t load_be32(const uint8_t* p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline void store_be32(uint8_t* p, uint32_t x) {
+    p[0] = (uint8_t) (x >> 24);
+    p[1] = (uint8_t) (x >> 16);
+    p[2] = (uint8_t) (x >> 8);
+    p[3] = (uint8_t) x;
+}
+
+#define S0(x) (ror((x), 2) ^ ror((x), 13) ^ ror((x), 22))
+#define S1(x) (ror((x), 6) ^ ror((x), 11) ^ ror((x), 25))
+#define s0(x) (ror((x), 7) ^ ror((x), 18) ^ ((x) >> 3))
+#define s1(x) (ror((x), 17) ^ ror((x), 19) ^ ((x) >> 10))
+#define CH(x, y, z) ((((y) ^ (z)) & (x)) ^ (z))
+#define MAJ(x, y, z) (((x) & (y)) | (((x) | (y)) & (z)))
+
+// Round 'i' with the working variables renamed so that no moves are needed.  For rounds
+// 16-63, W[i % 16] is first replaced by the next word of the message schedule.
+#define ROUND(a, b, c, d, e, f, g, h, i) do {                                               \
+    if ((i) >= 16) {                                                                        \
+        W[(i) & 15] += s1(W[((i) - 2) & 15]) + W[((i) - 7) & 15] + s0(W[((i) - 15) & 15]); \
+    }                                                                                       \
+    const uint32_t t1 = h + S1(e) + CH(e, f, g) + K[i] + W[(i) & 15];                       \
+    d += t1;                                                                                \
+    h = t1 + S0(a) + MAJ(a, b, c);                                                          \
+} while (0)
+
+static void compress(uint32_t state[8], const uint8_t* block) {
+    uint32_t W[16];
+    for (int i = 0; i < 16; i++) {
+        W[i] = load_be32(block + 4 * i);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i += 8) {
+        ROUND(a, b, c, d, e, f, g, h, i + 0);
+        ROUND(h, a, b, c, d, e, f, g, i + 1);
+        ROUND(g, h, a, b, c, d, e, f, i + 2);
+        ROUND(f, g, h, a, b, c, d, e, i + 3);
+        ROUND(e, f, g, h, a, b, c, d, i + 4);
+        ROUND(d, e, f, g, h, a, b, c, i + 5);
+        ROUND(c, d, e, f, g, h, a, b, i + 6);
+        ROUND(b, c, d, e, f, g, h, a, i + 7);
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256_init(sha256_t* ctx) {
+    static const uint32_t H0[8] = {
+    0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u,
+    };
+
+    memcpy(ctx->state, H0, sizeof(H0));
+    ctx->length = 0;
+}
+
+void sha256_update(sha256_t* ctx, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*) data;
+    size_t used = (size_t) (ctx->length % SHA256_BLOCK_SIZE);
+    ctx->length += len;
+
+    // Complete a partial block.
+    if (used > 0) {
+        const size_t count = len < SHA256_BLOCK_SIZE - used ? len : SHA256_BLOCK_SIZE - used;
+        memcpy(ctx->buffer + used, p, count);
+        p += count;
+        len -= count;
+        used += count;
+
+        if (used < SHA256_BLOCK_SIZE) {
+            return;
+        }
+
+        compress(ctx->state, ctx->buffer);
+    }
+
+    for (; len >= SHA256_BLOCK_SIZE; p += SHA256_BLOCK_SIZE, len -= SHA256_BLOCK_SIZE) {
+        compress(ctx->state, p);
+    }
+
+    memcpy(ctx->buffer, p, len);
+}
+
+void sha256_final(sha256_t* ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    const uint64_t bits = ctx->length * 8;
+
+    // Pad with 0x80, then zeros up to the last 8 bytes of a block, which hold the length.
+    static const uint8_t padding[SHA256_BLOCK_SIZE] = { 0x80 };
+    const size_t used = (size_t) (ctx->length % SHA256_BLOCK_SIZE);
+    sha256_update(ctx, padding, (used < 56 ? 56 : 120) - used);
+
+    uint8_t length[8];
+    store_be32(length, (uint32_t) (bits >> 32));
+    store_be32(length + 4, (uint32_t) bits);
+    sha256_update(ctx, length, sizeof(length));
+
+    for (int i = 0; i < 8; i++) {
+        store_be32(digest + 4 * i, ctx->state[i]);
+    }
+}
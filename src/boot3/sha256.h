@@ -0,0 +1,31 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;                        // Bytes hashed so far
+    uint8_t buffer[SHA256_BLOCK_SIZE];      // Partial block
+} sha256_t;
+
+void sha256_init(sha256_t* ctx);
+void sha256_update(sha256_t* ctx, const void* data, size_t len);
+void sha256_final(sha256_t* ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
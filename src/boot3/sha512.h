@@ -0,0 +1,33 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHA512_BLOCK_SIZE 128
+#define SHA512_DIGEST_SIZE 64
+
+// SHA-512 (FIPS 180-4), as required by Ed25519.  Only a few blocks are hashed per signature,
+// so this is written for size rather than speed.
+typedef struct {
+    uint64_t state[8];
+    uint64_t length;                        // Bytes hashed so far
+    uint8_t buffer[SHA512_BLOCK_SIZE];      // Partial block
+} sha512_t;
+
+void sha512_init(sha512_t* ctx);
+void sha512_update(sha512_t* ctx, const void* data, size_t len);
+void sha512_final(sha512_t* ctx, uint8_t digest[SHA512_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,75 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Pico SDK
+#include <hardware/flash.h>
+
+// Project
+#include "signature.h"
+
+void signature_init(signature_t* signature) {
+    memset(signature, 0, sizeof(signature_t));
+    sha256_init(&signature->_hash);
+}
+
+void signature_restart(signature_t* signature) {
+    signature->is_present = false;
+    sha256_init(&signature->_hash);
+}
+
+bool signature_is_signature_block(const struct uf2_block* block) {
+    const signature_header_t* header = (const signature_header_t*) block->data;
+    return (block->flags & UF2_FLAG_NOT_MAIN_FLASH) != 0
+        && header->magic == SIGNATURE_MAGIC;
+}
+
+bool signature_add_block(signature_t* signature, const struct uf2_block* block) {
+    const signature_header_t* header = (const signature_header_t*) block->data;
+
+    bool ok = signature_is_signature_block(block);
+    ok &= header->version == SIGNATURE_VERSION;
+    ok &= header->algorithm == SIGNATURE_ALGORITHM_ED25519;
+    ok &= sizeof(signature_header_t) <= block->payload_size;
+
+    // A UF2 file has at most one signature.
+    ok &= !signature->is_present;
+
+    if (ok) {
+        memcpy(signature->signature, header->signature, sizeof(signature->signature));
+        signature->is_present = true;
+    }
+
+    return ok;
+}
+
+void signature_hash_block(signature_t* signature, const struct uf2_block* block) {
+    const uint32_t addr = block->target_addr;
+    const uint8_t addr_le[4] = {
+        (uint8_t) addr, (uint8_t) (addr >> 8), (uint8_t) (addr >> 16), (uint8_t) (addr >> 24)
+    };
+
+    sha256_update(&signature->_hash, addr_le, sizeof(addr_le));
+    sha256_update(&signature->_hash, block->data, FLASH_PAGE_SIZE);
+}
+
+bool signature_verify(signature_t* signature, const uint8_t public_key[ED25519_PUBLIC_KEY_SIZE]) {
+    sha256_final(&signature->_hash, signature->_digest);
+
+    signature->_is_verified = signature->is_present
+        && ed25519_verify(signature->signature, signature->_digest, sizeof(signature->_digest), public_key);
+
+    return signature->_is_verified;
+}
+
+bool signature_matches(signature_t* signature) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256_final(&signature->_hash, digest);
+
+    return signature->_is_verified
+        && memcmp(digest, signature->_digest, sizeof(digest)) == 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <boot/uf2.h>
+
+// Project
+#include "ed25519.h"
+#include "sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A signed UF2 file carries a signature block: a UF2 metadata block (flagged
+// UF2_FLAG_NOT_MAIN_FLASH) with an Ed25519 signature of the image digest.
+//
+// The image digest is the SHA-256 of each flash block's target address (32-bit little-endian)
+// followed by its 256-byte payload, for every RP2040 flash block in file order.  Metadata
+// blocks (including the manifest and the signature itself) are not covered, so the block
+// numbering may change after signing.  Because the image header is not covered either, the
+// bootloader records the version from a UF2 file only after verifying its flash blocks (see
+// 'update_firmware()').
+//
+// The signature block is appended by 'scripts/uf2_sign.py'.
+
+#define SIGNATURE_MAGIC             0x47495342  // "BSIG" (little-endian)
+#define SIGNATURE_VERSION           1
+#define SIGNATURE_ALGORITHM_ED25519 1
+
+// Payload of the signature block.
+typedef struct {
+    uint32_t magic;                                 // SIGNATURE_MAGIC
+    uint16_t version;                               // SIGNATURE_VERSION
+    uint16_t algorithm;                             // SIGNATURE_ALGORITHM_ED25519
+    uint8_t signature[ED25519_SIGNATURE_SIZE];      // Signature of the image digest
+} signature_header_t;
+
+typedef struct {
+    uint8_t signature[ED25519_SIGNATURE_SIZE];      // Signature from the UF2 file
+    bool is_present;                                // True if the signature block was read
+
+    // Private: state for hashing the image as it is read.
+    sha256_t _hash;                                 // Running hash of the flash blocks
+    uint8_t _digest[SHA256_DIGEST_SIZE];            // Image digest verified by 'signature_verify'
+    bool _is_verified;                              // True if '_digest' holds a verified digest
+} signature_t;
+
+void signature_init(signature_t* signature);
+
+// Resets the state for reading the UF2 file again, retaining the verified digest.
+void signature_restart(signature_t* signature);
+
+// Returns true if the given (metadata) block is a signature block.
+bool signature_is_signature_block(const struct uf2_block* block);
+
+// Records the signature from the given signature block.  Returns false if the block is
+// malformed, uses an unsupported algorithm, or a signature was already received.
+bool signature_add_block(signature_t* signature, const struct uf2_block* block);
+
+// Adds the given flash block to the image digest.
+void signature_hash_block(signature_t* signature, const struct uf2_block* block);
+
+// Completes the image digest after the last flash block and verifies the signature against
+// 'public_key'.  Returns false if the UF2 file is unsigned or the signature does not match.
+bool signature_verify(signature_t* signature, const uint8_t public_key[ED25519_PUBLIC_KEY_SIZE]);
+
+// Completes the image digest after reading the UF2 file again and returns true if it is the
+// same digest verified by 'signature_verify' (i.e., the file did not change between reads).
+bool signature_matches(signature_t* signature);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,45 @@
+# https://github.com/DLehenbauer/pico-sdcard-bootloader
+# SPDX-License-Identifier: 0BSD
+#
+# Post-build check that the bootloader image fits in the flash reserved for it.  Invoked
+# with 'cmake -P' after linking:
+#
+#   ELF     Path to the bootloader's ELF file
+#   NM      Path to 'arm-none-eabi-nm'
+#   BUDGET  Bytes of flash available for the bootloader image (BOOTLOADER_SIZE, less the
+#           last sector, which holds the installed image record)
+#
+# The image spans from '__logical_binary_start' to '__flash_binary_end' (see 'memmap.ld').  On
+# failure, the ELF is deleted so that the next build relinks and checks again.
+
+execute_process(
+    COMMAND ${NM} ${ELF}
+    OUTPUT_VARIABLE symbols
+    RESULT_VARIABLE result
+)
+
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Unable to read symbols from '${ELF}'")
+endif()
+
+string(REGEX MATCH "([0-9a-fA-F]+) [A-Za-z] __logical_binary_start\n" _ "${symbols}")
+set(start "${CMAKE_MATCH_1}")
+string(REGEX MATCH "([0-9a-fA-F]+) [A-Za-z] __flash_binary_end\n" _ "${symbols}")
+set(end "${CMAKE_MATCH_1}")
+
+if (start STREQUAL "" OR end STREQUAL "")
+    message(FATAL_ERROR "'${ELF}' does not define __logical_binary_start and __flash_binary_end")
+endif()
+
+math(EXPR used "0x${end} - 0x${start}")
+math(EXPR budget "${BUDGET}")
+math(EXPR free "${budget} - ${used}")
+math(EXPR percent "${used} * 100 / ${budget}")
+
+if (used GREATER budget)
+    math(EXPR excess "${used} - ${budget}")
+    file(REMOVE ${ELF})
+    message(FATAL_ERROR "Bootloader is ${used} bytes, which exceeds the ${budget} bytes available in BOOTLOADER_SIZE by ${excess} bytes")
+endif()
+
+message(STATUS "Bootloader uses ${used} of ${budget} bytes (${percent}%, ${free} bytes free)")
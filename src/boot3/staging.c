@@ -0,0 +1,140 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Pico SDK
+#include <boot/uf2.h>
+#include <hardware/flash.h>
+
+// Project
+#include "boot_control.h"
+#include "crc32.h"
+#include "flash.h"
+#include "staging.h"
+
+_Static_assert(BOOTLOADER_STAGING_SIZE % FLASH_SECTOR_SIZE == 0,
+    "BOOTLOADER_STAGING_SIZE must be a multiple of the flash sector size");
+
+#define STAGING_CAPACITY (BOOTLOADER_STAGING_SIZE - BOOT_CONTROL_STAGING_DATA_OFFSET)
+
+static const boot_control_staging_header_t* staging_header() {
+    return (const boot_control_staging_header_t*) flash_contents(STAGING_OFFSET);
+}
+
+static const uint8_t* staging_data() {
+    return flash_contents(STAGING_OFFSET + BOOT_CONTROL_STAGING_DATA_OFFSET);
+}
+
+static void staging_init(void) {}
+
+static bool staging_uf2_exists(void) {
+    if (BOOTLOADER_STAGING_SIZE == 0) {
+        return false;
+    }
+
+    return staging_header()->magic == BOOT_CONTROL_STAGING_MAGIC;
+}
+
+// Presents the staged UF2 file, one block at a time.
+static bool read_uf2_image(prog_t* prog, accept_block_cb_t callback, const uint8_t* data, uint32_t size) {
+    if (size % sizeof(struct uf2_block) != 0) {
+        return false;
+    }
+
+    bool ok = true;
+
+    for (uint32_t offset = 0; offset < size; offset += sizeof(struct uf2_block)) {
+        // Copy the block to RAM.  Flash is not readable while 'flash_prog()' runs.
+        struct uf2_block block;
+        memcpy(&block, data + offset, sizeof(block));
+
+        ok = callback(prog, &block);
+        if (!ok || prog->is_done) {
+            break;
+        }
+    }
+
+    return ok;
+}
+
+// Presents the staged binary as a UF2 file with one block per flash page.
+static bool read_dense_image(prog_t* prog, accept_block_cb_t callback, const uint8_t* data, uint32_t size) {
+    const uint32_t num_blocks = (size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+
+    bool ok = true;
+
+    struct uf2_block block;
+    memset(&block, 0, sizeof(block));
+    block.magic_start0 = UF2_MAGIC_START0;
+    block.magic_start1 = UF2_MAGIC_START1;
+    block.flags = UF2_FLAG_FAMILY_ID_PRESENT;
+    block.payload_size = FLASH_PAGE_SIZE;
+    block.num_blocks = num_blocks;
+    block.file_size = RP2040_FAMILY_ID;
+    block.magic_end = UF2_MAGIC_END;
+
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        const uint32_t offset = i * FLASH_PAGE_SIZE;
+        const uint32_t length = MIN(size - offset, FLASH_PAGE_SIZE);
+
+        block.target_addr = XIP_BASE + offset;
+        block.block_no = i;
+
+        // The last page is padded with erased bytes.
+        memcpy(block.data, data + offset, length);
+        memset(block.data + length, 0xFF, FLASH_PAGE_SIZE - length);
+
+        ok = callback(prog, &block);
+        if (!ok || prog->is_done) {
+            break;
+        }
+    }
+
+    return ok;
+}
+
+static bool staging_read_uf2(prog_t* prog, accept_block_cb_t callback) {
+    if (!staging_uf2_exists()) {
+        return false;
+    }
+
+    const boot_control_staging_header_t header = *staging_header();
+
+    // Reject a staged image that is incomplete or was only partially written.
+    bool ok = header.version == BOOT_CONTROL_STAGING_VERSION;
+    ok &= 0 < header.size && header.size <= STAGING_CAPACITY;
+    ok &= ok && crc32_update(0, staging_data(), header.size) == header.crc;
+
+    if (!ok) {
+        return false;
+    }
+
+    switch (header.format) {
+        case BOOT_CONTROL_STAGING_UF2:
+            return read_uf2_image(prog, callback, staging_data(), header.size);
+
+        case BOOT_CONTROL_STAGING_DENSE:
+            return read_dense_image(prog, callback, staging_data(), header.size);
+
+        default:
+            return false;
+    }
+}
+
+static bool staging_remove_uf2(void) {
+    flash_erase(STAGING_OFFSET, FLASH_SECTOR_SIZE);
+    return !staging_uf2_exists();
+}
+
+const transport_t staging_transport = {
+    .name = "staging area",
+    .reads_flash = true,
+    .init = staging_init,
+    .uf2_exists = staging_uf2_exists,
+    .read_uf2 = staging_read_uf2,
+    .remove_uf2 = staging_remove_uf2,
+};
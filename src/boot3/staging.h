@@ -0,0 +1,18 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Project
+#include "prog.h"
+#include "transport.h"
+
+// The staging area holds an update written by the firmware itself (see 'boot_control.h').
+// Its size is BOOTLOADER_STAGING_SIZE ('config.cmake'), which is 0 if disabled.
+//
+// 'staging_transport' verifies the staged image's CRC-32 before each read.  Dense images are
+// presented as UF2 blocks for consecutive pages starting at XIP_BASE.  Removing the image
+// erases the staging header so that it is not installed again.
+#define STAGING_OFFSET (PROG_AREA_SIZE + BOOTLOADER_ROLLBACK_SIZE)
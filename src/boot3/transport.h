@@ -15,12 +15,55 @@
 
 // Project
 #include "prog.h"
+#include "tuning.h"
 
-void transport_init();  // Initializes the transport layer.
-bool uf2_exists();      // Returns true if new firmware is available.
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-// Reads the firmware file and invokes the callback for each UF2 block.
-bool read_uf2(prog_t* prog, accept_block_cb_t callback);
+// A source of firmware files.  Transports are enabled at build time ('config.cmake') and
+// probed in turn by 'main()' until one has a firmware file.
+typedef struct transport_s {
+    const char* name;
 
-// Removes the UF2 file after reading it.
-bool remove_uf2();
+    // True if 'read_uf2' reads flash, which is unavailable while an erase is in progress.
+    bool reads_flash;
+
+    // Rate of the transport's link in bits per second (e.g., the SD card's SPI clock), or 0
+    // if not applicable.  Reported in the update log.
+    uint32_t baud_rate;
+
+    // Initializes the transport.  Called once at startup.
+    void (*init)(void);
+
+    // Returns true if new firmware is available.
+    bool (*uf2_exists)(void);
+
+    // Reads the firmware file and invokes the callback for each UF2 block.  The file is read
+    // once per pass, so this may be called several times per update.
+    bool (*read_uf2)(prog_t* prog, accept_block_cb_t callback);
+
+    // Removes the firmware file after it has been installed.
+    bool (*remove_uf2)(void);
+
+    // Sets aside a firmware file that failed validation, so that 'uf2_exists' offers the next
+    // one (if any).  Returns false if the file cannot be skipped, and must be replaced before
+    // the device can boot.  NULL if the transport has no files to skip.
+    bool (*reject_uf2)(void);
+
+    // Appends 'size' bytes to the transport's update log (see 'update_log.h'), or NULL if the
+    // transport does not keep a log.
+    bool (*append_log)(const void* data, size_t size);
+
+    // Settings for updates from this transport (e.g., from the SD card's tuning file), or
+    // NULL to use the compiled settings.  Read when 'uf2_exists' finds firmware.
+    const tuning_t* tuning;
+} transport_t;
+
+extern const transport_t sd_transport;          // 'sd_transport.c': 'firmware.uf2' on the SD card
+extern const transport_t uart_transport;        // 'uart_transport.c': Streamed by a host over a UART
+extern const transport_t staging_transport;     // 'staging.c': Staged in flash by the firmware
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,134 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Project
+#include "tuning.h"
+
+// A span of the tuning file.  Spans are never NUL-terminated.
+typedef struct {
+    const char* start;
+    size_t len;
+} span_t;
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static span_t trim(span_t s) {
+    while (s.len > 0 && is_space(s.start[0])) {
+        s.start++;
+        s.len--;
+    }
+    while (s.len > 0 && is_space(s.start[s.len - 1])) {
+        s.len--;
+    }
+    return s;
+}
+
+static bool equals(span_t s, const char* literal) {
+    return s.len == strlen(literal) && memcmp(s.start, literal, s.len) == 0;
+}
+
+// Parses a decimal number.  Fails on an empty span, other characters or overflow.
+static bool parse_u32(span_t s, uint32_t* value) {
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < s.len; i++) {
+        const char c = s.start[i];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+
+        const uint32_t digit = (uint32_t) (c - '0');
+        if (result > (UINT32_MAX - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+
+    *value = result;
+    return s.len > 0;
+}
+
+static bool parse_bool(span_t s, bool* value) {
+    if (equals(s, "1") || equals(s, "on") || equals(s, "true")) {
+        *value = true;
+        return true;
+    }
+
+    if (equals(s, "0") || equals(s, "off") || equals(s, "false")) {
+        *value = false;
+        return true;
+    }
+
+    return false;
+}
+
+// Applies one 'key=value' setting.  Returns false if the line is ignored.
+static bool parse_setting(tuning_t* tuning, span_t line) {
+    const char* equals_sign = memchr(line.start, '=', line.len);
+    if (equals_sign == NULL) {
+        return false;
+    }
+
+    const size_t key_len = (size_t) (equals_sign - line.start);
+    const span_t key = trim((span_t) { line.start, key_len });
+    const span_t value = trim((span_t) { equals_sign + 1, line.len - key_len - 1 });
+
+    if (equals(key, "sd_baud_rate")) {
+        uint32_t baud_rate;
+        if (!parse_u32(value, &baud_rate)
+            || baud_rate < BOOTLOADER_SD_BAUD_RATE_MIN || baud_rate > BOOTLOADER_SD_BAUD_RATE_MAX) {
+            return false;
+        }
+        tuning->sd_baud_rate = baud_rate;
+        return true;
+    }
+
+    if (equals(key, "led_progress")) {
+        return parse_bool(value, &tuning->led_progress);
+    }
+
+    if (equals(key, "skip_identical")) {
+        return parse_bool(value, &tuning->skip_identical);
+    }
+
+    return false;
+}
+
+void tuning_init(tuning_t* tuning, uint32_t sd_baud_rate) {
+    tuning->sd_baud_rate = sd_baud_rate;
+    tuning->led_progress = true;
+    tuning->skip_identical = true;
+}
+
+int tuning_parse(tuning_t* tuning, const char* text, size_t len) {
+    int num_ignored = 0;
+    size_t pos = 0;
+
+    while (pos < len) {
+        const char* newline = memchr(text + pos, '\n', len - pos);
+        const size_t end = newline != NULL ? (size_t) (newline - text) : len;
+
+        span_t line = { text + pos, end - pos };
+        pos = end + 1;
+
+        // Drop the comment, if any.
+        const char* hash = memchr(line.start, '#', line.len);
+        if (hash != NULL) {
+            line.len = (size_t) (hash - line.start);
+        }
+
+        line = trim(line);
+        if (line.len > 0 && !parse_setting(tuning, line)) {
+            num_ignored++;
+        }
+    }
+
+    return num_ignored;
+}
@@ -0,0 +1,60 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An optional tuning file in the SD card's root directory (BOOTLOADER_TUNING_FILE) overrides
+// some of the compiled settings for updates from that card, so that a new card or board can
+// be tuned without rebuilding the bootloader.  The file is plain text, one setting per line:
+//
+//     # SD card SPI clock in Hz (400kHz to BOOTLOADER_SD_BAUD_RATE_MAX)
+//     sd_baud_rate = 25000000
+//
+//     # Blink the LED while updating (on/off, 1/0, true/false)
+//     led_progress = off
+//
+//     # Skip updates (and sectors) that match the installed firmware (on/off)
+//     skip_identical = on
+//
+// Whitespace around keys and values is ignored, and '#' starts a comment.  A line that is
+// malformed, has an unknown key or a value out of range is ignored, and the setting keeps its
+// compiled value.  The file is read once per mount into a TUNING_MAX_FILE_SIZE buffer, and a
+// larger file is ignored.  The parser does not allocate and reads only the given bytes.
+
+#define TUNING_MAX_FILE_SIZE        512
+
+// Bounds for 'sd_baud_rate' ('config.cmake').  Cards are initialized at 400kHz, and 25MHz is
+// the fastest clock that every card supports in SPI mode.
+#define BOOTLOADER_SD_BAUD_RATE_MIN 400000
+
+#ifndef BOOTLOADER_SD_BAUD_RATE_MAX
+#define BOOTLOADER_SD_BAUD_RATE_MAX 25000000
+#endif
+
+typedef struct {
+    uint32_t sd_baud_rate;          // SD card SPI clock in Hz
+    bool led_progress;              // Blink the LED while updating
+    bool skip_identical;            // If false, every update is a full rewrite
+} tuning_t;
+
+// Sets the compiled defaults.
+void tuning_init(tuning_t* tuning, uint32_t sd_baud_rate);
+
+// Applies the settings in the first 'len' bytes of 'text' (which need not be NUL-terminated).
+// Returns the number of lines that were ignored (other than blank lines and comments).
+int tuning_parse(tuning_t* tuning, const char* text, size_t len);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,80 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <stdint.h>
+
+// Pico SDK
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+#include <hardware/uart.h>
+#include <pico/time.h>
+
+// Project
+#include "uart_link.h"
+#include "uart_proto.h"
+
+#define UART_INSTANCE __CONCAT(uart, BOOTLOADER_UART_TRANSPORT)
+
+// Received bytes are written to a ring buffer by DMA, so nothing is lost while the CPU is
+// busy programming flash.  The ring must hold a full window of frames.  (DMA ring buffers
+// must be aligned to their size.)
+#define RX_RING_BITS 12
+#define RX_RING_SIZE (1u << RX_RING_BITS)
+
+_Static_assert(RX_RING_SIZE >= UART_PROTO_WINDOW * UART_PROTO_MAX_FRAME_SIZE,
+    "Receive ring must hold a full window of frames.");
+
+static uint8_t rx_ring[RX_RING_SIZE] __attribute__((aligned(RX_RING_SIZE)));
+static uint32_t rx_channel;
+static uint32_t rx_pos;     // Offset of the next unread byte in 'rx_ring'
+
+void uart_link_init(void) {
+    uart_init(UART_INSTANCE, BOOTLOADER_UART_TRANSPORT_BAUD_RATE);
+    gpio_set_function(BOOTLOADER_UART_TRANSPORT_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(BOOTLOADER_UART_TRANSPORT_RX_PIN, GPIO_FUNC_UART);
+
+    rx_channel = dma_claim_unused_channel(/* required: */ true);
+
+    dma_channel_config config = dma_channel_get_default_config(rx_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, /* write: */ true, RX_RING_BITS);
+    channel_config_set_dreq(&config, uart_get_dreq(UART_INSTANCE, /* is_tx: */ false));
+
+    // The transfer count is effectively unbounded.  (At 3 Mbaud, it would take several hours
+    // to exhaust.)  The channel is reset with the other peripherals before the firmware runs.
+    dma_channel_configure(rx_channel, &config, rx_ring, &uart_get_hw(UART_INSTANCE)->dr,
+        UINT32_MAX, /* trigger: */ true);
+
+    rx_pos = 0;
+}
+
+static uint32_t rx_write_pos(void) {
+    return (uint32_t) dma_channel_hw_addr(rx_channel)->write_addr - (uint32_t) rx_ring;
+}
+
+bool uart_link_getc(uint8_t* byte, uint32_t timeout_us) {
+    const absolute_time_t deadline = make_timeout_time_us(timeout_us);
+
+    while (rx_pos == rx_write_pos()) {
+        if (time_reached(deadline)) {
+            return false;
+        }
+    }
+
+    *byte = rx_ring[rx_pos];
+    rx_pos = (rx_pos + 1) & (RX_RING_SIZE - 1);
+    return true;
+}
+
+void uart_link_drain(void) {
+    rx_pos = rx_write_pos();
+}
+
+void uart_link_write(const uint8_t* data, size_t length) {
+    uart_write_blocking(UART_INSTANCE, data, length);
+}
@@ -0,0 +1,33 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Byte stream used by the UART transport.  'uart_link.c' implements it with the RP2040's
+// UART and DMA.  The host tests substitute 'test/uart_link_posix.c', which reads and writes a
+// file descriptor (e.g., a pseudo-terminal).
+
+void uart_link_init(void);
+
+// Waits up to 'timeout_us' for the next received byte.  Returns false on timeout.
+bool uart_link_getc(uint8_t* byte, uint32_t timeout_us);
+
+// Discards any received bytes that have not been read.
+void uart_link_drain(void);
+
+void uart_link_write(const uint8_t* data, size_t length);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,108 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <stdarg.h>
+
+#ifdef BOOTLOADER_USE_UART
+// Pico SDK
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+#include <hardware/sync.h>
+#include <hardware/uart.h>
+#endif
+
+// Project
+#include "log_ring.h"
+#include "uart_log.h"
+
+#ifdef BOOTLOADER_USE_UART
+
+#define UART_LOG_UART __CONCAT(uart, BOOTLOADER_UART)
+
+// The DMA channel wraps its read address within the ring.  (DMA ring buffers must be aligned
+// to their size.)
+static uint8_t buffer[UART_LOG_SIZE] __attribute__((aligned(UART_LOG_SIZE)));
+static log_ring_t ring;
+static int dma_channel = -1;
+static uint32_t in_flight;          // Bytes in the transfer started by 'kick()'
+
+// Consumes the bytes sent by the previous transfer (if complete) and starts a transfer of
+// everything pending since.  Called with interrupts disabled, so that a log message written
+// from an interrupt does not race the restart.
+static void kick() {
+    if (dma_channel < 0 || dma_channel_is_busy(dma_channel)) {
+        return;
+    }
+
+    log_ring_consume(&ring, in_flight);
+    in_flight = log_ring_pending(&ring);
+
+    if (in_flight != 0) {
+        dma_channel_transfer_from_buffer_now(dma_channel, &buffer[ring.tail & ring.mask], in_flight);
+    }
+}
+
+void uart_log_init(void) {
+    uart_init(UART_LOG_UART, BOOTLOADER_UART_BAUD_RATE);
+    gpio_set_function(BOOTLOADER_UART_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(BOOTLOADER_UART_RX_PIN, GPIO_FUNC_UART);
+
+    log_ring_init(&ring, buffer, sizeof(buffer));
+    in_flight = 0;
+
+    dma_channel = dma_claim_unused_channel(/* required: */ true);
+    dma_channel_config config = dma_channel_get_default_config(dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_ring(&config, /* write: */ false, UART_LOG_BITS);
+    channel_config_set_dreq(&config, uart_get_dreq(UART_LOG_UART, /* is_tx: */ true));
+    dma_channel_configure(dma_channel, &config, &uart_get_hw(UART_LOG_UART)->dr, buffer, 0, /* trigger: */ false);
+}
+
+void uart_log_write(const void* data, uint32_t len) {
+    const uint32_t interrupts = save_and_disable_interrupts();
+    log_ring_write(&ring, data, len);
+    kick();
+    restore_interrupts(interrupts);
+}
+
+void uart_log_poll(void) {
+    const uint32_t interrupts = save_and_disable_interrupts();
+    kick();
+    restore_interrupts(interrupts);
+}
+
+void uart_log_flush(void) {
+    while (log_ring_pending(&ring) != 0) {
+        uart_log_poll();
+        tight_loop_contents();
+    }
+
+    uart_tx_wait_blocking(UART_LOG_UART);
+}
+
+#else
+
+void uart_log_init(void) {}
+void uart_log_write(const void* data, uint32_t len) {}
+void uart_log_poll(void) {}
+void uart_log_flush(void) {}
+
+#endif
+
+void uart_log_printf(const char* format, ...) {
+    #ifdef BOOTLOADER_USE_UART
+    char message[UART_LOG_MAX_MESSAGE];
+
+    va_list args;
+    va_start(args, format);
+    const size_t len = log_format(message, sizeof(message), format, args);
+    va_end(args);
+
+    uart_log_write(message, len);
+    #endif
+}
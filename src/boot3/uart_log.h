@@ -0,0 +1,60 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Diagnostic output on BOOTLOADER_UART (if BOOTLOADER_USE_UART is enabled).  Messages are
+// copied into a RAM ring ('log_ring.h') and sent by a DMA channel in the background, so
+// logging from the update loop only costs formatting and a copy.  If the ring is full, the
+// message is dropped rather than waiting for the UART.
+//
+// The DMA channel is restarted whenever a message is written (or 'uart_log_poll()' is
+// called), so output written while a transfer is in progress is sent by the next call.
+// Call 'uart_log_flush()' before resetting the device or starting the firmware.
+//
+// Without BOOTLOADER_USE_UART, these functions do nothing.
+
+// Size of the ring (2^UART_LOG_BITS bytes).  The DMA ring limit is 32kB.  The ring must hold
+// the largest message written at once (the profile frame, see 'profile.h').
+#define UART_LOG_BITS 11
+#define UART_LOG_SIZE (1u << UART_LOG_BITS)
+
+// Configures the UART and claims a DMA channel.
+void uart_log_init(void);
+
+// Queues 'len' bytes for the UART.
+void uart_log_write(const void* data, uint32_t len);
+
+// Formats a message with 'log_format()' (not printf) and queues it.  Messages are truncated
+// to UART_LOG_MAX_MESSAGE bytes.
+#define UART_LOG_MAX_MESSAGE 128
+void uart_log_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// Restarts the DMA channel if it finished sending and more output is pending.
+void uart_log_poll(void);
+
+// Waits until all queued output has left the UART.
+void uart_log_flush(void);
+
+// LOG() formats a message for the UART and compiles to nothing unless BOOTLOADER_USE_UART is
+// enabled in 'config.cmake'.
+//
+//     LOG("Pass 1: %u blocks\r\n", prog.num_blocks);
+#ifdef BOOTLOADER_USE_UART
+#define LOG(...) uart_log_printf(__VA_ARGS__)
+#else
+#define LOG(...) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
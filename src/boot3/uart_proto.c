@@ -0,0 +1,89 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Project
+#include "crc32.h"
+#include "uart_proto.h"
+
+static void put_u16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t) (value >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t value) {
+    put_u16(p, (uint16_t) value);
+    put_u16(p + 2, (uint16_t) (value >> 16));
+}
+
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return get_u16(p) | ((uint32_t) get_u16(p + 2) << 16);
+}
+
+size_t uart_proto_encode(uint8_t* buffer, uint8_t type, uint16_t seq, const void* payload, uint16_t length) {
+    buffer[0] = UART_PROTO_SYNC;
+    buffer[1] = type;
+    put_u16(&buffer[2], seq);
+    put_u16(&buffer[4], length);
+    if (length > 0) {
+        memcpy(&buffer[UART_PROTO_HEADER_SIZE], payload, length);
+    }
+
+    const uint32_t crc = crc32_update(0, &buffer[1], UART_PROTO_HEADER_SIZE - 1 + length);
+    put_u32(&buffer[UART_PROTO_HEADER_SIZE + length], crc);
+
+    return UART_PROTO_HEADER_SIZE + length + UART_PROTO_CRC_SIZE;
+}
+
+void uart_decoder_reset(uart_decoder_t* decoder) {
+    decoder->offset = 0;
+}
+
+uart_decode_result_t uart_decoder_put(uart_decoder_t* decoder, uint8_t byte) {
+    uint8_t* const buffer = decoder->buffer;
+
+    if (decoder->offset == 0 && byte != UART_PROTO_SYNC) {
+        // Skip noise (e.g., from the host opening the port) until the next sync byte.
+        return UART_DECODE_MORE;
+    }
+
+    buffer[decoder->offset++] = byte;
+
+    if (decoder->offset < UART_PROTO_HEADER_SIZE) {
+        return UART_DECODE_MORE;
+    }
+
+    const uint16_t length = get_u16(&buffer[4]);
+    if (length > UART_PROTO_MAX_PAYLOAD) {
+        decoder->offset = 0;
+        return UART_DECODE_CORRUPT;
+    }
+
+    const uint32_t size = UART_PROTO_HEADER_SIZE + length + UART_PROTO_CRC_SIZE;
+    if (decoder->offset < size) {
+        return UART_DECODE_MORE;
+    }
+
+    decoder->offset = 0;
+
+    const uint32_t crc = crc32_update(0, &buffer[1], UART_PROTO_HEADER_SIZE - 1 + length);
+    if (crc != get_u32(&buffer[UART_PROTO_HEADER_SIZE + length])) {
+        return UART_DECODE_CORRUPT;
+    }
+
+    uart_frame_t* const frame = &decoder->frame;
+    frame->type = buffer[1];
+    frame->seq = get_u16(&buffer[2]);
+    frame->length = length;
+    memcpy(frame->payload, &buffer[UART_PROTO_HEADER_SIZE], length);
+
+    return UART_DECODE_FRAME;
+}
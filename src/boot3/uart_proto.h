@@ -0,0 +1,99 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Framing for the UART transport ('uart_transport.c').  The host side is implemented by
+// 'scripts/uf2_stream.py'.  Each frame is:
+//
+//     sync (0x5A) | type | seq | length | payload[length] | CRC-32
+//
+// 'seq' and 'length' are 16 bits, and the CRC-32 is 32 bits, all little-endian.  The CRC-32
+// (as used by zlib) covers 'type' through the end of the payload.
+//
+// The device drives the exchange:
+//
+//     Device                          Host
+//     PROBE (version, window)   ->
+//                               <-    OFFER (num_blocks) or NONE
+//     READ                      ->
+//                               <-    DATA (seq = block index, payload = UF2 block)
+//     ACK (seq = next block)    ->    ...up to 'window' DATA frames may be unacknowledged
+//                               <-    END (seq = number of blocks)
+//     ACK (seq = number of blocks) ->
+//
+// The device reads the file once per update pass.  It sends NAK (seq = next block) when it
+// receives a corrupt or out-of-order frame, or times out, and the host resends from that
+// block.  The device sends STOP to end a read early, and REMOVE after installing the file.
+// Block indices are truncated to 16 bits.
+#define UART_PROTO_SYNC 0x5A
+#define UART_PROTO_VERSION 1
+#define UART_PROTO_MAX_PAYLOAD 512
+#define UART_PROTO_HEADER_SIZE 6
+#define UART_PROTO_CRC_SIZE 4
+#define UART_PROTO_MAX_FRAME_SIZE (UART_PROTO_HEADER_SIZE + UART_PROTO_MAX_PAYLOAD + UART_PROTO_CRC_SIZE)
+
+// Maximum number of unacknowledged DATA frames.  The device's receive buffer must hold
+// this many frames, since the device does not read the UART while programming flash.
+#define UART_PROTO_WINDOW 4
+
+typedef enum uart_proto_type_s {
+    // Device to host
+    UART_PROTO_PROBE = 0x01,
+    UART_PROTO_READ = 0x02,
+    UART_PROTO_ACK = 0x03,
+    UART_PROTO_NAK = 0x04,
+    UART_PROTO_STOP = 0x05,
+    UART_PROTO_REMOVE = 0x06,
+
+    // Host to device
+    UART_PROTO_NONE = 0x80,
+    UART_PROTO_OFFER = 0x81,
+    UART_PROTO_DATA = 0x82,
+    UART_PROTO_END = 0x83,
+    UART_PROTO_REMOVED = 0x86,
+} uart_proto_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint16_t seq;
+    uint16_t length;
+    uint8_t payload[UART_PROTO_MAX_PAYLOAD];
+} uart_frame_t;
+
+typedef enum uart_decode_result_s {
+    UART_DECODE_MORE = 0,       // Byte consumed; the frame is not complete yet
+    UART_DECODE_FRAME = 1,      // A valid frame is available in 'decoder->frame'
+    UART_DECODE_CORRUPT = 2,    // A frame was discarded (bad length or CRC-32)
+} uart_decode_result_t;
+
+// Reassembles frames from a byte stream.  Bytes preceding a sync byte are skipped.
+typedef struct {
+    uart_frame_t frame;
+    uint32_t offset;            // Bytes of the current frame received so far
+    uint8_t buffer[UART_PROTO_MAX_FRAME_SIZE];
+} uart_decoder_t;
+
+// Encodes a frame into 'buffer' (at least UART_PROTO_HEADER_SIZE + length + UART_PROTO_CRC_SIZE
+// bytes).  Returns the size of the frame.
+size_t uart_proto_encode(uint8_t* buffer, uint8_t type, uint16_t seq, const void* payload, uint16_t length);
+
+void uart_decoder_reset(uart_decoder_t* decoder);
+
+// Consumes one byte from the stream.
+uart_decode_result_t uart_decoder_put(uart_decoder_t* decoder, uint8_t byte);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,160 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <string.h>
+
+// Pico SDK
+#include <boot/uf2.h>
+
+// Project
+#include "transport.h"
+#include "uart_link.h"
+#include "uart_proto.h"
+
+#define PROBE_TIMEOUT_US (BOOTLOADER_UART_TRANSPORT_PROBE_MS * 1000u)
+#define TIMEOUT_US (BOOTLOADER_UART_TRANSPORT_TIMEOUT_MS * 1000u)
+
+// Consecutive timeouts and corrupt frames tolerated before a read fails.
+#define MAX_ERRORS 8
+
+static uart_decoder_t decoder;
+
+static void send(uint8_t type, uint16_t seq, const void* payload, uint16_t length) {
+    uint8_t buffer[UART_PROTO_HEADER_SIZE + 2 + UART_PROTO_CRC_SIZE];
+    uart_link_write(buffer, uart_proto_encode(buffer, type, seq, payload, length));
+}
+
+// Waits for the next frame, which is then available in 'decoder.frame'.  Returns
+// UART_DECODE_MORE if no frame arrives within 'timeout_us' of the last byte received.
+static uart_decode_result_t receive(uint32_t timeout_us) {
+    // Give up if the line is busy, but not with frames (e.g., a console is attached).
+    for (uint32_t i = 0; i < 2 * UART_PROTO_MAX_FRAME_SIZE; i++) {
+        uint8_t byte;
+        if (!uart_link_getc(&byte, timeout_us)) {
+            break;
+        }
+
+        const uart_decode_result_t result = uart_decoder_put(&decoder, byte);
+        if (result != UART_DECODE_MORE) {
+            return result;
+        }
+    }
+
+    uart_decoder_reset(&decoder);
+    return UART_DECODE_MORE;
+}
+
+// Sends a request and waits for the host's reply.  Stale DATA and END frames from a previous
+// read are skipped.
+static const uart_frame_t* request(uint8_t type, const void* payload, uint16_t length, uint32_t timeout_us) {
+    uart_link_drain();
+    uart_decoder_reset(&decoder);
+    send(type, 0, payload, length);
+
+    while (receive(timeout_us) == UART_DECODE_FRAME) {
+        if (decoder.frame.type >= UART_PROTO_NONE && decoder.frame.type != UART_PROTO_DATA && decoder.frame.type != UART_PROTO_END) {
+            return &decoder.frame;
+        }
+    }
+
+    return NULL;
+}
+
+static void uart_transport_init(void) {
+    uart_link_init();
+}
+
+static bool uart_transport_uf2_exists(void) {
+    const uint8_t payload[] = { UART_PROTO_VERSION, UART_PROTO_WINDOW };
+    const uart_frame_t* reply = request(UART_PROTO_PROBE, payload, sizeof(payload), PROBE_TIMEOUT_US);
+
+    return reply != NULL && reply->type == UART_PROTO_OFFER;
+}
+
+static bool uart_transport_read_uf2(prog_t* prog, accept_block_cb_t callback) {
+    uart_link_drain();
+    uart_decoder_reset(&decoder);
+    send(UART_PROTO_READ, 0, NULL, 0);
+
+    const uart_frame_t* frame = &decoder.frame;
+    uint32_t expected = 0;      // Index of the next block
+    uint32_t errors = 0;        // Consecutive errors since the last block was received
+    bool nak_sent = false;      // The host has been asked to resend from 'expected'
+
+    while (true) {
+        const uart_decode_result_t result = receive(TIMEOUT_US);
+
+        if (result == UART_DECODE_FRAME) {
+            if (frame->type == UART_PROTO_DATA && frame->seq == (uint16_t) expected
+                && frame->length == sizeof(struct uf2_block)
+            ) {
+                // Copy the payload to an aligned block.
+                struct uf2_block block;
+                memcpy(&block, frame->payload, sizeof(block));
+
+                expected++;
+                errors = 0;
+                nak_sent = false;
+
+                const bool ok = callback(prog, &block);
+                if (!ok || prog->is_done) {
+                    send(UART_PROTO_STOP, (uint16_t) expected, NULL, 0);
+                    return ok;
+                }
+
+                send(UART_PROTO_ACK, (uint16_t) expected, NULL, 0);
+                continue;
+            }
+
+            if (frame->type == UART_PROTO_END && frame->seq == (uint16_t) expected) {
+                send(UART_PROTO_ACK, (uint16_t) expected, NULL, 0);
+                return true;
+            }
+
+            const bool is_gap = (frame->type == UART_PROTO_DATA || frame->type == UART_PROTO_END)
+                && (int16_t) (frame->seq - (uint16_t) expected) > 0;
+
+            if (!is_gap) {
+                // Retransmitted data we already have, or a stale reply.
+                continue;
+            }
+        }
+
+        // A frame was lost or corrupted.  After a gap or corrupt frame, the frames already in
+        // flight are expected to be out of order, so only ask once.  After a timeout, the
+        // request (or the host's reply) may have been lost, so ask again.
+        if (result != UART_DECODE_MORE && nak_sent) {
+            continue;
+        }
+
+        if (++errors > MAX_ERRORS) {
+            send(UART_PROTO_STOP, (uint16_t) expected, NULL, 0);
+            return false;
+        }
+
+        send(UART_PROTO_NAK, (uint16_t) expected, NULL, 0);
+        nak_sent = true;
+    }
+}
+
+static bool uart_transport_remove_uf2(void) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        const uart_frame_t* reply = request(UART_PROTO_REMOVE, NULL, 0, TIMEOUT_US);
+        if (reply != NULL && reply->type == UART_PROTO_REMOVED) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const transport_t uart_transport = {
+    .name = "UART",
+    .init = uart_transport_init,
+    .uf2_exists = uart_transport_uf2_exists,
+    .read_uf2 = uart_transport_read_uf2,
+    .remove_uf2 = uart_transport_remove_uf2,
+};
@@ -0,0 +1,636 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Pico SDK
+#include <boot/uf2.h>
+#include <hardware/flash.h>
+#include <hardware/timer.h>
+
+// Project
+#include "diag.h"
+#include "erase_plan.h"
+#include "erase_scheduler.h"
+#include "flash.h"
+#include "image_header.h"
+#include "profile.h"
+#include "prog.h"
+#include "rollback.h"
+#include "scrub.h"
+#include "transport.h"
+#include "uart_log.h"
+#include "update.h"
+#include "update_log.h"
+#include "vector_table.h"
+
+#ifdef BOOTLOADER_SIGNING_KEY
+// Public key for verifying signed UF2 files (see 'signature.h').  UF2 files that are
+// unsigned or signed with a different key are rejected.
+static const uint8_t signing_key[ED25519_PUBLIC_KEY_SIZE] = { BOOTLOADER_SIGNING_KEY };
+
+// Hashes each flash block as it is read, so that the signature is checked without another
+// pass over the UF2 file.
+static void hash_block(prog_t* prog, const struct uf2_block* block) {
+    PROFILE_BEGIN(start);
+    signature_hash_block(&prog->signature, block);
+    PROFILE_END(PROFILE_HASH, start);
+}
+#else
+#define hash_block(prog, block) ((void)0)
+#endif
+
+#ifdef BOOTLOADER_ENCRYPTION_KEY
+// Device key for decrypting encrypted UF2 files (see 'encryption.h').  Unencrypted UF2 files
+// are still accepted.
+static const uint8_t encryption_key[AES128_KEY_SIZE] = { BOOTLOADER_ENCRYPTION_KEY };
+
+// The expanded key.  (Static to keep it off the stack.)
+static aes128_t device_key;
+#endif
+
+#ifdef BOOTLOADER_USE_UART
+// Logs the number of blocks accepted per second during a pass over the UF2 file (e.g., to
+// compare builds with and without BOOTLOADER_HOT_PATH_IN_RAM).
+static void log_pass(int pass, const prog_t* prog, uint32_t start_us) {
+    const uint32_t us = time_us_32() - start_us;
+    const uint32_t rate = us == 0 ? 0 : (uint32_t) ((uint64_t) prog->num_blocks_accepted * 1000000 / us);
+    LOG("[Boot3] Pass %d: %u blocks in %u us (%u blocks/s)\r\n",
+        pass, (unsigned) prog->num_blocks_accepted, (unsigned) us, (unsigned) rate);
+}
+
+#define PASS_BEGIN(name) const uint32_t name = time_us_32()
+#define PASS_END(pass, prog, name) log_pass((pass), (prog), (name))
+#else
+#define PASS_BEGIN(name) ((void)0)
+#define PASS_END(pass, prog, name) ((void)0)
+#endif
+
+// Statistics for the update log (see 'update_log.h').  (Static to keep them off the stack.)
+static update_log_record_t log_record;
+static update_log_phase_t current_phase;
+static uint32_t phase_start_us;
+
+// Adds the time since the last phase change to the current phase, and starts 'next'.
+static void enter_phase(update_log_phase_t next) {
+    const uint32_t now_us = time_us_32();
+    log_record.phase_us[current_phase] += now_us - phase_start_us;
+    current_phase = next;
+    phase_start_us = now_us;
+}
+
+// Blinks the LED to show progress, unless the transport's tuning disables it.
+static bool show_progress;
+
+static void progress_toggle() {
+    if (show_progress) {
+        led_toggle();
+    }
+}
+
+// Counts the UF2 bytes read from the transport by each pass.
+static bool read_block(prog_t* prog, const struct uf2_block* block) {
+    log_record.bytes_read += sizeof(struct uf2_block);
+    return process_block(prog, block);
+}
+
+// During pass 1 (validation), this callback is invoked for each block in the UF2
+// file that is valid and matches the expected family ID.
+static bool validate_uf2_callback(prog_t* prog, const struct uf2_block* block) {
+    // Blink the LED to show progress during large files.
+    if (prog->num_blocks_accepted % 128 == 0) {
+        progress_toggle();
+    }
+
+    hash_block(prog, block);
+
+    // If the UF2 file has a manifest, verify that it accurately describes the UF2 file.
+    // (We've already used the manifest to determine which sectors differ.)
+    if (manifest_is_present(&prog->manifest)) {
+        return manifest_verify_block(&prog->manifest, block);
+    }
+
+    // While validating, we also check if the current contents of flash are identical
+    // to the contents of the UF2 file (ignoring the stage2 bootloader).
+    if (block->target_addr != XIP_BASE && !prog->is_different) {
+        // Once we've found the first different block, we can stop reading/comparing.
+        PROFILE_BEGIN(start);
+        prog->is_different = memcmp(flash_contents(block->target_addr - XIP_BASE), block->data, FLASH_PAGE_SIZE) != 0;
+        PROFILE_END(PROFILE_MEMCMP, start);
+    }
+
+    // And continue processing blocks.
+    return true;
+}
+
+// Erases sectors as they are first written during pass 2.  (Static to keep it off the stack.)
+static erase_scheduler_t scheduler;
+
+// Sectors of the program area that are already blank, and need not be erased.
+static uint32_t blank_sectors[ERASE_PLAN_BITMAP_WORDS(PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE)];
+
+// During pass 2 (writing), this callback is invoked for each block in the UF2
+// file that is valid and matches the expected family ID.
+static bool write_uf2_callback(prog_t* prog, const struct uf2_block* block) {
+    // Blink the LED rapidly to show progress during large files.
+    if (prog->num_blocks_accepted % 16 == 0) {
+        progress_toggle();
+    }
+
+    hash_block(prog, block);
+
+    // If the UF2 file has a manifest, skip sectors that are already up to date.  (These
+    // sectors were not erased.)
+    if (manifest_is_present(&prog->manifest)
+        && !interval_set_contains(&prog->manifest.sectors_changed, sector_index(block->target_addr))) {
+        return true;
+    }
+
+    // There are a few target addresses that we require special handling.
+    switch (block->target_addr) {
+        case XIP_BASE:
+            // Ignore the stage2 bootloader block from the UF2 file.  We want to preserve our
+            // custom boot stage 2 (which we've already restored after erasing the sectors).
+            break;
+
+        case VECTOR_TABLE_ADDR:
+            // We detect if firmware has been installed by checking for a valid vector table.
+            // Delay writing the vector table until the end of the programming process.
+            memcpy(prog->vector_table, block->data, FLASH_PAGE_SIZE);
+            break;
+
+        default:
+            // Normal block: write to flash, erasing its sector first if needed.
+            erase_scheduler_prog(&scheduler, block->target_addr - XIP_BASE, block->data);
+            break;
+    }
+
+    // And continue processing blocks.
+    return true;
+}
+
+// During pass 0 (manifest), this callback is invoked for the first flash block in the UF2
+// file.  Any manifest blocks precede it, so we can stop reading here.
+static bool read_manifest_callback(prog_t* prog, const struct uf2_block* block) {
+    prog->is_done = true;
+    return true;
+}
+
+// Copy of a sector that a partial update writes in part.  (Static to keep it off the stack.)
+static uint8_t sector_copy[FLASH_SECTOR_SIZE];
+
+static bool is_blank(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns true if the UF2 file writes every page of the sectors it writes.
+static bool writes_whole_sectors(const prog_t* prog) {
+    return (uint32_t) prog->pages_written.num_elements
+        == (uint32_t) prog->sectors_erased.num_elements * (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE);
+}
+
+// Returns true if a page of the sector at 'offset' that the UF2 file does not write holds data.
+static bool has_unwritten_data(const prog_t* prog, uint32_t offset) {
+    for (uint32_t page = offset; page < offset + FLASH_SECTOR_SIZE; page += FLASH_PAGE_SIZE) {
+        if (!interval_set_contains(&prog->pages_written, page / FLASH_PAGE_SIZE)
+            && !is_blank(flash_contents(page), FLASH_PAGE_SIZE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// For a partial update, erases each sector in 'sectors' that holds data the UF2 file does not
+// overwrite, and programs that data back from RAM.  Pass 2 then programs the remaining pages
+// of these sectors without erasing them again.  The other sectors are added to 'to_plan', to
+// be erased as planned.  ('prog->pages_written' must hold the pages from pass 1.)
+static void preserve_unwritten_pages(const prog_t* prog, const interval_set_t* sectors, interval_set_t* to_plan) {
+    for (int i = 0; i < sectors->num_intervals; i++) {
+        const interval_t* interval = &sectors->intervals[i];
+
+        for (uint32_t sector = interval->start; sector < interval->end; sector++) {
+            const uint32_t offset = sector * FLASH_SECTOR_SIZE;
+
+            if (!has_unwritten_data(prog, offset)) {
+                interval_set_union(to_plan, sector, sector + 1);
+                continue;
+            }
+
+            memcpy(sector_copy, flash_contents(offset), FLASH_SECTOR_SIZE);
+            flash_erase(offset, FLASH_SECTOR_SIZE);
+            log_record.sectors_erased++;
+
+            for (uint32_t page = 0; page < FLASH_SECTOR_SIZE; page += FLASH_PAGE_SIZE) {
+                if (!interval_set_contains(&prog->pages_written, (offset + page) / FLASH_PAGE_SIZE)
+                    && !is_blank(&sector_copy[page], FLASH_PAGE_SIZE)) {
+                    flash_prog(offset + page, &sector_copy[page], FLASH_PAGE_SIZE);
+                }
+            }
+        }
+    }
+}
+
+#if BOOTLOADER_SCRUB_KB > 0
+// CRCs of the installed firmware, recorded after the image record (see 'scrub.h').  (Static to
+// keep it off the stack.)
+static scrub_table_t scrub_table;
+#endif
+
+// Returns the header of the installed firmware, or NULL if it is unknown.
+static const image_header_t* installed_image_header() {
+    return image_record_header((const image_record_t*) flash_contents(IMAGE_RECORD_OFFSET));
+}
+
+// Returns the number of bytes covered by the recorded scrub table, or 0 if there is none.
+static uint32_t installed_scrub_size() {
+#if BOOTLOADER_SCRUB_KB > 0
+    const scrub_table_t* table = (const scrub_table_t*) flash_contents(SCRUB_TABLE_OFFSET);
+    return scrub_table_is_valid(table) ? table->header.size : 0;
+#else
+    return 0;
+#endif
+}
+
+// Returns the scrub table to record for the firmware now installed, covering at least the
+// first 'min_size' bytes of flash and the sectors written by the UF2 file, or NULL if
+// scrubbing is disabled or there is nothing to cover.
+static const scrub_table_t* build_scrub_table(const prog_t* prog, uint32_t min_size) {
+#if BOOTLOADER_SCRUB_KB > 0
+    const interval_set_t* written = &prog->sectors_erased;
+    uint32_t size = written->num_intervals > 0
+        ? written->intervals[written->num_intervals - 1].end * FLASH_SECTOR_SIZE
+        : 0;
+
+    // An update skipped after reading the manifest has not read the flash blocks, but the
+    // manifest lists the sectors they write (in ascending order).
+    const manifest_t* manifest = &prog->manifest;
+    if (manifest_is_present(manifest) && manifest->num_received > 0) {
+        const uint32_t end = (manifest->entries[manifest->num_received - 1].sector + 1) * FLASH_SECTOR_SIZE;
+        size = end > size ? end : size;
+    }
+
+    size = min_size > size ? min_size : size;
+
+    if (size == 0) {
+        return NULL;
+    }
+
+    scrub_table_build(&scrub_table, flash_contents(0), size);
+    return &scrub_table;
+#else
+    return NULL;
+#endif
+}
+
+// Returns a copy of the recorded scrub table, or NULL if there is none.
+static const scrub_table_t* installed_scrub_table() {
+#if BOOTLOADER_SCRUB_KB > 0
+    memcpy(&scrub_table, flash_contents(SCRUB_TABLE_OFFSET), sizeof(scrub_table));
+    return scrub_table_is_valid(&scrub_table) ? &scrub_table : NULL;
+#else
+    return NULL;
+#endif
+}
+
+// Records the image header of the installed firmware at IMAGE_RECORD_OFFSET (see
+// 'image_header.h'), or erases the record if 'header' is NULL.  The scrub table
+// in the rest of the sector is written from 'table', or erased if 'table' is NULL.  The sector
+// is only erased and programmed if it changes.
+static void record_installed_image(const image_header_t* header, const scrub_table_t* table) {
+    const image_record_t record = image_record_make(header);
+    const uint8_t* current = flash_contents(IMAGE_RECORD_OFFSET);
+
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &record, sizeof(record));
+
+    const uint32_t table_size = table != NULL ? scrub_table_prog_size(table) : 0;
+
+    if (memcmp(current, page, sizeof(page)) == 0
+        && (table == NULL || memcmp(current + FLASH_PAGE_SIZE, table, table_size) == 0)
+        && is_blank(current + FLASH_PAGE_SIZE + table_size, SCRUB_TABLE_SIZE - table_size)) {
+        return;
+    }
+
+    if (!is_blank(current, FLASH_SECTOR_SIZE)) {
+        flash_erase(IMAGE_RECORD_OFFSET, FLASH_SECTOR_SIZE);
+    }
+
+    if (image_record_header(&record) != NULL) {
+        flash_prog(IMAGE_RECORD_OFFSET, page, sizeof(page));
+    }
+
+    if (table != NULL) {
+        flash_prog(SCRUB_TABLE_OFFSET, (const uint8_t*) table, table_size);
+    }
+}
+
+update_result_t update_firmware(const transport_t* transport, bool full_rewrite) {
+    update_result_t result = UPDATE_PROGRAMMED;
+    uint32_t scrub_size = 0;
+
+    // With a signing key, the image header of a UF2 file is trusted only once the file's
+    // signature is verified in pass 1.  (A manifest that matches the installed firmware skips
+    // pass 1, and with it the signature.)
+#ifdef BOOTLOADER_SIGNING_KEY
+    bool is_verified = false;
+#else
+    bool is_verified = true;
+#endif
+
+    prog_t prog;
+    prog_init(&prog);
+    profile_reset();
+
+#ifdef BOOTLOADER_ENCRYPTION_KEY
+    aes128_init(&device_key, encryption_key);
+    encryption_init(&prog.encryption, &device_key);
+#endif
+
+    // Apply the transport's tuning (if any) to this update.
+    const tuning_t* tuning = transport->tuning;
+    full_rewrite |= tuning != NULL && !tuning->skip_identical;
+    show_progress = tuning == NULL || tuning->led_progress;
+
+    update_log_init(&log_record);
+    log_record.baud_rate = tuning != NULL ? tuning->sd_baud_rate : transport->baud_rate;
+    current_phase = UPDATE_PHASE_MANIFEST;
+    phase_start_us = time_us_32();
+
+    // Learn the flash chip's size and erase instructions.  A PICO_FLASH_SIZE_BYTES larger than
+    // the chip must not let the UF2 file write past its end (and wrap around).
+    const flash_caps_t* caps = flash_detect();
+    prog_set_flash_size(&prog, caps->size_bytes);
+    LOG("[Boot3] Flash %06x: %u bytes, 32kB erase %02x, 64kB erase %02x, quad program %02x\r\n",
+        (unsigned) caps->jedec_id, (unsigned) caps->size_bytes,
+        caps->erase_32k_opcode, caps->erase_64k_opcode, caps->quad_program_opcode);
+
+    //
+    // Pass 0: Read the manifest (if present)
+    //
+
+    prog.accept_block = read_manifest_callback;
+    bool ok = transport->read_uf2(&prog, read_block);
+
+    // Reject firmware built for another board.
+    ok = ok && (!image_header_is_present(&prog.image_header)
+        || image_header_is_compatible(&prog.image_header, BOOTLOADER_BOARD_ID));
+
+    // Reject a malformed manifest (or image header) before reading the rest of the UF2 file.
+    if (!ok) {
+        result = UPDATE_INVALID_UF2;
+        goto done;
+    }
+
+    if (full_rewrite) {
+        // Rewrite every sector, skipping the comparisons with the current flash contents.
+        prog.is_different = true;
+        manifest_mark_all_changed(&prog.manifest);
+    } else if (manifest_is_present(&prog.manifest)) {
+        // Checksum the sectors listed by the manifest to find those that need to be updated.
+        // If none differ, we can skip reading the rest of the UF2 file.
+        prog.is_different = manifest_find_changed(&prog.manifest, flash_contents(0)) > 0;
+
+        if (!prog.is_different) {
+            diag(DIAG_SKIPPED_PROGRAMMING);
+            result = UPDATE_SKIPPED;
+            goto done;
+        }
+    }
+
+    //
+    // Pass 1: Validate the UF2 file
+    //
+
+    enter_phase(UPDATE_PHASE_VALIDATE);
+    prog_restart(&prog);
+    prog.accept_block = validate_uf2_callback;
+    PASS_BEGIN(pass1_start);
+    ok = transport->read_uf2(&prog, read_block);
+    PASS_END(1, &prog, pass1_start);
+
+    // Ensure that the entire program was received.
+    ok &= prog_is_complete(&prog);
+
+    // Ensure that the program contains a valid vector table.  (A partial update leaves the
+    // installed firmware's vector table in place.)
+    ok &= (prog.has_vector_table || prog.is_partial);
+
+    // Ensure that the manifest (if any) matches the UF2 file and lists exactly the
+    // sectors written by it.
+    if (manifest_is_present(&prog.manifest)) {
+        ok &= manifest_verify_finish(&prog.manifest);
+        ok &= (prog.manifest.num_entries == (uint32_t) prog.sectors_erased.num_elements);
+
+        // The manifest's CRCs assume that the pages the UF2 file does not write are erased,
+        // which a partial update does not do.
+        ok &= !prog.is_partial || writes_whole_sectors(&prog);
+    }
+
+#ifdef BOOTLOADER_SIGNING_KEY
+    // Ensure that the UF2 file is signed by the holder of our signing key.
+    ok = ok && signature_verify(&prog.signature, signing_key);
+    is_verified = ok;
+#endif
+
+    if (!ok) {
+        result = UPDATE_INVALID_UF2;
+        goto done;
+    }
+
+    if (!prog.is_different) {
+        diag(DIAG_SKIPPED_PROGRAMMING);
+        result = UPDATE_SKIPPED;
+        goto done;
+    }
+
+    //
+    // Pass 2: Write the UF2 file to flash
+    //
+
+    enter_phase(UPDATE_PHASE_PREPARE);
+
+    // Because there is a valid vector table in the UF2 file, we can assume
+    // that sector zero will be erased.  (A partial update never writes it.)
+    assert(prog.is_partial || prog.sectors_erased.num_intervals > 0);
+    assert(prog.is_partial || prog.sectors_erased.intervals[0].start == 0);
+
+    // Backup stage 2 bootloader.
+    uint8_t boot2_backup[FLASH_PAGE_SIZE];
+    memcpy(boot2_backup, flash_contents(0), FLASH_PAGE_SIZE);
+
+    // Erase sectors written by the UF2 file as they are reached.  If the UF2 file has a
+    // manifest, we only need to erase those sectors that changed.
+    const interval_set_t* sectors_to_erase = manifest_is_present(&prog.manifest)
+        ? &prog.manifest.sectors_changed
+        : &prog.sectors_erased;
+
+    const uint32_t area_sectors = (prog.area_end - PROG_AREA_BEGIN) / FLASH_SECTOR_SIZE;
+    erase_plan_find_blank(blank_sectors, sectors_to_erase, area_sectors);
+
+#if BOOTLOADER_ROLLBACK_SIZE > 0
+    // Save the sectors we are about to overwrite, so that the installed firmware can be
+    // restored if the new firmware fails to start (see 'rollback.h').  If the program area
+    // does not hold valid firmware, there is nothing worth restoring.
+    if (check_vector_table((const volatile uint32_t*) flash_contents(VECTOR_TABLE_ADDR - XIP_BASE))) {
+        if (!rollback_save(sectors_to_erase, blank_sectors, area_sectors, caps)) {
+            LOG("[Boot3] Rollback not saved; updating without rollback\r\n");
+        }
+    } else {
+        rollback_discard();
+    }
+#endif
+
+    // A partial update preserves the pages of partly written sectors that it does not write.
+    // Those sectors are rewritten now, and left out of the erase plan.
+    interval_set_t partial_sectors;
+    interval_set_init(&partial_sectors);
+
+    if (prog.is_partial) {
+        preserve_unwritten_pages(&prog, sectors_to_erase, &partial_sectors);
+        sectors_to_erase = &partial_sectors;
+    }
+
+    // Choose the cheapest mix of 4kB, 32kB and 64kB erases, skipping sectors that are already
+    // blank.  Nothing past the end of the program area is erased.
+    erase_plan_t plan;
+    erase_plan_init(&plan);
+    erase_plan_build(&plan, sectors_to_erase, blank_sectors, area_sectors, caps);
+    LOG("[Boot3] Erase plan: %d erases, %u ms\r\n", plan.num_erases, (unsigned) plan.cost_ms);
+
+    for (int i = 0; i < plan.num_erases; i++) {
+        log_record.sectors_erased += plan.erases[i].end - plan.erases[i].start;
+    }
+
+    // Forget the version of the installed firmware and its scrub table until the update
+    // completes.  A partial update does not change the version, and its table keeps covering
+    // the sectors that the previous one did.
+    if (prog.is_partial) {
+        scrub_size = installed_scrub_size();
+        record_installed_image(installed_image_header(), NULL);
+    } else {
+        record_installed_image(NULL, NULL);
+    }
+
+    // Erases run in the background while the next blocks are read, if the device supports it
+    // and the transport itself does not read from flash.
+    erase_scheduler_init(&scheduler, &plan, FLASH_ERASE_IS_ASYNC && !transport->reads_flash);
+
+    // Nothing may run from flash during a background erase, including the alarm playing an
+    // LED pattern (e.g., DIAG_NO_FIRMWARE), which blinking progress would also stop.
+    diag_stop();
+
+    if (show_progress) {
+        led_on();
+    }
+
+    // To improve the odds of recovery in case programming is interrupted, we
+    // restore our custom stage 2 bootloader first.  (If sector zero is unchanged, it
+    // is not erased.)
+    if (interval_set_contains(sectors_to_erase, 0)) {
+        erase_scheduler_prog(&scheduler, 0, boot2_backup);
+        erase_scheduler_flush(&scheduler);
+    }
+
+    // Reset our programming state and prepare for writing.
+    enter_phase(UPDATE_PHASE_WRITE);
+    prog_restart(&prog);
+    prog.accept_block = write_uf2_callback;
+
+    PASS_BEGIN(pass2_start);
+    ok &= transport->read_uf2(&prog, read_block);
+
+    // Wait for the last erase before anything runs from flash again.
+    erase_scheduler_flush(&scheduler);
+    PASS_END(2, &prog, pass2_start);
+    enter_phase(UPDATE_PHASE_FINISH);
+
+#ifdef BOOTLOADER_SIGNING_KEY
+    // Ensure that we wrote the same image that we verified.  If the UF2 file changed
+    // between passes, leave the vector table unwritten so the firmware does not run.
+    ok = ok && signature_matches(&prog.signature);
+#endif
+
+    // Program any pages still waiting for an erase.
+    if (ok) {
+        erase_scheduler_finish(&scheduler);
+    }
+
+    erase_scheduler_free(&scheduler);
+    erase_plan_free(&plan);
+    interval_set_free(&partial_sectors);
+
+    // A page that did not read back as written fails the update (see 'flash_prog()').
+    ok = ok && flash_prog_ok();
+
+    if (!ok) {
+        result = UPDATE_FLASH_FAILED;
+        goto done;
+    }
+
+    // Programming is successful.  The only thing left to do is to write the vector table
+    // to flash.  (A partial update keeps the installed one.)
+    if (!prog.is_partial) {
+        flash_prog(VECTOR_TABLE_ADDR - XIP_BASE, prog.vector_table, FLASH_PAGE_SIZE);
+    }
+
+done:
+    enter_phase(UPDATE_PHASE_FINISH);
+
+    if (ok) {
+        // Record the version of the firmware now installed (a partial update keeps the
+        // version), along with the CRCs for scrubbing it.
+        if (result == UPDATE_PROGRAMMED) {
+            const image_header_t* header = prog.is_partial ? installed_image_header() : &prog.image_header;
+            record_installed_image(header, build_scrub_table(&prog, scrub_size));
+        } else if (!prog.is_partial && is_verified) {
+            // The installed firmware matches the UF2 file.  If it has no scrub table (e.g.,
+            // it was installed before scrubbing was enabled), pass 1 found its sectors.
+            // (An unverified file must not change the recorded version, e.g. to one that no
+            // image in the firmware directory can replace.)
+            const scrub_table_t* table = installed_scrub_table();
+            record_installed_image(&prog.image_header, table != NULL ? table : build_scrub_table(&prog, 0));
+        }
+
+        // Finally, remove the UF2 file to prevent reprogramming on next boot.
+        if (!transport->remove_uf2()) {
+            diag(DIAG_DELETE_FAILED);
+        }
+    }
+
+    LOG("[Boot3] %s: result %u, %u blocks\r\n", transport->name, (unsigned) result, (unsigned) prog.num_blocks);
+
+    // Append a record of the update to the transport's log (e.g., on the SD card).  This is
+    // a single write after the flash work is done, so it does not delay the update.
+    if (transport->append_log != NULL) {
+        enter_phase(UPDATE_PHASE_FINISH);
+        log_record.image_version = image_header_is_present(&prog.image_header) ? prog.image_header.image_version : 0;
+        log_record.image_size = prog.num_blocks * FLASH_PAGE_SIZE;
+        log_record.blocks_accepted = prog.num_blocks_accepted;
+        log_record.result = (uint8_t) result;
+        update_log_seal(&log_record);
+
+        if (!transport->append_log(&log_record, sizeof(log_record))) {
+            LOG("[Boot3] Update log not written\r\n");
+        }
+    }
+
+    prog_free(&prog);
+    led_off();
+
+    // Report per-operation timings (if BOOTLOADER_USE_PROFILE is enabled).
+    profile_dump();
+
+    return result;
+}
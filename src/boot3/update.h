@@ -0,0 +1,34 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+
+// Project
+#include "transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum update_result_s {
+    UPDATE_PROGRAMMED = 0,      // The firmware was written to flash
+    UPDATE_SKIPPED = 1,         // Flash already contains the firmware
+    UPDATE_INVALID_UF2 = 2,     // The UF2 file was rejected before flash was modified
+    UPDATE_FLASH_FAILED = 3,    // Reading the UF2 file failed after flash was erased
+} update_result_t;
+
+// Validates the firmware file from the given transport and writes it to flash (if different).
+// On success, the firmware file is removed.
+//
+// If 'full_rewrite' is true, every sector written by the firmware file is erased and
+// reprogrammed, even if flash already contains the firmware.
+update_result_t update_firmware(const transport_t* transport, bool full_rewrite);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
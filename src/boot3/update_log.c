@@ -0,0 +1,28 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <stddef.h>
+#include <string.h>
+
+// Project
+#include "crc32.h"
+#include "update_log.h"
+
+// 'scripts/update_log.py' decodes the record at these offsets.
+_Static_assert(offsetof(update_log_record_t, phase_us) == 32, "update_log_record_t layout changed");
+_Static_assert(offsetof(update_log_record_t, crc) == 56, "update_log_record_t layout changed");
+_Static_assert(sizeof(update_log_record_t) == 60, "update_log_record_t layout changed");
+
+void update_log_init(update_log_record_t* record) {
+    memset(record, 0, sizeof(update_log_record_t));
+    record->magic = UPDATE_LOG_MAGIC;
+    record->version = UPDATE_LOG_VERSION;
+    record->size = sizeof(update_log_record_t);
+}
+
+void update_log_seal(update_log_record_t* record) {
+    record->crc = crc32_update(0, record, offsetof(update_log_record_t, crc));
+}
@@ -0,0 +1,59 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// After each update attempt, 'update_firmware()' appends one update_log_record_t to the
+// transport's log (if it keeps one), e.g., BOOTLOADER_UPDATE_LOG on the SD card.  The record
+// is written in a single append once the flash work is done, so logging does not slow the
+// update itself.  Decode collected logs with 'scripts/update_log.py'.
+//
+// Records are little-endian.  A parser skips 'size' bytes per record, so later versions may
+// append fields.
+#define UPDATE_LOG_MAGIC    0x474C5542  // "BULG" (little-endian)
+#define UPDATE_LOG_VERSION  1
+
+// Phases of an update, in order.  The order must match the names in 'scripts/update_log.py'.
+typedef enum update_log_phase_s {
+    UPDATE_PHASE_MANIFEST = 0,      // Pass 0: Read the manifest and compare checksums
+    UPDATE_PHASE_VALIDATE = 1,      // Pass 1: Validate the UF2 file
+    UPDATE_PHASE_PREPARE = 2,       // Plan erases (and save the rollback slot)
+    UPDATE_PHASE_WRITE = 3,         // Pass 2: Write the UF2 file to flash
+    UPDATE_PHASE_FINISH = 4,        // Remaining erases, vector table, record and file removal
+    UPDATE_LOG_NUM_PHASES
+} update_log_phase_t;
+
+typedef struct {
+    uint32_t magic;                                 // UPDATE_LOG_MAGIC
+    uint16_t version;                               // UPDATE_LOG_VERSION
+    uint16_t size;                                  // Size of the record in bytes
+    uint32_t image_version;                         // From the image header, or 0 if none
+    uint32_t image_size;                            // Bytes of flash covered by the UF2 file's blocks
+    uint32_t blocks_accepted;                       // Blocks accepted by the last pass
+    uint32_t sectors_erased;                        // 4kB sectors erased (including block erases)
+    uint32_t bytes_read;                            // UF2 bytes read from the transport, all passes
+    uint32_t baud_rate;                             // Transport's link rate (e.g., SD card SPI clock)
+    uint32_t phase_us[UPDATE_LOG_NUM_PHASES];       // Time spent in each phase
+    uint8_t result;                                 // update_result_t
+    uint8_t reserved[3];                            // 0
+    uint32_t crc;                                   // CRC-32 of the preceding bytes
+} update_log_record_t;
+
+// Clears the record and sets its magic, version and size.
+void update_log_init(update_log_record_t* record);
+
+// Sets the record's CRC.  Called once the record is complete.
+void update_log_seal(update_log_record_t* record);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -3,6 +3,7 @@
  * SPDX-License-Identifier: 0BSD
  */
 
+#include "prog.h"
 #include "vector_table.h"
 
 // Points to the start of the main program's vector table in flash memory (0x10000100).
@@ -28,8 +29,8 @@ bool check_vector_table(const volatile uint32_t* vt) {
     // The stage 2 bootloader & vector table occupy the first 0x1C0 bytes of flash.
     const uint32_t pc_min = VECTOR_TABLE_ADDR + VECTOR_TABLE_SIZE;
 
-    // Our stage 3 bootloader occupies the top 'BOOTLOADER_SIZE' bytes of flash.
-    const uint32_t pc_max = XIP_BASE + PICO_FLASH_SIZE_BYTES - BOOTLOADER_SIZE;
+    // Our stage 3 bootloader (and staging area, if any) occupy the top of flash.
+    const uint32_t pc_max = PROG_AREA_END;
     
     // The entry point of the program (pc) must be between.
     ok &= (pc_min <= pc) && (pc < pc_max);
@@ -20,3 +20,7 @@ extern const volatile uint32_t* vector_table;
 #define VECTOR_TABLE_PC_OFFSET 1
 
 bool check_vector_table(const volatile uint32_t* vt);
+
+// Sets VTOR to the main program's vector table, loads its initial stack pointer and jumps
+// to its reset handler.  (See 'vector_into_flash.S'.)
+void vector_into_flash(uint32_t);
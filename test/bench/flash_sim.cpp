@@ -0,0 +1,143 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <algorithm>
+
+// Project
+#include "flash.h"
+#include "flash_sim.h"
+#include "prog.h"
+#include "sim_clock.h"
+
+static constexpr uint64_t SECTOR_ERASE_NS = 45000000;   // tSE
+static constexpr uint64_t BLOCK32_ERASE_NS = 120000000; // tBE1
+static constexpr uint64_t BLOCK_ERASE_NS = 150000000;   // tBE2
+static constexpr uint64_t PAGE_PROGRAM_NS = 400000;     // tPP
+
+static std::vector<uint8_t> flash(PICO_FLASH_SIZE_BYTES, 0xFF);
+static FlashSimStats stats;
+static uint64_t busy_until_ns = 0;     // End of the erase in progress (if any)
+static flash_caps_t caps;
+static bool caps_valid = false;
+
+void flash_sim_reset(const std::vector<uint8_t>& contents) {
+    flash = contents;
+    flash.resize(PICO_FLASH_SIZE_BYTES, 0xFF);
+    stats = FlashSimStats();
+    busy_until_ns = 0;
+    caps_valid = false;
+}
+
+const flash_caps_t* flash_detect() {
+    flash_caps_init(&caps, PICO_FLASH_SIZE_BYTES);
+    caps.jedec_id = 0xEF4015;
+    caps.has_sfdp = true;
+    caps.erase_32k_opcode = 0x52;
+    caps.quad_program_opcode = FLASH_QUAD_PAGE_PROGRAM;
+    caps_valid = true;
+    return &caps;
+}
+
+const std::vector<uint8_t>& flash_sim_contents() { return flash; }
+const FlashSimStats& flash_sim_stats() { return stats; }
+
+// The bootloader must never modify itself.  (It only erases the staging area's header and
+// rewrites the installed image record and scrub table in the last sector.)
+static bool in_prog_area(uint32_t flash_offs, size_t count) {
+    return flash_offs + count <= PROG_AREA_SIZE + BOOTLOADER_ROLLBACK_SIZE + BOOTLOADER_STAGING_SIZE
+        || (flash_offs >= IMAGE_RECORD_OFFSET && flash_offs + count <= IMAGE_RECORD_OFFSET + FLASH_SECTOR_SIZE);
+}
+
+static bool is_busy() {
+    return sim_clock_now_ns() < busy_until_ns;
+}
+
+// Erases the range and returns the time the flash is busy.
+static uint64_t erase(uint32_t flash_offs, size_t count) {
+    if (flash_offs % FLASH_SECTOR_SIZE != 0 || count % FLASH_SECTOR_SIZE != 0 || !in_prog_area(flash_offs, count)) {
+        stats.violations++;
+        return 0;
+    }
+
+    uint64_t time_ns = 0;
+
+    while (count > 0) {
+        uint32_t size = FLASH_SECTOR_SIZE;
+        if (caps_valid) {
+            size = flash_caps_erase_size(&caps, flash_offs, count);
+        } else if (flash_offs % FLASH_BLOCK_SIZE == 0 && count >= FLASH_BLOCK_SIZE) {
+            size = FLASH_BLOCK_SIZE;
+        }
+
+        if (size == FLASH_BLOCK_SIZE) {
+            stats.block_erases++;
+            time_ns += BLOCK_ERASE_NS;
+        } else if (size == FLASH_BLOCK_SIZE / 2) {
+            stats.block32_erases++;
+            time_ns += BLOCK32_ERASE_NS;
+        } else {
+            stats.sector_erases++;
+            time_ns += SECTOR_ERASE_NS;
+        }
+
+        std::fill_n(flash.begin() + flash_offs, size, 0xFF);
+        stats.bytes_erased += size;
+        flash_offs += size;
+        count -= size;
+    }
+
+    stats.time_ns += time_ns;
+    return time_ns;
+}
+
+void flash_erase(uint32_t flash_offs, size_t count) {
+    flash_erase_wait();
+    sim_clock_advance(erase(flash_offs, count));
+}
+
+void flash_erase_start(uint32_t flash_offs, size_t count) {
+    flash_erase_wait();
+    busy_until_ns = sim_clock_now_ns() + erase(flash_offs, count);
+}
+
+bool flash_erase_busy() {
+    return is_busy();
+}
+
+void flash_erase_wait() {
+    sim_clock_wait_until(busy_until_ns);
+}
+
+void flash_prog(uint32_t flash_offs, const uint8_t* data, size_t count) {
+    // Programming while an erase is in progress is a violation (the real flash would ignore it).
+    if (is_busy() || flash_offs % FLASH_PAGE_SIZE != 0 || count % FLASH_PAGE_SIZE != 0 || !in_prog_area(flash_offs, count)) {
+        stats.violations++;
+        return;
+    }
+
+    // Programming can only clear bits.
+    for (size_t i = 0; i < count; i++) {
+        uint8_t& byte = flash[flash_offs + i];
+        stats.violations += (byte & data[i]) != data[i];
+        byte &= data[i];
+    }
+
+    const uint64_t time_ns = PAGE_PROGRAM_NS * (count / FLASH_PAGE_SIZE);
+    stats.bytes_programmed += count;
+    stats.time_ns += time_ns;
+    sim_clock_advance(time_ns);
+}
+
+// Programming always succeeds, and a failure is counted as a violation above.
+bool flash_prog_ok() {
+    return true;
+}
+
+const uint8_t* flash_contents(uint32_t flash_offs) {
+    // Flash cannot be read (via XIP) while an erase is in progress.
+    stats.violations += is_busy();
+    return flash.data() + flash_offs;
+}
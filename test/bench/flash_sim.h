@@ -0,0 +1,37 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <cstdint>
+#include <vector>
+
+// Simulated NOR flash that implements 'flash.h' for host builds.  Like 'flash.c', erases use
+// the largest blocks reported by 'flash_detect()' (64kB, 32kB or 4kB), or the bootrom's 64kB
+// block / 4kB sector split before detection.  Capabilities and durations are the typical
+// values from the W25Q16JV datasheet (the Raspberry Pi Pico's flash).
+//
+// As on the device with BOOTLOADER_HOT_PATH_IN_RAM, 'flash_erase_start()' returns immediately
+// and the erase completes in the background on the simulated clock ('sim_clock.h').  Reading
+// or programming flash before it completes counts as a violation.  ('update.c' only uses the
+// background erase in 'update_bench_async', which models BOOTLOADER_HOT_PATH_IN_RAM.)
+struct FlashSimStats {
+    uint32_t sector_erases = 0;     // 4kB erases
+    uint32_t block32_erases = 0;    // 32kB erases
+    uint32_t block_erases = 0;      // 64kB erases
+    uint64_t bytes_erased = 0;
+    uint64_t bytes_programmed = 0;
+    uint32_t violations = 0;        // Programming bytes that were not erased, or touching the bootloader
+    uint64_t time_ns = 0;           // Time spent erasing and programming (including in the background)
+
+    uint32_t erases() const { return sector_erases + block32_erases + block_erases; }
+};
+
+// Replaces the flash contents (PICO_FLASH_SIZE_BYTES) and clears the statistics.
+void flash_sim_reset(const std::vector<uint8_t>& contents);
+
+const std::vector<uint8_t>& flash_sim_contents();
+const FlashSimStats& flash_sim_stats();
@@ -0,0 +1,129 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <cstring>
+
+// Project
+#include "sd_sim.h"
+#include "sim_clock.h"
+#include "transport.h"
+
+static constexpr uint32_t SECTOR_SIZE = 512;
+static constexpr uint64_t SD_CLOCK_HZ = 12500000;       // BOOTLOADER_SD_BAUD_RATE
+
+// Bytes on the bus per single block command: command (6), N_CR + R1 (2), data token (1),
+// data and CRC (2).
+static constexpr uint64_t SECTOR_BUS_BYTES = 6 + 2 + 1 + SECTOR_SIZE + 2;
+static constexpr uint64_t READ_ACCESS_NS = 100000;      // Typical single block access time
+static constexpr uint64_t WRITE_BUSY_NS = 1000000;      // Typical single block programming time
+
+static std::vector<uint8_t> file;
+static bool file_exists = false;
+static std::vector<uint8_t> log;
+static SdSimStats stats;
+
+void sd_sim_insert(const std::vector<uint8_t>& new_file) {
+    file = new_file;
+    file_exists = !file.empty();
+    log.clear();
+    stats = SdSimStats();
+}
+
+const std::vector<uint8_t>& sd_sim_log() { return log; }
+
+bool sd_sim_file_exists() { return file_exists; }
+const SdSimStats& sd_sim_stats() { return stats; }
+
+static uint64_t bus_ns(uint64_t bytes) {
+    return bytes * 8 * 1000000000 / SD_CLOCK_HZ;
+}
+
+static void read_sector() {
+    stats.sectors_read++;
+    stats.bytes_read += SECTOR_SIZE;
+    const uint64_t time_ns = bus_ns(SECTOR_BUS_BYTES) + READ_ACCESS_NS;
+    stats.time_ns += time_ns;
+    sim_clock_advance(time_ns);
+}
+
+static void write_sector() {
+    stats.sectors_written++;
+    const uint64_t time_ns = bus_ns(SECTOR_BUS_BYTES + 1) + WRITE_BUSY_NS;
+    stats.time_ns += time_ns;
+    sim_clock_advance(time_ns);
+}
+
+static void sd_init() {}
+
+static bool sd_uf2_exists() {
+    return file_exists;
+}
+
+static bool sd_read_uf2(prog_t* prog, accept_block_cb_t callback) {
+    if (!file_exists) {
+        return false;
+    }
+
+    // Opening the file reads its directory entry.
+    stats.files_opened++;
+    read_sector();
+
+    bool ok = true;
+
+    for (size_t offset = 0; offset < file.size(); offset += sizeof(struct uf2_block)) {
+        // Like 'sd_transport.c', a truncated final block is an error.
+        if (file.size() - offset < sizeof(struct uf2_block)) {
+            ok = false;
+            break;
+        }
+
+        read_sector();
+
+        struct uf2_block block;
+        memcpy(&block, &file[offset], sizeof(block));
+
+        ok = callback(prog, &block);
+        if (!ok || prog->is_done) {
+            break;
+        }
+
+        // Like 'sd_transport.c', seek past the rest of a program for another family.  (FatFs
+        // follows the cluster chain in its cached FAT sector, so the seek is not charged.)
+        offset += prog_blocks_to_skip(&block) * sizeof(struct uf2_block);
+    }
+
+    return ok;
+}
+
+static bool sd_remove_uf2() {
+    // Unlinking updates the directory entry and the FAT.
+    write_sector();
+    write_sector();
+
+    file_exists = false;
+    return true;
+}
+
+static bool sd_append_log(const void* data, size_t size) {
+    // Appending writes the last data sector and updates the directory entry.  (The log is
+    // assumed to fit in its allocated cluster.)
+    write_sector();
+    write_sector();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    log.insert(log.end(), bytes, bytes + size);
+    return true;
+}
+
+const transport_t sd_transport = {
+    .name = "SD card",
+    .baud_rate = SD_CLOCK_HZ,
+    .init = sd_init,
+    .uf2_exists = sd_uf2_exists,
+    .read_uf2 = sd_read_uf2,
+    .remove_uf2 = sd_remove_uf2,
+    .append_log = sd_append_log,
+};
@@ -0,0 +1,32 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <cstdint>
+#include <vector>
+
+// Simulated SD card that implements 'sd_transport' ('transport.h') for host builds.  It models FatFs reading
+// the firmware file one 512 byte sector (i.e., one UF2 block) per 'f_read()', each of which
+// costs a CMD17 exchange on the SPI bus at BOOTLOADER_SD_BAUD_RATE plus the card's access
+// time.  (See 'test/sd_emulator.h' to run the real transport against an emulated card.)
+struct SdSimStats {
+    uint32_t files_opened = 0;
+    uint32_t sectors_read = 0;
+    uint32_t sectors_written = 0;
+    uint64_t bytes_read = 0;        // File and directory bytes read from the card
+    uint64_t time_ns = 0;           // Time spent on the SPI bus and waiting for the card
+};
+
+// Inserts a card with the given firmware file, or without one if 'file' is empty.  Clears
+// the statistics.
+void sd_sim_insert(const std::vector<uint8_t>& file);
+
+bool sd_sim_file_exists();
+const SdSimStats& sd_sim_stats();
+
+// Returns the update log appended since the card was inserted (see 'update_log.h').
+const std::vector<uint8_t>& sd_sim_log();
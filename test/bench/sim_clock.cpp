@@ -0,0 +1,27 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Project
+#include "sim_clock.h"
+
+static uint64_t now_ns = 0;
+
+void sim_clock_reset() { now_ns = 0; }
+uint64_t sim_clock_now_ns() { return now_ns; }
+
+void sim_clock_advance(uint64_t ns) {
+    now_ns += ns;
+}
+
+void sim_clock_wait_until(uint64_t time_ns) {
+    if (time_ns > now_ns) {
+        now_ns = time_ns;
+    }
+}
+
+// The bootloader times the phases of an update with the hardware timer ('update_log.h').
+extern "C" uint32_t time_us_32(void) {
+    return (uint32_t) (now_ns / 1000);
+}
@@ -0,0 +1,20 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <cstdint>
+
+// Simulated time shared by the flash and SD card models.  The SD card model advances the
+// clock as the bootloader waits on the SPI bus.  The flash model advances it when the
+// bootloader waits on the flash, so an erase running in the background while blocks are
+// read from the SD card only advances the clock by the time not hidden behind the reads.
+void sim_clock_reset();
+uint64_t sim_clock_now_ns();
+
+// Advances the clock by 'ns', or to 'time_ns' if it is later.
+void sim_clock_advance(uint64_t ns);
+void sim_clock_wait_until(uint64_t time_ns);
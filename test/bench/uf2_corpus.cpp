@@ -0,0 +1,167 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <algorithm>
+
+// Project
+#include "crc32.h"
+#include "prog.h"
+#include "uf2_corpus.h"
+#include "vector_table.h"
+
+// Deterministic xorshift32, so that the corpus (and therefore the baseline) is stable.
+class Prng {
+public:
+    explicit Prng(uint32_t seed) : state(seed != 0 ? seed : 1) {}
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+private:
+    uint32_t state;
+};
+
+static std::vector<uint8_t> random_page(Prng& prng) {
+    std::vector<uint8_t> page(FLASH_PAGE_SIZE);
+    for (uint8_t& byte : page) {
+        byte = (uint8_t) prng.next();
+    }
+    return page;
+}
+
+static void append(std::vector<uint8_t>& file, const struct uf2_block& block) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&block);
+    file.insert(file.end(), bytes, bytes + sizeof(block));
+}
+
+// Assigns 'block_no' / 'num_blocks' to a single family's blocks.
+static void number_blocks(std::vector<struct uf2_block>& blocks) {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].block_no = i;
+        blocks[i].num_blocks = blocks.size();
+    }
+}
+
+Uf2CorpusEntry uf2_corpus_build(const Uf2CorpusSpec& spec) {
+    Uf2CorpusEntry entry = { spec, ImageBuilder(), {}, 0 };
+    Prng prng(crc32_update(0, reinterpret_cast<const uint8_t*>(spec.name.data()), spec.name.size()));
+
+    const uint32_t image_start = spec.partial ? UF2_CORPUS_PARTIAL_OFFSET : 0;
+
+    for (uint32_t offset = image_start; offset < image_start + spec.image_size; offset += FLASH_PAGE_SIZE) {
+        const bool skipped = spec.layout == Uf2Layout::Sparse
+            && (offset / FLASH_SECTOR_SIZE) % 2 == 1;
+
+        if (!skipped) {
+            entry.image.pages[offset] = random_page(prng);
+        }
+    }
+
+    if (!spec.partial) {
+        // Point the vector table at the first instruction after it.
+        std::vector<uint8_t>& vt = entry.image.pages[VECTOR_TABLE_ADDR - XIP_BASE];
+        const uint32_t sp = SRAM_END;
+        const uint32_t pc = (VECTOR_TABLE_ADDR + VECTOR_TABLE_SIZE) | 1;
+        memcpy(&vt[VECTOR_TABLE_SP_OFFSET * sizeof(uint32_t)], &sp, sizeof(sp));
+        memcpy(&vt[VECTOR_TABLE_PC_OFFSET * sizeof(uint32_t)], &pc, sizeof(pc));
+    }
+
+    std::vector<struct uf2_block> flash_blocks = entry.image.flash_blocks();
+    if (spec.layout == Uf2Layout::Reverse) {
+        std::reverse(flash_blocks.begin(), flash_blocks.end());
+    }
+
+    std::vector<struct uf2_block> blocks;
+
+    if (spec.partial) {
+        struct uf2_block block = {};
+        block.magic_start0 = UF2_MAGIC_START0;
+        block.magic_start1 = UF2_MAGIC_START1;
+        block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT;
+        block.payload_size = sizeof(prog_partial_header_t);
+        block.file_size = RP2040_FAMILY_ID;
+        block.magic_end = UF2_MAGIC_END;
+
+        const prog_partial_header_t header = { PROG_PARTIAL_MAGIC, PROG_PARTIAL_VERSION, 0 };
+        memcpy(block.data, &header, sizeof(header));
+        blocks.push_back(block);
+    }
+
+    if (spec.manifest) {
+        // The image CRC covers the flash blocks in file order.
+        uint32_t image_crc = 0;
+        for (const struct uf2_block& block : flash_blocks) {
+            image_crc = crc32_update(image_crc, block.data, FLASH_PAGE_SIZE);
+        }
+
+        blocks = entry.image.manifest_blocks(image_crc);
+    }
+
+    blocks.insert(blocks.end(), flash_blocks.begin(), flash_blocks.end());
+
+    for (uint32_t i = 0; i < spec.metadata_blocks; i++) {
+        struct uf2_block block = {};
+        block.magic_start0 = UF2_MAGIC_START0;
+        block.magic_start1 = UF2_MAGIC_START1;
+        block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT;
+        block.target_addr = SRAM_BASE + i * FLASH_PAGE_SIZE;
+        block.payload_size = FLASH_PAGE_SIZE;
+        block.file_size = RP2040_FAMILY_ID;
+        block.magic_end = UF2_MAGIC_END;
+        blocks.push_back(block);
+    }
+
+    number_blocks(blocks);
+
+    if (spec.other_family) {
+        // A "universal" UF2 file carries the same program built for each family, one after
+        // the other.  Each family numbers its blocks independently.
+        std::vector<struct uf2_block> other = flash_blocks;
+        for (struct uf2_block& block : other) {
+            block.file_size = RP2350_ARM_S_FAMILY_ID;
+        }
+        number_blocks(other);
+
+        for (const struct uf2_block& block : other) {
+            append(entry.file, block);
+        }
+        entry.num_blocks += other.size();
+    }
+
+    for (const struct uf2_block& block : blocks) {
+        append(entry.file, block);
+    }
+    entry.num_blocks += blocks.size();
+
+    return entry;
+}
+
+std::vector<Uf2CorpusSpec> uf2_corpus_specs() {
+    const uint32_t small = 16 * 1024;
+    const uint32_t medium = 256 * 1024;
+    const uint32_t full = PROG_AREA_SIZE;
+    const uint32_t assets = 200 * 1024;
+
+    return {
+        { "dense-16k",              small,  Uf2Layout::Dense,   false,  false,  0,  false },
+        { "dense-256k",             medium, Uf2Layout::Dense,   false,  false,  0,  false },
+        { "dense-full",             full,   Uf2Layout::Dense,   false,  false,  0,  false },
+        { "sparse-256k",            medium, Uf2Layout::Sparse,  false,  false,  0,  false },
+        { "reverse-256k",           medium, Uf2Layout::Reverse, false,  false,  0,  false },
+        { "multi-family-256k",      medium, Uf2Layout::Dense,   false,  true,   0,  false },
+        { "metadata-256k",          medium, Uf2Layout::Dense,   false,  false,  8,  false },
+        { "manifest-16k",           small,  Uf2Layout::Dense,   true,   false,  0,  false },
+        { "manifest-256k",          medium, Uf2Layout::Dense,   true,   false,  0,  false },
+        { "manifest-full",          full,   Uf2Layout::Dense,   true,   false,  0,  false },
+        { "manifest-sparse-256k",   medium, Uf2Layout::Sparse,  true,   false,  0,  false },
+        { "manifest-reverse-256k",  medium, Uf2Layout::Reverse, true,   false,  0,  false },
+        { "partial-200k",           assets, Uf2Layout::Dense,   false,  false,  0,  true  },
+    };
+}
@@ -0,0 +1,50 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Project
+#include "image_builder.h"
+
+// Order of the flash blocks in the UF2 file.
+enum class Uf2Layout {
+    Dense,      // Every page, ascending addresses (as produced by 'elf2uf2' / 'picotool')
+    Sparse,     // Every other 4kB sector, ascending addresses
+    Reverse,    // Every page, descending addresses
+};
+
+struct Uf2CorpusSpec {
+    std::string name;
+    uint32_t image_size;            // Bytes of flash spanned by the image (starting at XIP_BASE)
+    Uf2Layout layout;
+    bool manifest;                  // Prepend manifest blocks ('scripts/uf2_manifest.py')
+    bool other_family;              // Precede the image with a copy for another family (RP2350)
+    uint32_t metadata_blocks;       // Append this many NOT_MAIN_FLASH blocks
+    bool partial;                   // Partial update of the region at UF2_CORPUS_PARTIAL_OFFSET
+};
+
+// Start of the region written by partial updates.  It is not sector aligned, so that the
+// update preserves the rest of the first and last sectors.
+#define UF2_CORPUS_PARTIAL_OFFSET (256 * 1024 + 1024)
+
+struct Uf2CorpusEntry {
+    Uf2CorpusSpec spec;
+    ImageBuilder image;             // The RP2040 pages written by the UF2 file
+    std::vector<uint8_t> file;      // The UF2 file
+    uint32_t num_blocks;            // Total UF2 blocks in the file (all families)
+};
+
+// Returns the synthetic image for the given spec.  Page contents are pseudo-random (seeded
+// by the spec name) and the vector table at 0x10000100 is valid.  (A partial update spans
+// 'image_size' bytes from UF2_CORPUS_PARTIAL_OFFSET instead, and has no vector table.)
+Uf2CorpusEntry uf2_corpus_build(const Uf2CorpusSpec& spec);
+
+// The standard corpus used by 'update_bench'.
+std::vector<Uf2CorpusSpec> uf2_corpus_specs();
@@ -0,0 +1,468 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// End-to-end update benchmark.  Runs 'update_firmware()' for each synthetic UF2 file in the
+// corpus ('uf2_corpus.cpp') against a simulated SD card ('sd_sim.cpp') and NOR flash
+// ('flash_sim.cpp'), and reports one CSV row per corpus file and scenario:
+//
+//     corpus        Name of the UF2 file
+//     scenario      'install' (blank flash, or other firmware for a partial update),
+//                   'reinstall' (identical firmware already in flash), 'patch' (installed
+//                   firmware differs by one page), 'rewrite' (reinstall with
+//                   BOOT_CONTROL_FORCE_FULL_REWRITE) or 'staged' (install from a dense image
+//                   in the flash staging area, for images that fit)
+//     result        'programmed', 'skipped', 'invalid' or 'failed'
+//     blocks        UF2 blocks in the file (all families), or pages in the staged image
+//     sd_bytes      Bytes read from the SD card
+//     prog_bytes    Bytes programmed to flash
+//     sd_per_prog   SD bytes read per byte programmed ('-' if nothing was programmed)
+//     erases        Number of 4kB sector and 64kB block erases
+//     erased_kb     Total kB erased
+//     time_ms       Modeled time from the start of the update to the first firmware
+//                   instruction (SD bus and card latency + flash erase/program time, less
+//                   the erase time hidden behind SD card reads)
+//     hidden_ms     Erase time that overlapped SD card reads ('sim_clock.h')
+//     blocks_per_s  'blocks' / 'time_ms'
+//
+// 'update_bench' models the default build, in which each erase completes before the next block
+// is read, so 'hidden_ms' is 0.  'update_bench_async' is built with BOOTLOADER_HOT_PATH_IN_RAM,
+// so erases run in the background while pass 2 reads on (see FLASH_ERASE_IS_ASYNC in
+// 'flash.h'), and the difference between the two baselines is the time saved.  The modeled
+// time excludes card initialization, the watchdog reset, XIP reads and the CPU time spent
+// checksumming, so it is a lower bound for the real device.  Because the models are
+// deterministic, the results only change when the update path changes.
+//
+// Usage:
+//
+//     update_bench [--output FILE] [--compare BASELINE] [--tolerance PCT] [--corpus DIR]
+//
+//     --output      Also write the CSV to FILE (e.g., to update 'test/bench/baseline.csv')
+//     --compare     Exit with status 1 if any cost increased by more than the tolerance
+//                   (default 5%) relative to BASELINE, or if a result changed
+//     --corpus      Write the generated UF2 files to DIR (e.g., to try them on a device)
+//
+// The benchmark exits with status 2 if an update leaves flash with unexpected contents, or if
+// the update log record appended to the SD card disagrees with the simulation.
+
+// Standard
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Project
+extern "C" {
+#include "diag.h"
+}
+#include "flash_sim.h"
+#include "boot_control.h"
+#include "crc32.h"
+#include "image_header.h"
+#include "sd_sim.h"
+#include "sim_clock.h"
+#include "staging.h"
+#include "transport.h"
+#include "uf2_corpus.h"
+#include "update.h"
+#include "update_log.h"
+
+// The LED and UART diagnostics are not part of the update cost.
+extern "C" {
+void led_on() {}
+void led_off() {}
+void led_toggle() {}
+void diag(diag_code_t code) { (void) code; }
+void diag_stop() {}
+}
+
+static const char* const columns[] = {
+    "corpus", "scenario", "result", "blocks", "sd_bytes", "prog_bytes", "sd_per_prog",
+    "erases", "erased_kb", "time_ms", "hidden_ms", "blocks_per_s",
+};
+
+// Columns compared against the baseline.  Lower is better.
+static const char* const costs[] = {
+    "sd_bytes", "prog_bytes", "erases", "erased_kb", "time_ms",
+};
+
+typedef std::map<std::string, std::string> Row;
+
+enum class Scenario { Install, Reinstall, Patch, Rewrite, Staged };
+
+static const char* scenario_name(Scenario scenario) {
+    switch (scenario) {
+        case Scenario::Install: return "install";
+        case Scenario::Reinstall: return "reinstall";
+        case Scenario::Patch: return "patch";
+        case Scenario::Rewrite: return "rewrite";
+        case Scenario::Staged: return "staged";
+    }
+    return "?";
+}
+
+static const char* result_name(update_result_t result) {
+    switch (result) {
+        case UPDATE_PROGRAMMED: return "programmed";
+        case UPDATE_SKIPPED: return "skipped";
+        case UPDATE_INVALID_UF2: return "invalid";
+        case UPDATE_FLASH_FAILED: return "failed";
+    }
+    return "?";
+}
+
+// Our custom stage 2 bootloader and the bootloader itself, which the update must preserve.
+static void fill_reserved(std::vector<uint8_t>& flash) {
+    std::fill_n(flash.begin(), FLASH_PAGE_SIZE, 0xB2);
+    std::fill(flash.begin() + PROG_AREA_SIZE, flash.begin() + IMAGE_RECORD_OFFSET, 0xB3);
+}
+
+// The corpus images have no image header, so installed firmware is recorded with an empty one.
+static void record_installed(std::vector<uint8_t>& flash) {
+    const image_header_t none = {};
+    const image_record_t record = image_record_make(&none);
+    memcpy(&flash[IMAGE_RECORD_OFFSET], &record, sizeof(record));
+}
+
+// Returns the image as a dense binary, starting at XIP_BASE.
+static std::vector<uint8_t> dense_image(const Uf2CorpusEntry& entry) {
+    std::vector<uint8_t> binary = entry.image.flash();
+    binary.resize(entry.image.pages.rbegin()->first + FLASH_PAGE_SIZE);
+    return binary;
+}
+
+// A dense image only depends on the flash contents, so the 'staged' scenario is only run for
+// plain UF2 files (no manifest, metadata or other families) that fit the staging area.
+static bool is_staging_candidate(const Uf2CorpusEntry& entry) {
+    const Uf2CorpusSpec& spec = entry.spec;
+    const bool is_plain = spec.layout != Uf2Layout::Reverse && !spec.manifest && !spec.other_family
+        && spec.metadata_blocks == 0 && !spec.partial;
+
+    return is_plain && dense_image(entry).size() <= BOOTLOADER_STAGING_SIZE - BOOT_CONTROL_STAGING_DATA_OFFSET;
+}
+
+// Writes the image to the staging area, as the firmware would.
+static void stage(std::vector<uint8_t>& flash, const Uf2CorpusEntry& entry) {
+    const std::vector<uint8_t> binary = dense_image(entry);
+    const boot_control_staging_header_t header = boot_control_staging_header(BOOT_CONTROL_STAGING_DENSE, binary.data(), binary.size());
+
+    std::fill_n(flash.begin() + STAGING_OFFSET, BOOTLOADER_STAGING_SIZE, 0xFF);
+    memcpy(&flash[STAGING_OFFSET], &header, sizeof(header));
+    std::copy(binary.begin(), binary.end(), flash.begin() + STAGING_OFFSET + BOOT_CONTROL_STAGING_DATA_OFFSET);
+}
+
+// The firmware that a partial update changes, which spans the partial region.
+static const ImageBuilder& partial_base() {
+    static const Uf2CorpusEntry base = uf2_corpus_build(
+        { "partial-base", 512 * 1024, Uf2Layout::Dense, false, false, 0, false });
+    return base.image;
+}
+
+// Returns the flash contents once the image is installed.  A partial update only replaces
+// the pages it writes.
+static std::vector<uint8_t> installed_flash(const Uf2CorpusEntry& entry) {
+    if (!entry.spec.partial) {
+        return entry.image.flash();
+    }
+
+    std::vector<uint8_t> flash = partial_base().flash();
+    for (const auto& page : entry.image.pages) {
+        std::copy(page.second.begin(), page.second.end(), flash.begin() + page.first);
+    }
+    return flash;
+}
+
+// Returns the flash contents before the update.
+static std::vector<uint8_t> initial_flash(const Uf2CorpusEntry& entry, Scenario scenario) {
+    std::vector<uint8_t> flash(PICO_FLASH_SIZE_BYTES, 0xFF);
+
+    if (scenario != Scenario::Install && scenario != Scenario::Staged) {
+        flash = installed_flash(entry);
+        record_installed(flash);
+    } else if (entry.spec.partial) {
+        flash = partial_base().flash();
+        record_installed(flash);
+    }
+
+    if (scenario == Scenario::Patch) {
+        // Change the last page of the image, as a small code change would.
+        const uint32_t offset = entry.image.pages.rbegin()->first;
+        flash[offset] ^= 0xFF;
+    }
+
+    fill_reserved(flash);
+
+    if (scenario == Scenario::Staged) {
+        stage(flash, entry);
+    }
+
+    return flash;
+}
+
+// Returns the flash contents expected after a successful update.
+static std::vector<uint8_t> expected_flash(const Uf2CorpusEntry& entry, Scenario scenario) {
+    std::vector<uint8_t> flash = installed_flash(entry);
+    fill_reserved(flash);
+    record_installed(flash);
+
+    if (scenario == Scenario::Staged) {
+        // The staged image remains, but its header is erased.
+        stage(flash, entry);
+        std::fill_n(flash.begin() + STAGING_OFFSET, FLASH_SECTOR_SIZE, 0xFF);
+    }
+
+    return flash;
+}
+
+// Returns true if the SD card's update log holds one record that matches the simulation.
+static bool check_log(update_result_t result, const SdSimStats& sd) {
+    const std::vector<uint8_t>& log = sd_sim_log();
+    if (log.size() != sizeof(update_log_record_t)) {
+        return false;
+    }
+
+    update_log_record_t record;
+    memcpy(&record, log.data(), sizeof(record));
+
+    uint64_t total_us = 0;
+    for (uint32_t us : record.phase_us) {
+        total_us += us;
+    }
+
+    // Opening the firmware file reads its directory entry, which is not part of the UF2 file.
+    return record.magic == UPDATE_LOG_MAGIC
+        && record.result == result
+        && record.crc == crc32_update(0, &record, offsetof(update_log_record_t, crc))
+        && record.baud_rate == sd_transport.baud_rate
+        && record.bytes_read == sd.bytes_read - sd.files_opened * 512
+        && total_us <= sim_clock_now_ns() / 1000;
+}
+
+static std::string format(double value, int precision) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+    return buffer;
+}
+
+static Row run(const Uf2CorpusEntry& entry, Scenario scenario) {
+    const std::string label = entry.spec.name + "/" + scenario_name(scenario);
+
+    flash_sim_reset(initial_flash(entry, scenario));
+    sd_sim_insert(entry.file);
+    sim_clock_reset();
+
+    const update_result_t result = update_firmware(
+        scenario == Scenario::Staged ? &staging_transport : &sd_transport,
+        /* full_rewrite: */ scenario == Scenario::Rewrite);
+
+    const FlashSimStats& flash = flash_sim_stats();
+    const SdSimStats& sd = sd_sim_stats();
+
+    if (flash.violations != 0) {
+        fprintf(stderr, "%s: %u flash violations\n", label.c_str(), flash.violations);
+        exit(2);
+    }
+
+    if (result != UPDATE_INVALID_UF2 && flash_sim_contents() != expected_flash(entry, scenario)) {
+        fprintf(stderr, "%s: unexpected flash contents\n", label.c_str());
+        exit(2);
+    }
+
+    // Only the SD card keeps an update log.
+    if (scenario == Scenario::Staged ? !sd_sim_log().empty() : !check_log(result, sd)) {
+        fprintf(stderr, "%s: unexpected update log\n", label.c_str());
+        exit(2);
+    }
+
+    const double time_ms = sim_clock_now_ns() / 1e6;
+    const double hidden_ms = (flash.time_ns + sd.time_ns - sim_clock_now_ns()) / 1e6;
+
+    // Dense images are presented as one UF2 block per page.
+    const uint32_t blocks = scenario == Scenario::Staged
+        ? dense_image(entry).size() / FLASH_PAGE_SIZE
+        : entry.num_blocks;
+
+    Row row;
+    row["corpus"] = entry.spec.name;
+    row["scenario"] = scenario_name(scenario);
+    row["result"] = result_name(result);
+    row["blocks"] = std::to_string(blocks);
+    row["sd_bytes"] = std::to_string(sd.bytes_read);
+    row["prog_bytes"] = std::to_string(flash.bytes_programmed);
+    row["sd_per_prog"] = flash.bytes_programmed > 0
+        ? format((double) sd.bytes_read / flash.bytes_programmed, 2)
+        : "-";
+    row["erases"] = std::to_string(flash.erases());
+    row["erased_kb"] = std::to_string(flash.bytes_erased / 1024);
+    row["time_ms"] = format(time_ms, 1);
+    row["hidden_ms"] = format(hidden_ms, 1);
+    row["blocks_per_s"] = format(blocks / (time_ms / 1000), 0);
+    return row;
+}
+
+static std::string to_csv(const std::vector<Row>& rows) {
+    std::string csv;
+
+    for (const char* column : columns) {
+        csv += (csv.empty() ? "" : ",") + std::string(column);
+    }
+    csv += "\n";
+
+    for (const Row& row : rows) {
+        std::string line;
+        for (const char* column : columns) {
+            line += (line.empty() ? "" : ",") + row.at(column);
+        }
+        csv += line + "\n";
+    }
+
+    return csv;
+}
+
+static bool read_csv(const std::string& path, std::vector<Row>& rows) {
+    std::ifstream file(path);
+    if (!file) { return false; }
+
+    std::string line;
+    std::vector<std::string> header;
+
+    while (std::getline(file, line)) {
+        if (line.empty()) { continue; }
+
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, ',')) {
+            fields.push_back(field);
+        }
+
+        if (header.empty()) {
+            header = fields;
+            continue;
+        }
+
+        Row row;
+        for (size_t i = 0; i < header.size() && i < fields.size(); i++) {
+            row[header[i]] = fields[i];
+        }
+        rows.push_back(row);
+    }
+
+    return !header.empty();
+}
+
+// Returns the number of regressions relative to the baseline.
+static int compare(const std::vector<Row>& rows, const std::vector<Row>& baseline, double tolerance) {
+    int regressions = 0;
+
+    for (const Row& expected : baseline) {
+        const std::string label = expected.at("corpus") + "/" + expected.at("scenario");
+
+        const Row* actual = nullptr;
+        for (const Row& row : rows) {
+            if (row.at("corpus") == expected.at("corpus") && row.at("scenario") == expected.at("scenario")) {
+                actual = &row;
+            }
+        }
+
+        if (actual == nullptr) {
+            printf("REGRESSION %s: missing\n", label.c_str());
+            regressions++;
+            continue;
+        }
+
+        if (actual->at("result") != expected.at("result")) {
+            printf("REGRESSION %s: result %s (was %s)\n", label.c_str(),
+                actual->at("result").c_str(), expected.at("result").c_str());
+            regressions++;
+        }
+
+        for (const char* cost : costs) {
+            const double was = atof(expected.at(cost).c_str());
+            const double now = atof(actual->at(cost).c_str());
+
+            if (now > was * (1 + tolerance / 100)) {
+                printf("REGRESSION %s: %s %s (was %s)\n", label.c_str(), cost,
+                    actual->at(cost).c_str(), expected.at(cost).c_str());
+                regressions++;
+            } else if (now < was) {
+                printf("improved   %s: %s %s (was %s)\n", label.c_str(), cost,
+                    actual->at(cost).c_str(), expected.at(cost).c_str());
+            }
+        }
+    }
+
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    std::string output;
+    std::string baseline_path;
+    std::string corpus_dir;
+    double tolerance = 5;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--output" && has_value) {
+            output = argv[++i];
+        } else if (arg == "--compare" && has_value) {
+            baseline_path = argv[++i];
+        } else if (arg == "--tolerance" && has_value) {
+            tolerance = atof(argv[++i]);
+        } else if (arg == "--corpus" && has_value) {
+            corpus_dir = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--output FILE] [--compare BASELINE] [--tolerance PCT] [--corpus DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Row> rows;
+
+    for (const Uf2CorpusSpec& spec : uf2_corpus_specs()) {
+        const Uf2CorpusEntry entry = uf2_corpus_build(spec);
+
+        if (!corpus_dir.empty()) {
+            std::ofstream file(corpus_dir + "/" + spec.name + ".uf2", std::ios::binary);
+            file.write(reinterpret_cast<const char*>(entry.file.data()), entry.file.size());
+        }
+
+        for (Scenario scenario : { Scenario::Install, Scenario::Reinstall, Scenario::Patch, Scenario::Rewrite }) {
+            rows.push_back(run(entry, scenario));
+        }
+
+        if (is_staging_candidate(entry)) {
+            rows.push_back(run(entry, Scenario::Staged));
+        }
+    }
+
+    const std::string csv = to_csv(rows);
+    fputs(csv.c_str(), stdout);
+
+    if (!output.empty()) {
+        std::ofstream file(output);
+        file << csv;
+    }
+
+    if (!baseline_path.empty()) {
+        std::vector<Row> baseline;
+        if (!read_csv(baseline_path, baseline)) {
+            fprintf(stderr, "unable to read '%s'\n", baseline_path.c_str());
+            return 2;
+        }
+
+        const int regressions = compare(rows, baseline, tolerance);
+        printf("%d regression(s) relative to '%s'\n", regressions, baseline_path.c_str());
+        return regressions > 0 ? 1 : 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// Standard
+#include <algorithm>
+#include <map>
+#include <string.h>
+#include <vector>
+
+// Project
+#include "crc32.h"
+#include "manifest.h"
+#include "prog.h"
+
+// ImageBuilder assembles a UF2 image from individual flash pages, along with the simulated
+// flash contents after programming.  It generates manifest blocks the same way as
+// 'scripts/uf2_manifest.py'.
+class ImageBuilder {
+public:
+    std::map<uint32_t, std::vector<uint8_t>> pages;    // Page payloads keyed by flash offset
+
+    void add_page(uint32_t offset, uint8_t fill) {
+        pages[offset] = std::vector<uint8_t>(FLASH_PAGE_SIZE, fill);
+    }
+
+    // Returns the flash contents after programming the image (all other bytes erased).
+    std::vector<uint8_t> flash() const {
+        std::vector<uint8_t> result(PICO_FLASH_SIZE_BYTES, 0xFF);
+        for (const auto& page : pages) {
+            std::copy(page.second.begin(), page.second.end(), result.begin() + page.first);
+        }
+        return result;
+    }
+
+    std::vector<manifest_entry_t> entries() const {
+        const std::vector<uint8_t> image = flash();
+        std::vector<manifest_entry_t> result;
+
+        for (const auto& page : pages) {
+            const uint32_t sector = page.first / FLASH_SECTOR_SIZE;
+            if (!result.empty() && result.back().sector == sector) { continue; }
+
+            const uint32_t skip = sector == 0 ? FLASH_PAGE_SIZE : 0;
+            const uint8_t* p = image.data() + sector * FLASH_SECTOR_SIZE + skip;
+            result.push_back({ sector, crc32_update(0, p, FLASH_SECTOR_SIZE - skip) });
+        }
+
+        return result;
+    }
+
+    uint32_t image_crc() const {
+        uint32_t crc = 0;
+        for (const auto& page : pages) {
+            crc = crc32_update(crc, page.second.data(), FLASH_PAGE_SIZE);
+        }
+        return crc;
+    }
+
+    std::vector<struct uf2_block> manifest_blocks() const {
+        return manifest_blocks(image_crc());
+    }
+
+    // As above, with the image CRC of flash blocks written in a different order.
+    std::vector<struct uf2_block> manifest_blocks(uint32_t image_crc) const {
+        const std::vector<manifest_entry_t> all = entries();
+        std::vector<struct uf2_block> result;
+
+        for (size_t first = 0; first < all.size(); first += MANIFEST_MAX_ENTRIES_PER_BLOCK) {
+            const size_t count = std::min(all.size() - first, MANIFEST_MAX_ENTRIES_PER_BLOCK);
+
+            struct uf2_block block = {};
+            block.magic_start0 = UF2_MAGIC_START0;
+            block.magic_start1 = UF2_MAGIC_START1;
+            block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT;
+            block.payload_size = sizeof(manifest_header_t) + count * sizeof(manifest_entry_t);
+            block.file_size = RP2040_FAMILY_ID;
+            block.magic_end = UF2_MAGIC_END;
+
+            manifest_header_t header = {};
+            header.magic = MANIFEST_MAGIC;
+            header.version = MANIFEST_VERSION;
+            header.num_entries = count;
+            header.first_entry = first;
+            header.total_entries = all.size();
+            header.image_crc = image_crc;
+
+            memcpy(block.data, &header, sizeof(header));
+            memcpy(block.data + sizeof(header), &all[first], count * sizeof(manifest_entry_t));
+            result.push_back(block);
+        }
+
+        return result;
+    }
+
+    std::vector<struct uf2_block> flash_blocks() const {
+        std::vector<struct uf2_block> result;
+
+        for (const auto& page : pages) {
+            struct uf2_block block = {};
+            block.magic_start0 = UF2_MAGIC_START0;
+            block.magic_start1 = UF2_MAGIC_START1;
+            block.flags = UF2_FLAG_FAMILY_ID_PRESENT;
+            block.target_addr = XIP_BASE + page.first;
+            block.payload_size = FLASH_PAGE_SIZE;
+            block.file_size = RP2040_FAMILY_ID;
+            block.magic_end = UF2_MAGIC_END;
+            memcpy(block.data, page.second.data(), FLASH_PAGE_SIZE);
+            result.push_back(block);
+        }
+
+        return result;
+    }
+};
@@ -0,0 +1,16 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// FatFs_SPI's 'spi_t' embeds DMA channel configurations.  The host build replaces the
+// DMA-driven 'spi.c' with 'test/sd_host.c', so only the type is required.
+
+#pragma once
+
+// Standard
+#include <stdint.h>
+
+typedef struct {
+    uint32_t ctrl;
+} dma_channel_config;
@@ -0,0 +1,40 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stddef.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <pico/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spi_inst spi_inst_t;
+
+#define spi0 ((spi_inst_t*) 0x4003c000)
+#define spi1 ((spi_inst_t*) 0x40040000)
+
+typedef enum { SPI_CPHA_0 = 0, SPI_CPHA_1 = 1 } spi_cpha_t;
+typedef enum { SPI_CPOL_0 = 0, SPI_CPOL_1 = 1 } spi_cpol_t;
+typedef enum { SPI_LSB_FIRST = 0, SPI_MSB_FIRST = 1 } spi_order_t;
+
+uint spi_init(spi_inst_t* spi, uint baudrate);
+void spi_deinit(spi_inst_t* spi);
+uint spi_set_baudrate(spi_inst_t* spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t* spi);
+void spi_set_format(spi_inst_t* spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+
+int spi_write_read_blocking(spi_inst_t* spi, const uint8_t* src, uint8_t* dst, size_t len);
+int spi_write_blocking(spi_inst_t* spi, const uint8_t* src, size_t len);
+int spi_read_blocking(spi_inst_t* spi, uint8_t repeated_tx_data, uint8_t* dst, size_t len);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,20 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Provided by the test.
+uint32_t time_us_32(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,29 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    volatile uint32_t scratch[8];
+} watchdog_hw_t;
+
+// Provided by the test.
+extern watchdog_hw_t* const watchdog_hw;
+
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms);
+
+static inline void tight_loop_contents(void) {}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
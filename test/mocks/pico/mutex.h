@@ -0,0 +1,29 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Host tests are single threaded, so mutexes only track whether they are held.
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    bool initialized;
+    bool locked;
+} mutex_t;
+
+static inline void mutex_init(mutex_t* mtx) { mtx->initialized = true; mtx->locked = false; }
+static inline bool mutex_is_initialized(mutex_t* mtx) { return mtx->initialized; }
+static inline void mutex_enter_blocking(mutex_t* mtx) { mtx->locked = true; }
+static inline void mutex_exit(mutex_t* mtx) { mtx->locked = false; }
+
+static inline bool mutex_try_enter(mutex_t* mtx, uint32_t* owner_out) {
+    (void) owner_out;
+    if (mtx->locked) { return false; }
+    mtx->locked = true;
+    return true;
+}
@@ -0,0 +1,42 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Host tests are single threaded, so semaphores only count permits.
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    int16_t permits;
+    int16_t max_permits;
+} semaphore_t;
+
+static inline void sem_init(semaphore_t* sem, int16_t initial_permits, int16_t max_permits) {
+    sem->permits = initial_permits;
+    sem->max_permits = max_permits;
+}
+
+static inline int sem_available(semaphore_t* sem) { return sem->permits; }
+static inline void sem_reset(semaphore_t* sem, int16_t permits) { sem->permits = permits; }
+
+static inline void sem_acquire_blocking(semaphore_t* sem) {
+    if (sem->permits > 0) { sem->permits--; }
+}
+
+static inline bool sem_acquire_timeout_ms(semaphore_t* sem, uint32_t timeout_ms) {
+    (void) timeout_ms;
+    if (sem->permits == 0) { return false; }
+    sem->permits--;
+    return true;
+}
+
+static inline bool sem_release(semaphore_t* sem) {
+    if (sem->permits == sem->max_permits) { return false; }
+    sem->permits++;
+    return true;
+}
@@ -0,0 +1,22 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Host stand-in for the Pico SDK's 'pico/stdlib.h', providing the subset used by
+// FatFs_SPI and 'sd_transport.c'.  Implemented in 'test/sd_host.c'.
+
+#pragma once
+
+// Pico SDK
+#include <pico.h>
+
+// Mocks
+#include <hardware/gpio.h>
+#include <pico/time.h>
+
+// glibc's '__CONCAT' does not expand its arguments like newlib's does, which the bootloader
+// relies on (e.g., '__CONCAT(spi, BOOTLOADER_SD_SPI)').
+#undef __CONCAT
+#define __CONCAT1(x, y) x ## y
+#define __CONCAT(x, y) __CONCAT1(x, y)
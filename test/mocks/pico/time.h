@@ -0,0 +1,66 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pico SDK
+#include <pico/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void busy_wait_us(uint64_t us);
+void busy_wait_us_32(uint32_t us);
+void busy_wait_ms(uint32_t ms);
+
+static inline absolute_time_t get_absolute_time(void) {
+    absolute_time_t t;
+    update_us_since_boot(&t, time_us_64());
+    return t;
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t) (to_us_since_boot(t) / 1000);
+}
+
+static inline absolute_time_t delayed_by_us(const absolute_time_t t, uint64_t us) {
+    absolute_time_t delayed;
+    update_us_since_boot(&delayed, to_us_since_boot(t) + us);
+    return delayed;
+}
+
+static inline absolute_time_t delayed_by_ms(const absolute_time_t t, uint32_t ms) {
+    return delayed_by_us(t, ms * 1000ull);
+}
+
+static inline absolute_time_t make_timeout_time_us(uint64_t us) {
+    return delayed_by_us(get_absolute_time(), us);
+}
+
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) {
+    return delayed_by_ms(get_absolute_time(), ms);
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+    return (int64_t) (to_us_since_boot(to) - to_us_since_boot(from));
+}
+
+static inline bool time_reached(absolute_time_t t) {
+    return time_us_64() >= to_us_since_boot(t);
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,394 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// Project
+#include "sd_emulator.h"
+
+// R1 flags
+static constexpr uint8_t R1_ILLEGAL_COMMAND = 0x04;
+static constexpr uint8_t R1_CRC_ERROR = 0x08;
+static constexpr uint8_t R1_ADDRESS_ERROR = 0x20;
+static constexpr uint8_t R1_PARAMETER_ERROR = 0x40;
+
+// Tokens
+static constexpr uint8_t TOKEN_START_BLOCK = 0xFE;
+static constexpr uint8_t TOKEN_START_BLOCK_MULTIPLE = 0xFC;
+static constexpr uint8_t TOKEN_STOP_TRAN = 0xFD;
+static constexpr uint8_t TOKEN_ERROR_OUT_OF_RANGE = 0x08;
+static constexpr uint8_t DATA_RESPONSE_ACCEPTED = 0x05;
+static constexpr uint8_t DATA_RESPONSE_CRC_ERROR = 0x0B;
+
+static constexpr uint32_t MAX_NCR = 8;
+
+uint32_t SdEmulator::Stats::total_commands() const {
+    uint32_t total = 0;
+    for (size_t i = 0; i < commands.size(); i++) {
+        total += commands[i] + app_commands[i];
+    }
+    return total;
+}
+
+SdEmulator::SdEmulator(std::vector<uint8_t> image)
+    : image_(std::move(image)) {
+    assert(!image_.empty() && image_.size() % (512 * 1024) == 0);
+}
+
+SdEmulator SdEmulator::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return SdEmulator(std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {}));
+}
+
+bool SdEmulator::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(image_.data()), image_.size());
+    return file.good();
+}
+
+uint8_t SdEmulator::crc7(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc <<= 1;
+            if ((byte ^ crc) & 0x80) {
+                crc ^= 0x09;
+            }
+            byte <<= 1;
+        }
+    }
+    return crc & 0x7F;
+}
+
+uint16_t SdEmulator::crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000)
+                ? (crc << 1) ^ 0x1021
+                : crc << 1;
+        }
+    }
+    return crc;
+}
+
+void SdEmulator::select(bool selected) {
+    if (selected_ && !selected) {
+        // Deselecting aborts a partially received command.
+        cmd_len_ = 0;
+    }
+    selected_ = selected;
+}
+
+uint32_t SdEmulator::latency_bytes(uint8_t cmd) const {
+    const uint64_t bits = (uint64_t) latency_us_[cmd] * clock_hz_;
+    return (uint32_t) ((bits + 8000000 - 1) / 8000000);
+}
+
+void SdEmulator::queue_fill(uint8_t value, uint32_t count) {
+    out_.insert(out_.end(), count, value);
+}
+
+// The command's latency as extra N_CR bytes before the response.
+uint32_t SdEmulator::ncr(uint8_t cmd) const {
+    return std::min(latency_bytes(cmd), MAX_NCR - 1);
+}
+
+// Queues N_CR (one fill byte plus 'delay'), followed by the response.
+void SdEmulator::respond(uint32_t delay, std::initializer_list<uint8_t> response) {
+    queue_fill(0xFF, 1 + delay);
+    out_.insert(out_.end(), response);
+}
+
+// Queues the access time, start block token, data and CRC.
+void SdEmulator::queue_data(uint8_t cmd, const uint8_t* data, size_t len) {
+    queue_fill(0xFF, latency_bytes(cmd));
+    out_.push_back(TOKEN_START_BLOCK);
+    out_.insert(out_.end(), data, data + len);
+
+    const uint16_t crc = crc16(data, len);
+    out_.push_back(crc >> 8);
+    out_.push_back(crc & 0xFF);
+}
+
+void SdEmulator::queue_read_block(uint8_t cmd, uint32_t block) {
+    if (block >= num_blocks()) {
+        queue_fill(0xFF, latency_bytes(cmd));
+        out_.push_back(TOKEN_ERROR_OUT_OF_RANGE);
+        mode_ = Mode::Command;
+        return;
+    }
+
+    queue_data(cmd, &image_[(size_t) block * block_size], block_size);
+    stats_.blocks_read++;
+}
+
+// Version 2.0 (SDHC/SDXC) CSD.  Capacity is (C_SIZE + 1) * 512kB.
+void SdEmulator::csd(uint8_t* csd) const {
+    const uint32_t c_size = num_blocks() / 1024 - 1;
+    const uint8_t value[15] = {
+        0x40,                   // CSD_STRUCTURE = 1
+        0x0E,                   // TAAC
+        0x00,                   // NSAC
+        0x32,                   // TRAN_SPEED = 25MHz
+        0x5B, 0x59,             // CCC, READ_BL_LEN = 9
+        0x00,                   // READ_BL_PARTIAL = 0, ..., DSR_IMP = 0
+        (uint8_t) ((c_size >> 16) & 0x3F),
+        (uint8_t) (c_size >> 8),
+        (uint8_t) c_size,
+        0x7F, 0x80,             // ERASE_BLK_EN = 1, SECTOR_SIZE = 0x7F
+        0x0A, 0x40,             // R2W_FACTOR = 2, WRITE_BL_LEN = 9
+        0x00,                   // FILE_FORMAT_GRP, COPY, PERM_WP, TMP_WP, FILE_FORMAT
+    };
+
+    memcpy(csd, value, sizeof(value));
+    csd[15] = (crc7(csd, 15) << 1) | 1;
+}
+
+uint8_t SdEmulator::transfer(uint8_t mosi) {
+    stats_.bytes_clocked++;
+    elapsed_ps_ += 8000000000000ull / clock_hz_;
+
+    // While deselected, DO is high impedance and pulled up.
+    if (!selected_) {
+        return 0xFF;
+    }
+
+    // The byte shifted out was determined before 'mosi' was shifted in.
+    if (out_.empty() && mode_ == Mode::ReadMultiple) {
+        queue_read_block(18, block_++);
+    }
+
+    uint8_t miso = 0xFF;
+    if (!out_.empty()) {
+        miso = out_.front();
+        out_.pop_front();
+    }
+
+    if (mode_ == Mode::WriteToken || mode_ == Mode::WriteData) {
+        receive_data(mosi);
+        return miso;
+    }
+
+    // Commands start with a '0' start bit followed by a '1' transmission bit.
+    if (cmd_len_ == 0 && (mosi & 0xC0) != 0x40) {
+        return miso;
+    }
+
+    cmd_[cmd_len_++] = mosi;
+    if (cmd_len_ == sizeof(cmd_)) {
+        cmd_len_ = 0;
+        execute();
+    }
+
+    return miso;
+}
+
+void SdEmulator::receive_data(uint8_t mosi) {
+    const uint8_t cmd = write_multiple_ ? 25 : 24;
+
+    if (mode_ == Mode::WriteToken) {
+        if (mosi == (write_multiple_ ? TOKEN_START_BLOCK_MULTIPLE : TOKEN_START_BLOCK)) {
+            write_buffer_.clear();
+            mode_ = Mode::WriteData;
+        } else if (write_multiple_ && mosi == TOKEN_STOP_TRAN) {
+            // One byte after the stop tran token, the card signals busy.
+            queue_fill(0xFF, 1);
+            queue_fill(0x00, std::max(1u, latency_bytes(cmd)));
+            mode_ = Mode::Command;
+        }
+        return;
+    }
+
+    // Data block followed by a 16-bit CRC.
+    write_buffer_.push_back(mosi);
+    if (write_buffer_.size() < block_size + 2) {
+        return;
+    }
+
+    const uint16_t crc = (write_buffer_[block_size] << 8) | write_buffer_[block_size + 1];
+    if (crc_enabled_ && crc != crc16(write_buffer_.data(), block_size)) {
+        stats_.crc_errors++;
+        out_.push_back(DATA_RESPONSE_CRC_ERROR);
+        mode_ = Mode::Command;
+        return;
+    }
+
+    // A real card reports writing past the end with CMD13.  We simply drop the block.
+    if (block_ < num_blocks()) {
+        std::copy_n(write_buffer_.begin(), block_size, &image_[(size_t) block_ * block_size]);
+        stats_.blocks_written++;
+    }
+
+    out_.push_back(DATA_RESPONSE_ACCEPTED);
+    queue_fill(0x00, std::max(1u, latency_bytes(cmd)));
+    block_++;
+    mode_ = write_multiple_ ? Mode::WriteToken : Mode::Command;
+}
+
+void SdEmulator::execute() {
+    const uint8_t cmd = cmd_[0] & 0x3F;
+    const uint32_t arg = (cmd_[1] << 24) | (cmd_[2] << 16) | (cmd_[3] << 8) | cmd_[4];
+    const bool is_app = app_cmd_;
+    app_cmd_ = false;
+
+    // CMD0 and CMD8 always carry a valid CRC.  Others are checked only if enabled by CMD59.
+    const bool crc_ok = (cmd_[5] >> 1) == crc7(cmd_, 5);
+
+    if (!spi_mode_) {
+        // Until the card receives CMD0 with CS asserted, it is in SD mode and ignores us.
+        if (cmd == 0 && crc_ok) {
+            spi_mode_ = true;
+        } else {
+            return;
+        }
+    }
+
+    // A new command aborts any response still being shifted out.
+    out_.clear();
+
+    (is_app ? stats_.app_commands : stats_.commands)[cmd]++;
+
+    if (!crc_ok && (cmd == 0 || cmd == 8 || crc_enabled_)) {
+        stats_.crc_errors++;
+        respond(ncr(cmd), { r1(R1_CRC_ERROR) });
+        return;
+    }
+
+    if (cmd == 12) {
+        // The byte following CMD12 is a stuff byte, then R1 and busy.
+        mode_ = Mode::Command;
+        queue_fill(0xFF, 1);
+        respond(ncr(cmd), { r1() });
+        queue_fill(0x00, std::max(1u, latency_bytes(cmd)));
+        return;
+    }
+
+    mode_ = Mode::Command;
+
+    if (is_app) {
+        switch (cmd) {
+            case 23:
+                respond(ncr(cmd), { r1() });
+                return;
+
+            case 41: {
+                if (!init_started_) {
+                    init_started_ = true;
+                    init_start_ = stats_.bytes_clocked;
+                }
+
+                if (stats_.bytes_clocked - init_start_ >= latency_bytes(41)) {
+                    idle_ = false;
+                }
+
+                respond(0, { r1() });
+                return;
+            }
+
+            default:
+                // Undefined application commands are interpreted as the regular command.
+                break;
+        }
+    }
+
+    // While initializing, only commands that participate in initialization are legal.
+    if (idle_ && !(cmd == 0 || cmd == 8 || cmd == 55 || cmd == 58 || cmd == 59)) {
+        respond(ncr(cmd), { r1(R1_ILLEGAL_COMMAND) });
+        return;
+    }
+
+    switch (cmd) {
+        case 0:
+            idle_ = true;
+            init_started_ = false;
+            crc_enabled_ = false;
+            respond(ncr(cmd), { r1() });
+            break;
+
+        case 8:
+            // Accept 2.7-3.6V and echo the check pattern.
+            respond(ncr(cmd), { r1(), 0x00, 0x00, (uint8_t) ((arg >> 8) & 0x0F), (uint8_t) arg });
+            break;
+
+        case 9: {
+            uint8_t value[16];
+            csd(value);
+            respond(0, { r1() });
+            queue_data(cmd, value, sizeof(value));
+            break;
+        }
+
+        case 10: {
+            uint8_t value[16] = { 0x03, 'S', 'D', 'E', 'M', 'U', 'L', 'A', 0x10, 0, 0, 0, 1, 0x01, 0x7A };
+            value[15] = (crc7(value, 15) << 1) | 1;
+            respond(0, { r1() });
+            queue_data(cmd, value, sizeof(value));
+            break;
+        }
+
+        case 13:
+            respond(ncr(cmd), { r1(), 0x00 });
+            break;
+
+        case 16:
+            respond(ncr(cmd), { r1(arg == block_size ? 0 : R1_PARAMETER_ERROR) });
+            break;
+
+        case 17:
+        case 18:
+            if (arg >= num_blocks()) {
+                respond(0, { r1(R1_ADDRESS_ERROR) });
+                break;
+            }
+
+            respond(0, { r1() });
+            queue_read_block(cmd, arg);
+            block_ = arg + 1;
+            if (cmd == 18) {
+                mode_ = Mode::ReadMultiple;
+            }
+            break;
+
+        case 24:
+        case 25:
+            if (arg >= num_blocks()) {
+                respond(0, { r1(R1_ADDRESS_ERROR) });
+                break;
+            }
+
+            respond(0, { r1() });
+            block_ = arg;
+            write_multiple_ = (cmd == 25);
+            mode_ = Mode::WriteToken;
+            break;
+
+        case 55:
+            app_cmd_ = true;
+            respond(ncr(cmd), { r1() });
+            break;
+
+        case 58:
+            // Power up status (once initialized) | CCS (SDHC), 2.7-3.6V.
+            respond(ncr(cmd), { r1(), (uint8_t) (idle_ ? 0x40 : 0xC0), 0xFF, 0x80, 0x00 });
+            break;
+
+        case 59:
+            crc_enabled_ = arg & 1;
+            respond(ncr(cmd), { r1() });
+            break;
+
+        default:
+            respond(ncr(cmd), { r1(R1_ILLEGAL_COMMAND) });
+            break;
+    }
+}
@@ -0,0 +1,136 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Emulates an SDHC card in SPI mode, backed by a disk image held in memory.  The card
+// exchanges one byte at a time with 'transfer()', as the SPI bus does.
+//
+// Supported commands:
+//
+//     CMD0   GO_IDLE_STATE         R1
+//     CMD8   SEND_IF_COND          R7
+//     CMD9   SEND_CSD              R1 + data block (16 bytes)
+//     CMD10  SEND_CID              R1 + data block (16 bytes)
+//     CMD12  STOP_TRANSMISSION     stuff byte + R1 + busy
+//     CMD13  SEND_STATUS           R2
+//     CMD16  SET_BLOCKLEN          R1 (only 512 is accepted)
+//     CMD17  READ_SINGLE_BLOCK     R1 + data block
+//     CMD18  READ_MULTIPLE_BLOCK   R1 + data blocks until CMD12
+//     CMD24  WRITE_BLOCK           R1, then data block -> data response + busy
+//     CMD25  WRITE_MULTIPLE_BLOCK  R1, then data blocks until stop token
+//     CMD55  APP_CMD               R1
+//     CMD58  READ_OCR              R3
+//     CMD59  CRC_ON_OFF            R1
+//     ACMD23 SET_WR_BLK_ERASE_COUNT R1
+//     ACMD41 SD_SEND_OP_COND       R1
+//
+// Anything else is answered with an 'illegal command' R1.
+class SdEmulator {
+public:
+    static constexpr uint32_t block_size = 512;
+
+    struct Stats {
+        std::array<uint32_t, 64> commands{};        // Commands received, by index
+        std::array<uint32_t, 64> app_commands{};    // Application commands received, by index
+        uint64_t bytes_clocked = 0;                 // Bytes exchanged on the bus (selected or not)
+        uint64_t blocks_read = 0;                   // Data blocks sent to the host
+        uint64_t blocks_written = 0;                // Data blocks written to the image
+        uint32_t crc_errors = 0;                    // Commands or data blocks rejected for a bad CRC
+
+        uint32_t total_commands() const;
+    };
+
+    // The image size must be a non-zero multiple of 512kB, which is the granularity of
+    // the capacity reported in the CSD.
+    explicit SdEmulator(std::vector<uint8_t> image);
+
+    // Loads/saves the image from/to a file (e.g., one created with 'mkfs.fat' and 'mcopy').
+    static SdEmulator load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    std::vector<uint8_t>& image() { return image_; }
+    uint32_t num_blocks() const { return image_.size() / block_size; }
+
+    // The SPI clock rate is used to convert latencies to byte times and to compute
+    // 'elapsed_us()'.  The card starts at the 400kHz identification rate.
+    void set_clock_hz(uint32_t hz) { clock_hz_ = hz; }
+
+    // Sets the latency of the given command (the same for CMDn and ACMDn), converted to byte
+    // times at the current clock rate:
+    //
+    //   - CMD9/10/17/18: access time before each data token
+    //   - CMD12/24/25:   busy time after the response (24/25: after each data block)
+    //   - ACMD41:        initialization time, measured from the first ACMD41
+    //   - others:        delay before R1, clamped to the maximum N_CR of 8 bytes
+    void set_latency_us(uint8_t cmd, uint32_t us) { latency_us_[cmd & 0x3F] = us; }
+
+    // Drives the chip select.  While deselected, the card ignores the bus and reads as 0xFF.
+    void select(bool selected);
+    bool is_selected() const { return selected_; }
+
+    // Exchanges one byte: shifts 'mosi' into the card and returns the byte shifted out.
+    uint8_t transfer(uint8_t mosi);
+
+    const Stats& stats() const { return stats_; }
+    void reset_stats() { stats_ = Stats(); elapsed_ps_ = 0; }
+
+    // Time spent clocking the bus at the rate(s) set with 'set_clock_hz()'.
+    uint64_t elapsed_us() const { return elapsed_ps_ / 1000000; }
+
+    static uint8_t crc7(const uint8_t* data, size_t len);
+    static uint16_t crc16(const uint8_t* data, size_t len);
+
+private:
+    enum class Mode {
+        Command,        // Parsing commands
+        ReadMultiple,   // Streaming blocks for CMD18 until CMD12
+        WriteToken,     // Waiting for a start block (or stop tran) token for CMD24/25
+        WriteData,      // Receiving a data block for CMD24/25
+    };
+
+    void execute();
+    void receive_data(uint8_t mosi);
+
+    uint32_t latency_bytes(uint8_t cmd) const;
+    uint8_t r1(uint8_t flags = 0) const { return (idle_ ? 0x01 : 0x00) | flags; }
+    uint32_t ncr(uint8_t cmd) const;
+    void respond(uint32_t delay, std::initializer_list<uint8_t> response);
+    void queue_fill(uint8_t value, uint32_t count);
+    void queue_data(uint8_t cmd, const uint8_t* data, size_t len);
+    void queue_read_block(uint8_t cmd, uint32_t block);
+    void csd(uint8_t* csd) const;
+
+    std::vector<uint8_t> image_;
+    std::array<uint32_t, 64> latency_us_{};
+    uint32_t clock_hz_ = 400000;
+    uint64_t elapsed_ps_ = 0;
+    Stats stats_;
+
+    bool selected_ = false;
+    bool spi_mode_ = false;         // Set by CMD0 while selected
+    bool idle_ = true;              // Cleared by ACMD41 once initialization completes
+    bool app_cmd_ = false;          // Previous command was CMD55
+    bool crc_enabled_ = false;      // Set by CMD59
+    bool init_started_ = false;
+    uint64_t init_start_ = 0;       // Bytes clocked at the first ACMD41
+
+    Mode mode_ = Mode::Command;
+    uint8_t cmd_[6] = {};
+    uint32_t cmd_len_ = 0;
+    std::deque<uint8_t> out_;
+
+    uint32_t block_ = 0;            // Next block to read or write
+    bool write_multiple_ = false;
+    std::vector<uint8_t> write_buffer_;
+};
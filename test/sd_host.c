@@ -0,0 +1,186 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Host implementations of the Pico SDK functions used by FatFs_SPI and 'sd_transport.c'.  This
+// replaces FatFs_SPI's DMA-driven 'spi.c' and 'rtc.c', forwarding the SPI bus to the card
+// attached with 'sd_host_attach()'.
+
+// For clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+
+// Standard
+#include <stddef.h>
+#include <time.h>
+
+// Pico SDK
+#include <hardware/spi.h>
+#include <pico/stdlib.h>
+
+// SPI/FatFS
+#include <ff.h>
+#include <diskio.h>
+#include <hw_config.h>
+
+// Project
+#include "sd_host.h"
+
+static const sd_host_bus_t* bus = NULL;
+static bool gpio_state[32];
+
+void sd_host_attach(const sd_host_bus_t* new_bus) {
+    sd_card_t* pSd = sd_get_by_num(0);
+
+    if (pSd->mounted) {
+        f_unmount(pSd->pcName);
+        pSd->mounted = false;
+    }
+
+    pSd->m_Status |= STA_NOINIT;
+    bus = new_bus;
+}
+
+static uint8_t transfer(uint8_t mosi) {
+    // With no card inserted, DO is pulled up.
+    return bus != NULL
+        ? bus->transfer(mosi)
+        : 0xFF;
+}
+
+// FatFs_SPI 'spi.c'
+
+bool my_spi_init(spi_t* pSPI) {
+    (void) pSPI;
+    return true;
+}
+
+void spi_lock(spi_t* pSPI) { (void) pSPI; }
+void spi_unlock(spi_t* pSPI) { (void) pSPI; }
+
+bool spi_transfer(spi_t* pSPI, const uint8_t* tx, uint8_t* rx, size_t length) {
+    (void) pSPI;
+
+    for (size_t i = 0; i < length; i++) {
+        const uint8_t miso = transfer(tx != NULL ? tx[i] : 0xFF);
+        if (rx != NULL) { rx[i] = miso; }
+    }
+
+    return true;
+}
+
+// FatFs_SPI 'rtc.c'
+
+void time_init() {}
+
+DWORD get_fattime(void) {
+    // 2024-01-01 00:00:00
+    return ((DWORD) (2024 - 1980) << 25) | ((DWORD) 1 << 21) | ((DWORD) 1 << 16);
+}
+
+// hardware/spi.h
+
+uint spi_init(spi_inst_t* spi, uint baudrate) {
+    return spi_set_baudrate(spi, baudrate);
+}
+
+void spi_deinit(spi_inst_t* spi) { (void) spi; }
+
+uint spi_set_baudrate(spi_inst_t* spi, uint baudrate) {
+    (void) spi;
+
+    if (bus != NULL) {
+        bus->set_clock_hz(baudrate);
+    }
+
+    return baudrate;
+}
+
+uint spi_get_baudrate(const spi_inst_t* spi) {
+    (void) spi;
+    return BOOTLOADER_SD_BAUD_RATE;
+}
+
+void spi_set_format(spi_inst_t* spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order) {
+    (void) spi; (void) data_bits; (void) cpol; (void) cpha; (void) order;
+}
+
+int spi_write_read_blocking(spi_inst_t* spi, const uint8_t* src, uint8_t* dst, size_t len) {
+    (void) spi;
+
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = transfer(src[i]);
+    }
+
+    return (int) len;
+}
+
+int spi_write_blocking(spi_inst_t* spi, const uint8_t* src, size_t len) {
+    (void) spi;
+
+    for (size_t i = 0; i < len; i++) {
+        transfer(src[i]);
+    }
+
+    return (int) len;
+}
+
+int spi_read_blocking(spi_inst_t* spi, uint8_t repeated_tx_data, uint8_t* dst, size_t len) {
+    (void) spi;
+
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = transfer(repeated_tx_data);
+    }
+
+    return (int) len;
+}
+
+// hardware/gpio.h
+
+void gpio_init(uint gpio) { gpio_state[gpio] = false; }
+void gpio_deinit(uint gpio) { (void) gpio; }
+void gpio_set_function(uint gpio, enum gpio_function fn) { (void) gpio; (void) fn; }
+void gpio_set_dir(uint gpio, bool out) { (void) gpio; (void) out; }
+void gpio_set_pulls(uint gpio, bool up, bool down) { (void) gpio; (void) up; (void) down; }
+void gpio_set_drive_strength(uint gpio, enum gpio_drive_strength drive) { (void) gpio; (void) drive; }
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) { (void) gpio; (void) event_mask; (void) enabled; }
+void gpio_acknowledge_irq(uint gpio, uint32_t event_mask) { (void) gpio; (void) event_mask; }
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback) {
+    (void) gpio; (void) event_mask; (void) enabled; (void) callback;
+}
+
+void gpio_put(uint gpio, bool value) {
+    gpio_state[gpio] = value;
+
+    // Chip select is active low.
+    if (gpio == BOOTLOADER_SD_SPI_CSN_PIN && bus != NULL) {
+        bus->select(!value);
+    }
+}
+
+bool gpio_get(uint gpio) {
+    return gpio_state[gpio];
+}
+
+// pico/time.h
+
+uint64_t time_us_64(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t) time_us_64();
+}
+
+void busy_wait_us(uint64_t us) {
+    const uint64_t end = time_us_64() + us;
+    while (time_us_64() < end) { }
+}
+
+void busy_wait_us_32(uint32_t us) { busy_wait_us(us); }
+void busy_wait_ms(uint32_t ms) { busy_wait_us(ms * 1000ull); }
+void sleep_us(uint64_t us) { busy_wait_us(us); }
+void sleep_ms(uint32_t ms) { busy_wait_us(ms * 1000ull); }
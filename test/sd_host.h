@@ -0,0 +1,30 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The card on the emulated SPI bus.  FatFs_SPI's chip select, byte transfers and baud
+// rate changes are forwarded here.
+typedef struct {
+    void (*select)(bool selected);
+    uint8_t (*transfer)(uint8_t mosi);
+    void (*set_clock_hz)(uint32_t hz);
+} sd_host_bus_t;
+
+// Inserts the given card, or removes the card if 'bus' is NULL.  Any previously mounted
+// volume is unmounted, as if the card had been swapped.
+void sd_host_attach(const sd_host_bus_t* bus);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
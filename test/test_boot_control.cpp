@@ -0,0 +1,102 @@
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "boot_control.h"
+
+static watchdog_hw_t watchdog;
+watchdog_hw_t* const watchdog_hw = &watchdog;
+
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms) {}
+
+class BootControlSuite : public ::testing::Test {
+protected:
+    void SetUp() override {
+        watchdog = {};
+    }
+};
+
+TEST_F(BootControlSuite, Encoding) {
+    // Magic | version | flags
+    EXPECT_EQ(0xB0C70100u, boot_control_encode(0));
+    EXPECT_EQ(0xB0C70105u, boot_control_encode(BOOT_CONTROL_SKIP_SD_PROBE | BOOT_CONTROL_FORCE_FULL_REWRITE));
+
+    // Flags outside the low byte are dropped.
+    EXPECT_EQ(0xB0C70102u, boot_control_encode(0xFF00 | BOOT_CONTROL_FORCE_UPDATE_CHECK));
+}
+
+TEST_F(BootControlSuite, RoundTrip) {
+    for (uint32_t flags = 0; flags <= BOOT_CONTROL_MAILBOX_FLAGS_MASK; flags++) {
+        const uint32_t word = boot_control_encode(flags);
+        EXPECT_EQ(flags, boot_control_decode(word, ~word));
+    }
+}
+
+TEST_F(BootControlSuite, RejectsInvalid) {
+    const uint32_t word = boot_control_encode(BOOT_CONTROL_SKIP_SD_PROBE);
+
+    // Power-on reset clears the scratch registers.
+    EXPECT_EQ(0u, boot_control_decode(0, 0));
+
+    // Mismatched complement
+    EXPECT_EQ(0u, boot_control_decode(word, word));
+    EXPECT_EQ(0u, boot_control_decode(word, ~word ^ 1));
+
+    // Wrong magic
+    EXPECT_EQ(0u, boot_control_decode(word ^ 0x10000, ~(word ^ 0x10000)));
+
+    // Unsupported version
+    const uint32_t v2 = (word & ~0xFF00u) | (2 << 8);
+    EXPECT_EQ(0u, boot_control_decode(v2, ~v2));
+}
+
+TEST_F(BootControlSuite, PostAndTake) {
+    watchdog.scratch[0] = 0x12345678;
+    watchdog.scratch[BOOT_CONTROL_FAST_BOOT_SCRATCH] = BOOT_CONTROL_FAST_BOOT_MAGIC;
+
+    boot_control_post(BOOT_CONTROL_FORCE_UPDATE_CHECK);
+
+    // Posting cancels a pending fast boot, so that the stage 3 bootloader runs.
+    EXPECT_EQ(0u, watchdog.scratch[BOOT_CONTROL_FAST_BOOT_SCRATCH]);
+
+    EXPECT_EQ(BOOT_CONTROL_FORCE_UPDATE_CHECK, boot_control_take());
+
+    // Requests apply to a single reboot.
+    EXPECT_EQ(0u, watchdog.scratch[BOOT_CONTROL_MAILBOX_SCRATCH]);
+    EXPECT_EQ(0u, watchdog.scratch[BOOT_CONTROL_MAILBOX_CHECK_SCRATCH]);
+    EXPECT_EQ(0u, boot_control_take());
+
+    // Other registers are untouched.
+    EXPECT_EQ(0x12345678u, watchdog.scratch[0]);
+}
+
+TEST_F(BootControlSuite, LatestPostWins) {
+    boot_control_post(BOOT_CONTROL_SKIP_SD_PROBE);
+    boot_control_post(BOOT_CONTROL_FORCE_FULL_REWRITE);
+    EXPECT_EQ(BOOT_CONTROL_FORCE_FULL_REWRITE, boot_control_take());
+}
+
+TEST_F(BootControlSuite, BootCount) {
+    // Magic | count
+    EXPECT_EQ(0xB0C00000u, boot_control_encode_boot_count(0));
+    EXPECT_EQ(0xB0C00003u, boot_control_encode_boot_count(3));
+
+    for (uint32_t count = 0; count < 10; count++) {
+        EXPECT_EQ(count, boot_control_decode_boot_count(boot_control_encode_boot_count(count)));
+    }
+
+    // Power-on reset clears the register, and the firmware may have used it for other purposes.
+    EXPECT_EQ(0u, boot_control_decode_boot_count(0));
+    EXPECT_EQ(0u, boot_control_decode_boot_count(0x12340005));
+    EXPECT_EQ(0u, boot_control_decode_boot_count(BOOT_CONTROL_BOOT_CONFIRMED));
+}
+
+TEST_F(BootControlSuite, Confirm) {
+    watchdog.scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH] = boot_control_encode_boot_count(2);
+    boot_control_confirm();
+    EXPECT_EQ(BOOT_CONTROL_BOOT_CONFIRMED, watchdog.scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH]);
+
+    // Other registers are untouched.
+    EXPECT_EQ(0u, watchdog.scratch[BOOT_CONTROL_MAILBOX_SCRATCH]);
+    EXPECT_EQ(0u, watchdog.scratch[BOOT_CONTROL_FAST_BOOT_SCRATCH]);
+}
@@ -0,0 +1,93 @@
+// Standard
+#include <utility>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "diag_pattern.h"
+
+typedef std::vector<std::pair<bool, uint16_t>> timings_t;
+
+static timings_t expand(const uint8_t* morse) {
+    diag_step_t steps[DIAG_MAX_STEPS];
+    const int num_steps = diag_steps(morse, steps);
+
+    EXPECT_LE(num_steps, DIAG_MAX_STEPS);
+
+    timings_t result;
+    for (int i = 0; i < num_steps; i++) {
+        result.push_back({ steps[i].led_on, steps[i].duration_ms });
+    }
+    return result;
+}
+
+static uint32_t duration_ms(const timings_t& timings) {
+    uint32_t total = 0;
+    for (const auto& step : timings) {
+        total += step.second;
+    }
+    return total;
+}
+
+TEST(DiagPatternSuite, Dot) {
+    const uint8_t morse_e[] = { 1, 0 };
+    const timings_t expected = { { false, 300 }, { true, 100 }, { false, 400 } };
+    EXPECT_EQ(expected, expand(morse_e));
+}
+
+TEST(DiagPatternSuite, NoFirmware) {
+    // "N" is dash-dot.
+    const timings_t expected = { { false, 300 }, { true, 300 }, { false, 100 }, { true, 100 }, { false, 400 } };
+    EXPECT_EQ(expected, expand(diag_morse(DIAG_NO_FIRMWARE)));
+    EXPECT_EQ(1200u, duration_ms(expand(diag_morse(DIAG_NO_FIRMWARE))));
+}
+
+TEST(DiagPatternSuite, AllCodes) {
+    const diag_code_t codes[] = {
+        DIAG_ENTERING_FIRMWARE,
+        FATAL_WATCHDOG_WITHOUT_FIRMWARE,
+        DIAG_NO_FIRMWARE,
+        FATAL_FLASH_FAILED,
+        FATAL_INVALID_UF2,
+        DIAG_DELETE_FAILED,
+        DIAG_SKIPPED_PROGRAMMING,
+        DIAG_STAGING_REJECTED,
+        DIAG_ROLLED_BACK,
+        DIAG_SCRUB_FAILED,
+        DIAG_IMAGE_REJECTED,
+    };
+
+    for (diag_code_t code : codes) {
+        const timings_t timings = expand(diag_morse(code));
+
+        // Every pattern starts with a 3 dot gap and ends with a 4 dot gap.
+        ASSERT_GE(timings.size(), 3u) << "code " << code;
+        EXPECT_EQ(std::make_pair(false, (uint16_t) (3 * DIAG_DOT_MS)), timings.front()) << "code " << code;
+        EXPECT_EQ(std::make_pair(false, (uint16_t) (4 * DIAG_DOT_MS)), timings.back()) << "code " << code;
+
+        // Steps alternate between on and off, with elements being either a dot or dash.
+        for (size_t i = 1; i < timings.size(); i++) {
+            EXPECT_EQ(i % 2 == 1, timings[i].first) << "code " << code << ", step " << i;
+
+            if (timings[i].first) {
+                EXPECT_TRUE(timings[i].second == DIAG_DOT_MS || timings[i].second == 3 * DIAG_DOT_MS);
+            } else if (i + 1 < timings.size()) {
+                EXPECT_EQ(DIAG_DOT_MS, timings[i].second);
+            }
+        }
+
+        // Keep patterns short enough to be recognizable.
+        EXPECT_LE(duration_ms(timings), 2000u) << "code " << code;
+    }
+}
+
+TEST(DiagPatternSuite, DistinctPatterns) {
+    for (int a = DIAG_ENTERING_FIRMWARE; a <= DIAG_SCRUB_FAILED; a++) {
+        for (int b = a + 1; b <= DIAG_SCRUB_FAILED; b++) {
+            EXPECT_NE(expand(diag_morse((diag_code_t) a)), expand(diag_morse((diag_code_t) b)))
+                << "codes " << a << " and " << b;
+        }
+    }
+}
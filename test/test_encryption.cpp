@@ -0,0 +1,292 @@
+// Standard
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "aes.h"
+#include "encryption.h"
+#include "image_builder.h"
+#include "prog.h"
+
+static std::vector<uint8_t> from_hex(const char* hex) {
+    std::vector<uint8_t> result;
+    for (size_t i = 0; hex[i] != '\0'; i += 2) {
+        result.push_back((uint8_t) std::stoul(std::string(hex + i, 2), nullptr, 16));
+    }
+    return result;
+}
+
+// NIST SP 800-38A, F.5.1 (CTR-AES128.Encrypt) and F.5.2 (CTR-AES128.Decrypt).
+static const char* nist_key = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char* nist_counter = "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+static const char* nist_plaintext =
+    "6bc1bee22e409f96e93d7e117393172a"
+    "ae2d8a571e03ac9c9eb76fac45af8e51"
+    "30c81c46a35ce411e5fbc1191a0a52ef"
+    "f69f2445df4f9b17ad2b417be66c3710";
+static const char* nist_ciphertext =
+    "874d6191b620e3261bef6864990db6ce"
+    "9806f66b7970fdff8617187bb9fffdff"
+    "5ae4df3edbd5d35e5b4f09020db03eab"
+    "1e031dda2fbe03d1792170a0f3009cee";
+
+class AesSuite : public ::testing::Test {
+protected:
+    aes128_t aes;
+
+    void SetUp() override {
+        aes128_init(&aes, from_hex(nist_key).data());
+    }
+
+    // Runs counter mode over 'input' in pieces of the given sizes (the last piece takes the rest).
+    std::vector<uint8_t> ctr(const char* input, const std::vector<size_t>& pieces = {}) {
+        std::vector<uint8_t> data = from_hex(input);
+        std::vector<uint8_t> counter = from_hex(nist_counter);
+
+        size_t offset = 0;
+        for (size_t piece : pieces) {
+            aes128_ctr(&aes, counter.data(), data.data() + offset, piece);
+            offset += piece;
+        }
+        aes128_ctr(&aes, counter.data(), data.data() + offset, data.size() - offset);
+        return data;
+    }
+};
+
+TEST(AesBlockSuite, KnownAnswer) {
+    // FIPS 197, Appendix C.1.
+    aes128_t aes;
+    aes128_init(&aes, from_hex("000102030405060708090a0b0c0d0e0f").data());
+
+    uint8_t out[AES_BLOCK_SIZE];
+    aes128_encrypt(&aes, from_hex("00112233445566778899aabbccddeeff").data(), out);
+    EXPECT_EQ(from_hex("69c4e0d86a7b0430d8cdb78070b4c55a"), std::vector<uint8_t>(out, out + sizeof(out)));
+}
+
+TEST_F(AesSuite, CtrEncrypt) {
+    EXPECT_EQ(from_hex(nist_ciphertext), ctr(nist_plaintext));
+}
+
+TEST_F(AesSuite, CtrDecrypt) {
+    EXPECT_EQ(from_hex(nist_plaintext), ctr(nist_ciphertext));
+}
+
+TEST_F(AesSuite, CtrContinues) {
+    // The counter carries from 0x...feff to 0x...ff00 between the second and third blocks.
+    EXPECT_EQ(from_hex(nist_ciphertext), ctr(nist_plaintext, { 16, 16 }));
+    EXPECT_EQ(from_hex(nist_ciphertext), ctr(nist_plaintext, { 32 }));
+}
+
+TEST_F(AesSuite, CtrUnaligned) {
+    // A partial block uses the start of the key stream for its counter.
+    std::vector<uint8_t> data = from_hex(nist_plaintext);
+    std::vector<uint8_t> counter = from_hex(nist_counter);
+    aes128_ctr(&aes, counter.data(), data.data() + 1, 20);
+
+    const std::vector<uint8_t> plaintext = from_hex(nist_plaintext);
+    const std::vector<uint8_t> expected = ctr(nist_plaintext);
+    for (size_t i = 0; i < 20; i++) {
+        const uint8_t key_stream = expected[i] ^ plaintext[i];
+        EXPECT_EQ(plaintext[i + 1] ^ key_stream, data[i + 1]) << "byte " << i;
+    }
+    EXPECT_EQ(plaintext[0], data[0]);
+    EXPECT_EQ(plaintext[21], data[21]);
+}
+
+// The key check and the start and end of the first page's payload, as encrypted by
+// 'scripts/uf2_encrypt.py' with the NIST key and the nonce 00 01 .. 0b.
+static const char* image_key_check = "bdb7c0ef49717942";
+static const char* image_page_start = "32832e63966b30879a8cb2d3992d03ac";
+static const char* image_page_end = "4ace131d05be8876a0c973cd8635bbcf";
+
+static std::vector<std::vector<uint8_t>> accepted;
+
+static bool record_block_cb(prog_t* prog, const struct uf2_block* block) {
+    accepted.emplace_back(block->data, block->data + FLASH_PAGE_SIZE);
+    return true;
+}
+
+class EncryptionSuite : public ::testing::Test {
+protected:
+    prog_t prog;
+    ImageBuilder image;
+    aes128_t key;
+    std::vector<uint8_t> nonce;
+
+    void SetUp() override {
+        aes128_init(&key, from_hex(nist_key).data());
+        for (uint8_t i = 0; i < ENCRYPTION_NONCE_SIZE; i++) {
+            nonce.push_back(i);
+        }
+
+        prog_init(&prog);
+        encryption_init(&prog.encryption, &key);
+        prog.accept_block = record_block_cb;
+        accepted.clear();
+
+        // (No vector table, which 'process_block' would check.)
+        image.add_page(FLASH_SECTOR_SIZE, 0x33);
+        image.add_page(FLASH_SECTOR_SIZE + 3 * FLASH_PAGE_SIZE, 0x44);
+        image.add_page(5 * FLASH_SECTOR_SIZE + 15 * FLASH_PAGE_SIZE, 0x55);
+    }
+
+    void TearDown() override {
+        prog_free(&prog);
+    }
+
+    static void set_counter(const std::vector<uint8_t>& nonce, uint32_t value, uint8_t counter[AES_BLOCK_SIZE]) {
+        memcpy(counter, nonce.data(), ENCRYPTION_NONCE_SIZE);
+        counter[12] = (uint8_t) (value >> 24);
+        counter[13] = (uint8_t) (value >> 16);
+        counter[14] = (uint8_t) (value >> 8);
+        counter[15] = (uint8_t) value;
+    }
+
+    struct uf2_block encryption_block(const aes128_t* with_key) const {
+        struct uf2_block block = {};
+        block.magic_start0 = UF2_MAGIC_START0;
+        block.magic_start1 = UF2_MAGIC_START1;
+        block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT;
+        block.payload_size = sizeof(encryption_header_t);
+        block.file_size = RP2040_FAMILY_ID;
+        block.magic_end = UF2_MAGIC_END;
+
+        encryption_header_t header = {};
+        header.magic = ENCRYPTION_MAGIC;
+        header.version = ENCRYPTION_VERSION;
+        header.algorithm = ENCRYPTION_ALGORITHM_AES128_CTR;
+        memcpy(header.nonce, nonce.data(), sizeof(header.nonce));
+
+        uint8_t counter[AES_BLOCK_SIZE];
+        set_counter(nonce, ENCRYPTION_KEY_CHECK_COUNTER, counter);
+        aes128_ctr(with_key, counter, header.key_check, sizeof(header.key_check));
+
+        memcpy(block.data, &header, sizeof(header));
+        return block;
+    }
+
+    // Returns the image's flash blocks with their payloads encrypted, as by 'uf2_encrypt.py'.
+    std::vector<struct uf2_block> encrypted_blocks() const {
+        std::vector<struct uf2_block> blocks = image.flash_blocks();
+        for (auto& block : blocks) {
+            uint8_t counter[AES_BLOCK_SIZE];
+            set_counter(nonce, (block.target_addr - XIP_BASE) / AES_BLOCK_SIZE, counter);
+            aes128_ctr(&key, counter, block.data, FLASH_PAGE_SIZE);
+        }
+        return blocks;
+    }
+
+    // Returns the given blocks, numbered in order.
+    static std::vector<struct uf2_block> uf2(std::vector<struct uf2_block> blocks) {
+        for (size_t i = 0; i < blocks.size(); i++) {
+            blocks[i].block_no = i;
+            blocks[i].num_blocks = blocks.size();
+        }
+        return blocks;
+    }
+
+    std::vector<struct uf2_block> encrypted_uf2() const {
+        std::vector<struct uf2_block> blocks = encrypted_blocks();
+        blocks.insert(blocks.begin(), encryption_block(&key));
+        return uf2(blocks);
+    }
+
+    bool read(const std::vector<struct uf2_block>& blocks) {
+        prog_restart(&prog);
+        accepted.clear();
+        for (const auto& block : blocks) {
+            if (!process_block(&prog, &block)) { return false; }
+        }
+        return prog_is_complete(&prog);
+    }
+
+    std::vector<std::vector<uint8_t>> plaintext() const {
+        std::vector<std::vector<uint8_t>> result;
+        for (const auto& page : image.pages) {
+            result.push_back(page.second);
+        }
+        return result;
+    }
+};
+
+TEST_F(EncryptionSuite, MatchesScript) {
+    const struct uf2_block header = encryption_block(&key);
+    EXPECT_EQ(from_hex(image_key_check),
+        std::vector<uint8_t>(((const encryption_header_t*) header.data)->key_check,
+                             ((const encryption_header_t*) header.data)->key_check + ENCRYPTION_KEY_CHECK_SIZE));
+
+    const struct uf2_block page = encrypted_blocks()[0];
+    EXPECT_EQ(from_hex(image_page_start), std::vector<uint8_t>(page.data, page.data + 16));
+    EXPECT_EQ(from_hex(image_page_end), std::vector<uint8_t>(page.data + FLASH_PAGE_SIZE - 16, page.data + FLASH_PAGE_SIZE));
+}
+
+TEST_F(EncryptionSuite, Decrypt) {
+    const auto blocks = encrypted_uf2();
+
+    ASSERT_TRUE(read(blocks));
+    EXPECT_TRUE(prog.encryption.is_present);
+    EXPECT_EQ(plaintext(), accepted);
+
+    // Reading the file again decrypts it again.
+    ASSERT_TRUE(read(blocks));
+    EXPECT_EQ(plaintext(), accepted);
+}
+
+TEST_F(EncryptionSuite, Unencrypted) {
+    // Unencrypted UF2 files are still accepted.
+    ASSERT_TRUE(read(uf2(image.flash_blocks())));
+    EXPECT_FALSE(prog.encryption.is_present);
+    EXPECT_EQ(plaintext(), accepted);
+}
+
+TEST_F(EncryptionSuite, RejectWithoutKey) {
+    encryption_init(&prog.encryption, nullptr);
+    EXPECT_FALSE(read(encrypted_uf2()));
+}
+
+TEST_F(EncryptionSuite, RejectOtherKey) {
+    aes128_t other;
+    aes128_init(&other, from_hex("000102030405060708090a0b0c0d0e0f").data());
+
+    std::vector<struct uf2_block> blocks = encrypted_blocks();
+    blocks.insert(blocks.begin(), encryption_block(&other));
+    EXPECT_FALSE(read(uf2(blocks)));
+}
+
+TEST_F(EncryptionSuite, RejectMisplaced) {
+    // The nonce must precede all flash blocks.
+    std::vector<struct uf2_block> blocks = encrypted_blocks();
+    blocks.insert(blocks.begin() + 1, encryption_block(&key));
+    EXPECT_FALSE(read(uf2(blocks)));
+}
+
+TEST_F(EncryptionSuite, RejectMalformed) {
+    const struct uf2_block good = encryption_block(&key);
+
+    // Only one nonce is allowed.
+    std::vector<struct uf2_block> blocks = encrypted_blocks();
+    blocks.insert(blocks.begin(), { good, good });
+    EXPECT_FALSE(read(uf2(blocks)));
+
+    struct uf2_block bad = good;
+    ((encryption_header_t*) bad.data)->version = ENCRYPTION_VERSION + 1;
+    blocks = encrypted_blocks();
+    blocks.insert(blocks.begin(), bad);
+    EXPECT_FALSE(read(uf2(blocks)));
+
+    bad = good;
+    ((encryption_header_t*) bad.data)->algorithm = ENCRYPTION_ALGORITHM_AES128_CTR + 1;
+    blocks = encrypted_blocks();
+    blocks.insert(blocks.begin(), bad);
+    EXPECT_FALSE(read(uf2(blocks)));
+
+    bad = good;
+    bad.payload_size = sizeof(encryption_header_t) - 1;
+    blocks = encrypted_blocks();
+    blocks.insert(blocks.begin(), bad);
+    EXPECT_FALSE(read(uf2(blocks)));
+}
@@ -0,0 +1,243 @@
+// Standard
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "erase_plan.h"
+
+static constexpr uint32_t NUM_SECTORS = 48;     // Three 64kB blocks
+
+class ErasePlanSuite : public ::testing::Test {
+protected:
+    interval_set_t sectors;
+    flash_caps_t caps;
+    erase_plan_t plan;
+    uint32_t blank[ERASE_PLAN_BITMAP_WORDS(NUM_SECTORS)];
+
+    void SetUp() override {
+        interval_set_init(&sectors);
+        flash_caps_init(&caps, 2 * 1024 * 1024);
+        caps.erase_32k_opcode = 0x52;
+        erase_plan_init(&plan);
+        std::fill(std::begin(blank), std::end(blank), 0);
+    }
+
+    void TearDown() override {
+        erase_plan_free(&plan);
+        interval_set_free(&sectors);
+    }
+
+    void set_blank(uint32_t sector) {
+        blank[sector / 32] |= 1u << (sector % 32);
+    }
+
+    bool is_blank(uint32_t sector) const {
+        return (blank[sector / 32] >> (sector % 32)) & 1;
+    }
+
+    // Returns the plan's erases as (first sector, number of sectors) pairs.
+    std::vector<std::pair<uint32_t, uint32_t>> erases() const {
+        std::vector<std::pair<uint32_t, uint32_t>> result;
+        for (int i = 0; i < plan.num_erases; i++) {
+            result.emplace_back(plan.erases[i].start, plan.erases[i].end - plan.erases[i].start);
+        }
+        return result;
+    }
+
+    void build(uint32_t limit = NUM_SECTORS) {
+        erase_plan_build(&plan, &sectors, blank, limit, &caps);
+        expect_valid(limit);
+    }
+
+    // Every sector that is not blank is erased exactly once, and nothing else is erased.
+    void expect_valid(uint32_t limit) {
+        std::vector<int> times_erased(NUM_SECTORS + 16, 0);
+        uint32_t cost_ms = 0;
+
+        for (int i = 0; i < plan.num_erases; i++) {
+            const interval_t& erase = plan.erases[i];
+            const uint32_t count = erase.end - erase.start;
+
+            ASSERT_TRUE(count == 1 || count == 8 || count == 16) << count;
+            ASSERT_EQ(erase.start % count, 0u) << "unaligned erase at " << erase.start;
+            ASSERT_LE(erase.end, limit);
+            if (i > 0) { ASSERT_LE(plan.erases[i - 1].end, erase.start); }
+
+            cost_ms += count == 16 ? caps.erase_64k_ms : count == 8 ? caps.erase_32k_ms : caps.erase_4k_ms;
+            for (uint32_t s = erase.start; s < erase.end; s++) {
+                times_erased[s]++;
+                EXPECT_TRUE(interval_set_contains(&sectors, s)) << "erased sector " << s << " outside the set";
+                EXPECT_EQ(erase_plan_find(&plan, s), &erase);
+            }
+        }
+
+        for (uint32_t s = 0; s < NUM_SECTORS; s++) {
+            const bool must_erase = s < limit && interval_set_contains(&sectors, s) && !is_blank(s);
+            EXPECT_LE(times_erased[s], 1) << "sector " << s;
+            if (must_erase) { EXPECT_EQ(times_erased[s], 1) << "sector " << s; }
+            if (times_erased[s] == 0) { EXPECT_EQ(erase_plan_find(&plan, s), nullptr) << "sector " << s; }
+        }
+
+        EXPECT_EQ(plan.cost_ms, cost_ms);
+    }
+
+    // Returns the cost of the cheapest set of erases by exhaustive search: the first sector that
+    // must be erased but is not yet covered is covered by each allowed erase in turn.
+    uint32_t brute_force_ms(uint32_t limit, std::vector<bool>& covered, uint32_t from = 0) const {
+        uint32_t s = from;
+        while (s < NUM_SECTORS && (covered[s] || s >= limit || !interval_set_contains(&sectors, s) || is_blank(s))) {
+            s++;
+        }
+
+        if (s == NUM_SECTORS) {
+            return 0;
+        }
+
+        struct { uint32_t count; uint8_t opcode; uint32_t ms; } const options[] = {
+            { 1, caps.erase_4k_opcode, caps.erase_4k_ms },
+            { 8, caps.erase_32k_opcode, caps.erase_32k_ms },
+            { 16, caps.erase_64k_opcode, caps.erase_64k_ms },
+        };
+
+        uint32_t best = UINT32_MAX;
+
+        for (const auto& option : options) {
+            const uint32_t first = s - (s % option.count);
+            bool allowed = option.opcode != 0;
+
+            for (uint32_t i = first; i < first + option.count; i++) {
+                allowed &= i < limit && interval_set_contains(&sectors, i) && !covered[i];
+            }
+
+            if (!allowed) {
+                continue;
+            }
+
+            std::fill_n(covered.begin() + first, option.count, true);
+            const uint32_t rest = brute_force_ms(limit, covered, s + 1);
+            std::fill_n(covered.begin() + first, option.count, false);
+
+            if (rest != UINT32_MAX) {
+                best = std::min(best, option.ms + rest);
+            }
+        }
+
+        return best;
+    }
+};
+
+TEST_F(ErasePlanSuite, Empty) {
+    build();
+    EXPECT_EQ(plan.num_erases, 0);
+    EXPECT_EQ(plan.cost_ms, 0u);
+}
+
+TEST_F(ErasePlanSuite, FullBlock) {
+    interval_set_union(&sectors, 16, 32);
+    build();
+
+    const std::vector<std::pair<uint32_t, uint32_t>> expected = { { 16, 16 } };
+    EXPECT_EQ(expected, erases());
+    EXPECT_EQ(plan.cost_ms, 150u);
+}
+
+TEST_F(ErasePlanSuite, Halves) {
+    // Sectors 8-23 straddle two blocks: each half is erased with a 32kB erase.
+    interval_set_union(&sectors, 8, 24);
+    build();
+
+    const std::vector<std::pair<uint32_t, uint32_t>> expected = { { 8, 8 }, { 16, 8 } };
+    EXPECT_EQ(expected, erases());
+}
+
+TEST_F(ErasePlanSuite, FewSectors) {
+    // Two 4kB erases (90ms) are cheaper than a 32kB or 64kB erase.
+    interval_set_union(&sectors, 0, 16);
+    for (uint32_t s = 0; s < 16; s++) {
+        if (s != 3 && s != 12) { set_blank(s); }
+    }
+    build();
+
+    const std::vector<std::pair<uint32_t, uint32_t>> expected = { { 3, 1 }, { 12, 1 } };
+    EXPECT_EQ(expected, erases());
+    EXPECT_EQ(plan.cost_ms, 90u);
+}
+
+TEST_F(ErasePlanSuite, AllBlank) {
+    interval_set_union(&sectors, 0, 16);
+    for (uint32_t s = 0; s < 16; s++) { set_blank(s); }
+    build();
+
+    EXPECT_EQ(plan.num_erases, 0);
+}
+
+TEST_F(ErasePlanSuite, No32kErase) {
+    caps.erase_32k_opcode = 0;
+    interval_set_union(&sectors, 8, 16);
+    build();
+
+    EXPECT_EQ(plan.num_erases, 8);
+    EXPECT_EQ(plan.cost_ms, 8 * 45u);
+}
+
+TEST_F(ErasePlanSuite, Limit) {
+    // Nothing at or above the limit (the end of the program area) is erased, even if the set
+    // extends past it.
+    interval_set_union(&sectors, 32, NUM_SECTORS);
+    build(/* limit: */ 40);
+
+    const std::vector<std::pair<uint32_t, uint32_t>> expected = { { 32, 8 } };
+    EXPECT_EQ(expected, erases());
+
+    build(/* limit: */ 36);
+    EXPECT_EQ(plan.num_erases, 4);
+    EXPECT_EQ(plan.erases[3].end, 36u);
+}
+
+TEST_F(ErasePlanSuite, Rebuild) {
+    interval_set_union(&sectors, 0, 16);
+    build();
+    build();
+    EXPECT_EQ(plan.num_erases, 1);
+}
+
+TEST_F(ErasePlanSuite, MatchesBruteForce) {
+    std::mt19937 rng(44);
+
+    for (int trial = 0; trial < 2000; trial++) {
+        interval_set_clear(&sectors);
+        std::fill(std::begin(blank), std::end(blank), 0);
+
+        // Random costs, including ties and missing erase sizes.
+        caps.erase_4k_ms = 1 + rng() % 60;
+        caps.erase_32k_ms = 1 + rng() % 300;
+        caps.erase_64k_ms = 1 + rng() % 600;
+        caps.erase_32k_opcode = rng() % 4 ? 0x52 : 0;
+        caps.erase_64k_opcode = rng() % 4 ? 0xD8 : 0;
+
+        // Sets of varying density, so that block erases are often possible.
+        const uint32_t density = rng() % 4;
+        for (uint32_t s = 0; s < NUM_SECTORS; s++) {
+            if (rng() % 4 <= density) { interval_set_union(&sectors, s, s + 1); }
+            if (rng() % 3 == 0) { set_blank(s); }
+        }
+
+        const uint32_t limit = rng() % 2 ? NUM_SECTORS : rng() % (NUM_SECTORS + 1);
+
+        build(limit);
+
+        std::vector<bool> covered(NUM_SECTORS, false);
+        ASSERT_EQ(plan.cost_ms, brute_force_ms(limit, covered)) << "trial " << trial;
+        if (HasFailure()) { break; }
+    }
+}
+
+TEST_F(ErasePlanSuite, NoBlankBitmap) {
+    interval_set_union(&sectors, 0, 2);
+    erase_plan_build(&plan, &sectors, nullptr, NUM_SECTORS, &caps);
+    EXPECT_EQ(plan.num_erases, 2);
+}
@@ -0,0 +1,260 @@
+// Standard
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "erase_scheduler.h"
+#include "flash.h"
+
+// A flash whose erases stay in progress until 'busy_polls' calls to 'flash_erase_busy()'
+// have been made, or until the scheduler waits.  Records the sequence of operations and
+// counts programming that would fail on a real device.
+static std::vector<uint8_t> flash(32 * FLASH_BLOCK_SIZE, 0x00);
+static std::vector<std::string> ops;
+static bool is_busy = false;
+static int busy_polls = 0;
+static int violations = 0;
+
+void flash_erase_start(uint32_t flash_offs, size_t count) {
+    violations += is_busy;
+    ops.push_back("erase " + std::to_string(flash_offs / FLASH_SECTOR_SIZE) + "+" + std::to_string(count / FLASH_SECTOR_SIZE));
+    std::fill_n(flash.begin() + flash_offs, count, 0xFF);
+    is_busy = true;
+}
+
+bool flash_erase_busy() {
+    if (is_busy && busy_polls-- <= 0) {
+        is_busy = false;
+    }
+    return is_busy;
+}
+
+void flash_erase_wait() {
+    if (is_busy) {
+        ops.push_back("wait");
+    }
+    is_busy = false;
+}
+
+void flash_prog(uint32_t flash_offs, const uint8_t* data, size_t count) {
+    violations += is_busy;
+    ops.push_back("prog " + std::to_string(flash_offs / FLASH_PAGE_SIZE));
+
+    // Programming can only clear bits.
+    for (size_t i = 0; i < count; i++) {
+        violations += (flash[flash_offs + i] & data[i]) != data[i];
+        flash[flash_offs + i] &= data[i];
+    }
+}
+
+class EraseSchedulerSuite : public ::testing::Test {
+protected:
+    interval_set_t sectors;
+    flash_caps_t caps;
+    erase_plan_t plan;
+    erase_scheduler_t scheduler;
+
+    void SetUp() override {
+        std::fill(flash.begin(), flash.end(), 0x00);
+        ops.clear();
+        is_busy = false;
+        busy_polls = 1000;
+        violations = 0;
+        interval_set_init(&sectors);
+        flash_caps_init(&caps, PICO_FLASH_SIZE_BYTES);
+        erase_plan_init(&plan);
+    }
+
+    void TearDown() override {
+        erase_scheduler_free(&scheduler);
+        erase_plan_free(&plan);
+        interval_set_free(&sectors);
+    }
+
+    // Plans the erase of 'sectors' (except those marked in 'blank') and starts the scheduler.
+    void init(bool is_async, const uint32_t* blank = nullptr) {
+        erase_plan_build(&plan, &sectors, blank, flash.size() / FLASH_SECTOR_SIZE, &caps);
+        erase_scheduler_init(&scheduler, &plan, is_async);
+    }
+
+    void prog(uint32_t page) {
+        std::vector<uint8_t> data(FLASH_PAGE_SIZE, (uint8_t) page);
+        erase_scheduler_prog(&scheduler, page * FLASH_PAGE_SIZE, data.data());
+    }
+
+    void expect_page(uint32_t page) {
+        const uint8_t* p = &flash[page * FLASH_PAGE_SIZE];
+        EXPECT_TRUE(std::all_of(p, p + FLASH_PAGE_SIZE, [&](uint8_t b) { return b == (uint8_t) page; })) << "page " << page;
+    }
+
+    void expect_erased(uint32_t sector) {
+        const uint8_t* p = &flash[sector * FLASH_SECTOR_SIZE];
+        EXPECT_TRUE(std::all_of(p, p + FLASH_SECTOR_SIZE, [](uint8_t b) { return b == 0xFF; })) << "sector " << sector;
+    }
+};
+
+TEST_F(EraseSchedulerSuite, BuffersPagesWhileErasing) {
+    interval_set_union(&sectors, 1, 3);
+    init(/* is_async: */ true);
+
+    // The first page of each sector starts its erase.  Pages for a sector being erased are
+    // buffered until the next sector is reached.
+    prog(16);
+    prog(17);
+    prog(32);
+    prog(33);
+    erase_scheduler_finish(&scheduler);
+
+    const std::vector<std::string> expected = {
+        "erase 1+1", "wait", "prog 16", "prog 17",
+        "erase 2+1", "wait", "prog 32", "prog 33",
+    };
+    EXPECT_EQ(expected, ops);
+    EXPECT_EQ(0, violations);
+
+    for (uint32_t page : { 16, 17, 32, 33 }) { expect_page(page); }
+}
+
+TEST_F(EraseSchedulerSuite, ProgramsOnceEraseCompletes) {
+    interval_set_union(&sectors, 1, 2);
+    init(/* is_async: */ true);
+
+    // The erase finishes while the second page is being read.
+    busy_polls = 1;
+    prog(16);
+    prog(17);
+    prog(18);
+
+    const std::vector<std::string> expected = {
+        "erase 1+1", "prog 16", "prog 17", "prog 18",
+    };
+    EXPECT_EQ(expected, ops);
+    EXPECT_EQ(0, violations);
+}
+
+TEST_F(EraseSchedulerSuite, WaitsWhenBufferIsFull) {
+    interval_set_union(&sectors, 0, 16);
+    init(/* is_async: */ true);
+
+    for (uint32_t page = 0; page <= ERASE_SCHEDULER_MAX_PENDING; page++) {
+        prog(page);
+    }
+
+    // The page that does not fit waits for the erase, after the buffered pages.
+    EXPECT_EQ("wait", ops[1]);
+    EXPECT_EQ("prog " + std::to_string(ERASE_SCHEDULER_MAX_PENDING), ops.back());
+    EXPECT_EQ(ERASE_SCHEDULER_MAX_PENDING + 3u, ops.size());
+    EXPECT_EQ(0, violations);
+}
+
+TEST_F(EraseSchedulerSuite, Synchronous) {
+    interval_set_union(&sectors, 1, 2);
+    init(/* is_async: */ false);
+
+    prog(16);
+    prog(17);
+
+    const std::vector<std::string> expected = { "erase 1+1", "wait", "prog 16", "prog 17" };
+    EXPECT_EQ(expected, ops);
+    EXPECT_EQ(0, violations);
+}
+
+TEST_F(EraseSchedulerSuite, BlockErase) {
+    // Sectors 16-31 form an aligned 64kB block, but sectors 33-48 do not.
+    interval_set_union(&sectors, 16, 32);
+    interval_set_union(&sectors, 33, 49);
+    init(/* is_async: */ false);
+
+    // A page in the middle of the block erases the entire block.
+    prog(20 * 16);
+    prog(16 * 16);
+    prog(33 * 16);
+
+    const std::vector<std::string> expected = {
+        "erase 16+16", "wait", "prog 320", "prog 256",
+        "erase 33+1", "wait", "prog 528",
+    };
+    EXPECT_EQ(expected, ops);
+    EXPECT_EQ(0, violations);
+}
+
+TEST_F(EraseSchedulerSuite, PlannedErases) {
+    // With a 32kB erase, sectors 40-47 are erased together, but sector 48 is erased alone.
+    caps.erase_32k_opcode = 0x52;
+    interval_set_union(&sectors, 40, 49);
+    init(/* is_async: */ false);
+
+    prog(41 * 16);
+    prog(48 * 16);
+    prog(47 * 16);
+
+    const std::vector<std::string> expected = {
+        "erase 40+8", "wait", "prog 656",
+        "erase 48+1", "wait", "prog 768",
+        "prog 752",
+    };
+    EXPECT_EQ(expected, ops);
+    EXPECT_EQ(0, violations);
+}
+
+TEST_F(EraseSchedulerSuite, BlankSectors) {
+    // Sector 2 is already blank, so it is programmed without an erase.
+    interval_set_union(&sectors, 1, 3);
+    std::fill_n(flash.begin() + 2 * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE, 0xFF);
+    const uint32_t blank[1] = { 1u << 2 };
+    init(/* is_async: */ true, blank);
+
+    prog(32);
+    prog(16);
+    erase_scheduler_finish(&scheduler);
+
+    const std::vector<std::string> expected = { "prog 32", "erase 1+1", "wait", "prog 16" };
+    EXPECT_EQ(expected, ops);
+    EXPECT_EQ(0, violations);
+}
+
+TEST_F(EraseSchedulerSuite, OutOfOrder) {
+    interval_set_union(&sectors, 1, 4);
+    init(/* is_async: */ true);
+
+    for (uint32_t page : { 48, 16, 49, 32, 17 }) {
+        prog(page);
+    }
+    erase_scheduler_finish(&scheduler);
+
+    // Each sector is erased once, before its first page is programmed.
+    EXPECT_EQ(3, std::count_if(ops.begin(), ops.end(), [](const std::string& op) { return op.rfind("erase", 0) == 0; }));
+    EXPECT_EQ(0, violations);
+
+    for (uint32_t page : { 48, 16, 49, 32, 17 }) { expect_page(page); }
+}
+
+TEST_F(EraseSchedulerSuite, FinishErasesRemainingSectors) {
+    interval_set_union(&sectors, 1, 4);
+    init(/* is_async: */ true);
+
+    prog(16);
+    erase_scheduler_finish(&scheduler);
+
+    expect_page(16);
+    expect_erased(2);
+    expect_erased(3);
+    EXPECT_EQ(0, violations);
+}
+
+TEST_F(EraseSchedulerSuite, FreeWaitsForErase) {
+    interval_set_union(&sectors, 1, 2);
+    init(/* is_async: */ true);
+
+    prog(16);
+    EXPECT_TRUE(is_busy);
+
+    // Buffered pages are discarded (e.g., if reading the UF2 file failed).
+    erase_scheduler_free(&scheduler);
+    EXPECT_FALSE(is_busy);
+    EXPECT_EQ("wait", ops.back());
+}
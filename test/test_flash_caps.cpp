@@ -0,0 +1,321 @@
+// Standard
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "flash_caps.h"
+
+// The SFDP address space of a flash chip.  Reads past the end return 0xFF, like an
+// unprogrammed SFDP area.
+struct SfdpDump {
+    std::vector<uint8_t> bytes;
+    int reads = 0;
+
+    SfdpDump() : bytes(256, 0xFF) {}
+
+    SfdpDump(std::initializer_list<std::pair<uint32_t, std::vector<uint8_t>>> regions) : SfdpDump() {
+        for (const auto& region : regions) {
+            std::copy(region.second.begin(), region.second.end(), bytes.begin() + region.first);
+        }
+    }
+
+    static bool read(void* context, uint32_t addr, void* buffer, size_t len) {
+        SfdpDump* dump = static_cast<SfdpDump*>(context);
+        dump->reads++;
+
+        uint8_t* out = static_cast<uint8_t*>(buffer);
+        for (size_t i = 0; i < len; i++) {
+            out[i] = addr + i < dump->bytes.size() ? dump->bytes[addr + i] : 0xFF;
+        }
+        return true;
+    }
+};
+
+static bool fail_read(void*, uint32_t, void*, size_t) {
+    return false;
+}
+
+// Winbond W25Q16JV (JEDEC ID EF 40 15), the Raspberry Pi Pico's flash.  SFDP revision 1.5
+// with a single 16 DWORD basic table.
+static const SfdpDump w25q16jv({
+    { 0x00, { 0x53, 0x46, 0x44, 0x50, 0x05, 0x01, 0x00, 0xFF,
+              0x00, 0x05, 0x01, 0x10, 0x80, 0x00, 0x00, 0xFF } },
+    { 0x80, { 0xE5, 0x20, 0xF1, 0xFF, 0xFF, 0xFF, 0xFF, 0x00,
+              0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x42, 0xBB,
+              0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00,
+              0xFF, 0xFF, 0x40, 0xEB, 0x0C, 0x20, 0x0F, 0x52,
+              0x10, 0xD8, 0x00, 0x00, 0x36, 0x02, 0xA6, 0x00,
+              0x82, 0xEA, 0x14, 0xC9, 0xE9, 0x63, 0x76, 0x33,
+              0x7A, 0x75, 0x7A, 0x75, 0xF7, 0xA2, 0xD5, 0x5C,
+              0x19, 0xF7, 0x4D, 0xFF, 0xE9, 0x30, 0xF8, 0x80 } },
+});
+
+// Macronix MX25L3233F (JEDEC ID C2 20 16).  SFDP revision 1.6 with the basic table, a 4-byte
+// address instruction table and a vendor table.
+static const SfdpDump mx25l3233f({
+    { 0x00, { 0x53, 0x46, 0x44, 0x50, 0x06, 0x01, 0x02, 0xFF,
+              0x00, 0x06, 0x01, 0x10, 0x30, 0x00, 0x00, 0xFF,
+              0x84, 0x00, 0x01, 0x02, 0x70, 0x00, 0x00, 0xFF,
+              0xC2, 0x00, 0x01, 0x04, 0x90, 0x00, 0x00, 0xFF } },
+    { 0x30, { 0xE5, 0x20, 0xF1, 0xFF, 0xFF, 0xFF, 0xFF, 0x01,
+              0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x04, 0xBB,
+              0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF,
+              0xFF, 0xFF, 0x44, 0xEB, 0x0C, 0x20, 0x0F, 0x52,
+              0x10, 0xD8, 0x00, 0xFF, 0xD6, 0x49, 0xC5, 0x00,
+              0x82, 0xDF, 0x04, 0xE3, 0x44, 0x03, 0x67, 0x38,
+              0x30, 0xB0, 0x30, 0xB0, 0xF7, 0xBD, 0xD5, 0x5C,
+              0x4A, 0x9E, 0x29, 0xFF, 0xF0, 0x50, 0xF9, 0x85 } },
+    { 0x70, { 0x7F, 0xEF, 0xFF, 0xFF, 0x21, 0x5C, 0xDC, 0xFF } },
+});
+
+// Winbond W25Q256JV (JEDEC ID EF 40 19), a 32MB chip.  Only the first 16MB can be mapped.
+static const SfdpDump w25q256jv({
+    { 0x00, { 0x53, 0x46, 0x44, 0x50, 0x06, 0x01, 0x00, 0xFF,
+              0x00, 0x06, 0x01, 0x10, 0x80, 0x00, 0x00, 0xFF } },
+    { 0x80, { 0xE5, 0x20, 0xFB, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F,
+              0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x42, 0xBB,
+              0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00,
+              0xFF, 0xFF, 0x40, 0xEB, 0x0C, 0x20, 0x0F, 0x52,
+              0x10, 0xD8, 0x00, 0x00, 0x36, 0x02, 0xA6, 0x00,
+              0x82, 0xEA, 0x14, 0xE2, 0xE9, 0x63, 0x76, 0x33,
+              0x7A, 0x75, 0x7A, 0x75, 0xF7, 0xA2, 0xD5, 0x5C,
+              0x19, 0xF7, 0x4D, 0xFF, 0xE9, 0x70, 0xF9, 0xA5 } },
+});
+
+static flash_caps_t detect(const SfdpDump& source, uint32_t jedec_id) {
+    SfdpDump dump = source;
+    flash_caps_t caps;
+    flash_caps_init(&caps, 2 * 1024 * 1024);
+    flash_caps_detect(&caps, jedec_id, SfdpDump::read, &dump);
+    return caps;
+}
+
+TEST(FlashCapsSuite, Defaults) {
+    flash_caps_t caps;
+    flash_caps_init(&caps, 2 * 1024 * 1024);
+
+    EXPECT_EQ(caps.size_bytes, 2u * 1024 * 1024);
+    EXPECT_FALSE(caps.has_sfdp);
+    EXPECT_EQ(caps.erase_4k_opcode, 0x20);
+    EXPECT_EQ(caps.erase_32k_opcode, 0x00);
+    EXPECT_EQ(caps.erase_64k_opcode, 0xD8);
+    EXPECT_EQ(caps.quad_program_opcode, 0x00);
+    EXPECT_EQ(caps.erase_4k_ms, 45);
+    EXPECT_EQ(caps.erase_32k_ms, 120);
+    EXPECT_EQ(caps.erase_64k_ms, 150);
+}
+
+TEST(FlashCapsSuite, W25Q16JV) {
+    const flash_caps_t caps = detect(w25q16jv, 0xEF4015);
+
+    EXPECT_EQ(caps.jedec_id, 0xEF4015u);
+    EXPECT_TRUE(caps.has_sfdp);
+    EXPECT_EQ(caps.size_bytes, 2u * 1024 * 1024);
+    EXPECT_EQ(caps.erase_4k_opcode, 0x20);
+    EXPECT_EQ(caps.erase_32k_opcode, 0x52);
+    EXPECT_EQ(caps.erase_64k_opcode, 0xD8);
+    EXPECT_EQ(caps.quad_program_opcode, FLASH_QUAD_PAGE_PROGRAM);
+    EXPECT_EQ(caps.qe_status_opcode, 0x35);
+    EXPECT_EQ(caps.qe_mask, 0x02);
+
+    // Typical erase times from DWORD 10.
+    EXPECT_EQ(caps.erase_4k_ms, 64);
+    EXPECT_EQ(caps.erase_32k_ms, 128);
+    EXPECT_EQ(caps.erase_64k_ms, 160);
+}
+
+TEST(FlashCapsSuite, NoEraseTimes) {
+    // JESD216 (revision 1.0) tables end at DWORD 9, so the erase times keep their defaults.
+    SfdpDump dump = w25q16jv;
+    dump.bytes[11] = 9;
+
+    const flash_caps_t caps = detect(dump, 0xEF4015);
+    EXPECT_TRUE(caps.has_sfdp);
+    EXPECT_EQ(caps.erase_32k_opcode, 0x52);
+    EXPECT_EQ(caps.erase_4k_ms, 45);
+    EXPECT_EQ(caps.erase_32k_ms, 120);
+    EXPECT_EQ(caps.erase_64k_ms, 150);
+
+    // Nor do they locate the Quad Enable bit, so pages are programmed on one lane.
+    EXPECT_EQ(caps.quad_program_opcode, 0x00);
+}
+
+TEST(FlashCapsSuite, QuadEnable) {
+    // DWORD 15, bits 22:20 locate the Quad Enable bit.
+    const auto detect_qe = [](uint8_t encoding) {
+        SfdpDump dump = w25q16jv;
+        uint8_t& bits = dump.bytes[0x80 + 56 + 2];
+        bits = (uint8_t) ((bits & ~0x70) | (encoding << 4));
+        return detect(dump, 0xEF4015);
+    };
+
+    flash_caps_t caps = detect_qe(0);
+    EXPECT_EQ(caps.quad_program_opcode, FLASH_QUAD_PAGE_PROGRAM);
+    EXPECT_EQ(caps.qe_status_opcode, 0x00);
+
+    caps = detect_qe(2);
+    EXPECT_EQ(caps.quad_program_opcode, FLASH_QUAD_PAGE_PROGRAM);
+    EXPECT_EQ(caps.qe_status_opcode, 0x05);
+    EXPECT_EQ(caps.qe_mask, 0x40);
+
+    caps = detect_qe(3);
+    EXPECT_EQ(caps.qe_status_opcode, 0x3F);
+    EXPECT_EQ(caps.qe_mask, 0x80);
+
+    caps = detect_qe(5);
+    EXPECT_EQ(caps.qe_status_opcode, 0x35);
+    EXPECT_EQ(caps.qe_mask, 0x02);
+
+    // Status register 2 may not be readable, and 6-7 are reserved.
+    for (uint8_t encoding : { 1, 6, 7 }) {
+        EXPECT_EQ(detect_qe(encoding).quad_program_opcode, 0x00) << (int) encoding;
+    }
+}
+
+TEST(FlashCapsSuite, MX25L3233F) {
+    const flash_caps_t caps = detect(mx25l3233f, 0xC22016);
+
+    EXPECT_TRUE(caps.has_sfdp);
+    EXPECT_EQ(caps.size_bytes, 4u * 1024 * 1024);
+    EXPECT_EQ(caps.erase_32k_opcode, 0x52);
+    EXPECT_EQ(caps.erase_64k_opcode, 0xD8);
+
+    // Macronix chips program four lanes with 1-4-4 (0x38), not 1-1-4.
+    EXPECT_EQ(caps.quad_program_opcode, 0x00);
+}
+
+TEST(FlashCapsSuite, LargerThanAddressable) {
+    const flash_caps_t caps = detect(w25q256jv, 0xEF4019);
+
+    EXPECT_TRUE(caps.has_sfdp);
+    EXPECT_EQ(caps.size_bytes, 16u * 1024 * 1024);
+}
+
+TEST(FlashCapsSuite, DensityAsPowerOfTwo) {
+    // Bit 31 of DWORD 2 selects a log2 encoding (64Gbit here).
+    SfdpDump dump = w25q16jv;
+    const uint8_t density[] = { 0x24, 0x00, 0x00, 0x80 };
+    memcpy(&dump.bytes[0x84], density, sizeof(density));
+    EXPECT_EQ(detect(dump, 0xEF4015).size_bytes, 16u * 1024 * 1024);
+
+    // 2^23 bits is 1MB.
+    dump.bytes[0x84] = 23;
+    EXPECT_EQ(detect(dump, 0xEF4015).size_bytes, 1u * 1024 * 1024);
+}
+
+TEST(FlashCapsSuite, EraseTypes) {
+    // Erase types may be listed in any order.  Here, only 4kB and 64kB erases are supported,
+    // with a nonstandard instruction for the 64kB erase.
+    SfdpDump dump = w25q16jv;
+    const uint8_t erase_types[] = { 0x10, 0xDC, 0x00, 0xFF, 0x0C, 0x21, 0x00, 0xFF };
+    memcpy(&dump.bytes[0x80 + 28], erase_types, sizeof(erase_types));
+
+    const flash_caps_t caps = detect(dump, 0xEF4015);
+    EXPECT_EQ(caps.erase_32k_opcode, 0x00);
+    EXPECT_EQ(caps.erase_64k_opcode, 0xDC);
+
+    // The 4kB erase instruction comes from DWORD 1.
+    EXPECT_EQ(caps.erase_4k_opcode, 0x20);
+}
+
+TEST(FlashCapsSuite, HighestMinorRevision) {
+    // A second basic table with a higher minor revision supersedes the first.
+    SfdpDump dump = w25q16jv;
+    dump.bytes[6] = 1;
+    const uint8_t header[] = { 0x00, 0x06, 0x01, 0x09, 0xC0, 0x00, 0x00, 0xFF };
+    memcpy(&dump.bytes[16], header, sizeof(header));
+    memcpy(&dump.bytes[0xC0], &dump.bytes[0x80], 36);
+    dump.bytes[0xC0 + 7] = 0x01;        // 32Mbit
+
+    EXPECT_EQ(detect(dump, 0xEF4016).size_bytes, 4u * 1024 * 1024);
+}
+
+TEST(FlashCapsSuite, NoSfdp) {
+    // Without SFDP, the capacity comes from the JEDEC ID and the erases keep the defaults.
+    const SfdpDump blank;
+    const flash_caps_t caps = detect(blank, 0xEF4017);
+
+    EXPECT_FALSE(caps.has_sfdp);
+    EXPECT_EQ(caps.jedec_id, 0xEF4017u);
+    EXPECT_EQ(caps.size_bytes, 8u * 1024 * 1024);
+    EXPECT_EQ(caps.erase_32k_opcode, 0x00);
+    EXPECT_EQ(caps.erase_64k_opcode, 0xD8);
+    EXPECT_EQ(caps.quad_program_opcode, 0x00);
+
+    // A vendor-specific capacity code is ignored.
+    EXPECT_EQ(detect(blank, 0xEF4042).size_bytes, 2u * 1024 * 1024);
+}
+
+TEST(FlashCapsSuite, NoChip) {
+    // An unresponsive chip keeps the defaults without reading SFDP.
+    for (uint32_t jedec_id : { 0x000000u, 0xFFFFFFu }) {
+        SfdpDump dump = w25q16jv;
+        flash_caps_t caps;
+        flash_caps_init(&caps, 2 * 1024 * 1024);
+        flash_caps_detect(&caps, jedec_id, SfdpDump::read, &dump);
+
+        EXPECT_EQ(dump.reads, 0);
+        EXPECT_EQ(caps.jedec_id, 0u);
+        EXPECT_EQ(caps.size_bytes, 2u * 1024 * 1024);
+    }
+}
+
+TEST(FlashCapsSuite, RejectMalformed) {
+    flash_caps_t caps;
+    flash_caps_init(&caps, 2 * 1024 * 1024);
+    const flash_caps_t defaults = caps;
+
+    const auto expect_rejected = [&](SfdpDump dump) {
+        EXPECT_FALSE(flash_caps_parse_sfdp(&caps, SfdpDump::read, &dump));
+        EXPECT_EQ(0, memcmp(&caps, &defaults, sizeof(caps)));
+    };
+
+    SfdpDump dump = w25q16jv;
+    dump.bytes[0] = 'X';                // Signature
+    expect_rejected(dump);
+
+    dump = w25q16jv;
+    dump.bytes[5] = 2;                  // Major revision
+    expect_rejected(dump);
+
+    dump = w25q16jv;
+    dump.bytes[11] = 8;                 // Basic table shorter than JESD216's 9 DWORDs
+    expect_rejected(dump);
+
+    dump = w25q16jv;
+    dump.bytes[15] = 0x81;              // No basic table
+    expect_rejected(dump);
+
+    dump = w25q16jv;
+    memset(&dump.bytes[0x84], 0, 4);    // Capacity of 1 bit
+    expect_rejected(dump);
+
+    EXPECT_FALSE(flash_caps_parse_sfdp(&caps, fail_read, nullptr));
+    EXPECT_EQ(0, memcmp(&caps, &defaults, sizeof(caps)));
+}
+
+TEST(FlashCapsSuite, EraseSize) {
+    const flash_caps_t caps = detect(w25q16jv, 0xEF4015);
+    const uint32_t k = 1024;
+
+    EXPECT_EQ(flash_caps_erase_size(&caps, 0, 128 * k), 64 * k);
+    EXPECT_EQ(flash_caps_erase_size(&caps, 0, 64 * k), 64 * k);
+    EXPECT_EQ(flash_caps_erase_size(&caps, 0, 60 * k), 32 * k);
+    EXPECT_EQ(flash_caps_erase_size(&caps, 32 * k, 64 * k), 32 * k);
+    EXPECT_EQ(flash_caps_erase_size(&caps, 0, 28 * k), 4 * k);
+    EXPECT_EQ(flash_caps_erase_size(&caps, 4 * k, 128 * k), 4 * k);
+
+    EXPECT_EQ(flash_caps_erase_opcode(&caps, 64 * k), 0xD8);
+    EXPECT_EQ(flash_caps_erase_opcode(&caps, 32 * k), 0x52);
+    EXPECT_EQ(flash_caps_erase_opcode(&caps, 4 * k), 0x20);
+
+    // Without a 32kB erase, 4kB sectors are used up to the next 64kB boundary.
+    flash_caps_t defaults;
+    flash_caps_init(&defaults, 2 * 1024 * 1024);
+    EXPECT_EQ(flash_caps_erase_size(&defaults, 0, 128 * k), 64 * k);
+    EXPECT_EQ(flash_caps_erase_size(&defaults, 32 * k, 64 * k), 4 * k);
+}
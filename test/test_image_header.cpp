@@ -0,0 +1,218 @@
+// Standard
+#include <string.h>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "image_builder.h"
+#include "image_header.h"
+#include "prog.h"
+
+// Returns an image header block, as written by 'scripts/uf2_version.py'.
+static struct uf2_block header_block(uint32_t image_version, const char* board_id) {
+    struct uf2_block block = {};
+    block.magic_start0 = UF2_MAGIC_START0;
+    block.magic_start1 = UF2_MAGIC_START1;
+    block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT;
+    block.payload_size = sizeof(image_header_t);
+    block.file_size = RP2040_FAMILY_ID;
+    block.magic_end = UF2_MAGIC_END;
+
+    image_header_t header = {};
+    header.magic = IMAGE_HEADER_MAGIC;
+    header.version = IMAGE_HEADER_VERSION;
+    header.image_version = image_version;
+    strncpy(header.board_id, board_id, sizeof(header.board_id) - 1);
+
+    memcpy(block.data, &header, sizeof(header));
+    return block;
+}
+
+static image_header_t header(uint32_t image_version, const char* board_id) {
+    const struct uf2_block block = header_block(image_version, board_id);
+    image_header_t result = {};
+    EXPECT_TRUE(image_header_read(&result, &block));
+    return result;
+}
+
+TEST(ImageHeaderSuite, Read) {
+    const struct uf2_block block = header_block(0x010203, "pico");
+    ASSERT_TRUE(image_header_is_header_block(&block));
+
+    image_header_t result = {};
+    ASSERT_TRUE(image_header_read(&result, &block));
+    EXPECT_TRUE(image_header_is_present(&result));
+    EXPECT_EQ(result.image_version, 0x010203u);
+    EXPECT_STREQ(result.board_id, "pico");
+}
+
+TEST(ImageHeaderSuite, RejectMalformed) {
+    image_header_t result = {};
+
+    struct uf2_block block = header_block(1, "pico");
+    block.flags &= ~UF2_FLAG_NOT_MAIN_FLASH;
+    EXPECT_FALSE(image_header_is_header_block(&block));
+    EXPECT_FALSE(image_header_read(&result, &block));
+
+    block = header_block(1, "pico");
+    reinterpret_cast<image_header_t*>(block.data)->version = IMAGE_HEADER_VERSION + 1;
+    EXPECT_FALSE(image_header_read(&result, &block));
+
+    block = header_block(1, "pico");
+    block.payload_size = sizeof(image_header_t) - 1;
+    EXPECT_FALSE(image_header_read(&result, &block));
+
+    block = header_block(1, "pico");
+    block.file_size = RP2040_FAMILY_ID + 1;
+    EXPECT_FALSE(image_header_read(&result, &block));
+
+    block = header_block(1, "pico");
+    block.magic_end = 0;
+    EXPECT_FALSE(image_header_read(&result, &block));
+
+    // The board ID must be NUL-terminated.
+    block = header_block(1, "pico");
+    memset(reinterpret_cast<image_header_t*>(block.data)->board_id, 'x', IMAGE_BOARD_ID_SIZE);
+    EXPECT_FALSE(image_header_read(&result, &block));
+
+    EXPECT_FALSE(image_header_is_present(&result));
+}
+
+TEST(ImageHeaderSuite, Compatible) {
+    const image_header_t pico = header(1, "pico");
+    const image_header_t pico_w = header(1, "pico_w");
+    const image_header_t any = header(1, "");
+
+    EXPECT_TRUE(image_header_is_compatible(&pico, "pico"));
+    EXPECT_FALSE(image_header_is_compatible(&pico_w, "pico"));
+
+    // An empty board ID matches any board.
+    EXPECT_TRUE(image_header_is_compatible(&any, "pico"));
+    EXPECT_TRUE(image_header_is_compatible(&pico_w, ""));
+}
+
+TEST(ImageHeaderSuite, Newer) {
+    const image_header_t installed = header(5, "pico");
+    const image_header_t v4 = header(4, "pico");
+    const image_header_t v5 = header(5, "pico");
+    const image_header_t v6 = header(6, "pico");
+    const image_header_t v6_other_board = header(6, "pico_w");
+
+    EXPECT_TRUE(image_header_is_newer(&v6, &installed, "pico"));
+    EXPECT_FALSE(image_header_is_newer(&v5, &installed, "pico"));
+    EXPECT_FALSE(image_header_is_newer(&v4, &installed, "pico"));
+    EXPECT_FALSE(image_header_is_newer(&v6_other_board, &installed, "pico"));
+
+    // Any compatible image is newer than unknown firmware.
+    EXPECT_TRUE(image_header_is_newer(&v4, nullptr, "pico"));
+    EXPECT_FALSE(image_header_is_newer(&v6_other_board, nullptr, "pico"));
+
+    const image_header_t missing = {};
+    EXPECT_FALSE(image_header_is_newer(&missing, nullptr, "pico"));
+
+    // Nothing is newer than installed firmware without a header.
+    EXPECT_FALSE(image_header_is_newer(&v6, &missing, "pico"));
+}
+
+TEST(ImageHeaderSuite, Record) {
+    const image_header_t installed = header(7, "pico");
+    image_record_t record = image_record_make(&installed);
+
+    const image_header_t* result = image_record_header(&record);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(0, memcmp(result, &installed, sizeof(installed)));
+
+    // A corrupt record is ignored.
+    record.header.image_version++;
+    EXPECT_EQ(image_record_header(&record), nullptr);
+
+    // Without a header, the record is erased.
+    const std::vector<uint8_t> erased(sizeof(image_record_t), 0xFF);
+    record = image_record_make(nullptr);
+    EXPECT_EQ(0, memcmp(&record, erased.data(), erased.size()));
+    EXPECT_EQ(image_record_header(&record), nullptr);
+
+    // Firmware without a header is recorded with an empty one.
+    const image_header_t missing = {};
+    record = image_record_make(&missing);
+    result = image_record_header(&record);
+    ASSERT_NE(result, nullptr);
+    EXPECT_FALSE(image_header_is_present(result));
+}
+
+// Installing 'firmware.uf2' without a header, which is then deleted, must not lead to
+// installing an image from the firmware directory on the next boot.
+TEST(ImageHeaderSuite, UnversionedInstallIsKept) {
+    const image_header_t installed = {};
+    const image_record_t record = image_record_make(&installed);
+
+    const image_header_t dir_image = header(1, "pico");
+    EXPECT_FALSE(image_header_is_newer(&dir_image, image_record_header(&record), "pico"));
+}
+
+class ImageHeaderProgSuite : public ::testing::Test {
+protected:
+    prog_t prog;
+    ImageBuilder image;
+
+    void SetUp() override {
+        prog_init(&prog);
+        prog.accept_block = [](prog_t*, const struct uf2_block*) { return true; };
+
+        image.add_page(FLASH_SECTOR_SIZE, 0x33);
+        image.add_page(FLASH_SECTOR_SIZE + FLASH_PAGE_SIZE, 0x44);
+    }
+
+    void TearDown() override {
+        prog_free(&prog);
+    }
+
+    // Numbers the blocks and processes them in order.  Returns false if any block is rejected.
+    bool process(std::vector<struct uf2_block> blocks) {
+        bool ok = true;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            blocks[i].block_no = i;
+            blocks[i].num_blocks = blocks.size();
+            ok &= process_block(&prog, &blocks[i]);
+        }
+        return ok;
+    }
+};
+
+TEST_F(ImageHeaderProgSuite, FirstBlock) {
+    std::vector<struct uf2_block> blocks = { header_block(3, "pico") };
+    for (const auto& block : image.flash_blocks()) { blocks.push_back(block); }
+
+    ASSERT_TRUE(process(blocks));
+    EXPECT_TRUE(image_header_is_present(&prog.image_header));
+    EXPECT_EQ(prog.image_header.image_version, 3u);
+    EXPECT_TRUE(prog_is_complete(&prog));
+
+    // The header is read again on the next pass.
+    prog_restart(&prog);
+    EXPECT_FALSE(image_header_is_present(&prog.image_header));
+}
+
+TEST_F(ImageHeaderProgSuite, PrecedesManifest) {
+    std::vector<struct uf2_block> blocks = { header_block(3, "pico") };
+    for (const auto& block : image.manifest_blocks()) { blocks.push_back(block); }
+    for (const auto& block : image.flash_blocks()) { blocks.push_back(block); }
+
+    ASSERT_TRUE(process(blocks));
+    EXPECT_TRUE(image_header_is_present(&prog.image_header));
+    EXPECT_TRUE(manifest_is_complete(&prog.manifest));
+}
+
+TEST_F(ImageHeaderProgSuite, RejectNotFirst) {
+    std::vector<struct uf2_block> blocks = image.flash_blocks();
+    blocks.insert(blocks.begin() + 1, header_block(3, "pico"));
+
+    EXPECT_FALSE(process(blocks));
+}
+
+TEST_F(ImageHeaderProgSuite, NoHeader) {
+    ASSERT_TRUE(process(image.flash_blocks()));
+    EXPECT_FALSE(image_header_is_present(&prog.image_header));
+}
@@ -294,3 +294,18 @@ TEST_F(IntervalSetSuite, Random) {
         } while (testSet.num_intervals() > 1);
     }
 }
+
+TEST_F(IntervalSetSuite, Contains) {
+    EXPECT_FALSE(interval_set_contains(&set, 10));
+
+    interval_set_union(&set, 10, 20);
+    interval_set_union(&set, 30, 40);
+
+    EXPECT_FALSE(interval_set_contains(&set, 9));
+    EXPECT_TRUE(interval_set_contains(&set, 10));
+    EXPECT_TRUE(interval_set_contains(&set, 19));
+    EXPECT_FALSE(interval_set_contains(&set, 20));     // Half-open: 'end' is excluded
+    EXPECT_FALSE(interval_set_contains(&set, 29));
+    EXPECT_TRUE(interval_set_contains(&set, 30));
+    EXPECT_FALSE(interval_set_contains(&set, 40));
+}
@@ -0,0 +1,139 @@
+// Standard
+#include <stdarg.h>
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "log_ring.h"
+
+class LogRingSuite : public ::testing::Test {
+protected:
+    uint8_t buffer[16];
+    log_ring_t ring;
+
+    void SetUp() override {
+        log_ring_init(&ring, buffer, sizeof(buffer));
+    }
+
+    bool write(const std::string& text) {
+        return log_ring_write(&ring, text.data(), text.size());
+    }
+
+    std::string read(uint32_t len) {
+        std::vector<char> out(len);
+        out.resize(log_ring_read(&ring, out.data(), len));
+        return std::string(out.begin(), out.end());
+    }
+};
+
+TEST_F(LogRingSuite, WriteRead) {
+    EXPECT_EQ(log_ring_pending(&ring), 0u);
+    EXPECT_EQ(log_ring_free(&ring), sizeof(buffer));
+
+    ASSERT_TRUE(write("hello"));
+    EXPECT_EQ(log_ring_pending(&ring), 5u);
+    EXPECT_EQ(log_ring_free(&ring), sizeof(buffer) - 5);
+
+    EXPECT_EQ(read(3), "hel");
+    EXPECT_EQ(read(16), "lo");
+    EXPECT_EQ(log_ring_pending(&ring), 0u);
+}
+
+TEST_F(LogRingSuite, WrapAround) {
+    // Repeatedly write messages that straddle the end of the buffer.
+    for (int i = 0; i < 20; i++) {
+        const std::string message = "msg" + std::to_string(i) + "-";
+        ASSERT_TRUE(write(message)) << i;
+        ASSERT_TRUE(write(message)) << i;
+        EXPECT_EQ(read(64), message + message) << i;
+    }
+
+    EXPECT_EQ(ring.dropped, 0u);
+}
+
+TEST_F(LogRingSuite, IndicesWrap) {
+    // 'head' and 'tail' wrap at 2^32.
+    ring.head = ring.tail = UINT32_MAX - 2;
+
+    ASSERT_TRUE(write("abcdef"));
+    EXPECT_EQ(log_ring_pending(&ring), 6u);
+    EXPECT_EQ(read(6), "abcdef");
+}
+
+TEST_F(LogRingSuite, DropWhenFull) {
+    ASSERT_TRUE(write("0123456789"));
+
+    // A message that does not fit is dropped entirely, not truncated.
+    EXPECT_FALSE(write("abcdefg"));
+    EXPECT_EQ(ring.dropped, 7u);
+    EXPECT_EQ(log_ring_pending(&ring), 10u);
+
+    // Exactly filling the ring succeeds.
+    EXPECT_TRUE(write("abcdef"));
+    EXPECT_EQ(log_ring_free(&ring), 0u);
+    EXPECT_EQ(read(16), "0123456789abcdef");
+
+    // Consuming (as the DMA channel does) frees space.
+    ASSERT_TRUE(write("xyz"));
+    log_ring_consume(&ring, 3);
+    EXPECT_EQ(log_ring_pending(&ring), 0u);
+    EXPECT_EQ(ring.dropped, 7u);
+}
+
+static std::string format(size_t size, const char* format, ...) {
+    std::vector<char> buffer(size + 1, '#');
+
+    va_list args;
+    va_start(args, format);
+    const size_t len = log_format(buffer.data(), size, format, args);
+    va_end(args);
+
+    // Nothing is written past 'size'.
+    EXPECT_EQ(buffer[size], '#');
+
+    if (size == 0) {
+        EXPECT_EQ(len, 0u);
+        return std::string();
+    }
+
+    EXPECT_EQ(len, strlen(buffer.data()));
+    return std::string(buffer.data());
+}
+
+TEST(LogFormatSuite, Conversions) {
+    EXPECT_EQ(format(64, "plain"), "plain");
+    EXPECT_EQ(format(64, "%d %d %d", 0, 42, -42), "0 42 -42");
+    EXPECT_EQ(format(64, "%d", INT32_MIN), "-2147483648");
+    EXPECT_EQ(format(64, "%u", UINT32_MAX), "4294967295");
+    EXPECT_EQ(format(64, "%lu", 7ul), "7");
+    EXPECT_EQ(format(64, "%x %X", 0xbeefu, 0xbeefu), "beef BEEF");
+    EXPECT_EQ(format(64, "%c%c", 'o', 'k'), "ok");
+    EXPECT_EQ(format(64, "[%s]", "sd"), "[sd]");
+    EXPECT_EQ(format(64, "100%%"), "100%");
+}
+
+TEST(LogFormatSuite, Width) {
+    EXPECT_EQ(format(64, "%08x", 0x1234u), "00001234");
+    EXPECT_EQ(format(64, "%4u|", 7u), "   7|");
+    EXPECT_EQ(format(64, "%5d", -12), "  -12");
+    EXPECT_EQ(format(64, "%05d", -12), "-0012");
+    EXPECT_EQ(format(64, "%4s|", "ab"), "  ab|");
+
+    // A value wider than the field is not truncated.
+    EXPECT_EQ(format(64, "%2u", 12345u), "12345");
+}
+
+TEST(LogFormatSuite, Unsupported) {
+    EXPECT_EQ(format(64, "%f", 1.0), "%f");
+    EXPECT_EQ(format(64, "end%"), "end");
+}
+
+TEST(LogFormatSuite, Truncate) {
+    EXPECT_EQ(format(6, "%s", "truncated"), "trunc");
+    EXPECT_EQ(format(4, "%08x", 0xffu), "000");
+    EXPECT_EQ(format(1, "abc"), "");
+    EXPECT_EQ(format(0, "abc"), "");
+}
@@ -0,0 +1,226 @@
+// Standard
+#include <algorithm>
+#include <map>
+#include <string.h>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "crc32.h"
+#include "image_builder.h"
+#include "manifest.h"
+#include "prog.h"
+
+TEST(Crc32Suite, KnownAnswer) {
+    // Standard CRC-32 check value.
+    EXPECT_EQ(0xCBF43926u, crc32_update(0, "123456789", 9));
+
+    // Empty input leaves the CRC unchanged.
+    EXPECT_EQ(0u, crc32_update(0, "", 0));
+}
+
+TEST(Crc32Suite, Incremental) {
+    const uint32_t crc = crc32_update(0, "1234", 4);
+    EXPECT_EQ(0xCBF43926u, crc32_update(crc, "56789", 5));
+}
+
+TEST(Crc32Suite, Fill) {
+    std::vector<uint8_t> erased(FLASH_SECTOR_SIZE, 0xFF);
+    EXPECT_EQ(crc32_update(0, erased.data(), erased.size()), crc32_fill(0, 0xFF, erased.size()));
+}
+
+class ManifestSuite : public ::testing::Test {
+protected:
+    manifest_t manifest;
+    ImageBuilder image;
+
+    void SetUp() override {
+        manifest_init(&manifest);
+
+        image.add_page(0, 0x11);                                           // Stage 2 bootloader
+        image.add_page(FLASH_PAGE_SIZE, 0x22);                             // Vector table
+        image.add_page(FLASH_SECTOR_SIZE, 0x33);
+        image.add_page(FLASH_SECTOR_SIZE + 3 * FLASH_PAGE_SIZE, 0x44);     // Gap of erased pages
+        image.add_page(5 * FLASH_SECTOR_SIZE + 15 * FLASH_PAGE_SIZE, 0x55);
+    }
+
+    void TearDown() override {
+        manifest_free(&manifest);
+    }
+
+    void add_manifest() {
+        for (const auto& block : image.manifest_blocks()) {
+            ASSERT_TRUE(manifest_add_block(&manifest, &block));
+        }
+        ASSERT_TRUE(manifest_is_complete(&manifest));
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> changed() const {
+        std::vector<std::pair<uint32_t, uint32_t>> result;
+        for (int i = 0; i < manifest.sectors_changed.num_intervals; i++) {
+            result.push_back({ manifest.sectors_changed.intervals[i].start, manifest.sectors_changed.intervals[i].end });
+        }
+        return result;
+    }
+};
+
+TEST_F(ManifestSuite, AddBlocks) {
+    EXPECT_FALSE(manifest_is_present(&manifest));
+    add_manifest();
+
+    EXPECT_EQ(3u, manifest.num_entries);
+    EXPECT_EQ(0u, manifest.entries[0].sector);
+    EXPECT_EQ(1u, manifest.entries[1].sector);
+    EXPECT_EQ(5u, manifest.entries[2].sector);
+    EXPECT_EQ(image.image_crc(), manifest.image_crc);
+}
+
+TEST_F(ManifestSuite, MultipleBlocks) {
+    for (uint32_t sector = 6; sector < 6 + 2 * MANIFEST_MAX_ENTRIES_PER_BLOCK; sector++) {
+        image.add_page(sector * FLASH_SECTOR_SIZE, sector);
+    }
+
+    ASSERT_EQ(3u, image.manifest_blocks().size());
+    add_manifest();
+    EXPECT_EQ(3 + 2 * MANIFEST_MAX_ENTRIES_PER_BLOCK, manifest.num_entries);
+}
+
+TEST_F(ManifestSuite, RejectMalformed) {
+    const struct uf2_block valid = image.manifest_blocks()[0];
+    manifest_header_t* header;
+    manifest_entry_t* entries;
+
+    struct uf2_block block = valid;
+    header = (manifest_header_t*) block.data;
+    header->version++;
+    EXPECT_FALSE(manifest_add_block(&manifest, &block));
+
+    // Must be flagged as a metadata block.
+    block = valid;
+    block.flags &= ~UF2_FLAG_NOT_MAIN_FLASH;
+    EXPECT_FALSE(manifest_add_block(&manifest, &block));
+
+    // Entries must fit within the payload.
+    block = valid;
+    block.payload_size -= 1;
+    EXPECT_FALSE(manifest_add_block(&manifest, &block));
+
+    // Must begin with the first entry.
+    block = valid;
+    header = (manifest_header_t*) block.data;
+    header->first_entry = 1;
+    EXPECT_FALSE(manifest_add_block(&manifest, &block));
+
+    // Sectors must be sorted.
+    block = valid;
+    entries = (manifest_entry_t*) (block.data + sizeof(manifest_header_t));
+    std::swap(entries[1], entries[2]);
+    EXPECT_FALSE(manifest_add_block(&manifest, &block));
+
+    // Sectors must be within the program area.
+    block = valid;
+    entries = (manifest_entry_t*) (block.data + sizeof(manifest_header_t));
+    entries[2].sector = PROG_AREA_SIZE / FLASH_SECTOR_SIZE;
+    EXPECT_FALSE(manifest_add_block(&manifest, &block));
+}
+
+TEST_F(ManifestSuite, FindChangedIdentical) {
+    add_manifest();
+
+    std::vector<uint8_t> flash = image.flash();
+    EXPECT_EQ(0, manifest_find_changed(&manifest, flash.data()));
+
+    // The stage 2 bootloader is excluded from the CRC.
+    flash[0] = ~flash[0];
+    EXPECT_EQ(0, manifest_find_changed(&manifest, flash.data()));
+}
+
+TEST_F(ManifestSuite, FindChangedRewritesSectorZero) {
+    add_manifest();
+
+    std::vector<uint8_t> flash = image.flash();
+    flash[5 * FLASH_SECTOR_SIZE] = 0;
+    EXPECT_EQ(2, manifest_find_changed(&manifest, flash.data()));
+
+    const std::vector<std::pair<uint32_t, uint32_t>> expected = { { 0, 1 }, { 5, 6 } };
+    EXPECT_EQ(expected, changed());
+}
+
+TEST_F(ManifestSuite, Verify) {
+    add_manifest();
+
+    for (const auto& block : image.flash_blocks()) {
+        EXPECT_TRUE(manifest_verify_block(&manifest, &block));
+    }
+
+    EXPECT_TRUE(manifest_verify_finish(&manifest));
+}
+
+TEST_F(ManifestSuite, VerifyWrongSectorCrc) {
+    add_manifest();
+
+    std::vector<struct uf2_block> blocks = image.flash_blocks();
+    blocks[2].data[0]++;
+
+    // The mismatch is detected once the block's sector is complete.
+    bool ok = true;
+    for (const auto& block : blocks) {
+        ok &= manifest_verify_block(&manifest, &block);
+    }
+
+    EXPECT_FALSE(ok);
+}
+
+TEST_F(ManifestSuite, VerifyUnlistedSector) {
+    add_manifest();
+
+    struct uf2_block block = image.flash_blocks()[0];
+    block.target_addr = XIP_BASE + 2 * FLASH_SECTOR_SIZE;
+    EXPECT_FALSE(manifest_verify_block(&manifest, &block));
+}
+
+TEST_F(ManifestSuite, VerifyMissingSector) {
+    add_manifest();
+
+    std::vector<struct uf2_block> blocks = image.flash_blocks();
+    blocks.pop_back();
+
+    for (const auto& block : blocks) {
+        EXPECT_TRUE(manifest_verify_block(&manifest, &block));
+    }
+
+    EXPECT_FALSE(manifest_verify_finish(&manifest));
+}
+
+TEST_F(ManifestSuite, VerifyUnordered) {
+    add_manifest();
+
+    std::vector<uint8_t> flash = image.flash();
+    EXPECT_EQ(0, manifest_find_changed(&manifest, flash.data()));
+
+    std::vector<struct uf2_block> blocks = image.flash_blocks();
+    std::reverse(blocks.begin(), blocks.end());
+
+    for (const auto& block : blocks) {
+        EXPECT_TRUE(manifest_verify_block(&manifest, &block));
+    }
+
+    // The image CRC is order dependent.
+    EXPECT_FALSE(manifest_verify_finish(&manifest));
+
+    // Because the per-sector CRCs could not be verified, all sectors are rewritten.
+    const std::vector<std::pair<uint32_t, uint32_t>> expected = { { 0, 2 }, { 5, 6 } };
+    EXPECT_EQ(expected, changed());
+}
+
+TEST_F(ManifestSuite, Restart) {
+    add_manifest();
+    manifest_restart(&manifest);
+    EXPECT_FALSE(manifest_is_complete(&manifest));
+
+    // Re-reading the UF2 file re-adds the same entries.
+    add_manifest();
+    EXPECT_EQ(3u, manifest.num_entries);
+}
@@ -0,0 +1,98 @@
+// Standard
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "crc32.h"
+#include "profile.h"
+
+class ProfileSuite : public ::testing::Test {
+protected:
+    void SetUp() override {
+        profile_reset();
+    }
+
+    // Decodes an unsigned LEB128 varint at 'pos', advancing 'pos' past it.
+    static uint32_t get_varint(const std::vector<uint8_t>& data, size_t& pos) {
+        uint32_t value = 0;
+        for (int shift = 0; ; shift += 7) {
+            const uint8_t byte = data.at(pos++);
+            value |= (uint32_t) (byte & 0x7F) << shift;
+            if (byte < 0x80) { return value; }
+        }
+    }
+};
+
+TEST_F(ProfileSuite, Buckets) {
+    EXPECT_EQ(0u, profile_bucket(0));
+    EXPECT_EQ(1u, profile_bucket(1));
+    EXPECT_EQ(2u, profile_bucket(2));
+    EXPECT_EQ(2u, profile_bucket(3));
+    EXPECT_EQ(3u, profile_bucket(4));
+    EXPECT_EQ(11u, profile_bucket(1024));
+    EXPECT_EQ(10u, profile_bucket(1023));
+
+    // Long durations saturate in the last bucket.
+    EXPECT_EQ(PROFILE_NUM_BUCKETS - 1u, profile_bucket(UINT32_MAX));
+}
+
+TEST_F(ProfileSuite, Record) {
+    profile_record(PROFILE_F_READ, 3);
+    profile_record(PROFILE_F_READ, 100);
+    profile_record(PROFILE_F_READ, 2);
+
+    const profile_hist_t* hist = profile_get(PROFILE_F_READ);
+    EXPECT_EQ(3u, hist->count);
+    EXPECT_EQ(105u, hist->total_us);
+    EXPECT_EQ(100u, hist->max_us);
+    EXPECT_EQ(2u, hist->buckets[2]);
+    EXPECT_EQ(1u, hist->buckets[7]);
+
+    // Other operations are unaffected.
+    EXPECT_EQ(0u, profile_get(PROFILE_FLASH_PROG)->count);
+
+    profile_reset();
+    EXPECT_EQ(0u, profile_get(PROFILE_F_READ)->count);
+}
+
+TEST_F(ProfileSuite, Encode) {
+    profile_record(PROFILE_FLASH_ERASE, 45000);
+    profile_record(PROFILE_MEMCMP, 1);
+
+    std::vector<uint8_t> buffer(PROFILE_MAX_ENCODED_SIZE);
+    const size_t length = profile_encode(buffer.data(), buffer.size());
+    ASSERT_GT(length, 0u);
+    buffer.resize(length);
+
+    // Mostly empty histograms encode compactly.
+    EXPECT_LT(length, (size_t) PROFILE_NUM_OPS * (PROFILE_NUM_BUCKETS + 3) + 16);
+
+    ASSERT_EQ(0, memcmp(buffer.data(), PROFILE_MAGIC, 4));
+    EXPECT_EQ(PROFILE_VERSION, buffer[4]);
+    EXPECT_EQ(PROFILE_NUM_OPS, buffer[5]);
+    EXPECT_EQ(PROFILE_NUM_BUCKETS, buffer[6]);
+
+    size_t pos = 7;
+    for (int op = 0; op < PROFILE_NUM_OPS; op++) {
+        const profile_hist_t* hist = profile_get((profile_op_t) op);
+        EXPECT_EQ(hist->count, get_varint(buffer, pos));
+        EXPECT_EQ(hist->total_us, get_varint(buffer, pos));
+        EXPECT_EQ(hist->max_us, get_varint(buffer, pos));
+
+        for (int i = 0; i < PROFILE_NUM_BUCKETS; i++) {
+            EXPECT_EQ(hist->buckets[i], get_varint(buffer, pos));
+        }
+    }
+
+    // The frame ends with the CRC-32 of everything after the magic.
+    ASSERT_EQ(length, pos + 4);
+    const uint32_t crc = buffer[pos] | (buffer[pos + 1] << 8) | (buffer[pos + 2] << 16) | ((uint32_t) buffer[pos + 3] << 24);
+    EXPECT_EQ(crc32_update(0, buffer.data() + 4, pos - 4), crc);
+}
+
+TEST_F(ProfileSuite, EncodeBufferTooSmall) {
+    uint8_t buffer[16];
+    EXPECT_EQ(0u, profile_encode(buffer, sizeof(buffer)));
+}
@@ -225,6 +225,32 @@ TEST_F(ProgSuite, ProgramAreaBounds) {
     assert_bad(block);
 }
 
+// Test that a chip smaller than PICO_FLASH_SIZE_BYTES shrinks the program area
+TEST_F(ProgSuite, SmallerFlash) {
+    // A larger chip does not grow the program area.
+    prog_set_flash_size(&prog, PICO_FLASH_SIZE_BYTES * 2);
+    EXPECT_EQ(prog.area_end, PROG_AREA_END);
+
+    // The bootloader, staging area and rollback slot still sit at the top of the (smaller) chip.
+    const uint32_t flash_size = PICO_FLASH_SIZE_BYTES / 2;
+    prog_set_flash_size(&prog, flash_size);
+    EXPECT_EQ(prog.area_end, PROG_AREA_BEGIN + flash_size - BOOTLOADER_SIZE - BOOTLOADER_STAGING_SIZE - BOOTLOADER_ROLLBACK_SIZE);
+
+    struct uf2_block block = valid_block;
+    block.target_addr = prog.area_end - FLASH_PAGE_SIZE;
+    block.block_no = 0;
+    block.num_blocks = 2;
+    assert_ok(block);
+
+    block.target_addr = prog.area_end;
+    block.block_no = 1;
+    assert_bad(block);
+
+    // Nothing fits.
+    prog_set_flash_size(&prog, BOOTLOADER_SIZE);
+    EXPECT_EQ(prog.area_end, PROG_AREA_BEGIN);
+}
+
 // Test duplicate page writing detection
 TEST_F(ProgSuite, DuplicatePageWriting) {
     struct uf2_block block = valid_block;
@@ -265,6 +291,61 @@ TEST_F(ProgSuite, MultipleBlocks) {
     assert_bad(block);
 }
 
+// Reading stops once every block of the program has been processed.
+TEST_F(ProgSuite, DoneWhenComplete) {
+    struct uf2_block block = valid_block;
+    block.num_blocks = 2;
+    assert_ok(block);
+    EXPECT_FALSE(prog.is_done);
+
+    block.block_no = 1;
+    block.target_addr += FLASH_PAGE_SIZE;
+    assert_ok(block);
+    EXPECT_TRUE(prog.is_done);
+
+    prog_restart(&prog);
+    EXPECT_FALSE(prog.is_done);
+
+    // A trailing metadata block (e.g., a signature) completes the program.
+    block = valid_block;
+    block.num_blocks = 2;
+    assert_ok(block);
+
+    block.block_no = 1;
+    block.flags |= UF2_FLAG_NOT_MAIN_FLASH;
+    assert_skipped(block);
+    EXPECT_TRUE(prog.is_done);
+}
+
+// The rest of a program for another family can be skipped.
+TEST_F(ProgSuite, BlocksToSkip) {
+    struct uf2_block block = valid_block;
+    block.num_blocks = 10;
+    block.block_no = 3;
+    EXPECT_EQ(prog_blocks_to_skip(&block), 0u);
+
+    block.file_size = RP2040_FAMILY_ID + 1;
+    EXPECT_EQ(prog_blocks_to_skip(&block), 6u);
+    assert_skipped(block);
+
+    block.block_no = 9;
+    EXPECT_EQ(prog_blocks_to_skip(&block), 0u);
+
+    // Blocks without a family ID are for another family, too.
+    block = valid_block;
+    block.flags &= ~UF2_FLAG_FAMILY_ID_PRESENT;
+    block.num_blocks = 4;
+    EXPECT_EQ(prog_blocks_to_skip(&block), 3u);
+
+    // Malformed blocks are not trusted.
+    block.block_no = 4;
+    EXPECT_EQ(prog_blocks_to_skip(&block), 0u);
+
+    block.block_no = 0;
+    block.magic_end = 0;
+    EXPECT_EQ(prog_blocks_to_skip(&block), 0u);
+}
+
 TEST_F(ProgSuite, MultipleBlocksWithAddressGaps) {
     struct uf2_block block = valid_block;
     block.num_blocks = 3;
@@ -295,3 +376,128 @@ TEST_F(ProgSuite, RejectedByCallback) {
     // Reset callback result for future tests
     callback_result = true;
 }
+
+// Metadata blocks are counted in the block numbering.
+TEST_F(ProgSuite, MetadataBlockNumbering) {
+    struct uf2_block block = valid_block;
+    block.num_blocks = 2;
+    block.flags |= UF2_FLAG_NOT_MAIN_FLASH;
+    assert_skipped(block);
+
+    block = valid_block;
+    block.num_blocks = 2;
+    block.block_no = 1;
+    assert_ok(block);
+
+    EXPECT_TRUE(prog_is_complete(&prog));
+}
+
+// Builds a manifest block listing the single sector written by 'valid_block'.
+static struct uf2_block manifest_block(uint32_t block_no, uint32_t num_blocks) {
+    struct uf2_block block = valid_block;
+    block.flags |= UF2_FLAG_NOT_MAIN_FLASH;
+    block.block_no = block_no;
+    block.num_blocks = num_blocks;
+    block.target_addr = 0;
+    block.payload_size = sizeof(manifest_header_t) + sizeof(manifest_entry_t);
+    memset(block.data, 0, sizeof(block.data));
+
+    manifest_header_t* header = (manifest_header_t*) block.data;
+    header->magic = MANIFEST_MAGIC;
+    header->version = MANIFEST_VERSION;
+    header->num_entries = 1;
+    header->total_entries = 1;
+
+    return block;
+}
+
+TEST_F(ProgSuite, Manifest) {
+    assert_skipped(manifest_block(0, 2));
+    EXPECT_TRUE(manifest_is_complete(&prog.manifest));
+
+    struct uf2_block block = valid_block;
+    block.block_no = 1;
+    block.num_blocks = 2;
+    assert_ok(block);
+}
+
+// The manifest must precede all flash blocks.
+TEST_F(ProgSuite, ManifestAfterFlashBlock) {
+    struct uf2_block block = valid_block;
+    block.num_blocks = 2;
+    assert_ok(block);
+
+    assert_bad(manifest_block(1, 2));
+}
+
+// The manifest must be complete before the first flash block.
+TEST_F(ProgSuite, ManifestIncomplete) {
+    struct uf2_block first = manifest_block(0, 3);
+    ((manifest_header_t*) first.data)->total_entries = 2;
+    assert_skipped(first);
+
+    struct uf2_block block = valid_block;
+    block.block_no = 1;
+    block.num_blocks = 3;
+    assert_bad(block);
+}
+
+// Builds a partial-update block.
+static struct uf2_block partial_block(uint32_t block_no, uint32_t num_blocks) {
+    struct uf2_block block = valid_block;
+    block.flags |= UF2_FLAG_NOT_MAIN_FLASH;
+    block.block_no = block_no;
+    block.num_blocks = num_blocks;
+    block.target_addr = 0;
+    block.payload_size = sizeof(prog_partial_header_t);
+    memset(block.data, 0, sizeof(block.data));
+
+    prog_partial_header_t* header = (prog_partial_header_t*) block.data;
+    header->magic = PROG_PARTIAL_MAGIC;
+    header->version = PROG_PARTIAL_VERSION;
+
+    return block;
+}
+
+// A partial update may write any sector but sector 0, and needs no vector table.
+TEST_F(ProgSuite, Partial) {
+    assert_skipped(partial_block(0, 3));
+    EXPECT_TRUE(prog.is_partial);
+
+    struct uf2_block block = valid_block;
+    block.block_no = 1;
+    block.num_blocks = 3;
+    block.target_addr = PROG_AREA_BEGIN + FLASH_SECTOR_SIZE + FLASH_PAGE_SIZE;
+    assert_ok(block);
+    EXPECT_FALSE(prog.has_vector_table);
+
+    block.block_no = 2;
+    block.target_addr = VECTOR_TABLE_ADDR;
+    assert_bad(block);
+
+    prog_restart(&prog);
+    EXPECT_FALSE(prog.is_partial);
+}
+
+// The partial-update block must precede all flash blocks, and appear once.
+TEST_F(ProgSuite, PartialAfterFlashBlock) {
+    struct uf2_block block = valid_block;
+    block.num_blocks = 2;
+    block.target_addr = PROG_AREA_BEGIN + FLASH_SECTOR_SIZE;
+    assert_ok(block);
+
+    assert_bad(partial_block(1, 2));
+    EXPECT_FALSE(prog.is_partial);
+}
+
+TEST_F(ProgSuite, PartialDuplicate) {
+    assert_skipped(partial_block(0, 2));
+    assert_bad(partial_block(1, 2));
+}
+
+TEST_F(ProgSuite, PartialUnsupportedVersion) {
+    struct uf2_block block = partial_block(0, 1);
+    ((prog_partial_header_t*) block.data)->version = PROG_PARTIAL_VERSION + 1;
+    assert_bad(block);
+    EXPECT_FALSE(prog.is_partial);
+}
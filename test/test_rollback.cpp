@@ -0,0 +1,342 @@
+// Standard
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "boot_control.h"
+#include "erase_plan.h"
+#include "flash.h"
+#include "rollback.h"
+#include "staging.h"
+
+// Simulated NOR flash: programming can only clear bits, and erases set whole sectors to 0xFF.
+static std::vector<uint8_t> flash(PICO_FLASH_SIZE_BYTES, 0xFF);
+static std::vector<std::pair<uint32_t, size_t>> erases;
+static flash_caps_t caps;
+
+static watchdog_hw_t watchdog;
+watchdog_hw_t* const watchdog_hw = &watchdog;
+
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms) {}
+
+// The bootloader must not modify itself (other than the installed image record).
+static bool is_writable(uint32_t flash_offs, size_t count) {
+    return flash_offs + count <= PICO_FLASH_SIZE_BYTES - BOOTLOADER_SIZE
+        || (flash_offs == IMAGE_RECORD_OFFSET && count <= FLASH_SECTOR_SIZE);
+}
+
+const uint8_t* flash_contents(uint32_t flash_offs) {
+    return flash.data() + flash_offs;
+}
+
+const flash_caps_t* flash_detect(void) {
+    return &caps;
+}
+
+void flash_erase(uint32_t flash_offs, size_t count) {
+    EXPECT_EQ(flash_offs % FLASH_SECTOR_SIZE, 0u);
+    EXPECT_EQ(count % FLASH_SECTOR_SIZE, 0u);
+    EXPECT_TRUE(is_writable(flash_offs, count)) << std::hex << flash_offs;
+
+    erases.push_back({ flash_offs, count });
+    std::fill_n(flash.begin() + flash_offs, count, 0xFF);
+}
+
+void flash_prog(uint32_t flash_offs, const uint8_t* data, size_t count) {
+    EXPECT_EQ(flash_offs % FLASH_PAGE_SIZE, 0u);
+    EXPECT_EQ(count % FLASH_PAGE_SIZE, 0u);
+    EXPECT_TRUE(is_writable(flash_offs, count)) << std::hex << flash_offs;
+
+    for (size_t i = 0; i < count; i++) {
+        flash[flash_offs + i] &= data[i];
+    }
+}
+
+class RollbackSuite : public ::testing::Test {
+protected:
+    interval_set_t sectors;
+    uint32_t blank[ERASE_PLAN_BITMAP_WORDS(PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE)];
+
+    void SetUp() override {
+        std::fill(flash.begin(), flash.end(), 0xFF);
+        erases.clear();
+        watchdog = {};
+        flash_caps_init(&caps, PICO_FLASH_SIZE_BYTES);
+        caps.erase_32k_opcode = 0x52;
+        interval_set_init(&sectors);
+    }
+
+    void TearDown() override {
+        interval_set_free(&sectors);
+    }
+
+    // Fills the given sectors with a pattern that depends on 'seed'.
+    static void fill(uint32_t start, uint32_t end, uint8_t seed) {
+        for (uint32_t offs = start * FLASH_SECTOR_SIZE; offs < end * FLASH_SECTOR_SIZE; offs++) {
+            flash[offs] = (uint8_t) (offs * 7 + seed);
+        }
+    }
+
+    static void record(uint32_t image_version) {
+        image_header_t header = {};
+        header.magic = IMAGE_HEADER_MAGIC;
+        header.version = IMAGE_HEADER_VERSION;
+        header.image_version = image_version;
+
+        const image_record_t record = image_record_make(&header);
+        std::fill_n(flash.begin() + IMAGE_RECORD_OFFSET, FLASH_SECTOR_SIZE, 0xFF);
+        memcpy(&flash[IMAGE_RECORD_OFFSET], &record, sizeof(record));
+    }
+
+    static uint32_t recorded_version() {
+        const image_header_t* header = image_record_header((const image_record_t*) &flash[IMAGE_RECORD_OFFSET]);
+        return header != nullptr ? header->image_version : 0;
+    }
+
+    static std::vector<uint8_t> program_area() {
+        return std::vector<uint8_t>(flash.begin(), flash.begin() + PROG_AREA_SIZE);
+    }
+
+    // Saves 'sectors', as 'update_firmware()' does before pass 2.
+    bool save() {
+        const uint32_t limit = PROG_AREA_SIZE / FLASH_SECTOR_SIZE;
+        erase_plan_find_blank(blank, &sectors, limit);
+        return rollback_save(&sectors, blank, limit, &caps);
+    }
+
+    // Overwrites 'sectors' with new firmware, as pass 2 does.
+    void update(uint8_t seed, uint32_t image_version) {
+        for (int i = 0; i < sectors.num_intervals; i++) {
+            fill(sectors.intervals[i].start, sectors.intervals[i].end, seed);
+        }
+        record(image_version);
+    }
+
+    // Starts the firmware as 'main()' does.  Returns true if it was rolled back instead.
+    static bool boot() {
+        const bool rolled_back = rollback_check(/* firmware_is_valid: */ true);
+        rollback_count_boot();
+        return rolled_back;
+    }
+
+    static uint32_t boot_count() {
+        return boot_control_decode_boot_count(watchdog.scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH]);
+    }
+};
+
+TEST_F(RollbackSuite, Layout) {
+    // [program area][rollback slot][staging area][bootloader]
+    EXPECT_EQ(ROLLBACK_OFFSET, PROG_AREA_SIZE);
+    EXPECT_EQ(STAGING_OFFSET, ROLLBACK_OFFSET + BOOTLOADER_ROLLBACK_SIZE);
+    EXPECT_EQ(STAGING_OFFSET + BOOTLOADER_STAGING_SIZE + BOOTLOADER_SIZE, (uint32_t) PICO_FLASH_SIZE_BYTES);
+    EXPECT_EQ(sizeof(rollback_header_t), 14u * FLASH_PAGE_SIZE);
+}
+
+TEST_F(RollbackSuite, Empty) {
+    EXPECT_FALSE(rollback_is_armed());
+    EXPECT_FALSE(rollback_check(/* firmware_is_valid: */ false));
+
+    // The firmware may use the register for other purposes.
+    watchdog.scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH] = 0x12345678;
+    rollback_count_boot();
+    EXPECT_EQ(0x12345678u, watchdog.scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH]);
+    EXPECT_TRUE(erases.empty());
+}
+
+TEST_F(RollbackSuite, RestoresAfterFailedBoots) {
+    fill(0, 40, 1);
+    record(1);
+    const std::vector<uint8_t> before = program_area();
+
+    interval_set_union(&sectors, 0, 20);
+    interval_set_union(&sectors, 32, 34);
+    ASSERT_TRUE(save());
+    EXPECT_TRUE(rollback_is_armed());
+    EXPECT_EQ(0u, boot_count());
+
+    update(2, 2);
+    const std::vector<uint8_t> after = program_area();
+
+    // The new firmware starts BOOTLOADER_ROLLBACK_BOOTS times without confirming.
+    for (uint32_t i = 0; i < BOOTLOADER_ROLLBACK_BOOTS; i++) {
+        EXPECT_FALSE(boot()) << "boot " << i;
+        EXPECT_EQ(i + 1, boot_count());
+    }
+    EXPECT_EQ(after, program_area());
+
+    EXPECT_TRUE(boot());
+    EXPECT_EQ(before, program_area());
+    EXPECT_EQ(1u, recorded_version());
+
+    // The slot is emptied, and the restored firmware is not counted.
+    EXPECT_FALSE(rollback_is_armed());
+    EXPECT_EQ(0u, boot_count());
+    EXPECT_FALSE(boot());
+}
+
+TEST_F(RollbackSuite, Confirmed) {
+    fill(0, 16, 1);
+    interval_set_union(&sectors, 0, 16);
+    ASSERT_TRUE(save());
+    update(2, 2);
+
+    EXPECT_FALSE(boot());
+    boot_control_confirm();
+    EXPECT_FALSE(boot());
+    EXPECT_FALSE(rollback_is_armed());
+
+    // Once confirmed, the firmware is kept, even if it later fails.
+    const std::vector<uint8_t> after = program_area();
+    for (uint32_t i = 0; i < 2 * BOOTLOADER_ROLLBACK_BOOTS; i++) {
+        EXPECT_FALSE(boot());
+    }
+    EXPECT_FALSE(rollback_check(/* firmware_is_valid: */ false));
+    EXPECT_EQ(after, program_area());
+    EXPECT_EQ(0u, boot_count());
+}
+
+TEST_F(RollbackSuite, InterruptedUpdate) {
+    fill(0, 16, 1);
+    const std::vector<uint8_t> before = program_area();
+    interval_set_union(&sectors, 0, 16);
+    ASSERT_TRUE(save());
+
+    // Power fails partway through pass 2, before the vector table is written.
+    fill(0, 5, 2);
+    watchdog = {};
+
+    EXPECT_TRUE(rollback_check(/* firmware_is_valid: */ false));
+    EXPECT_EQ(before, program_area());
+}
+
+TEST_F(RollbackSuite, InterruptedRestore) {
+    fill(0, 16, 1);
+    const std::vector<uint8_t> before = program_area();
+    interval_set_union(&sectors, 0, 16);
+    ASSERT_TRUE(save());
+    update(2, 2);
+
+    // Power fails partway through a restore.  (Power-on reset clears the boot count.)
+    flash[ROLLBACK_OFFSET + ROLLBACK_RESTORING_OFFSET] = 0;
+    fill(0, 3, 3);
+    watchdog = {};
+
+    EXPECT_FALSE(rollback_is_armed());
+    EXPECT_TRUE(rollback_check(/* firmware_is_valid: */ true));
+    EXPECT_EQ(before, program_area());
+    EXPECT_EQ(0u, recorded_version());
+}
+
+TEST_F(RollbackSuite, BlankSectors) {
+    // Sector 2 was blank before the update.  It is erased, but not copied.
+    fill(0, 2, 1);
+    fill(3, 4, 1);
+    const std::vector<uint8_t> before = program_area();
+    interval_set_union(&sectors, 0, 4);
+    ASSERT_TRUE(save());
+
+    const rollback_header_t* header = (const rollback_header_t*) &flash[ROLLBACK_OFFSET];
+    const std::vector<uint16_t> expected = { 0, 1, 2 | ROLLBACK_ENTRY_BLANK, 3 };
+    EXPECT_EQ(expected, std::vector<uint16_t>(header->entries, header->entries + header->num_entries));
+
+    // Only three copies were erased and written.
+    EXPECT_EQ(std::vector<uint8_t>(FLASH_SECTOR_SIZE, 0xFF),
+        std::vector<uint8_t>(&flash[ROLLBACK_OFFSET + 4 * FLASH_SECTOR_SIZE], &flash[ROLLBACK_OFFSET + 5 * FLASH_SECTOR_SIZE]));
+
+    update(2, 2);
+    watchdog.scratch[BOOT_CONTROL_BOOT_COUNT_SCRATCH] = boot_control_encode_boot_count(BOOTLOADER_ROLLBACK_BOOTS);
+    EXPECT_TRUE(rollback_check(/* firmware_is_valid: */ true));
+    EXPECT_EQ(before, program_area());
+}
+
+TEST_F(RollbackSuite, LargeErases) {
+    // A restore of a whole 64kB block uses one erase.
+    fill(16, 32, 1);
+    interval_set_union(&sectors, 16, 32);
+    ASSERT_TRUE(save());
+    update(2, 2);
+
+    erases.clear();
+    EXPECT_TRUE(rollback_check(/* firmware_is_valid: */ false));
+
+    const std::vector<std::pair<uint32_t, size_t>> expected = {
+        { 16 * FLASH_SECTOR_SIZE, 16 * FLASH_SECTOR_SIZE },     // Program area
+        { IMAGE_RECORD_OFFSET, FLASH_SECTOR_SIZE },             // Installed image record
+        { ROLLBACK_OFFSET, FLASH_SECTOR_SIZE },                 // Slot header
+    };
+    EXPECT_EQ(expected, erases);
+}
+
+TEST_F(RollbackSuite, ScrubTableErased) {
+    fill(0, 4, 1);
+    record(1);
+    interval_set_union(&sectors, 0, 4);
+    ASSERT_TRUE(save());
+
+    // The update keeps the version, but records a scrub table for the new firmware.
+    update(2, 1);
+    std::fill_n(flash.begin() + IMAGE_RECORD_OFFSET + FLASH_PAGE_SIZE, 64, 0x5A);
+
+    EXPECT_TRUE(rollback_check(/* firmware_is_valid: */ false));
+    EXPECT_EQ(1u, recorded_version());
+    EXPECT_EQ(std::vector<uint8_t>(FLASH_SECTOR_SIZE - FLASH_PAGE_SIZE, 0xFF),
+        std::vector<uint8_t>(&flash[IMAGE_RECORD_OFFSET + FLASH_PAGE_SIZE], &flash[IMAGE_RECORD_OFFSET + FLASH_SECTOR_SIZE]));
+}
+
+TEST_F(RollbackSuite, CorruptCopy) {
+    fill(0, 16, 1);
+    interval_set_union(&sectors, 0, 16);
+    ASSERT_TRUE(save());
+    update(2, 2);
+    const std::vector<uint8_t> after = program_area();
+
+    flash[ROLLBACK_OFFSET + FLASH_SECTOR_SIZE + 100] ^= 0x10;
+
+    // The slot is discarded rather than restoring a corrupt copy.
+    EXPECT_FALSE(rollback_check(/* firmware_is_valid: */ false));
+    EXPECT_FALSE(rollback_is_armed());
+    EXPECT_EQ(after, program_area());
+}
+
+TEST_F(RollbackSuite, TooLarge) {
+    fill(0, ROLLBACK_CAPACITY + 1, 1);
+    interval_set_union(&sectors, 0, ROLLBACK_CAPACITY + 1);
+    EXPECT_FALSE(save());
+    EXPECT_FALSE(rollback_is_armed());
+
+    // Blank sectors need no copy.
+    std::fill_n(flash.begin(), FLASH_SECTOR_SIZE, 0xFF);
+    EXPECT_TRUE(save());
+}
+
+TEST_F(RollbackSuite, SmallerFlash) {
+    // The slot would wrap around on a smaller chip.
+    fill(0, 16, 1);
+    interval_set_union(&sectors, 0, 16);
+    caps.size_bytes = PICO_FLASH_SIZE_BYTES / 2;
+    EXPECT_FALSE(save());
+    EXPECT_FALSE(rollback_is_armed());
+}
+
+TEST_F(RollbackSuite, NextUpdateReplacesSlot) {
+    fill(0, 16, 1);
+    interval_set_union(&sectors, 0, 16);
+    ASSERT_TRUE(save());
+    update(2, 2);
+    boot_control_confirm();
+    EXPECT_FALSE(boot());
+
+    // The next update saves the confirmed firmware and is armed again.
+    const std::vector<uint8_t> confirmed = program_area();
+    ASSERT_TRUE(save());
+    EXPECT_TRUE(rollback_is_armed());
+    update(3, 3);
+
+    EXPECT_TRUE(rollback_check(/* firmware_is_valid: */ false));
+    EXPECT_EQ(confirmed, program_area());
+    EXPECT_EQ(2u, recorded_version());
+}
@@ -0,0 +1,127 @@
+// Standard
+#include <string.h>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "crc32.h"
+#include "scrub.h"
+
+static_assert(sizeof(scrub_table_t) == SCRUB_TABLE_SIZE, "The table fills the record sector after the record");
+
+class ScrubSuite : public ::testing::Test {
+protected:
+    std::vector<uint8_t> flash;
+    scrub_table_t table;
+
+    // Fills 'size' bytes of flash with a pattern and builds the table for them.
+    void build(uint32_t size) {
+        flash.resize(size);
+        for (uint32_t i = 0; i < size; i++) {
+            flash[i] = (uint8_t) (i * 7 + i / 4096);
+        }
+        scrub_table_build(&table, flash.data(), size);
+    }
+
+    int check(uint32_t first, uint32_t count) {
+        return scrub_check(&table, flash.data(), first, count);
+    }
+};
+
+TEST_F(ScrubSuite, Build) {
+    build(16 * FLASH_SECTOR_SIZE);
+
+    EXPECT_TRUE(scrub_table_is_valid(&table));
+    EXPECT_EQ(table.header.num_chunks, 16);
+    EXPECT_EQ(table.header.chunk_size, (uint32_t) FLASH_SECTOR_SIZE);
+    EXPECT_EQ(table.header.size, 16u * FLASH_SECTOR_SIZE);
+
+    for (uint32_t i = 0; i < 16; i++) {
+        EXPECT_EQ(table.chunk_crcs[i], crc32_update(0, &flash[i * FLASH_SECTOR_SIZE], FLASH_SECTOR_SIZE)) << "chunk " << i;
+    }
+
+    // Unused entries stay erased, and only the pages holding entries are programmed.
+    EXPECT_EQ(table.chunk_crcs[16], 0xFFFFFFFFu);
+    EXPECT_EQ(scrub_table_prog_size(&table), (uint32_t) FLASH_PAGE_SIZE);
+    EXPECT_EQ(check(0, 16), -1);
+}
+
+TEST_F(ScrubSuite, LargeImage) {
+    // One sector more than the table has entries for doubles the chunk size, leaving a
+    // shorter last chunk.
+    build((SCRUB_MAX_CHUNKS + 1) * FLASH_SECTOR_SIZE);
+
+    EXPECT_TRUE(scrub_table_is_valid(&table));
+    EXPECT_EQ(table.header.chunk_size, 2u * FLASH_SECTOR_SIZE);
+    EXPECT_EQ(table.header.num_chunks, (SCRUB_MAX_CHUNKS + 2) / 2);
+    EXPECT_EQ(scrub_table_prog_size(&table), 8u * FLASH_PAGE_SIZE);
+    EXPECT_EQ(check(0, table.header.num_chunks), -1);
+
+    flash.back() ^= 1;
+    EXPECT_EQ(check(0, table.header.num_chunks), table.header.num_chunks - 1);
+}
+
+TEST_F(ScrubSuite, Corruption) {
+    build(16 * FLASH_SECTOR_SIZE);
+    flash[5 * FLASH_SECTOR_SIZE + 100] ^= 0x10;
+
+    EXPECT_EQ(check(0, 16), 5);
+    EXPECT_EQ(check(6, 3), -1);
+
+    // The check wraps around to chunk 0.
+    EXPECT_EQ(check(15, 6), -1);
+    EXPECT_EQ(check(15, 7), 5);
+
+    // A count larger than the table checks each chunk once.
+    EXPECT_EQ(check(6, 100), 5);
+}
+
+TEST_F(ScrubSuite, Invalid) {
+    build(16 * FLASH_SECTOR_SIZE);
+
+    scrub_table_t erased;
+    memset(&erased, 0xFF, sizeof(erased));
+    EXPECT_FALSE(scrub_table_is_valid(&erased));
+
+    scrub_table_t corrupt = table;
+    corrupt.chunk_crcs[3] ^= 1;
+    EXPECT_FALSE(scrub_table_is_valid(&corrupt));
+
+    corrupt = table;
+    corrupt.header.version++;
+    EXPECT_FALSE(scrub_table_is_valid(&corrupt));
+
+    // The entry count must match the size (even if the CRC does).
+    corrupt = table;
+    corrupt.header.num_chunks = SCRUB_MAX_CHUNKS + 1;
+    corrupt.header.size = corrupt.header.num_chunks * FLASH_SECTOR_SIZE;
+    EXPECT_FALSE(scrub_table_is_valid(&corrupt));
+}
+
+TEST_F(ScrubSuite, MarkedFailed) {
+    image_record_t record;
+    memset(&record, 0, sizeof(record));
+    EXPECT_TRUE(scrub_is_marked_failed(&record));
+
+    // The marked record is not a valid record (of firmware with or without a header).
+    EXPECT_EQ(image_record_header(&record), nullptr);
+
+    const image_record_t erased = image_record_make(NULL);
+    EXPECT_FALSE(scrub_is_marked_failed(&erased));
+
+    const image_header_t none = {};
+    const image_record_t unversioned = image_record_make(&none);
+    EXPECT_FALSE(scrub_is_marked_failed(&unversioned));
+}
+
+TEST_F(ScrubSuite, ChunksFor) {
+    build(16 * FLASH_SECTOR_SIZE);
+
+    EXPECT_EQ(scrub_chunks_for(&table, 0), 1u);
+    EXPECT_EQ(scrub_chunks_for(&table, 4096), 1u);
+    EXPECT_EQ(scrub_chunks_for(&table, 4097), 2u);
+    EXPECT_EQ(scrub_chunks_for(&table, 64 * 1024), 16u);
+    EXPECT_EQ(scrub_chunks_for(&table, 0xFFFFFFFF), 16u);
+}
@@ -0,0 +1,328 @@
+// Standard
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "sd_emulator.h"
+
+static constexpr uint32_t image_size = 512 * 1024;
+
+// Minimal SPI mode host, just enough to exercise the emulator.
+class SdEmulatorSuite : public ::testing::Test {
+protected:
+    SdEmulator card{ std::vector<uint8_t>(image_size) };
+
+    void SetUp() override {
+        for (size_t i = 0; i < card.image().size(); i++) {
+            card.image()[i] = (uint8_t) (i * 7 + i / SdEmulator::block_size);
+        }
+
+        // At least 74 clocks with CS deasserted, then select the card.
+        clock(10);
+        card.select(true);
+    }
+
+    uint8_t xfer(uint8_t value = 0xFF) { return card.transfer(value); }
+
+    void clock(int count) {
+        for (int i = 0; i < count; i++) { xfer(); }
+    }
+
+    void send_cmd(uint8_t cmd, uint32_t arg, bool valid_crc = true) {
+        uint8_t frame[6] = {
+            (uint8_t) (0x40 | cmd),
+            (uint8_t) (arg >> 24), (uint8_t) (arg >> 16), (uint8_t) (arg >> 8), (uint8_t) arg,
+        };
+        frame[5] = (SdEmulator::crc7(frame, 5) << 1) | 1;
+        if (!valid_crc) { frame[5] ^= 0x02; }
+
+        for (uint8_t byte : frame) { xfer(byte); }
+    }
+
+    // Returns the R1 response, or 0xFF if the card did not respond within N_CR.  'ncr'
+    // receives the position of R1 (1-based).
+    uint8_t response(int* ncr = nullptr) {
+        for (int i = 1; i <= 9; i++) {
+            const uint8_t r1 = xfer();
+            if ((r1 & 0x80) == 0) {
+                if (ncr != nullptr) { *ncr = i; }
+                return r1;
+            }
+        }
+        return 0xFF;
+    }
+
+    uint8_t cmd(uint8_t cmd, uint32_t arg, bool valid_crc = true) {
+        send_cmd(cmd, arg, valid_crc);
+        return response();
+    }
+
+    uint8_t acmd(uint8_t cmd, uint32_t arg) {
+        this->cmd(55, 0);
+        return this->cmd(cmd, arg);
+    }
+
+    void init() {
+        ASSERT_EQ(cmd(0, 0), 0x01);
+        ASSERT_EQ(cmd(8, 0x1AA), 0x01);
+        clock(4);
+
+        for (int i = 0; i < 100 && acmd(41, 1u << 30) != 0x00; i++) { }
+        ASSERT_EQ(acmd(41, 1u << 30), 0x00);
+    }
+
+    // Waits for a data token and returns it.  'access' counts the bytes before the token.
+    uint8_t token(uint32_t* access = nullptr) {
+        uint32_t count = 0;
+        uint8_t value;
+        while ((value = xfer()) == 0xFF && count < 100000) { count++; }
+        if (access != nullptr) { *access = count; }
+        return value;
+    }
+
+    std::vector<uint8_t> read_data(size_t len) {
+        EXPECT_EQ(token(), 0xFE);
+
+        std::vector<uint8_t> data(len);
+        for (auto& byte : data) { byte = xfer(); }
+
+        const uint16_t crc = (xfer() << 8) | xfer();
+        EXPECT_EQ(crc, SdEmulator::crc16(data.data(), data.size()));
+        return data;
+    }
+
+    // Sends a data block and returns the data response, after waiting out busy.
+    uint8_t write_data(uint8_t start_token, const std::vector<uint8_t>& data, bool valid_crc = true) {
+        xfer();
+        xfer(start_token);
+        for (uint8_t byte : data) { xfer(byte); }
+
+        uint16_t crc = SdEmulator::crc16(data.data(), data.size());
+        if (!valid_crc) { crc ^= 1; }
+        xfer(crc >> 8);
+        xfer(crc & 0xFF);
+
+        const uint8_t response = xfer() & 0x1F;
+        wait_busy();
+        return response;
+    }
+
+    uint32_t wait_busy() {
+        uint32_t count = 0;
+        while (xfer() != 0xFF) { count++; }
+        return count;
+    }
+
+    std::vector<uint8_t> block(uint32_t index) {
+        const auto begin = card.image().begin() + index * SdEmulator::block_size;
+        return std::vector<uint8_t>(begin, begin + SdEmulator::block_size);
+    }
+};
+
+TEST_F(SdEmulatorSuite, Crc) {
+    // CMD0 and CMD8 examples from the SD Physical Layer Specification.
+    const uint8_t cmd0[] = { 0x40, 0, 0, 0, 0 };
+    const uint8_t cmd8[] = { 0x48, 0, 0, 0x01, 0xAA };
+    EXPECT_EQ(SdEmulator::crc7(cmd0, sizeof(cmd0)), 0x95 >> 1);
+    EXPECT_EQ(SdEmulator::crc7(cmd8, sizeof(cmd8)), 0x87 >> 1);
+
+    // 512 bytes of 0xFF.
+    const std::vector<uint8_t> ones(512, 0xFF);
+    EXPECT_EQ(SdEmulator::crc16(ones.data(), ones.size()), 0x7FA1);
+}
+
+TEST_F(SdEmulatorSuite, IgnoresCommandsBeforeCmd0) {
+    EXPECT_EQ(cmd(8, 0x1AA), 0xFF);
+    EXPECT_EQ(cmd(0, 0, /* valid_crc: */ false), 0xFF);
+    EXPECT_EQ(cmd(0, 0), 0x01);
+}
+
+TEST_F(SdEmulatorSuite, IgnoresBusWhileDeselected) {
+    card.select(false);
+    send_cmd(0, 0);
+    EXPECT_EQ(response(), 0xFF);
+
+    card.select(true);
+    EXPECT_EQ(cmd(0, 0), 0x01);
+}
+
+TEST_F(SdEmulatorSuite, Cmd8EchoesCheckPattern) {
+    ASSERT_EQ(cmd(0, 0), 0x01);
+    ASSERT_EQ(cmd(8, 0x1AA), 0x01);
+
+    const uint8_t r7[] = { xfer(), xfer(), xfer(), xfer() };
+    EXPECT_EQ(r7[2], 0x01);
+    EXPECT_EQ(r7[3], 0xAA);
+}
+
+TEST_F(SdEmulatorSuite, DataCommandsIllegalWhileIdle) {
+    ASSERT_EQ(cmd(0, 0), 0x01);
+    EXPECT_EQ(cmd(17, 0), 0x05);
+}
+
+TEST_F(SdEmulatorSuite, InitLatency) {
+    // 10ms at 400kHz is 500 byte times.
+    card.set_latency_us(41, 10000);
+
+    ASSERT_EQ(cmd(0, 0), 0x01);
+
+    const uint64_t start = card.stats().bytes_clocked;
+    ASSERT_EQ(acmd(41, 1u << 30), 0x01);
+    while (acmd(41, 1u << 30) != 0x00) { clock(10); }
+    EXPECT_GE(card.stats().bytes_clocked - start, 500u);
+    EXPECT_GE(card.elapsed_us(), 10000u);
+}
+
+TEST_F(SdEmulatorSuite, ReadOcr) {
+    ASSERT_EQ(cmd(0, 0), 0x01);
+    ASSERT_EQ(cmd(58, 0), 0x01);
+    EXPECT_EQ(xfer() & 0x80, 0x00);    // Busy while initializing
+    clock(3);
+
+    init();
+    ASSERT_EQ(cmd(58, 0), 0x00);
+    EXPECT_EQ(xfer(), 0xC0);           // Powered up, SDHC
+}
+
+TEST_F(SdEmulatorSuite, Csd) {
+    init();
+    ASSERT_EQ(cmd(9, 0), 0x00);
+
+    const auto csd = read_data(16);
+    EXPECT_EQ(csd[0] >> 6, 1);         // CSD version 2.0
+
+    const uint32_t c_size = ((csd[7] & 0x3F) << 16) | (csd[8] << 8) | csd[9];
+    EXPECT_EQ((c_size + 1) * 1024, card.num_blocks());
+    EXPECT_EQ(csd[15], (SdEmulator::crc7(csd.data(), 15) << 1) | 1);
+}
+
+TEST_F(SdEmulatorSuite, ReadSingleBlock) {
+    init();
+    ASSERT_EQ(cmd(17, 3), 0x00);
+    EXPECT_EQ(read_data(SdEmulator::block_size), block(3));
+    EXPECT_EQ(card.stats().blocks_read, 1u);
+}
+
+TEST_F(SdEmulatorSuite, ReadOutOfRange) {
+    init();
+    EXPECT_EQ(cmd(17, card.num_blocks()), 0x20);
+}
+
+TEST_F(SdEmulatorSuite, ReadMultipleBlocks) {
+    init();
+    ASSERT_EQ(cmd(18, 5), 0x00);
+    for (uint32_t i = 5; i < 9; i++) {
+        EXPECT_EQ(read_data(SdEmulator::block_size), block(i));
+    }
+
+    // Stop transmission: skip the stuff byte, then R1 and busy.
+    send_cmd(12, 0);
+    xfer();
+    EXPECT_EQ(response(), 0x00);
+    wait_busy();
+
+    // The card has stopped streaming and accepts new commands.
+    clock(1000);
+    ASSERT_EQ(cmd(17, 0), 0x00);
+    EXPECT_EQ(read_data(SdEmulator::block_size), block(0));
+}
+
+TEST_F(SdEmulatorSuite, ReadMultiplePastEnd) {
+    init();
+    ASSERT_EQ(cmd(18, card.num_blocks() - 1), 0x00);
+    EXPECT_EQ(read_data(SdEmulator::block_size), block(card.num_blocks() - 1));
+    EXPECT_EQ(token(), 0x08);           // Out of range error token
+}
+
+TEST_F(SdEmulatorSuite, WriteBlock) {
+    init();
+
+    const std::vector<uint8_t> data(SdEmulator::block_size, 0xA5);
+    ASSERT_EQ(cmd(24, 2), 0x00);
+    EXPECT_EQ(write_data(0xFE, data), 0x05);
+    EXPECT_EQ(block(2), data);
+    EXPECT_EQ(card.stats().blocks_written, 1u);
+}
+
+TEST_F(SdEmulatorSuite, WriteMultipleBlocks) {
+    init();
+    ASSERT_EQ(acmd(23, 3), 0x00);
+    ASSERT_EQ(cmd(25, 10), 0x00);
+
+    for (uint8_t i = 0; i < 3; i++) {
+        EXPECT_EQ(write_data(0xFC, std::vector<uint8_t>(SdEmulator::block_size, i)), 0x05);
+    }
+
+    xfer(0xFD);
+    xfer();
+    wait_busy();
+
+    for (uint8_t i = 0; i < 3; i++) {
+        EXPECT_EQ(block(10 + i), std::vector<uint8_t>(SdEmulator::block_size, i));
+    }
+
+    EXPECT_EQ(card.stats().blocks_written, 3u);
+    EXPECT_EQ(card.stats().commands[25], 1u);
+    EXPECT_EQ(card.stats().app_commands[23], 1u);
+}
+
+TEST_F(SdEmulatorSuite, CrcChecking) {
+    init();
+
+    // CRCs are ignored by default (except for CMD0 and CMD8).
+    EXPECT_EQ(cmd(13, 0, /* valid_crc: */ false), 0x00);
+    clock(1);
+
+    ASSERT_EQ(cmd(59, 1), 0x00);
+    EXPECT_EQ(cmd(13, 0, /* valid_crc: */ false), 0x08);
+
+    const auto original = block(1);
+    ASSERT_EQ(cmd(24, 1), 0x00);
+    EXPECT_EQ(write_data(0xFE, std::vector<uint8_t>(SdEmulator::block_size), /* valid_crc: */ false), 0x0B);
+    EXPECT_EQ(block(1), original);
+    EXPECT_EQ(card.stats().crc_errors, 2u);
+}
+
+TEST_F(SdEmulatorSuite, Latency) {
+    init();
+    card.set_clock_hz(8000000);         // 1 byte per microsecond
+
+    card.set_latency_us(17, 250);
+    ASSERT_EQ(cmd(17, 0), 0x00);
+    uint32_t access;
+    EXPECT_EQ(token(&access), 0xFE);
+    EXPECT_EQ(access, 250u);
+    clock(SdEmulator::block_size + 2);
+
+    card.set_latency_us(24, 1000);
+    ASSERT_EQ(cmd(24, 0), 0x00);
+    xfer(0xFE);
+    clock(SdEmulator::block_size + 2);
+    EXPECT_EQ(xfer() & 0x1F, 0x05);
+    EXPECT_EQ(wait_busy(), 1000u);
+
+    // N_CR is limited to 8 bytes, so R1 arrives no later than the 9th byte.
+    int ncr;
+    card.set_latency_us(13, 1000);
+    send_cmd(13, 0);
+    EXPECT_EQ(response(&ncr), 0x00);
+    EXPECT_EQ(ncr, 9);
+}
+
+TEST_F(SdEmulatorSuite, Stats) {
+    init();
+    card.reset_stats();
+    card.set_clock_hz(12500000);
+
+    ASSERT_EQ(cmd(17, 0), 0x00);
+    read_data(SdEmulator::block_size);
+
+    EXPECT_EQ(card.stats().commands[17], 1u);
+    EXPECT_EQ(card.stats().total_commands(), 1u);
+
+    // 6 command bytes + N_CR + R1 + token + 512 data + 2 CRC.
+    EXPECT_EQ(card.stats().bytes_clocked, 6u + 1 + 1 + 1 + 512 + 2);
+    EXPECT_EQ(card.elapsed_us(), card.stats().bytes_clocked * 8 * 1000000 / 12500000);
+}
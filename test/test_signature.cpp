@@ -0,0 +1,255 @@
+// Standard
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "ed25519.h"
+#include "image_builder.h"
+#include "prog.h"
+#include "sha256.h"
+#include "sha512.h"
+#include "signature.h"
+
+static std::vector<uint8_t> from_hex(const char* hex) {
+    std::vector<uint8_t> result;
+    for (size_t i = 0; hex[i] != '\0'; i += 2) {
+        result.push_back((uint8_t) std::stoul(std::string(hex + i, 2), nullptr, 16));
+    }
+    return result;
+}
+
+static std::vector<uint8_t> sha256(const std::string& message) {
+    std::vector<uint8_t> digest(SHA256_DIGEST_SIZE);
+    sha256_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, message.data(), message.size());
+    sha256_final(&ctx, digest.data());
+    return digest;
+}
+
+TEST(Sha256Suite, KnownAnswer) {
+    // FIPS 180-4 examples.
+    EXPECT_EQ(from_hex("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"), sha256(""));
+    EXPECT_EQ(from_hex("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"), sha256("abc"));
+    EXPECT_EQ(from_hex("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"),
+        sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+}
+
+TEST(Sha256Suite, Incremental) {
+    // One million 'a's, fed in uneven pieces that straddle block boundaries.
+    const std::string chunk(997, 'a');
+    sha256_t ctx;
+    sha256_init(&ctx);
+
+    size_t remaining = 1000000;
+    while (remaining > 0) {
+        const size_t count = std::min(remaining, chunk.size());
+        sha256_update(&ctx, chunk.data(), count);
+        remaining -= count;
+    }
+
+    std::vector<uint8_t> digest(SHA256_DIGEST_SIZE);
+    sha256_final(&ctx, digest.data());
+    EXPECT_EQ(from_hex("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"), digest);
+}
+
+TEST(Sha512Suite, KnownAnswer) {
+    std::vector<uint8_t> digest(SHA512_DIGEST_SIZE);
+    sha512_t ctx;
+    sha512_init(&ctx);
+    sha512_update(&ctx, "abc", 3);
+    sha512_final(&ctx, digest.data());
+
+    EXPECT_EQ(from_hex(
+        "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+        "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f"), digest);
+}
+
+// RFC 8032, section 7.1, tests 1 and 2.
+static const char* rfc8032_pk1 = "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a";
+static const char* rfc8032_sig1 =
+    "e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e065224901555fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b";
+static const char* rfc8032_pk2 = "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c";
+static const char* rfc8032_sig2 =
+    "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00";
+
+TEST(Ed25519Suite, KnownAnswer) {
+    const uint8_t message = 0x72;
+    EXPECT_TRUE(ed25519_verify(from_hex(rfc8032_sig1).data(), nullptr, 0, from_hex(rfc8032_pk1).data()));
+    EXPECT_TRUE(ed25519_verify(from_hex(rfc8032_sig2).data(), &message, 1, from_hex(rfc8032_pk2).data()));
+}
+
+TEST(Ed25519Suite, RejectsTampering) {
+    const std::vector<uint8_t> pk = from_hex(rfc8032_pk2);
+    const std::vector<uint8_t> sig = from_hex(rfc8032_sig2);
+    const uint8_t message = 0x72;
+
+    // Wrong message.
+    const uint8_t other = 0x73;
+    EXPECT_FALSE(ed25519_verify(sig.data(), &other, 1, pk.data()));
+
+    // Wrong key.
+    EXPECT_FALSE(ed25519_verify(sig.data(), &message, 1, from_hex(rfc8032_pk1).data()));
+
+    // Any flipped bit in the signature.
+    for (size_t bit = 0; bit < sig.size() * 8; bit += 37) {
+        std::vector<uint8_t> bad = sig;
+        bad[bit / 8] ^= 1 << (bit % 8);
+        EXPECT_FALSE(ed25519_verify(bad.data(), &message, 1, pk.data())) << "bit " << bit;
+    }
+}
+
+TEST(Ed25519Suite, RejectsUnreducedScalar) {
+    // S + L verifies mathematically, but RFC 8032 requires rejecting S >= L.
+    static const uint8_t L[32] = {
+        0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10
+    };
+
+    std::vector<uint8_t> sig = from_hex(rfc8032_sig1);
+    unsigned carry = 0;
+    for (int i = 0; i < 32; i++) {
+        carry += sig[32 + i] + L[i];
+        sig[32 + i] = (uint8_t) carry;
+        carry >>= 8;
+    }
+
+    EXPECT_FALSE(ed25519_verify(sig.data(), nullptr, 0, from_hex(rfc8032_pk1).data()));
+}
+
+// The SignatureSuite image, signed by 'scripts/uf2_sign.py' with the RFC 8032 test 1 key.
+static const char* image_signature =
+    "113e952544fd68e1a2a3715c003a6d2c8203073791d6a53025726c7742536ebee18096616c8b8190b798f433c821a2b0765bb680ef7129b96eca9dc4cd38a108";
+
+static bool hash_block_cb(prog_t* prog, const struct uf2_block* block) {
+    signature_hash_block(&prog->signature, block);
+    return true;
+}
+
+class SignatureSuite : public ::testing::Test {
+protected:
+    prog_t prog;
+    ImageBuilder image;
+    std::vector<uint8_t> public_key = from_hex(rfc8032_pk1);
+
+    void SetUp() override {
+        prog_init(&prog);
+        prog.accept_block = hash_block_cb;
+
+        // (No vector table, which 'process_block' would check.)
+        image.add_page(0, 0x11);
+        image.add_page(FLASH_SECTOR_SIZE, 0x33);
+        image.add_page(FLASH_SECTOR_SIZE + 3 * FLASH_PAGE_SIZE, 0x44);
+        image.add_page(5 * FLASH_SECTOR_SIZE + 15 * FLASH_PAGE_SIZE, 0x55);
+    }
+
+    void TearDown() override {
+        prog_free(&prog);
+    }
+
+    static struct uf2_block signature_block(const std::vector<uint8_t>& signature) {
+        struct uf2_block block = {};
+        block.magic_start0 = UF2_MAGIC_START0;
+        block.magic_start1 = UF2_MAGIC_START1;
+        block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT;
+        block.payload_size = sizeof(signature_header_t);
+        block.file_size = RP2040_FAMILY_ID;
+        block.magic_end = UF2_MAGIC_END;
+
+        signature_header_t header = {};
+        header.magic = SIGNATURE_MAGIC;
+        header.version = SIGNATURE_VERSION;
+        header.algorithm = SIGNATURE_ALGORITHM_ED25519;
+        memcpy(header.signature, signature.data(), sizeof(header.signature));
+        memcpy(block.data, &header, sizeof(header));
+        return block;
+    }
+
+    // Returns the image's flash blocks followed by the given extra blocks, numbered in order.
+    std::vector<struct uf2_block> uf2(const std::vector<struct uf2_block>& extra) const {
+        std::vector<struct uf2_block> blocks = image.flash_blocks();
+        blocks.insert(blocks.end(), extra.begin(), extra.end());
+
+        for (size_t i = 0; i < blocks.size(); i++) {
+            blocks[i].block_no = i;
+            blocks[i].num_blocks = blocks.size();
+        }
+        return blocks;
+    }
+
+    bool read(const std::vector<struct uf2_block>& blocks) {
+        prog_restart(&prog);
+        for (const auto& block : blocks) {
+            if (!process_block(&prog, &block)) { return false; }
+        }
+        return prog_is_complete(&prog);
+    }
+};
+
+TEST_F(SignatureSuite, Verify) {
+    const auto blocks = uf2({ signature_block(from_hex(image_signature)) });
+
+    ASSERT_TRUE(read(blocks));
+    EXPECT_TRUE(prog.signature.is_present);
+    EXPECT_TRUE(signature_verify(&prog.signature, public_key.data()));
+
+    // Reading the same file again produces the verified digest.
+    ASSERT_TRUE(read(blocks));
+    EXPECT_TRUE(signature_matches(&prog.signature));
+}
+
+TEST_F(SignatureSuite, RejectUnsigned) {
+    ASSERT_TRUE(read(uf2({})));
+    EXPECT_FALSE(prog.signature.is_present);
+    EXPECT_FALSE(signature_verify(&prog.signature, public_key.data()));
+    EXPECT_FALSE(signature_matches(&prog.signature));
+}
+
+TEST_F(SignatureSuite, RejectModifiedImage) {
+    image.add_page(FLASH_SECTOR_SIZE, 0x34);
+
+    ASSERT_TRUE(read(uf2({ signature_block(from_hex(image_signature)) })));
+    EXPECT_FALSE(signature_verify(&prog.signature, public_key.data()));
+}
+
+TEST_F(SignatureSuite, RejectMovedBlock) {
+    // The digest covers target addresses as well as payloads.
+    const std::vector<uint8_t> page = image.pages[5 * FLASH_SECTOR_SIZE + 15 * FLASH_PAGE_SIZE];
+    image.pages.erase(5 * FLASH_SECTOR_SIZE + 15 * FLASH_PAGE_SIZE);
+    image.pages[6 * FLASH_SECTOR_SIZE] = page;
+
+    ASSERT_TRUE(read(uf2({ signature_block(from_hex(image_signature)) })));
+    EXPECT_FALSE(signature_verify(&prog.signature, public_key.data()));
+}
+
+TEST_F(SignatureSuite, DetectChangeBetweenReads) {
+    ASSERT_TRUE(read(uf2({ signature_block(from_hex(image_signature)) })));
+    ASSERT_TRUE(signature_verify(&prog.signature, public_key.data()));
+
+    image.add_page(FLASH_SECTOR_SIZE, 0x34);
+    ASSERT_TRUE(read(uf2({ signature_block(from_hex(image_signature)) })));
+    EXPECT_FALSE(signature_matches(&prog.signature));
+}
+
+TEST_F(SignatureSuite, RejectMalformed) {
+    const struct uf2_block good = signature_block(from_hex(image_signature));
+
+    // Only one signature is allowed.
+    EXPECT_FALSE(read(uf2({ good, good })));
+
+    struct uf2_block bad = good;
+    ((signature_header_t*) bad.data)->version = SIGNATURE_VERSION + 1;
+    EXPECT_FALSE(read(uf2({ bad })));
+
+    bad = good;
+    ((signature_header_t*) bad.data)->algorithm = SIGNATURE_ALGORITHM_ED25519 + 1;
+    EXPECT_FALSE(read(uf2({ bad })));
+
+    bad = good;
+    bad.payload_size = sizeof(signature_header_t) - 1;
+    EXPECT_FALSE(read(uf2({ bad })));
+}
@@ -0,0 +1,201 @@
+// Standard
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "boot_control.h"
+#include "crc32.h"
+#include "flash.h"
+#include "image_builder.h"
+#include "prog.h"
+#include "staging.h"
+#include "vector_table.h"
+
+static std::vector<uint8_t> flash(PICO_FLASH_SIZE_BYTES, 0xFF);
+static std::vector<std::pair<uint32_t, size_t>> erases;
+
+const uint8_t* flash_contents(uint32_t flash_offs) {
+    return flash.data() + flash_offs;
+}
+
+void flash_erase(uint32_t flash_offs, size_t count) {
+    erases.push_back({ flash_offs, count });
+    std::fill_n(flash.begin() + flash_offs, count, 0xFF);
+}
+
+// Blocks received from 'staging_transport.read_uf2()'.
+static std::vector<struct uf2_block> blocks_read;
+
+static bool record_block(prog_t* prog, const struct uf2_block* block) {
+    blocks_read.push_back(*block);
+    return true;
+}
+
+class StagingSuite : public ::testing::Test {
+protected:
+    prog_t prog;
+
+    void SetUp() override {
+        std::fill(flash.begin(), flash.end(), 0xFF);
+        erases.clear();
+        blocks_read.clear();
+        prog_init(&prog);
+    }
+
+    void TearDown() override {
+        prog_free(&prog);
+    }
+
+    // Writes the image and header to the staging area, as the firmware would.
+    static void stage(uint16_t format, const std::vector<uint8_t>& image) {
+        ASSERT_LE(image.size(), BOOTLOADER_STAGING_SIZE - BOOT_CONTROL_STAGING_DATA_OFFSET);
+        std::copy(image.begin(), image.end(), flash.begin() + STAGING_OFFSET + BOOT_CONTROL_STAGING_DATA_OFFSET);
+
+        const boot_control_staging_header_t header = boot_control_staging_header(format, image.data(), image.size());
+        memcpy(&flash[STAGING_OFFSET], &header, sizeof(header));
+    }
+
+    static std::vector<uint8_t> to_file(const std::vector<struct uf2_block>& blocks) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(blocks.data());
+        return std::vector<uint8_t>(bytes, bytes + blocks.size() * sizeof(struct uf2_block));
+    }
+
+    // Returns a binary with the given number of bytes and a valid vector table.
+    static std::vector<uint8_t> make_binary(size_t size) {
+        std::vector<uint8_t> binary(size);
+        for (size_t i = 0; i < size; i++) {
+            binary[i] = (uint8_t) (i * 7);
+        }
+
+        const uint32_t vt[] = { SRAM_END, (VECTOR_TABLE_ADDR + VECTOR_TABLE_SIZE) | 1 };
+        memcpy(&binary[VECTOR_TABLE_ADDR - XIP_BASE], vt, sizeof(vt));
+        return binary;
+    }
+};
+
+TEST_F(StagingSuite, Layout) {
+    // The staging area sits between the program area and the bootloader.
+    EXPECT_EQ(BOOT_CONTROL_STAGING_OFFSET(PICO_FLASH_SIZE_BYTES, BOOTLOADER_SIZE, BOOTLOADER_STAGING_SIZE), STAGING_OFFSET);
+    EXPECT_EQ(PROG_AREA_END - XIP_BASE, STAGING_OFFSET);
+    EXPECT_EQ(0u, STAGING_OFFSET % FLASH_SECTOR_SIZE);
+}
+
+TEST_F(StagingSuite, HeaderCrcMatchesBootloader) {
+    const std::vector<uint8_t> binary = make_binary(1000);
+    EXPECT_EQ(crc32_update(0, binary.data(), binary.size()), boot_control_crc32(0, binary.data(), binary.size()));
+    EXPECT_EQ(0xCBF43926u, boot_control_crc32(0, "123456789", 9));
+}
+
+TEST_F(StagingSuite, NothingStaged) {
+    EXPECT_FALSE(staging_transport.uf2_exists());
+    EXPECT_FALSE(staging_transport.read_uf2(&prog, record_block));
+}
+
+TEST_F(StagingSuite, Uf2) {
+    ImageBuilder image;
+    image.add_page(0, 0x11);
+    image.add_page(FLASH_SECTOR_SIZE, 0x22);
+    image.add_page(3 * FLASH_SECTOR_SIZE, 0x33);
+
+    std::vector<struct uf2_block> blocks = image.flash_blocks();
+    const std::vector<uint8_t> file = to_file(blocks);
+    stage(BOOT_CONTROL_STAGING_UF2, file);
+
+    ASSERT_TRUE(staging_transport.uf2_exists());
+    ASSERT_TRUE(staging_transport.read_uf2(&prog, record_block));
+    ASSERT_EQ(blocks.size(), blocks_read.size());
+    EXPECT_EQ(0, memcmp(blocks.data(), blocks_read.data(), file.size()));
+}
+
+TEST_F(StagingSuite, Dense) {
+    // Two and a half pages: the last page is padded with erased bytes.
+    const std::vector<uint8_t> binary = make_binary(2 * FLASH_PAGE_SIZE + 100);
+    stage(BOOT_CONTROL_STAGING_DENSE, binary);
+
+    ASSERT_TRUE(staging_transport.read_uf2(&prog, record_block));
+    ASSERT_EQ(3u, blocks_read.size());
+
+    for (uint32_t i = 0; i < blocks_read.size(); i++) {
+        const struct uf2_block& block = blocks_read[i];
+        EXPECT_EQ(XIP_BASE + i * FLASH_PAGE_SIZE, block.target_addr);
+        EXPECT_EQ(i, block.block_no);
+        EXPECT_EQ(3u, block.num_blocks);
+        EXPECT_EQ(FLASH_PAGE_SIZE, block.payload_size);
+    }
+
+    EXPECT_EQ(0, memcmp(blocks_read[2].data, &binary[2 * FLASH_PAGE_SIZE], 100));
+    EXPECT_TRUE(std::all_of(blocks_read[2].data + 100, blocks_read[2].data + FLASH_PAGE_SIZE,
+        [](uint8_t b) { return b == 0xFF; }));
+}
+
+TEST_F(StagingSuite, DenseIsValidProgram) {
+    stage(BOOT_CONTROL_STAGING_DENSE, make_binary(8 * FLASH_PAGE_SIZE));
+
+    prog.accept_block = [](prog_t* prog, const struct uf2_block* block) { return true; };
+    ASSERT_TRUE(staging_transport.read_uf2(&prog, process_block));
+    EXPECT_TRUE(prog_is_complete(&prog));
+    EXPECT_TRUE(prog.has_vector_table);
+}
+
+TEST_F(StagingSuite, StopsWhenDone) {
+    stage(BOOT_CONTROL_STAGING_DENSE, make_binary(8 * FLASH_PAGE_SIZE));
+
+    ASSERT_TRUE(staging_transport.read_uf2(&prog, [](prog_t* prog, const struct uf2_block* block) {
+        blocks_read.push_back(*block);
+        prog->is_done = true;
+        return true;
+    }));
+
+    EXPECT_EQ(1u, blocks_read.size());
+}
+
+TEST_F(StagingSuite, RejectsCorruptImage) {
+    stage(BOOT_CONTROL_STAGING_DENSE, make_binary(4 * FLASH_PAGE_SIZE));
+
+    // E.g., the firmware lost power after writing the header, but before the image was
+    // fully programmed.
+    flash[STAGING_OFFSET + BOOT_CONTROL_STAGING_DATA_OFFSET + 10] ^= 1;
+
+    EXPECT_TRUE(staging_transport.uf2_exists());
+    EXPECT_FALSE(staging_transport.read_uf2(&prog, record_block));
+    EXPECT_TRUE(blocks_read.empty());
+}
+
+TEST_F(StagingSuite, RejectsInvalidHeader) {
+    const std::vector<uint8_t> binary = make_binary(FLASH_PAGE_SIZE);
+    boot_control_staging_header_t* header = reinterpret_cast<boot_control_staging_header_t*>(&flash[STAGING_OFFSET]);
+
+    stage(/* format: */ 3, binary);
+    EXPECT_FALSE(staging_transport.read_uf2(&prog, record_block));
+
+    stage(BOOT_CONTROL_STAGING_DENSE, binary);
+    header->version = BOOT_CONTROL_STAGING_VERSION + 1;
+    EXPECT_FALSE(staging_transport.read_uf2(&prog, record_block));
+
+    stage(BOOT_CONTROL_STAGING_DENSE, binary);
+    header->size = BOOTLOADER_STAGING_SIZE;
+    EXPECT_FALSE(staging_transport.read_uf2(&prog, record_block));
+
+    // UF2 files are a whole number of blocks.
+    stage(BOOT_CONTROL_STAGING_UF2, binary);
+    EXPECT_FALSE(staging_transport.read_uf2(&prog, record_block));
+
+    EXPECT_TRUE(blocks_read.empty());
+}
+
+TEST_F(StagingSuite, Remove) {
+    stage(BOOT_CONTROL_STAGING_DENSE, make_binary(FLASH_SECTOR_SIZE + FLASH_PAGE_SIZE));
+    ASSERT_TRUE(staging_transport.uf2_exists());
+
+    EXPECT_TRUE(staging_transport.remove_uf2());
+    EXPECT_FALSE(staging_transport.uf2_exists());
+
+    // Only the sector holding the header is erased.
+    ASSERT_EQ(1u, erases.size());
+    EXPECT_EQ(STAGING_OFFSET, erases[0].first);
+    EXPECT_EQ(FLASH_SECTOR_SIZE, erases[0].second);
+}
@@ -0,0 +1,511 @@
+// Runs 'sd_transport.c' and FatFs_SPI against an emulated SD card.  The FAT images are created
+// with 'mkfs.fat' and mtools ('mcopy', 'mdel'), so these tests are skipped if the tools are
+// not installed.
+
+// Standard
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+// POSIX
+#include <stdlib.h>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "flash.h"
+#include "image_header.h"
+#include "prog.h"
+#include "sd_emulator.h"
+#include "sd_host.h"
+#include "transport.h"
+
+static SdEmulator* card = nullptr;
+
+static const sd_host_bus_t card_bus = {
+    .select = [](bool selected) { card->select(selected); },
+    .transfer = [](uint8_t mosi) { return card->transfer(mosi); },
+    .set_clock_hz = [](uint32_t hz) { card->set_clock_hz(hz); },
+};
+
+static bool have_tool(const std::string& name) {
+    return std::system(("command -v " + name + " > /dev/null 2>&1").c_str()) == 0;
+}
+
+static bool run(const std::string& command) {
+    return std::system((command + " > /dev/null 2>&1").c_str()) == 0;
+}
+
+// Returns a UF2 file with 'num_blocks' consecutive 256 byte payloads, starting after the
+// stage 2 bootloader.
+static std::vector<uint8_t> make_uf2(uint32_t num_blocks) {
+    std::vector<uint8_t> file;
+
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        struct uf2_block block = {};
+        block.magic_start0 = UF2_MAGIC_START0;
+        block.magic_start1 = UF2_MAGIC_START1;
+        block.flags = UF2_FLAG_FAMILY_ID_PRESENT;
+        block.target_addr = XIP_BASE + FLASH_PAGE_SIZE * (i + 1);
+        block.payload_size = FLASH_PAGE_SIZE;
+        block.block_no = i;
+        block.num_blocks = num_blocks;
+        block.file_size = RP2040_FAMILY_ID;
+        for (uint32_t j = 0; j < FLASH_PAGE_SIZE; j++) {
+            block.data[j] = (uint8_t) (i + j);
+        }
+        block.magic_end = UF2_MAGIC_END;
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&block);
+        file.insert(file.end(), bytes, bytes + sizeof(block));
+    }
+
+    return file;
+}
+
+// Returns 'firmware' preceded by an image header block for the given version and board.
+static std::vector<uint8_t> make_versioned_uf2(const std::vector<uint8_t>& firmware, uint32_t image_version, const char* board_id) {
+    struct uf2_block block = {};
+    block.magic_start0 = UF2_MAGIC_START0;
+    block.magic_start1 = UF2_MAGIC_START1;
+    block.flags = UF2_FLAG_NOT_MAIN_FLASH | UF2_FLAG_FAMILY_ID_PRESENT;
+    block.payload_size = sizeof(image_header_t);
+    block.file_size = RP2040_FAMILY_ID;
+    block.magic_end = UF2_MAGIC_END;
+
+    image_header_t header = {};
+    header.magic = IMAGE_HEADER_MAGIC;
+    header.version = IMAGE_HEADER_VERSION;
+    header.image_version = image_version;
+    strncpy(header.board_id, board_id, sizeof(header.board_id) - 1);
+    memcpy(block.data, &header, sizeof(header));
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&block);
+    std::vector<uint8_t> file(bytes, bytes + sizeof(block));
+    file.insert(file.end(), firmware.begin(), firmware.end());
+    return file;
+}
+
+// Returns a copy of the UF2 file with each block's family ID replaced and its target address
+// moved by 'offset'.
+static std::vector<uint8_t> relabel_uf2(std::vector<uint8_t> file, uint32_t family_id, uint32_t offset) {
+    for (size_t i = 0; i < file.size(); i += sizeof(struct uf2_block)) {
+        struct uf2_block* block = reinterpret_cast<struct uf2_block*>(&file[i]);
+        block->file_size = family_id;
+        block->target_addr += offset;
+    }
+    return file;
+}
+
+// 'sd_transport.c' reads the installed image record from flash (see 'image_header.h').
+static std::vector<uint8_t> flash(PICO_FLASH_SIZE_BYTES, 0xFF);
+
+const uint8_t* flash_contents(uint32_t flash_offs) {
+    return flash.data() + flash_offs;
+}
+
+static void record_installed(const image_header_t* header) {
+    const image_record_t record = image_record_make(header);
+    memcpy(&flash[IMAGE_RECORD_OFFSET], &record, sizeof(record));
+}
+
+// Blocks received by 'sd_transport.read_uf2()'.
+static std::vector<struct uf2_block> blocks_read;
+
+static bool record_block(prog_t* prog, const struct uf2_block* block) {
+    blocks_read.push_back(*block);
+    return true;
+}
+
+struct ImageOptions {
+    uint32_t size_mb = 64;
+    uint32_t cluster_sectors = 8;       // 'mkfs.fat -s'
+    uint32_t fragments = 0;             // Number of free gaps the firmware is scattered across
+};
+
+class TransportSuite : public ::testing::Test {
+protected:
+    std::string dir;
+    std::string image;
+    std::unique_ptr<SdEmulator> emulator;
+
+    void SetUp() override {
+        if (!have_tool("mkfs.fat") || !have_tool("mcopy") || !have_tool("mdel")) {
+            GTEST_SKIP() << "Requires 'mkfs.fat' and mtools";
+        }
+
+        char path[] = "/tmp/sd_image_XXXXXX";
+        ASSERT_NE(mkdtemp(path), nullptr);
+        dir = path;
+        image = dir + "/sd.img";
+
+        blocks_read.clear();
+        record_installed(nullptr);
+        sd_transport.init();
+    }
+
+    void TearDown() override {
+        sd_host_attach(nullptr);
+        card = nullptr;
+
+        if (!dir.empty()) {
+            run("rm -rf " + dir);
+        }
+    }
+
+    void write_file(const std::string& name, const std::vector<uint8_t>& contents) {
+        std::ofstream file(dir + "/" + name, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+    }
+
+    // Formats a FAT image and copies 'firmware' to it as 'firmware.uf2' (unless empty).
+    void make_image(const std::vector<uint8_t>& firmware, const ImageOptions& options = ImageOptions()) {
+        run("rm -f " + image);
+        ASSERT_TRUE(run("mkfs.fat -C -s " + std::to_string(options.cluster_sectors) + " " + image + " "
+            + std::to_string(options.size_mb * 1024)));
+
+        // To fragment the firmware, fill the start of the volume with small files and delete
+        // every other one.  mtools then allocates the firmware into the gaps.
+        if (options.fragments > 0) {
+            const uint32_t cluster_size = options.cluster_sectors * SdEmulator::block_size;
+            const uint32_t gap_size = (firmware.size() / options.fragments + cluster_size - 1) / cluster_size * cluster_size;
+
+            write_file("filler", std::vector<uint8_t>(gap_size, 0xAA));
+            for (uint32_t i = 0; i < options.fragments * 2; i++) {
+                ASSERT_TRUE(run("mcopy -i " + image + " " + dir + "/filler ::fill" + std::to_string(i)));
+            }
+            for (uint32_t i = 0; i < options.fragments * 2; i += 2) {
+                ASSERT_TRUE(run("mdel -i " + image + " ::fill" + std::to_string(i)));
+            }
+        }
+
+        if (!firmware.empty()) {
+            write_file("firmware.uf2", firmware);
+            ASSERT_TRUE(run("mcopy -i " + image + " " + dir + "/firmware.uf2 ::firmware.uf2"));
+        }
+    }
+
+    // Copies 'contents' to the given path in the firmware directory of the current image.
+    void add_dir_file(const std::string& name, const std::vector<uint8_t>& contents) {
+        run("mmd -i " + image + " ::firmware");
+        write_file(name, contents);
+        ASSERT_TRUE(run("mcopy -i " + image + " " + dir + "/" + name + " ::firmware/" + name));
+    }
+
+    // Inserts the card with the current image.
+    void insert() {
+        emulator.reset(new SdEmulator(SdEmulator::load(image)));
+        card = emulator.get();
+        sd_host_attach(&card_bus);
+    }
+
+    bool read() {
+        prog_t prog = {};
+        blocks_read.clear();
+        return sd_transport.read_uf2(&prog, record_block);
+    }
+
+    void print_stats(const char* label) {
+        const SdEmulator::Stats& stats = card->stats();
+        printf("%-24s %10llu bytes %6u commands (CMD17: %u, CMD18: %u, CMD24: %u, CMD25: %u) %8llu us\n",
+            label,
+            (unsigned long long) stats.bytes_clocked,
+            stats.total_commands(),
+            stats.commands[17], stats.commands[18], stats.commands[24], stats.commands[25],
+            (unsigned long long) card->elapsed_us());
+    }
+};
+
+TEST_F(TransportSuite, NoCard) {
+    sd_host_attach(nullptr);
+    EXPECT_FALSE(sd_transport.uf2_exists());
+}
+
+TEST_F(TransportSuite, NoFirmware) {
+    make_image({});
+    insert();
+    EXPECT_FALSE(sd_transport.uf2_exists());
+
+    prog_t prog = {};
+    EXPECT_FALSE(sd_transport.read_uf2(&prog, record_block));
+}
+
+TEST_F(TransportSuite, ReadFirmware) {
+    const std::vector<uint8_t> firmware = make_uf2(300);
+    make_image(firmware);
+    insert();
+
+    ASSERT_TRUE(sd_transport.uf2_exists());
+    card->reset_stats();
+
+    ASSERT_TRUE(read());
+    ASSERT_EQ(blocks_read.size() * sizeof(struct uf2_block), firmware.size());
+    EXPECT_EQ(0, memcmp(blocks_read.data(), firmware.data(), firmware.size()));
+
+    // Reading never writes to the card.
+    EXPECT_EQ(card->stats().blocks_written, 0u);
+    EXPECT_GE(card->stats().blocks_read, firmware.size() / SdEmulator::block_size);
+    print_stats("read");
+}
+
+TEST_F(TransportSuite, StopsWhenDone) {
+    make_image(make_uf2(300));
+    insert();
+
+    prog_t prog = {};
+    blocks_read.clear();
+    ASSERT_TRUE(sd_transport.read_uf2(&prog, [](prog_t* prog, const struct uf2_block* block) {
+        blocks_read.push_back(*block);
+        prog->is_done = blocks_read.size() == 10;
+        return true;
+    }));
+
+    EXPECT_EQ(blocks_read.size(), 10u);
+}
+
+TEST_F(TransportSuite, RemoveFirmware) {
+    make_image(make_uf2(16));
+    insert();
+    ASSERT_TRUE(sd_transport.uf2_exists());
+
+    EXPECT_TRUE(sd_transport.remove_uf2());
+    EXPECT_GT(card->stats().blocks_written, 0u);
+    EXPECT_FALSE(sd_transport.uf2_exists());
+
+    // The file is also gone after the card is reinserted.
+    ASSERT_TRUE(card->save(image));
+    insert();
+    EXPECT_FALSE(sd_transport.uf2_exists());
+}
+
+TEST_F(TransportSuite, ReinsertedCardIsRemounted) {
+    make_image({});
+    insert();
+    EXPECT_FALSE(sd_transport.uf2_exists());
+
+    make_image(make_uf2(16));
+    insert();
+    EXPECT_TRUE(sd_transport.uf2_exists());
+}
+
+TEST_F(TransportSuite, DirectoryNewest) {
+    const std::vector<uint8_t> newest = make_versioned_uf2(make_uf2(200), 3, "pico");
+
+    make_image({});
+    add_dir_file("v1.uf2", make_versioned_uf2(make_uf2(200), 1, "pico"));
+    add_dir_file("v3.uf2", newest);
+    add_dir_file("v2.uf2", make_versioned_uf2(make_uf2(200), 2, "pico"));
+    add_dir_file("other.uf2", make_versioned_uf2(make_uf2(200), 9, "pico_w"));
+    add_dir_file("plain.uf2", make_uf2(200));
+    add_dir_file("notes.txt", std::vector<uint8_t>(1024, 'x'));
+    insert();
+
+    // Choosing reads only the first block of each file.
+    card->reset_stats();
+    ASSERT_TRUE(sd_transport.uf2_exists());
+    EXPECT_LT(card->stats().blocks_read, 64u);
+    print_stats("choose");
+
+    ASSERT_TRUE(read());
+    ASSERT_EQ(blocks_read.size() * sizeof(struct uf2_block), newest.size());
+    EXPECT_EQ(0, memcmp(blocks_read.data(), newest.data(), newest.size()));
+
+    // Images in the firmware directory are not deleted.
+    EXPECT_TRUE(sd_transport.remove_uf2());
+    EXPECT_EQ(card->stats().blocks_written, 0u);
+}
+
+TEST_F(TransportSuite, DirectorySkipsInstalledVersion) {
+    make_image({});
+    add_dir_file("v2.uf2", make_versioned_uf2(make_uf2(200), 2, "pico"));
+    insert();
+
+    image_header_t installed = {};
+    installed.magic = IMAGE_HEADER_MAGIC;
+    installed.version = IMAGE_HEADER_VERSION;
+    installed.image_version = 2;
+    record_installed(&installed);
+
+    card->reset_stats();
+    EXPECT_FALSE(sd_transport.uf2_exists());
+    EXPECT_LT(card->stats().blocks_read, 16u);
+
+    // A newer image is installed.
+    installed.image_version = 1;
+    record_installed(&installed);
+    EXPECT_TRUE(sd_transport.uf2_exists());
+}
+
+// Each pass opens the image chosen by 'uf2_exists()' without scanning the directory again.
+TEST_F(TransportSuite, DirectoryPassesDoNotRescan) {
+    const std::vector<uint8_t> newest = make_versioned_uf2(make_uf2(200), 40, "pico");
+
+    make_image({});
+    for (uint32_t i = 1; i < 40; i++) {
+        add_dir_file("v" + std::to_string(i) + ".uf2", make_versioned_uf2(make_uf2(8), i, "pico"));
+    }
+    add_dir_file("v40.uf2", newest);
+    insert();
+
+    ASSERT_TRUE(sd_transport.uf2_exists());
+
+    for (int pass = 0; pass < 3; pass++) {
+        card->reset_stats();
+        ASSERT_TRUE(read());
+        ASSERT_EQ(blocks_read.size() * sizeof(struct uf2_block), newest.size());
+
+        // The image itself, plus its FAT and directory sectors, but not the first block of
+        // the other 39 images.
+        EXPECT_LT(card->stats().blocks_read, newest.size() / SdEmulator::block_size + 32u);
+    }
+}
+
+// Once a 'firmware.uf2' without an image header is installed (and deleted), the images in the
+// firmware directory do not replace it.
+TEST_F(TransportSuite, DirectoryKeepsUnversionedInstall) {
+    make_image(make_uf2(16));
+    add_dir_file("v1.uf2", make_versioned_uf2(make_uf2(200), 1, "pico"));
+    insert();
+
+    ASSERT_TRUE(sd_transport.uf2_exists());
+    ASSERT_TRUE(read());
+
+    // As recorded by 'update_firmware()' for a UF2 file without a header.
+    const image_header_t none = {};
+    record_installed(&none);
+    ASSERT_TRUE(sd_transport.remove_uf2());
+
+    EXPECT_FALSE(sd_transport.uf2_exists());
+}
+
+// An image in the firmware directory that fails validation is skipped, falling back to the next
+// newest image, until the card is reinserted.
+TEST_F(TransportSuite, DirectoryRejectedImageIsSkipped) {
+    const std::vector<uint8_t> older = make_versioned_uf2(make_uf2(100), 1, "pico");
+    const std::vector<uint8_t> newer = make_versioned_uf2(make_uf2(200), 2, "pico");
+
+    make_image({});
+    add_dir_file("v1.uf2", older);
+    add_dir_file("v2.uf2", newer);
+    insert();
+
+    ASSERT_TRUE(sd_transport.uf2_exists());
+    ASSERT_TRUE(read());
+    ASSERT_EQ(blocks_read.size() * sizeof(struct uf2_block), newer.size());
+
+    EXPECT_TRUE(sd_transport.reject_uf2());
+    ASSERT_TRUE(sd_transport.uf2_exists());
+    ASSERT_TRUE(read());
+    ASSERT_EQ(blocks_read.size() * sizeof(struct uf2_block), older.size());
+
+    EXPECT_TRUE(sd_transport.reject_uf2());
+    EXPECT_FALSE(sd_transport.uf2_exists());
+
+    // Rejecting an image does not write to the card.
+    EXPECT_EQ(card->stats().blocks_written, 0u);
+
+    insert();
+    EXPECT_TRUE(sd_transport.uf2_exists());
+}
+
+// An invalid 'firmware.uf2' cannot be skipped.
+TEST_F(TransportSuite, FirmwareFileIsNotRejected) {
+    make_image(make_uf2(16));
+    add_dir_file("v1.uf2", make_versioned_uf2(make_uf2(200), 1, "pico"));
+    insert();
+
+    ASSERT_TRUE(sd_transport.uf2_exists());
+    EXPECT_FALSE(sd_transport.reject_uf2());
+    EXPECT_TRUE(sd_transport.uf2_exists());
+}
+
+TEST_F(TransportSuite, FirmwareFilePrecedesDirectory) {
+    const std::vector<uint8_t> firmware = make_uf2(16);
+    make_image(firmware);
+    add_dir_file("v1.uf2", make_versioned_uf2(make_uf2(200), 1, "pico"));
+    insert();
+
+    ASSERT_TRUE(sd_transport.uf2_exists());
+    ASSERT_TRUE(read());
+    ASSERT_EQ(blocks_read.size() * sizeof(struct uf2_block), firmware.size());
+}
+
+// In a combined UF2 file, the programs for other families are skipped without reading them,
+// and reading stops once the RP2040 program is complete.
+TEST_F(TransportSuite, MultiFamilySkipsOtherFamilies) {
+    // Keep the RP2040 program clear of the vector table, which 'process_block()' validates.
+    const std::vector<uint8_t> rp2040 = relabel_uf2(make_uf2(100), RP2040_FAMILY_ID, FLASH_SECTOR_SIZE);
+    const std::vector<uint8_t> other = relabel_uf2(make_uf2(400), RP2350_ARM_S_FAMILY_ID, 0);
+
+    std::vector<uint8_t> firmware = other;
+    firmware.insert(firmware.end(), rp2040.begin(), rp2040.end());
+    firmware.insert(firmware.end(), other.begin(), other.end());
+
+    make_image(firmware);
+    insert();
+    ASSERT_TRUE(sd_transport.uf2_exists());
+    card->reset_stats();
+
+    prog_t prog;
+    prog_init(&prog);
+    prog.accept_block = record_block;
+    blocks_read.clear();
+
+    ASSERT_TRUE(sd_transport.read_uf2(&prog, process_block));
+    EXPECT_TRUE(prog_is_complete(&prog));
+    ASSERT_EQ(blocks_read.size() * sizeof(struct uf2_block), rp2040.size());
+    EXPECT_EQ(0, memcmp(blocks_read.data(), rp2040.data(), rp2040.size()));
+    prog_free(&prog);
+
+    // Only the first block of the leading program for another family is read (plus FAT and
+    // directory sectors), not the 800 blocks of the other programs.
+    EXPECT_LT(card->stats().blocks_read, 100u + 32u);
+    print_stats("multi-family");
+}
+
+// Compares the cost of reading the same firmware from differently laid out cards.  The
+// 'elapsed' time is spent on the bus at the configured baud rate.
+TEST_F(TransportSuite, ReadCost) {
+    const std::vector<uint8_t> firmware = make_uf2(1024);
+
+    struct Case {
+        const char* label;
+        ImageOptions options;
+        uint32_t read_latency_us;
+    };
+
+    const Case cases[] = {
+        { "512B clusters", { 64, 1, 0 }, 0 },
+        { "4kB clusters", { 64, 8, 0 }, 0 },
+        { "32kB clusters", { 64, 64, 0 }, 0 },
+        { "4kB clusters, 16 frags", { 64, 8, 16 }, 0 },
+        { "4kB clusters, 500us", { 64, 8, 0 }, 500 },
+    };
+
+    uint64_t elapsed[std::size(cases)];
+
+    for (size_t i = 0; i < std::size(cases); i++) {
+        make_image(firmware, cases[i].options);
+        insert();
+        card->set_latency_us(17, cases[i].read_latency_us);
+        card->set_latency_us(18, cases[i].read_latency_us);
+
+        ASSERT_TRUE(sd_transport.uf2_exists());
+        card->reset_stats();
+
+        ASSERT_TRUE(read()) << cases[i].label;
+        ASSERT_EQ(blocks_read.size() * sizeof(struct uf2_block), firmware.size()) << cases[i].label;
+
+        print_stats(cases[i].label);
+        elapsed[i] = card->elapsed_us();
+    }
+
+    // Card latency dominates.
+    EXPECT_GT(elapsed[4], elapsed[1]);
+}
@@ -0,0 +1,132 @@
+// Standard
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "tuning.h"
+
+class TuningSuite : public ::testing::Test {
+protected:
+    tuning_t tuning;
+
+    void SetUp() override {
+        tuning_init(&tuning, 12500000);
+    }
+
+    int parse(const std::string& text) {
+        return tuning_parse(&tuning, text.data(), text.size());
+    }
+};
+
+TEST_F(TuningSuite, Defaults) {
+    EXPECT_EQ(parse(""), 0);
+    EXPECT_EQ(tuning.sd_baud_rate, 12500000u);
+    EXPECT_TRUE(tuning.led_progress);
+    EXPECT_TRUE(tuning.skip_identical);
+}
+
+TEST_F(TuningSuite, Settings) {
+    EXPECT_EQ(parse(
+        "# Tuned for the new card\n"
+        "sd_baud_rate=20000000\n"
+        "  led_progress = off  # Keep the enclosure dark\r\n"
+        "\n"
+        "\tskip_identical\t=\tfalse"), 0);
+
+    EXPECT_EQ(tuning.sd_baud_rate, 20000000u);
+    EXPECT_FALSE(tuning.led_progress);
+    EXPECT_FALSE(tuning.skip_identical);
+
+    EXPECT_EQ(parse("led_progress=1\nskip_identical=on\n"), 0);
+    EXPECT_TRUE(tuning.led_progress);
+    EXPECT_TRUE(tuning.skip_identical);
+}
+
+// Ignored lines keep the previous value.
+TEST_F(TuningSuite, Ignored) {
+    EXPECT_EQ(parse(
+        "sd_baud_rate\n"                            // No value
+        "sd_baud_rate=\n"                           // Empty value
+        "sd_baud_rate=20MHz\n"                      // Not a number
+        "sd_baud_rate=-1\n"
+        "sd_baud_rate=4294967296\n"                 // Overflow
+        "sd_baud_rate=99999999999999999999\n"
+        "led_progress=maybe\n"
+        "led_progress=OFF\n"                        // Case-sensitive
+        "skip_identical=0 1\n"
+        "sd baud rate=20000000\n"
+        "unknown=1\n"
+        "=1\n"), 12);
+
+    EXPECT_EQ(tuning.sd_baud_rate, 12500000u);
+    EXPECT_TRUE(tuning.led_progress);
+    EXPECT_TRUE(tuning.skip_identical);
+}
+
+TEST_F(TuningSuite, BaudRateBounds) {
+    EXPECT_EQ(parse("sd_baud_rate=" + std::to_string(BOOTLOADER_SD_BAUD_RATE_MIN - 1)), 1);
+    EXPECT_EQ(parse("sd_baud_rate=" + std::to_string(BOOTLOADER_SD_BAUD_RATE_MAX + 1)), 1);
+    EXPECT_EQ(tuning.sd_baud_rate, 12500000u);
+
+    EXPECT_EQ(parse("sd_baud_rate=" + std::to_string(BOOTLOADER_SD_BAUD_RATE_MIN)), 0);
+    EXPECT_EQ(tuning.sd_baud_rate, (uint32_t) BOOTLOADER_SD_BAUD_RATE_MIN);
+
+    EXPECT_EQ(parse("sd_baud_rate=" + std::to_string(BOOTLOADER_SD_BAUD_RATE_MAX)), 0);
+    EXPECT_EQ(tuning.sd_baud_rate, (uint32_t) BOOTLOADER_SD_BAUD_RATE_MAX);
+}
+
+// Only the given bytes are read, so a value cut short by the length is parsed as such.
+TEST_F(TuningSuite, StopsAtLength) {
+    const std::string text = "sd_baud_rate=1000000999";
+    EXPECT_EQ(tuning_parse(&tuning, text.data(), text.size() - 3), 0);
+    EXPECT_EQ(tuning.sd_baud_rate, 1000000u);
+
+    EXPECT_EQ(tuning_parse(&tuning, nullptr, 0), 0);
+}
+
+// Parses random and mutated files, checking that every setting stays within bounds.  The
+// inputs are copied to exactly sized heap buffers, so that AddressSanitizer (if enabled)
+// reports any read past the end.
+TEST_F(TuningSuite, Fuzz) {
+    static const char* const seeds[] = {
+        "sd_baud_rate=20000000\nled_progress=off\nskip_identical=false\n",
+        "# comment\n  sd_baud_rate = 400000 # slow card\r\n",
+        "led_progress=1\nskip_identical=on",
+    };
+    static const char alphabet[] = "sd_baud_rate=led_progress#skip_identical \t\r\n0123456789onfftrue";
+
+    uint32_t state = 0x2545F491;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    for (int i = 0; i < 100000; i++) {
+        std::string text = seeds[next() % (sizeof(seeds) / sizeof(seeds[0]))];
+
+        const int num_mutations = 1 + next() % 8;
+        for (int m = 0; m < num_mutations; m++) {
+            const size_t pos = text.empty() ? 0 : next() % text.size();
+            switch (next() % 4) {
+                case 0: text.insert(pos, 1, alphabet[next() % (sizeof(alphabet) - 1)]); break;
+                case 1: if (!text.empty()) { text.erase(pos, 1); } break;
+                case 2: if (!text.empty()) { text[pos] = (char) next(); } break;
+                case 3: text.resize(next() % (TUNING_MAX_FILE_SIZE + 1), (char) next()); break;
+            }
+        }
+
+        std::vector<char> buffer(text.begin(), text.end());
+        tuning_init(&tuning, 12500000);
+        const int num_ignored = tuning_parse(&tuning, buffer.data(), buffer.size());
+
+        ASSERT_GE(num_ignored, 0);
+        ASSERT_LE((size_t) num_ignored, buffer.size());
+        ASSERT_TRUE(tuning.sd_baud_rate == 12500000u
+            || (BOOTLOADER_SD_BAUD_RATE_MIN <= tuning.sd_baud_rate && tuning.sd_baud_rate <= BOOTLOADER_SD_BAUD_RATE_MAX));
+    }
+}
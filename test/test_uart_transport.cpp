@@ -0,0 +1,268 @@
+// Runs 'uart_transport.c' against a host peer ('uart_peer.cpp') over a pseudo-terminal.
+
+// For posix_openpt(), etc.
+#define _XOPEN_SOURCE 600
+
+// Standard
+#include <memory>
+#include <string.h>
+#include <vector>
+
+// POSIX
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "image_builder.h"
+#include "prog.h"
+#include "transport.h"
+#include "uart_link_posix.h"
+#include "uart_peer.h"
+#include "uart_proto.h"
+
+static_assert(sizeof(struct uf2_block) == UART_PROTO_MAX_PAYLOAD, "DATA frames hold one UF2 block");
+
+// Decodes a byte stream, returning the frames received.
+static std::vector<uart_frame_t> decode(const std::vector<uint8_t>& bytes, uint32_t* corrupt = nullptr) {
+    uart_decoder_t decoder;
+    uart_decoder_reset(&decoder);
+
+    std::vector<uart_frame_t> frames;
+    for (uint8_t byte : bytes) {
+        switch (uart_decoder_put(&decoder, byte)) {
+            case UART_DECODE_FRAME: frames.push_back(decoder.frame); break;
+            case UART_DECODE_CORRUPT: if (corrupt) { (*corrupt)++; } break;
+            default: break;
+        }
+    }
+    return frames;
+}
+
+static std::vector<uint8_t> encode(uint8_t type, uint16_t seq, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> frame(UART_PROTO_MAX_FRAME_SIZE);
+    frame.resize(uart_proto_encode(frame.data(), type, seq, payload.data(), static_cast<uint16_t>(payload.size())));
+    return frame;
+}
+
+TEST(UartProtoSuite, RoundTrip) {
+    std::vector<uint8_t> payload(UART_PROTO_MAX_PAYLOAD);
+    for (size_t i = 0; i < payload.size(); i++) { payload[i] = static_cast<uint8_t>(i * 13); }
+
+    std::vector<uint8_t> bytes = encode(UART_PROTO_DATA, 0x1234, payload);
+    ASSERT_EQ(UART_PROTO_MAX_FRAME_SIZE, bytes.size());
+
+    const std::vector<uint8_t> end = encode(UART_PROTO_END, 7, {});
+    ASSERT_EQ(UART_PROTO_HEADER_SIZE + UART_PROTO_CRC_SIZE, end.size());
+    bytes.insert(bytes.end(), end.begin(), end.end());
+
+    const std::vector<uart_frame_t> frames = decode(bytes);
+    ASSERT_EQ(2u, frames.size());
+
+    EXPECT_EQ(UART_PROTO_DATA, frames[0].type);
+    EXPECT_EQ(0x1234, frames[0].seq);
+    ASSERT_EQ(payload.size(), frames[0].length);
+    EXPECT_EQ(0, memcmp(payload.data(), frames[0].payload, payload.size()));
+
+    EXPECT_EQ(UART_PROTO_END, frames[1].type);
+    EXPECT_EQ(7, frames[1].seq);
+    EXPECT_EQ(0, frames[1].length);
+}
+
+TEST(UartProtoSuite, SkipsNoise) {
+    // E.g., a console or boot messages on the line before the first frame.
+    std::vector<uint8_t> bytes = { 'h', 'e', 'l', 'l', 'o', '\r', '\n' };
+    const std::vector<uint8_t> frame = encode(UART_PROTO_NONE, 0, {});
+    bytes.insert(bytes.end(), frame.begin(), frame.end());
+
+    uint32_t corrupt = 0;
+    const std::vector<uart_frame_t> frames = decode(bytes, &corrupt);
+    ASSERT_EQ(1u, frames.size());
+    EXPECT_EQ(UART_PROTO_NONE, frames[0].type);
+    EXPECT_EQ(0u, corrupt);
+}
+
+TEST(UartProtoSuite, RejectsCorruptFrames) {
+    std::vector<uint8_t> bad_crc = encode(UART_PROTO_DATA, 1, std::vector<uint8_t>(16, 0xAA));
+    bad_crc[UART_PROTO_HEADER_SIZE + 3] ^= 1;
+
+    // A length beyond the maximum payload is rejected as soon as the header is received.
+    std::vector<uint8_t> bad_length = encode(UART_PROTO_DATA, 2, {});
+    bad_length[4] = 0xFF;
+    bad_length[5] = 0xFF;
+    bad_length.resize(UART_PROTO_HEADER_SIZE);
+
+    std::vector<uint8_t> bytes = bad_crc;
+    bytes.insert(bytes.end(), bad_length.begin(), bad_length.end());
+    const std::vector<uint8_t> good = encode(UART_PROTO_END, 3, {});
+    bytes.insert(bytes.end(), good.begin(), good.end());
+
+    uint32_t corrupt = 0;
+    const std::vector<uart_frame_t> frames = decode(bytes, &corrupt);
+    EXPECT_EQ(2u, corrupt);
+    ASSERT_EQ(1u, frames.size());
+    EXPECT_EQ(UART_PROTO_END, frames[0].type);
+    EXPECT_EQ(3, frames[0].seq);
+}
+
+// Blocks received from 'read_uf2()'.
+static std::vector<struct uf2_block> blocks_read;
+
+static bool record_block(prog_t* prog, const struct uf2_block* block) {
+    blocks_read.push_back(*block);
+    return true;
+}
+
+class UartTransportSuite : public ::testing::Test {
+protected:
+    int host_fd = -1;       // Peer side of the pseudo-terminal
+    int device_fd = -1;     // Bootloader side of the pseudo-terminal
+    prog_t prog;
+
+    void SetUp() override {
+        host_fd = posix_openpt(O_RDWR | O_NOCTTY);
+        ASSERT_GE(host_fd, 0);
+        ASSERT_EQ(0, grantpt(host_fd));
+        ASSERT_EQ(0, unlockpt(host_fd));
+
+        device_fd = open(ptsname(host_fd), O_RDWR | O_NOCTTY);
+        ASSERT_GE(device_fd, 0);
+
+        // Pass bytes through unmodified, as a UART does.
+        struct termios tio;
+        ASSERT_EQ(0, tcgetattr(device_fd, &tio));
+        cfmakeraw(&tio);
+        ASSERT_EQ(0, tcsetattr(device_fd, TCSANOW, &tio));
+
+        uart_link_posix_attach(device_fd);
+        uart_transport.init();
+
+        blocks_read.clear();
+        prog_init(&prog);
+    }
+
+    void TearDown() override {
+        prog_free(&prog);
+        uart_link_posix_attach(-1);
+        close(device_fd);
+        close(host_fd);
+    }
+
+    static std::vector<struct uf2_block> make_blocks(uint32_t count) {
+        ImageBuilder image;
+        for (uint32_t i = 0; i < count; i++) {
+            image.add_page(i * FLASH_PAGE_SIZE, static_cast<uint8_t>(i));
+        }
+        return image.flash_blocks();
+    }
+
+    static std::vector<uint8_t> to_file(const std::vector<struct uf2_block>& blocks) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(blocks.data());
+        return std::vector<uint8_t>(bytes, bytes + blocks.size() * sizeof(struct uf2_block));
+    }
+
+    // Reads the file from the peer and checks that it arrived intact.
+    void expect_read(const std::vector<struct uf2_block>& blocks) {
+        blocks_read.clear();
+        ASSERT_TRUE(uart_transport.read_uf2(&prog, record_block));
+        ASSERT_EQ(blocks.size(), blocks_read.size());
+        EXPECT_EQ(0, memcmp(blocks.data(), blocks_read.data(), blocks.size() * sizeof(struct uf2_block)));
+    }
+};
+
+TEST_F(UartTransportSuite, NoPeer) {
+    EXPECT_FALSE(uart_transport.uf2_exists());
+}
+
+TEST_F(UartTransportSuite, NothingOffered) {
+    UartPeer peer(host_fd, {});
+    EXPECT_FALSE(uart_transport.uf2_exists());
+    EXPECT_EQ(1u, peer.stats().probes);
+}
+
+TEST_F(UartTransportSuite, ReadsEachPass) {
+    const std::vector<struct uf2_block> blocks = make_blocks(40);
+    UartPeer peer(host_fd, to_file(blocks));
+
+    ASSERT_TRUE(uart_transport.uf2_exists());
+
+    // The update reads the file once per pass.
+    expect_read(blocks);
+    expect_read(blocks);
+
+    const UartPeer::Stats stats = peer.stats();
+    EXPECT_EQ(2u, stats.reads);
+    EXPECT_EQ(0u, stats.naks);
+    EXPECT_EQ(2 * blocks.size(), stats.data_frames);
+}
+
+TEST_F(UartTransportSuite, StopsWhenDone) {
+    const std::vector<struct uf2_block> blocks = make_blocks(40);
+    UartPeer peer(host_fd, to_file(blocks));
+
+    ASSERT_TRUE(uart_transport.read_uf2(&prog, [](prog_t* prog, const struct uf2_block* block) {
+        blocks_read.push_back(*block);
+        prog->is_done = blocks_read.size() == 3;
+        return true;
+    }));
+    EXPECT_EQ(3u, blocks_read.size());
+
+    // The peer stops streaming, and the next read starts from the beginning.
+    prog.is_done = false;
+    expect_read(blocks);
+    EXPECT_EQ(1u, peer.stats().stops);
+}
+
+TEST_F(UartTransportSuite, StopsOnError) {
+    const std::vector<struct uf2_block> blocks = make_blocks(10);
+    UartPeer peer(host_fd, to_file(blocks));
+
+    EXPECT_FALSE(uart_transport.read_uf2(&prog, [](prog_t* prog, const struct uf2_block* block) {
+        return false;
+    }));
+    expect_read(blocks);
+}
+
+TEST_F(UartTransportSuite, RecoversFromCorruptFrames) {
+    const std::vector<struct uf2_block> blocks = make_blocks(64);
+    UartPeer::Options options;
+    options.corrupt_every = 7;
+    UartPeer peer(host_fd, to_file(blocks), options);
+
+    expect_read(blocks);
+    EXPECT_GT(peer.stats().naks, 0u);
+}
+
+TEST_F(UartTransportSuite, RecoversFromDroppedFrames) {
+    const std::vector<struct uf2_block> blocks = make_blocks(64);
+    UartPeer::Options options;
+    options.drop_every = 5;
+    UartPeer peer(host_fd, to_file(blocks), options);
+
+    expect_read(blocks);
+    EXPECT_GT(peer.stats().naks, 0u);
+}
+
+TEST_F(UartTransportSuite, FailsWhenPeerGoesAway) {
+    const std::vector<struct uf2_block> blocks = make_blocks(10);
+    {
+        UartPeer peer(host_fd, to_file(blocks));
+        ASSERT_TRUE(uart_transport.uf2_exists());
+    }
+
+    EXPECT_FALSE(uart_transport.read_uf2(&prog, record_block));
+    EXPECT_TRUE(blocks_read.empty());
+}
+
+TEST_F(UartTransportSuite, Remove) {
+    UartPeer peer(host_fd, to_file(make_blocks(4)));
+    ASSERT_TRUE(uart_transport.uf2_exists());
+
+    EXPECT_TRUE(uart_transport.remove_uf2());
+    EXPECT_TRUE(peer.stats().removed);
+    EXPECT_FALSE(uart_transport.uf2_exists());
+}
@@ -0,0 +1,42 @@
+// Standard
+#include <cstddef>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// Project
+#include "crc32.h"
+#include "update_log.h"
+
+TEST(UpdateLogSuite, Init) {
+    update_log_record_t record;
+    memset(&record, 0xAA, sizeof(record));
+    update_log_init(&record);
+
+    EXPECT_EQ(record.magic, UPDATE_LOG_MAGIC);
+    EXPECT_EQ(record.version, UPDATE_LOG_VERSION);
+    EXPECT_EQ(record.size, sizeof(update_log_record_t));
+    EXPECT_EQ(memcmp(&record, "BULG", 4), 0);
+
+    for (int phase = 0; phase < UPDATE_LOG_NUM_PHASES; phase++) {
+        EXPECT_EQ(record.phase_us[phase], 0u);
+    }
+    EXPECT_EQ(record.result, 0u);
+    EXPECT_EQ(record.reserved[0] | record.reserved[1] | record.reserved[2], 0);
+}
+
+TEST(UpdateLogSuite, Seal) {
+    update_log_record_t record;
+    update_log_init(&record);
+    record.image_size = 0x10000;
+    record.phase_us[UPDATE_PHASE_WRITE] = 123456;
+    update_log_seal(&record);
+
+    EXPECT_EQ(record.crc, crc32_update(0, &record, offsetof(update_log_record_t, crc)));
+
+    // The CRC covers every field before it.
+    const uint32_t sealed = record.crc;
+    record.result = 1;
+    update_log_seal(&record);
+    EXPECT_NE(record.crc, sealed);
+}
@@ -0,0 +1,91 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Host implementation of 'uart_link.h', which replaces the RP2040's UART and DMA ring buffer
+// with a file descriptor.
+
+// For poll()
+#define _POSIX_C_SOURCE 200112L
+
+// Standard
+#include <errno.h>
+#include <stdint.h>
+
+// POSIX
+#include <poll.h>
+#include <unistd.h>
+
+// Project
+#include "uart_link.h"
+#include "uart_link_posix.h"
+
+static int link_fd = -1;
+static uint8_t rx_buffer[256];
+static size_t rx_pos = 0;
+static size_t rx_len = 0;
+
+void uart_link_posix_attach(int fd) {
+    link_fd = fd;
+    rx_pos = rx_len = 0;
+}
+
+void uart_link_init(void) {}
+
+// Waits up to 'timeout_ms' for input.  A timeout of 0 returns immediately.
+static bool fill(int timeout_ms) {
+    if (link_fd < 0) {
+        return false;
+    }
+
+    struct pollfd pfd = { .fd = link_fd, .events = POLLIN };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+
+    if (ready <= 0 || !(pfd.revents & POLLIN)) {
+        return false;
+    }
+
+    const ssize_t count = read(link_fd, rx_buffer, sizeof(rx_buffer));
+    if (count <= 0) {
+        return false;
+    }
+
+    rx_pos = 0;
+    rx_len = (size_t) count;
+    return true;
+}
+
+bool uart_link_getc(uint8_t* byte, uint32_t timeout_us) {
+    if (rx_pos == rx_len && !fill((int) ((timeout_us + 999) / 1000))) {
+        return false;
+    }
+
+    *byte = rx_buffer[rx_pos++];
+    return true;
+}
+
+void uart_link_drain(void) {
+    rx_pos = rx_len = 0;
+    while (fill(/* timeout_ms: */ 0)) {
+        rx_pos = rx_len = 0;
+    }
+}
+
+void uart_link_write(const uint8_t* data, size_t length) {
+    while (link_fd >= 0 && length > 0) {
+        const ssize_t count = write(link_fd, data, length);
+        if (count < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return;
+        }
+
+        data += count;
+        length -= (size_t) count;
+    }
+}
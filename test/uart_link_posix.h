@@ -0,0 +1,19 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Connects 'uart_link.h' to the given file descriptor (e.g., the device side of a
+// pseudo-terminal), or disconnects it if 'fd' is negative.  Reads time out immediately
+// while disconnected and writes are discarded.
+void uart_link_posix_attach(int fd);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,199 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+// Standard
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+
+// POSIX
+#include <poll.h>
+#include <unistd.h>
+
+// Project
+#include "uart_peer.h"
+
+UartPeer::UartPeer(int fd, std::vector<uint8_t> file, Options options)
+    : fd(fd),
+      file(std::move(file)),
+      options(options),
+      num_blocks(static_cast<uint32_t>(this->file.size() / UART_PROTO_MAX_PAYLOAD)),
+      thread(&UartPeer::run, this) {}
+
+UartPeer::~UartPeer() {
+    stopping = true;
+    thread.join();
+}
+
+UartPeer::Stats UartPeer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+uint32_t UartPeer::unwrap(uint16_t seq) const {
+    return base + static_cast<int16_t>(seq - static_cast<uint16_t>(base));
+}
+
+void UartPeer::send(uint8_t type, uint16_t seq, const void* payload, uint16_t length) {
+    uint8_t buffer[UART_PROTO_MAX_FRAME_SIZE];
+    const size_t size = uart_proto_encode(buffer, type, seq, payload, length);
+
+    if (type == UART_PROTO_DATA) {
+        const uint32_t count = ++counters.data_frames;
+
+        if (options.drop_every != 0 && count % options.drop_every == 0) {
+            return;
+        }
+
+        if (options.corrupt_every != 0 && count % options.corrupt_every == 0) {
+            buffer[UART_PROTO_HEADER_SIZE + count % length] ^= 0x10;
+        }
+    }
+
+    for (size_t offset = 0; offset < size;) {
+        const ssize_t written = write(fd, buffer + offset, size - offset);
+        if (written < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return;
+        }
+        offset += static_cast<size_t>(written);
+    }
+}
+
+void UartPeer::send_data(uint32_t index) {
+    if (index == num_blocks) {
+        send(UART_PROTO_END, static_cast<uint16_t>(index), nullptr, 0);
+    } else {
+        send(UART_PROTO_DATA, static_cast<uint16_t>(index),
+            &file[index * UART_PROTO_MAX_PAYLOAD], UART_PROTO_MAX_PAYLOAD);
+    }
+}
+
+void UartPeer::handle(const uart_frame_t& frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    switch (frame.type) {
+        case UART_PROTO_PROBE: {
+            counters.probes++;
+            streaming = false;
+
+            if (num_blocks > 0 && !counters.removed) {
+                const uint8_t payload[] = {
+                    static_cast<uint8_t>(num_blocks),
+                    static_cast<uint8_t>(num_blocks >> 8),
+                    static_cast<uint8_t>(num_blocks >> 16),
+                    static_cast<uint8_t>(num_blocks >> 24),
+                };
+                send(UART_PROTO_OFFER, 0, payload, sizeof(payload));
+            } else {
+                send(UART_PROTO_NONE, 0, nullptr, 0);
+            }
+            break;
+        }
+
+        case UART_PROTO_READ:
+            counters.reads++;
+            streaming = true;
+            base = next = 0;
+            break;
+
+        case UART_PROTO_ACK: {
+            const uint32_t acked = unwrap(frame.seq);
+            if (streaming && acked > base && acked <= next) {
+                base = acked;
+
+                // The device acknowledges END with the number of blocks.
+                if (base == num_blocks && next > num_blocks) {
+                    streaming = false;
+                }
+            }
+            break;
+        }
+
+        case UART_PROTO_NAK: {
+            // Go back to the first block the device is missing.  (This also resends END if
+            // it was lost after the last block was acknowledged.)
+            counters.naks++;
+            const uint32_t missing = unwrap(frame.seq);
+            if (missing <= num_blocks) {
+                streaming = true;
+                base = next = missing;
+            }
+            break;
+        }
+
+        case UART_PROTO_STOP:
+            counters.stops++;
+            streaming = false;
+            break;
+
+        case UART_PROTO_REMOVE:
+            counters.removed = true;
+            streaming = false;
+            send(UART_PROTO_REMOVED, 0, nullptr, 0);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void UartPeer::run() {
+    uart_decoder_t decoder;
+    uart_decoder_reset(&decoder);
+
+    // Poll in short slices so that the destructor does not wait for a full timeout.
+    const int slice_ms = std::min(options.timeout_ms, 10);
+    auto last_heard = std::chrono::steady_clock::now();
+
+    while (!stopping) {
+        {
+            // Fill the window.
+            std::lock_guard<std::mutex> lock(mutex);
+            while (streaming && next <= num_blocks && next < base + options.window) {
+                send_data(next++);
+            }
+        }
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        const int ready = poll(&pfd, 1, slice_ms);
+
+        if (ready == 0) {
+            if (std::chrono::steady_clock::now() - last_heard < std::chrono::milliseconds(options.timeout_ms)) {
+                continue;
+            }
+
+            // Nothing heard from the device: resend the window.
+            std::lock_guard<std::mutex> lock(mutex);
+            if (streaming) {
+                counters.timeouts++;
+                next = base;
+            }
+            last_heard = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        uint8_t bytes[256];
+        const ssize_t count = (ready > 0 && (pfd.revents & POLLIN))
+            ? read(fd, bytes, sizeof(bytes))
+            : -1;
+
+        if (count <= 0) {
+            // The device side was closed (or the poll was interrupted).
+            usleep(1000);
+            continue;
+        }
+
+        last_heard = std::chrono::steady_clock::now();
+
+        for (ssize_t i = 0; i < count; i++) {
+            if (uart_decoder_put(&decoder, bytes[i]) == UART_DECODE_FRAME) {
+                handle(decoder.frame);
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * https://github.com/DLehenbauer/pico-sdcard-bootloader
+ * SPDX-License-Identifier: 0BSD
+ */
+
+#pragma once
+
+// Standard
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Project
+#include "uart_proto.h"
+
+// The host side of the UART transport protocol (see 'uart_proto.h'), as run by a factory
+// station.  Serves a UF2 file over a file descriptor (e.g., the host side of a
+// pseudo-terminal) on a background thread.  Frames can be corrupted or dropped to exercise
+// the device's recovery.
+class UartPeer {
+public:
+    struct Options {
+        uint32_t window = UART_PROTO_WINDOW;
+        uint32_t corrupt_every = 0;     // Corrupt every Nth DATA frame sent (0 = never)
+        uint32_t drop_every = 0;        // Drop every Nth DATA frame sent (0 = never)
+        int timeout_ms = 200;           // Resend unacknowledged frames after this long
+    };
+
+    struct Stats {
+        uint32_t probes = 0;            // PROBE requests received
+        uint32_t reads = 0;             // READ requests received
+        uint32_t naks = 0;              // NAKs received
+        uint32_t stops = 0;             // STOPs received
+        uint32_t timeouts = 0;          // Windows resent after a timeout
+        uint32_t data_frames = 0;       // DATA frames sent (including retransmissions)
+        bool removed = false;           // The device removed the file
+    };
+
+    // Serves 'file' (a whole number of UF2 blocks).  An empty file is not offered.
+    UartPeer(int fd, std::vector<uint8_t> file, Options options);
+    UartPeer(int fd, std::vector<uint8_t> file) : UartPeer(fd, std::move(file), Options()) {}
+    ~UartPeer();
+
+    Stats stats() const;
+
+private:
+    void run();
+    void handle(const uart_frame_t& frame);
+    void send(uint8_t type, uint16_t seq, const void* payload, uint16_t length);
+    void send_data(uint32_t index);
+
+    // Converts a 16-bit sequence number from the device to a block index near 'base'.
+    uint32_t unwrap(uint16_t seq) const;
+
+    const int fd;
+    const std::vector<uint8_t> file;
+    const Options options;
+    const uint32_t num_blocks;
+
+    // Go-back-N state: blocks before 'base' are acknowledged, and blocks before 'next' have
+    // been sent.  Index 'num_blocks' is the END frame.
+    bool streaming = false;
+    uint32_t base = 0;
+    uint32_t next = 0;
+
+    mutable std::mutex mutex;
+    Stats counters;
+
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};